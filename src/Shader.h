@@ -8,10 +8,13 @@
 #include <expected>
 
 #include <glad/glad.h>
+#include <array>
 #include <string_view>
 #include <glm/glm.hpp>
 #include <vector>
 
+#include <profiler.h>
+
 namespace sjd {
 
 enum class SHADER_ERROR {
@@ -25,6 +28,28 @@ enum class SHADER_ERROR {
 template <typename T>
 using ErrShader = std::expected<T, SHADER_ERROR>;
 
+// Texture units kept for samplers that engine modules bind themselves, at
+// the top of the 16 units GL 3.3 guarantees so material maps can count up
+// from 0 without meeting them. GL forbids samplers of different types on
+// one unit, so every program that declares one of these samplers gets its
+// unit assigned when it is linked, before anything else is bound.
+const GLint IRRADIANCE_MAP_UNIT {11};
+const GLint PREFILTERED_MAP_UNIT {12};
+const GLint SHADOW_MAP_UNIT {13};
+const GLint JOINT_PALETTE_UNIT {14};
+
+struct ReservedSampler {
+    const char* name;
+    GLint unit;
+};
+
+const std::array<ReservedSampler, 4> RESERVED_SAMPLERS {{
+    {"irradianceMap", IRRADIANCE_MAP_UNIT},
+    {"prefilteredMap", PREFILTERED_MAP_UNIT},
+    {"shadowMap", SHADOW_MAP_UNIT},
+    {"jointPalette", JOINT_PALETTE_UNIT},
+}};
+
 
 class Shader {
 public:
@@ -36,6 +61,12 @@ public:
            const std::string& fragmentPath,
            const std::string& geometryPath);
 
+    // vertex-only program whose outputs are captured by transform feedback,
+    // interleaved into one buffer in the order named; draw with
+    // GL_RASTERIZER_DISCARD enabled
+    Shader(const std::string& vertexPath,
+           const std::vector<std::string>& feedbackVaryings);
+
     auto id() const -> const GLuint& { return m_id; }
     auto isValid() const -> const bool& { return m_isValid; }
     auto errMsg() const -> std::string_view { return m_errMsg; }
@@ -43,6 +74,7 @@ public:
     // use/activate the shader
     void use() const {
         if (m_isValid) {
+            MAGE_COUNT_STATE_CHANGE();
             glUseProgram(m_id);
         } 
         else {
@@ -54,7 +86,9 @@ public:
     void setUniform(const std::string& name, bool value) const;
     void setUniform(const std::string& name, int value) const;
     void setUniform(const std::string& name, float value) const;
+    void setUniform(const std::string& name, const glm::vec2& vec) const;
     void setUniform(const std::string& name, const glm::vec3& vec) const;
+    void setUniform(const std::string& name, const glm::vec4& vec) const;
     void setUniform(const std::string& name, const glm::mat4& mat) const;
 
 protected:
@@ -73,7 +107,9 @@ protected:
                             std::string shaderSource) -> ErrShader<GLuint>;
     bool _linkProgram(GLuint vertShader, GLuint fragShader);
     bool _linkProgram(GLuint vertShader, GLuint fragShader, GLuint geomShader);
+    bool _linkProgram(GLuint vertShader, const std::vector<std::string>& feedbackVaryings);
     bool _reportLinkingErrors(GLuint programId);
+    void _assignReservedSamplers() const;
 };
 
 }
@@ -0,0 +1,199 @@
+#include <animation.h>
+#include <profiler.h>
+#include <shader.h>
+#include <cmath>
+#include <iostream>
+
+namespace sjd {
+
+auto Skeleton::isValid() const -> bool {
+    if (bindPose.size() != parents.size() || inverseBind.size() != parents.size()) {
+        return false;
+    }
+    for (size_t joint {0}; joint < parents.size(); joint++) {
+        if (parents[joint] >= static_cast<int32_t>(joint)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+auto makeJointChain(uint32_t joints, float spacing) -> Skeleton {
+    Skeleton skeleton {};
+    for (uint32_t joint {0}; joint < joints; joint++) {
+        skeleton.parents.push_back(static_cast<int32_t>(joint) - 1);
+        Transform local {};
+        local.position = glm::vec3(0.0f, joint == 0 ? 0.0f : spacing, 0.0f);
+        skeleton.bindPose.push_back(local);
+        skeleton.inverseBind.push_back(glm::translate(glm::mat4(1.0f),
+                                                      glm::vec3(0.0f, -spacing * joint, 0.0f)));
+    }
+    return skeleton;
+}
+
+void AnimationClip::sample(const Skeleton& skeleton,
+                           float time,
+                           std::vector<Transform>& localPose) const {
+    localPose = skeleton.bindPose;
+    if (duration > 0.0f) {
+        if (loop) {
+            time = std::fmod(time, duration);
+            if (time < 0.0f) {
+                time += duration;
+            }
+        }
+        else {
+            time = std::clamp(time, 0.0f, duration);
+        }
+    }
+    for (const AnimationTrack& track : tracks) {
+        if (track.keys.empty() || track.joint >= localPose.size()) {
+            continue;
+        }
+        auto after {std::upper_bound(track.times.begin(), track.times.end(), time)};
+        if (after == track.times.begin()) {
+            localPose[track.joint] = track.keys.front();
+            continue;
+        }
+        if (after == track.times.end()) {
+            localPose[track.joint] = track.keys.back();
+            continue;
+        }
+        size_t key {static_cast<size_t>(after - track.times.begin())};
+        float span {track.times[key] - track.times[key - 1]};
+        float alpha {span > 0.0f ? (time - track.times[key - 1]) / span : 0.0f};
+        localPose[track.joint] = interpolate(track.keys[key - 1], track.keys[key], alpha);
+    }
+}
+
+auto makeSwayClip(const Skeleton& skeleton,
+                  float duration,
+                  float amplitudeRadians,
+                  uint32_t keysPerSecond) -> AnimationClip {
+    AnimationClip clip {};
+    clip.duration = duration;
+    uint32_t keys {std::max(static_cast<uint32_t>(std::ceil(duration * keysPerSecond)), 1u) + 1};
+    size_t joints {skeleton.jointCount()};
+    for (size_t joint {0}; joint < joints; joint++) {
+        AnimationTrack track {};
+        track.joint = static_cast<uint32_t>(joint);
+        float phase {joints > 1
+                     ? 0.5f * glm::pi<float>() * static_cast<float>(joint) / static_cast<float>(joints - 1)
+                     : 0.0f};
+        for (uint32_t key {0}; key < keys; key++) {
+            float time {duration * static_cast<float>(key) / static_cast<float>(keys - 1)};
+            float angle {amplitudeRadians
+                         * std::sin(2.0f * glm::pi<float>() * time / duration - phase)};
+            Transform transform {skeleton.bindPose[joint]};
+            transform.rotation = glm::angleAxis(angle, glm::vec3(0.0f, 0.0f, 1.0f));
+            track.times.push_back(time);
+            track.keys.push_back(transform);
+        }
+        clip.tracks.push_back(std::move(track));
+    }
+    return clip;
+}
+
+auto toJointRows(const glm::mat4& matrix) -> JointRows {
+    JointRows joint {};
+    for (int row {0}; row < 3; row++) {
+        joint.rows[row] = glm::vec4(matrix[0][row], matrix[1][row], matrix[2][row], matrix[3][row]);
+    }
+    return joint;
+}
+
+void computeSkinningPalette(const Skeleton& skeleton,
+                            const std::vector<Transform>& localPose,
+                            const glm::mat4& model,
+                            JointRows* palette) {
+    // reused by every character a thread evaluates
+    thread_local std::vector<glm::mat4> globals;
+    globals.resize(skeleton.jointCount());
+    for (size_t joint {0}; joint < skeleton.jointCount(); joint++) {
+        glm::mat4 local {localPose[joint].matrix()};
+        int32_t parent {skeleton.parents[joint]};
+        globals[joint] = parent < 0 ? model * local : globals[parent] * local;
+        palette[joint] = toJointRows(globals[joint] * skeleton.inverseBind[joint]);
+    }
+}
+
+AnimationSystem::AnimationSystem(uint32_t workerCount)
+:   m_pool {workerCount, "animation worker"}
+{}
+
+AnimationSystem::~AnimationSystem() {
+    glDeleteTextures(1, &m_paletteTexture);
+    glDeleteBuffers(1, &m_paletteBuffer);
+}
+
+auto AnimationSystem::addCharacter(const AnimatedCharacter& character) -> size_t {
+    m_characters.push_back(character);
+    m_offsets.push_back(static_cast<uint32_t>(m_palette.size()));
+    m_palette.resize(m_palette.size() + character.skeleton->jointCount(),
+                     toJointRows(glm::mat4(1.0f)));
+    return m_characters.size() - 1;
+}
+
+void AnimationSystem::update(float deltaSeconds) {
+    MAGE_PROFILE_SCOPE("AnimationSystem::update");
+    m_deltaSeconds = deltaSeconds;
+    m_pool.run(m_characters.size(), BATCH_SIZE, [this](size_t begin, size_t end) {
+        MAGE_PROFILE_SCOPE("AnimationSystem::evaluate");
+        // reused across batches and updates
+        thread_local std::vector<Transform> localPose;
+        for (size_t index {begin}; index < end; index++) {
+            _evaluate(index, localPose);
+        }
+    });
+}
+
+void AnimationSystem::upload() {
+    if (m_palette.empty()) {
+        return;
+    }
+    MAGE_PROFILE_SCOPE("AnimationSystem::upload");
+    bool created {m_paletteBuffer == 0};
+    if (created) {
+        glGenBuffers(1, &m_paletteBuffer);
+        glGenTextures(1, &m_paletteTexture);
+    }
+    GLint maxTexels {0};
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    if (m_palette.size() * 3 > static_cast<size_t>(maxTexels)) {
+        std::cout << "Joint palette is larger than GL_MAX_TEXTURE_BUFFER_SIZE.\n";
+    }
+    GLsizeiptr bytes {static_cast<GLsizeiptr>(m_palette.size() * sizeof(JointRows))};
+    glBindBuffer(GL_TEXTURE_BUFFER, m_paletteBuffer);
+    // orphan last frame's palette so the upload never waits on its draws
+    glBufferData(GL_TEXTURE_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, m_palette.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    MAGE_COUNT_UPLOAD(static_cast<uint64_t>(bytes));
+    if (created) {
+        // the texture follows the buffer object through every reallocation
+        glBindTexture(GL_TEXTURE_BUFFER, m_paletteTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_paletteBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+}
+
+void AnimationSystem::bindPalette() const {
+    glActiveTexture(GL_TEXTURE0 + JOINT_PALETTE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, m_paletteTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void AnimationSystem::_evaluate(size_t index, std::vector<Transform>& localPose) {
+    AnimatedCharacter& character {m_characters[index]};
+    character.time += m_deltaSeconds * character.speed;
+    if (character.clip != nullptr) {
+        character.clip->sample(*character.skeleton, character.time, localPose);
+    }
+    else {
+        localPose = character.skeleton->bindPose;
+    }
+    computeSkinningPalette(*character.skeleton, localPose, character.model,
+                           m_palette.data() + m_offsets[index]);
+}
+
+}
@@ -0,0 +1,135 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <transform.h>
+#include <worker_pool.h>
+
+namespace sjd {
+
+// joints are stored parents first, so one pass from the root evaluates
+// the whole hierarchy
+struct Skeleton {
+    // -1 for roots, otherwise an index lower than the joint's own
+    std::vector<int32_t> parents;
+    // each joint's transform relative to its parent at rest
+    std::vector<Transform> bindPose;
+    // model space to joint space at rest
+    std::vector<glm::mat4> inverseBind;
+
+    auto jointCount() const -> size_t { return parents.size(); }
+    // false when parents don't precede their children or sizes differ
+    auto isValid() const -> bool;
+};
+
+// a chain of joints up the y axis, each spacing above its parent
+auto makeJointChain(uint32_t joints, float spacing) -> Skeleton;
+
+struct AnimationTrack {
+    uint32_t joint {0};
+    // ascending, in seconds
+    std::vector<float> times;
+    // parent-relative transform at each time
+    std::vector<Transform> keys;
+};
+
+struct AnimationClip {
+    float duration {0.0f};
+    bool loop {true};
+    // joints without a track keep their bind pose
+    std::vector<AnimationTrack> tracks;
+
+    // fills localPose with every joint's parent-relative transform at time
+    void sample(const Skeleton& skeleton, float time, std::vector<Transform>& localPose) const;
+};
+
+// each joint of the chain swinging about z, the tip a quarter period
+// behind the root, with keyframes every 1 / keysPerSecond
+auto makeSwayClip(const Skeleton& skeleton,
+                  float duration,
+                  float amplitudeRadians,
+                  uint32_t keysPerSecond = 30) -> AnimationClip;
+
+// one compact palette entry: the top three rows of an affine matrix,
+// which is all the GPU needs as the last row is always (0, 0, 0, 1)
+struct JointRows {
+    glm::vec4 rows[3];
+};
+
+auto toJointRows(const glm::mat4& matrix) -> JointRows;
+
+// writes model * global joint * inverse bind for each joint into palette
+void computeSkinningPalette(const Skeleton& skeleton,
+                            const std::vector<Transform>& localPose,
+                            const glm::mat4& model,
+                            JointRows* palette);
+
+struct AnimatedCharacter {
+    const Skeleton* skeleton {nullptr};
+    const AnimationClip* clip {nullptr};
+    glm::mat4 model {1.0f};
+    float time {0.0f};
+    float speed {1.0f};
+};
+
+// Samples and evaluates the poses of every character once per frame,
+// spread across worker threads, into one joint palette that is uploaded
+// to a texture buffer for skinned.lighting.vert.glsl.
+//
+// Characters are handed out to the workers and the calling thread in
+// batches through an atomic cursor; each writes only its own characters'
+// palette ranges, so the evaluation takes no locks. Characters sharing a
+// skinned mesh that were added one after another sit next to each other
+// in the palette, so the mesh can draw them all as instances.
+class AnimationSystem {
+public:
+    // 0 workers evaluates everything on the calling thread; by default the
+    // calling thread and the workers fill every hardware thread
+    AnimationSystem(uint32_t workerCount = std::max(std::thread::hardware_concurrency(), 1u) - 1);
+    ~AnimationSystem();
+
+    AnimationSystem(const AnimationSystem&) = delete;
+    AnimationSystem& operator=(const AnimationSystem&) = delete;
+
+    // returns the character's index; skeleton and clip must outlive it
+    auto addCharacter(const AnimatedCharacter& character) -> size_t;
+    auto character(size_t index) -> AnimatedCharacter& { return m_characters[index]; }
+    auto characterCount() const -> size_t { return m_characters.size(); }
+    // index of the character's first joint in the palette
+    auto paletteOffset(size_t index) const -> const uint32_t& { return m_offsets[index]; }
+    auto palette() const -> const std::vector<JointRows>& { return m_palette; }
+    auto workerCount() const -> size_t { return m_pool.workerCount(); }
+
+    // advances every character's clock by deltaSeconds and evaluates its pose
+    void update(float deltaSeconds);
+
+    // copies the palette to the texture buffer, creating it on first use
+    void upload();
+    // binds the palette as a samplerBuffer on JOINT_PALETTE_UNIT, where
+    // every program's jointPalette sampler already points
+    void bindPalette() const;
+
+private:
+    static const size_t BATCH_SIZE = 16;
+
+    void _evaluate(size_t index, std::vector<Transform>& localPose);
+
+    std::vector<AnimatedCharacter> m_characters;
+    std::vector<uint32_t> m_offsets;
+    std::vector<JointRows> m_palette;
+    float m_deltaSeconds {0.0f};
+
+    WorkerPool m_pool;
+
+    GLuint m_paletteBuffer {0};
+    GLuint m_paletteTexture {0};
+};
+
+}
+#endif
@@ -0,0 +1,50 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+#include <array>
+#include <limits>
+
+namespace sjd {
+
+// axis-aligned bounding box; default constructed boxes are empty
+struct AABB {
+    glm::vec3 min {std::numeric_limits<float>::max()};
+    glm::vec3 max {std::numeric_limits<float>::lowest()};
+
+    auto isEmpty() const -> bool {
+        return min.x > max.x || min.y > max.y || min.z > max.z;
+    }
+
+    void expand(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    auto center() const -> glm::vec3 { return (min + max) * 0.5f; }
+    auto extent() const -> glm::vec3 { return (max - min) * 0.5f; }
+
+    auto corners() const -> std::array<glm::vec3, 8> {
+        return {
+            glm::vec3(min.x, min.y, min.z), glm::vec3(max.x, min.y, min.z),
+            glm::vec3(min.x, max.y, min.z), glm::vec3(max.x, max.y, min.z),
+            glm::vec3(min.x, min.y, max.z), glm::vec3(max.x, min.y, max.z),
+            glm::vec3(min.x, max.y, max.z), glm::vec3(max.x, max.y, max.z),
+        };
+    }
+
+    // box enclosing this one after an affine transform
+    auto transformed(const glm::mat4& transform) const -> AABB {
+        AABB result {};
+        if (isEmpty()) {
+            return result;
+        }
+        for (const glm::vec3& corner : corners()) {
+            result.expand(glm::vec3(transform * glm::vec4(corner, 1.0f)));
+        }
+        return result;
+    }
+};
+
+}
+#endif
@@ -1,8 +1,21 @@
 #include "glm/geometric.hpp"
 #include <camera.h>
+#include <cmath>
 
 namespace sjd {
 
+auto interpolate(const CameraState& a, const CameraState& b, float alpha) -> CameraState {
+    // turnTo() wraps yaw to [-180, 180], so consecutive steps can sit
+    // either side of the seam
+    float yawDelta {std::remainder(b.yaw - a.yaw, 360.0f)};
+    return {
+        glm::mix(a.pos, b.pos, alpha),
+        a.yaw + yawDelta * alpha,
+        glm::mix(a.pitch, b.pitch, alpha),
+        glm::mix(a.zoom, b.zoom, alpha),
+    };
+}
+
 Camera::Camera(glm::vec3 initialPosition,
                glm::vec3 initialFocus)
 :   m_pos {initialPosition}
@@ -13,6 +26,14 @@ Camera::Camera(glm::vec3 initialPosition,
     }
 }
 
+void Camera::setState(const CameraState& state) {
+    m_pos = state.pos;
+    m_yaw = state.yaw;
+    m_pitch = state.pitch;
+    m_zoom = state.zoom;
+    _updateCameraVectors();
+}
+
 void Camera::processMovement(Camera::Movement direction,
                                     float deltaTime) {
     float velocity {m_movementSpeed * deltaTime};
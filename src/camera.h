@@ -7,6 +7,19 @@
 
 namespace sjd {
 
+// everything about a Camera that movement and rotation change, so a
+// fixed-step simulation can keep the last two steps and render between them
+struct CameraState {
+    glm::vec3 pos {0.0f, 0.0f, 3.0f};
+    // degrees
+    float yaw {-90.0f};
+    float pitch {0.0f};
+    float zoom {45.0f};
+};
+
+// alpha 0 gives a, 1 gives b; yaw turns the short way round
+auto interpolate(const CameraState& a, const CameraState& b, float alpha) -> CameraState;
+
 class Camera {
 public:
     enum Movement {
@@ -23,6 +36,11 @@ public:
 
     const glm::vec3& getPos() { return m_pos; };
     const glm::vec3& getFace() { return m_front; };
+    // vertical field of view in degrees
+    float getZoom() { return m_zoom; };
+
+    auto getState() const -> CameraState { return {m_pos, m_yaw, m_pitch, m_zoom}; }
+    void setState(const CameraState& state);
 
     glm::mat4 getViewMatrix(){
         return glm::lookAt(m_pos, m_pos + m_front, m_up);
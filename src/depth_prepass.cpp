@@ -0,0 +1,140 @@
+#include <depth_prepass.h>
+#include <profiler.h>
+#include <algorithm>
+
+namespace sjd {
+
+void sortFrontToBack(std::vector<Mesh*>& meshes, const glm::vec3& viewPos) {
+    // compute each key once rather than inside the comparator
+    std::vector<std::pair<float, Mesh*>> keyed;
+    keyed.reserve(meshes.size());
+    for (Mesh* mesh : meshes) {
+        glm::vec3 offset {mesh->position() - viewPos};
+        keyed.emplace_back(glm::dot(offset, offset), mesh);
+    }
+    std::stable_sort(keyed.begin(), keyed.end(),
+                     [](const auto& a, const auto& b){
+                         return a.first < b.first;
+                     });
+    for (size_t i {0}; i < keyed.size(); i++) {
+        meshes[i] = keyed[i].second;
+    }
+}
+
+DepthPrePass::DepthPrePass(const std::string& vertexPath,
+                           const std::string& fragmentPath)
+:   m_depthShader {vertexPath, fragmentPath}
+{
+    if (!m_depthShader.isValid()) {
+        std::cout << "Failed to create depth pre-pass shader.\n";
+        m_enabled = false;
+    }
+    glGenQueries(QUERY_FRAMES, m_prePassQueries.data());
+    glGenQueries(QUERY_FRAMES, m_colorPassQueries.data());
+}
+
+DepthPrePass::~DepthPrePass() {
+    glDeleteQueries(QUERY_FRAMES, m_prePassQueries.data());
+    glDeleteQueries(QUERY_FRAMES, m_colorPassQueries.data());
+}
+
+void DepthPrePass::render(const glm::mat4& projection,
+                          const glm::mat4& view,
+                          const glm::vec3& viewPos,
+                          std::vector<Mesh*>& opaqueMeshes,
+                          Shader& colorShader) {
+    size_t slot {m_frame % QUERY_FRAMES};
+    if (m_queriesEnabled) {
+        _resolveQueries();
+    }
+    m_prePassIssued[slot] = false;
+    m_colorPassIssued[slot] = false;
+
+    sortFrontToBack(opaqueMeshes, viewPos);
+
+    DepthState saved {};
+    if (m_enabled) {
+        saved = _saveDepthState();
+        MAGE_PROFILE_GPU_SCOPE("DepthPrePass::depthPass");
+        _beginDepthPass();
+        if (m_queriesEnabled) {
+            glBeginQuery(GL_SAMPLES_PASSED, m_prePassQueries[slot]);
+        }
+        for (Mesh* mesh : opaqueMeshes) {
+            mesh->draw(projection, view, m_depthShader);
+        }
+        if (m_queriesEnabled) {
+            glEndQuery(GL_SAMPLES_PASSED);
+            m_prePassIssued[slot] = true;
+        }
+        _beginColorPass(saved);
+    }
+
+    if (m_queriesEnabled) {
+        glBeginQuery(GL_SAMPLES_PASSED, m_colorPassQueries[slot]);
+    }
+    {
+        MAGE_PROFILE_GPU_SCOPE("DepthPrePass::colorPass");
+        for (Mesh* mesh : opaqueMeshes) {
+            mesh->draw(projection, view, colorShader);
+        }
+    }
+    if (m_queriesEnabled) {
+        glEndQuery(GL_SAMPLES_PASSED);
+        m_colorPassIssued[slot] = true;
+    }
+
+    if (m_enabled) {
+        _restoreDepthState(saved);
+    }
+    m_frame++;
+}
+
+auto DepthPrePass::_saveDepthState() -> DepthState {
+    DepthState state {};
+    glGetIntegerv(GL_DEPTH_FUNC, &state.depthFunc);
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &state.depthMask);
+    glGetBooleanv(GL_COLOR_WRITEMASK, state.colorMask);
+    return state;
+}
+
+void DepthPrePass::_beginDepthPass() {
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+}
+
+void DepthPrePass::_beginColorPass(const DepthState& saved) {
+    // depth is already final: only the visible surface passes GL_EQUAL,
+    // and there is nothing left to write
+    glColorMask(saved.colorMask[0], saved.colorMask[1], saved.colorMask[2], saved.colorMask[3]);
+    glDepthMask(GL_FALSE);
+    glDepthFunc(GL_EQUAL);
+}
+
+void DepthPrePass::_restoreDepthState(const DepthState& saved) {
+    glDepthMask(saved.depthMask);
+    glDepthFunc(saved.depthFunc);
+}
+
+void DepthPrePass::_resolveQueries() {
+    // the slot about to be reused was issued QUERY_FRAMES frames ago
+    size_t slot {m_frame % QUERY_FRAMES};
+    if (!m_colorPassIssued[slot]) {
+        return;
+    }
+    GLint available {GL_FALSE};
+    glGetQueryObjectiv(m_colorPassQueries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        // never stall: keep the previous stats rather than wait on the GPU
+        return;
+    }
+    FragmentStats stats {};
+    glGetQueryObjectuiv(m_colorPassQueries[slot], GL_QUERY_RESULT, &stats.colorPassSamples);
+    if (m_prePassIssued[slot]) {
+        glGetQueryObjectuiv(m_prePassQueries[slot], GL_QUERY_RESULT, &stats.prePassSamples);
+    }
+    m_stats = stats;
+}
+
+}
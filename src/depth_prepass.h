@@ -0,0 +1,87 @@
+#ifndef DEPTH_PREPASS_H
+#define DEPTH_PREPASS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <array>
+#include <string>
+#include <vector>
+
+#include <shader.h>
+#include <mesh/mesh.h>
+
+namespace sjd {
+
+// Samples that passed the depth test in each pass of the most recently
+// resolved frame. Without a pre-pass the colour pass would shade roughly
+// `prePassSamples` fragments; with it, only `colorPassSamples` are shaded.
+struct FragmentStats {
+    GLuint prePassSamples {0};
+    GLuint colorPassSamples {0};
+
+    auto shadedFragmentsSaved() const -> GLuint {
+        return (prePassSamples > colorPassSamples)
+            ? prePassSamples - colorPassSamples
+            : 0;
+    }
+};
+
+// sorts opaque meshes nearest-first so early-Z rejects as much as possible
+void sortFrontToBack(std::vector<Mesh*>& meshes, const glm::vec3& viewPos);
+
+class DepthPrePass {
+public:
+    DepthPrePass(const std::string& vertexPath,
+                 const std::string& fragmentPath);
+    ~DepthPrePass();
+
+    DepthPrePass(const DepthPrePass&) = delete;
+    DepthPrePass& operator=(const DepthPrePass&) = delete;
+
+    auto isEnabled() const -> const bool& { return m_enabled; }
+    auto isValid() const -> bool { return m_depthShader.isValid(); }
+    auto stats() const -> const FragmentStats& { return m_stats; }
+    auto depthShader() -> Shader& { return m_depthShader; }
+
+    void setEnabled(bool enabled) { m_enabled = enabled; }
+    void setQueriesEnabled(bool enabled) { m_queriesEnabled = enabled; }
+
+    // draws the opaque meshes front-to-back; when enabled a depth-only pass
+    // lays down the depth buffer first and the colour pass runs with GL_EQUAL,
+    // and the caller's depth func and write masks are restored afterwards
+    void render(const glm::mat4& projection,
+                const glm::mat4& view,
+                const glm::vec3& viewPos,
+                std::vector<Mesh*>& opaqueMeshes,
+                Shader& colorShader);
+
+private:
+    struct DepthState {
+        GLint depthFunc {GL_LESS};
+        GLboolean depthMask {GL_TRUE};
+        GLboolean colorMask[4] {GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE};
+    };
+
+    static auto _saveDepthState() -> DepthState;
+    void _beginDepthPass();
+    void _beginColorPass(const DepthState& saved);
+    void _restoreDepthState(const DepthState& saved);
+    void _resolveQueries();
+
+    // queries are double-buffered so results are read a frame late
+    // instead of stalling on the frame that was just submitted
+    static const size_t QUERY_FRAMES = 2;
+
+    Shader m_depthShader;
+    bool m_enabled {true};
+    bool m_queriesEnabled {true};
+    std::array<GLuint, QUERY_FRAMES> m_prePassQueries {};
+    std::array<GLuint, QUERY_FRAMES> m_colorPassQueries {};
+    std::array<bool, QUERY_FRAMES> m_prePassIssued {};
+    std::array<bool, QUERY_FRAMES> m_colorPassIssued {};
+    size_t m_frame {0};
+    FragmentStats m_stats {};
+};
+
+}
+#endif
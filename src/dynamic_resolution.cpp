@@ -0,0 +1,205 @@
+#include <dynamic_resolution.h>
+#include <profiler.h>
+#include <algorithm>
+#include <cmath>
+
+namespace sjd {
+
+namespace {
+
+auto scaledSize(uint32_t size, float scale) -> uint32_t {
+    return std::max(static_cast<uint32_t>(std::lround(static_cast<float>(size) * scale)), 1u);
+}
+
+}
+
+DynamicResolutionController::DynamicResolutionController(DynamicResolutionSettings settings)
+:   m_settings {settings}
+{
+    m_settings.minScale = std::clamp(m_settings.minScale, 0.1f, 1.0f);
+    m_settings.maxScale = std::clamp(m_settings.maxScale, m_settings.minScale, 2.0f);
+    m_settings.scaleStep = std::max(m_settings.scaleStep, 0.001f);
+    m_scale = m_settings.maxScale;
+}
+
+auto DynamicResolutionController::update(double gpuFrameMs) -> float {
+    m_lastChange = SCALE_CHANGE::NONE;
+    if (m_samples++ == 0) {
+        m_smoothedMs = gpuFrameMs;
+    }
+    else {
+        m_smoothedMs += m_settings.smoothing * (gpuFrameMs - m_smoothedMs);
+    }
+    if (m_cooldown > 0) {
+        m_cooldown--;
+        return m_scale;
+    }
+
+    double target {m_settings.targetFrameMs};
+    double goal {target * (1.0 - m_settings.underBudget * 0.5)};
+    float ideal {m_scale * static_cast<float>(std::sqrt(goal / std::max(m_smoothedMs, 0.001)))};
+    // rounding down keeps the chosen scale on the cheap side of the goal
+    float snapped {std::floor(ideal / m_settings.scaleStep + 0.001f) * m_settings.scaleStep};
+
+    if (m_smoothedMs > target * (1.0 + m_settings.overBudget)) {
+        m_settled = 0;
+        _changeScale(std::min(snapped, m_scale));
+    }
+    else if (m_smoothedMs < target * (1.0 - m_settings.underBudget)) {
+        if (++m_settled >= m_settings.settleFrames) {
+            m_settled = 0;
+            _changeScale(std::max(snapped, m_scale));
+        }
+    }
+    else {
+        m_settled = 0;
+    }
+    return m_scale;
+}
+
+void DynamicResolutionController::setScale(float scale) {
+    m_scale = std::clamp(scale, m_settings.minScale, m_settings.maxScale);
+    m_settled = 0;
+    m_cooldown = m_settings.cooldownFrames;
+}
+
+void DynamicResolutionController::reset() {
+    m_scale = m_settings.maxScale;
+    m_smoothedMs = 0.0;
+    m_samples = 0;
+    m_settled = 0;
+    m_cooldown = 0;
+    m_lastChange = SCALE_CHANGE::NONE;
+}
+
+void DynamicResolutionController::_changeScale(float scale) {
+    scale = std::clamp(scale, m_settings.minScale, m_settings.maxScale);
+    if (std::abs(scale - m_scale) < m_settings.scaleStep * 0.5f) {
+        return;
+    }
+    m_lastChange = scale < m_scale ? SCALE_CHANGE::DOWN : SCALE_CHANGE::UP;
+    // predict the new cost so the average doesn't have to relearn it
+    float ratio {scale / m_scale};
+    m_smoothedMs *= static_cast<double>(ratio * ratio);
+    m_scale = scale;
+    m_cooldown = m_settings.cooldownFrames;
+}
+
+DynamicResolution::DynamicResolution(uint32_t windowWidth,
+                                     uint32_t windowHeight,
+                                     DynamicResolutionSettings settings)
+:   m_controller {settings},
+    m_windowWidth {std::max(windowWidth, 1u)},
+    m_windowHeight {std::max(windowHeight, 1u)},
+    m_target {scaledSize(m_windowWidth, m_controller.settings().maxScale),
+              scaledSize(m_windowHeight, m_controller.settings().maxScale)}
+{
+    for (FrameQueries& frame : m_queries) {
+        glGenQueries(1, &frame.start);
+        glGenQueries(1, &frame.end);
+    }
+    _updateRenderSize();
+}
+
+DynamicResolution::~DynamicResolution() {
+    for (FrameQueries& frame : m_queries) {
+        glDeleteQueries(1, &frame.start);
+        glDeleteQueries(1, &frame.end);
+    }
+}
+
+void DynamicResolution::resize(uint32_t windowWidth, uint32_t windowHeight) {
+    m_windowWidth = std::max(windowWidth, 1u);
+    m_windowHeight = std::max(windowHeight, 1u);
+    float maxScale {m_controller.settings().maxScale};
+    m_target.resize(scaledSize(m_windowWidth, maxScale), scaledSize(m_windowHeight, maxScale));
+    _updateRenderSize();
+}
+
+void DynamicResolution::beginFrame() {
+    MAGE_PROFILE_SCOPE("DynamicResolution::beginFrame");
+    bool gpuTiming {m_controller.settings().gpuTiming};
+    if (gpuTiming) {
+        _resolveQueries();
+    }
+    _updateRenderSize();
+
+    if (gpuTiming) {
+        // the GPU has fallen QUERY_FRAMES behind: drop that frame's timing
+        // rather than wait for it
+        FrameQueries& frame {m_queries[m_next]};
+        frame.pending = false;
+        glQueryCounter(frame.start, GL_TIMESTAMP);
+    }
+
+    m_target.bind();
+    glViewport(0, 0, m_renderWidth, m_renderHeight);
+}
+
+void DynamicResolution::endFrame(GLuint windowFramebuffer) {
+    {
+        MAGE_PROFILE_GPU_SCOPE("DynamicResolution::upscale");
+        _padEdges();
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_target.id());
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, windowFramebuffer);
+        glBlitFramebuffer(0, 0, m_renderWidth, m_renderHeight,
+                          0, 0, m_windowWidth, m_windowHeight,
+                          GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    }
+    if (m_controller.settings().gpuTiming) {
+        FrameQueries& frame {m_queries[m_next]};
+        glQueryCounter(frame.end, GL_TIMESTAMP);
+        frame.pending = true;
+        m_next = (m_next + 1) % QUERY_FRAMES;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, windowFramebuffer);
+    glViewport(0, 0, m_windowWidth, m_windowHeight);
+}
+
+void DynamicResolution::_resolveQueries() {
+    // oldest first, so the controller sees frames in order
+    for (size_t i {0}; i < QUERY_FRAMES; i++) {
+        FrameQueries& frame {m_queries[(m_next + i) % QUERY_FRAMES]};
+        if (!frame.pending) {
+            continue;
+        }
+        GLint available {GL_FALSE};
+        glGetQueryObjectiv(frame.end, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+        GLuint64 start {0};
+        GLuint64 end {0};
+        glGetQueryObjectui64v(frame.start, GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(frame.end, GL_QUERY_RESULT, &end);
+        frame.pending = false;
+        m_lastGpuFrameMs = static_cast<double>(end - start) / 1.0e6;
+        m_controller.update(m_lastGpuFrameMs);
+    }
+}
+
+void DynamicResolution::_padEdges() {
+    // a linear blit filters across the edge of its source rectangle, so
+    // copy the last column and row outwards over the stale texels there
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_target.id());
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_target.id());
+    GLint w {static_cast<GLint>(m_renderWidth)};
+    GLint h {static_cast<GLint>(m_renderHeight)};
+    if (m_renderWidth < m_target.width()) {
+        glBlitFramebuffer(w - 1, 0, w, h, w, 0, w + 1, h,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        w++;
+    }
+    if (m_renderHeight < m_target.height()) {
+        glBlitFramebuffer(0, h - 1, w, h, 0, h, w, h + 1,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+}
+
+void DynamicResolution::_updateRenderSize() {
+    m_renderWidth = std::min(scaledSize(m_windowWidth, m_controller.scale()), m_target.width());
+    m_renderHeight = std::min(scaledSize(m_windowHeight, m_controller.scale()), m_target.height());
+}
+
+}
@@ -0,0 +1,140 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+#include <array>
+#include <cstdint>
+
+#include <framebuffer.h>
+
+namespace sjd {
+
+struct DynamicResolutionSettings {
+    double targetFrameMs {16.0};
+    // fraction of the window size along each axis
+    float minScale {0.5f};
+    float maxScale {1.0f};
+    // scale down as soon as the smoothed GPU time is this far over target
+    double overBudget {0.05};
+    // scale up only once it has been this far under target...
+    double underBudget {0.15};
+    // ...for this many frames in a row
+    uint32_t settleFrames {30};
+    // scales snap to multiples of this so noise can't nudge them
+    float scaleStep {0.05f};
+    // frames ignored after a change, as timer queries lag a few frames and
+    // would still report the old scale's cost
+    uint32_t cooldownFrames {4};
+    // weight of the newest sample in the moving average
+    double smoothing {0.2};
+    // when false DynamicResolution issues no timer queries and the caller
+    // feeds controller().update() itself; software rasterisers such as
+    // llvmpipe only time command submission, so use a blocking CPU time there
+    bool gpuTiming {true};
+};
+
+enum class SCALE_CHANGE {
+    NONE,
+    DOWN,
+    UP
+};
+
+// Picks a render scale from measured GPU frame times. GPU cost is treated
+// as proportional to pixel count, so the square of the scale.
+//
+// Going over budget scales down at once, while scaling up waits for
+// settleFrames of headroom. Both aim for the middle of the band between
+// the two thresholds, so a steady load settles on one scale instead of
+// stepping up and down every few frames.
+class DynamicResolutionController {
+public:
+    DynamicResolutionController(DynamicResolutionSettings settings = {});
+
+    auto settings() const -> const DynamicResolutionSettings& { return m_settings; }
+    auto scale() const -> const float& { return m_scale; }
+    auto smoothedMs() const -> const double& { return m_smoothedMs; }
+    // the change made by the last call to update()
+    auto lastChange() const -> const SCALE_CHANGE& { return m_lastChange; }
+    auto sampleCount() const -> const uint64_t& { return m_samples; }
+
+    // feeds one frame's GPU time and returns the scale for the next frame
+    auto update(double gpuFrameMs) -> float;
+
+    // overrides the scale, clamped to the settings' range
+    void setScale(float scale);
+    void reset();
+
+private:
+    void _changeScale(float scale);
+
+    DynamicResolutionSettings m_settings;
+    float m_scale {1.0f};
+    double m_smoothedMs {0.0};
+    uint64_t m_samples {0};
+    uint32_t m_settled {0};
+    uint32_t m_cooldown {0};
+    SCALE_CHANGE m_lastChange {SCALE_CHANGE::NONE};
+};
+
+// Renders into an offscreen target sized for the largest scale and draws
+// each frame into its scaled corner, so changing scale never reallocates.
+// endFrame() upscales that corner to the window with a linear blit.
+//
+// The frame is measured with a pair of GL_TIMESTAMP queries rather than
+// GL_TIME_ELAPSED, so GPU profile scopes can still be opened inside it.
+// Results are read back a few frames late and never waited on.
+class DynamicResolution {
+public:
+    DynamicResolution(uint32_t windowWidth,
+                      uint32_t windowHeight,
+                      DynamicResolutionSettings settings = {});
+    ~DynamicResolution();
+
+    DynamicResolution(const DynamicResolution&) = delete;
+    DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+    auto isValid() const -> bool { return m_target.isValid(); }
+    auto scale() const -> const float& { return m_controller.scale(); }
+    auto renderWidth() const -> const uint32_t& { return m_renderWidth; }
+    auto renderHeight() const -> const uint32_t& { return m_renderHeight; }
+    auto target() const -> const Framebuffer& { return m_target; }
+    auto controller() -> DynamicResolutionController& { return m_controller; }
+    // the most recent GPU frame time read back, 0.0 before the first one
+    auto lastGpuFrameMs() const -> const double& { return m_lastGpuFrameMs; }
+
+    // call from the framebuffer-size callback or after a window resize
+    void resize(uint32_t windowWidth, uint32_t windowHeight);
+
+    // feeds any finished timings to the controller, then binds the target
+    // with the viewport set to this frame's render size
+    void beginFrame();
+
+    // upscales the frame to windowFramebuffer and leaves that bound
+    void endFrame(GLuint windowFramebuffer);
+
+private:
+    static const size_t QUERY_FRAMES = 3;
+
+    struct FrameQueries {
+        GLuint start {0};
+        GLuint end {0};
+        bool pending {false};
+    };
+
+    void _resolveQueries();
+    void _padEdges();
+    void _updateRenderSize();
+
+    DynamicResolutionController m_controller;
+    uint32_t m_windowWidth;
+    uint32_t m_windowHeight;
+    uint32_t m_renderWidth {0};
+    uint32_t m_renderHeight {0};
+    Framebuffer m_target;
+    std::array<FrameQueries, QUERY_FRAMES> m_queries {};
+    size_t m_next {0};
+    double m_lastGpuFrameMs {0.0};
+};
+
+}
+#endif
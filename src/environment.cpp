@@ -0,0 +1,571 @@
+#include <environment.h>
+#include <profiler.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+namespace sjd {
+
+// the current context's fallback, see EnvironmentMap::createFallbacks()
+static GLuint s_fallbackCubemap {0};
+
+namespace {
+
+// puts the fallback back on unit if texture is what's bound there
+void rebindFallback(GLint unit, GLuint texture) {
+    if (texture == 0) {
+        return;
+    }
+    glActiveTexture(GL_TEXTURE0 + unit);
+    GLint bound {0};
+    glGetIntegerv(GL_TEXTURE_BINDING_CUBE_MAP, &bound);
+    if (static_cast<GLuint>(bound) == texture) {
+        glBindTexture(GL_TEXTURE_CUBE_MAP, s_fallbackCubemap);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+const char CACHE_MAGIC[4] {'M', 'E', 'N', 'V'};
+const uint32_t CACHE_VERSION {1};
+
+// RGB9E5 layout from EXT_texture_shared_exponent
+const int RGB9E5_MANTISSA_BITS {9};
+const int RGB9E5_EXPONENT_BIAS {15};
+const int RGB9E5_MAX_EXPONENT {31};
+
+// the cache is written in the machine's byte order, like the GPU reads it
+template <typename T>
+void writeValue(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+auto readValue(std::istream& in, T& value) -> bool {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+// FNV-1a
+void hashBytes(uint64_t& hash, const void* data, size_t size) {
+    const uint8_t* bytes {static_cast<const uint8_t*>(data)};
+    for (size_t i {0}; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+}
+
+void hashVec3(uint64_t& hash, const glm::vec3& value) {
+    hashBytes(hash, &value.x, sizeof(float));
+    hashBytes(hash, &value.y, sizeof(float));
+    hashBytes(hash, &value.z, sizeof(float));
+}
+
+auto mipLevels(uint32_t size) -> uint32_t {
+    uint32_t levels {1};
+    while ((size >> levels) > 0) {
+        levels++;
+    }
+    return levels;
+}
+
+auto elapsedMs(std::chrono::steady_clock::time_point start) -> double {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+auto packRgb9e5(const glm::vec3& color) -> uint32_t {
+    const float maxValue {static_cast<float>((1 << RGB9E5_MANTISSA_BITS) - 1)
+                          / static_cast<float>(1 << RGB9E5_MANTISSA_BITS)
+                          * std::ldexp(1.0f, RGB9E5_MAX_EXPONENT - RGB9E5_EXPONENT_BIAS)};
+    glm::vec3 clamped {glm::clamp(color, glm::vec3(0.0f), glm::vec3(maxValue))};
+    float largest {std::max(clamped.x, std::max(clamped.y, clamped.z))};
+    if (!(largest > 0.0f)) {
+        return 0;
+    }
+    int exponent {0};
+    // largest = m * 2^exponent with m in [0.5, 1), so floor(log2) is exponent - 1
+    std::frexp(largest, &exponent);
+    int shared {std::max(-RGB9E5_EXPONENT_BIAS - 1, exponent - 1) + 1 + RGB9E5_EXPONENT_BIAS};
+    float scale {std::ldexp(1.0f, shared - RGB9E5_EXPONENT_BIAS - RGB9E5_MANTISSA_BITS)};
+    if (std::floor(largest / scale + 0.5f) == static_cast<float>(1 << RGB9E5_MANTISSA_BITS)) {
+        scale *= 2.0f;
+        shared++;
+    }
+    uint32_t r {static_cast<uint32_t>(std::floor(clamped.x / scale + 0.5f))};
+    uint32_t g {static_cast<uint32_t>(std::floor(clamped.y / scale + 0.5f))};
+    uint32_t b {static_cast<uint32_t>(std::floor(clamped.z / scale + 0.5f))};
+    return r | (g << 9) | (b << 18) | (static_cast<uint32_t>(shared) << 27);
+}
+
+auto unpackRgb9e5(uint32_t packed) -> glm::vec3 {
+    int shared {static_cast<int>(packed >> 27)};
+    float scale {std::ldexp(1.0f, shared - RGB9E5_EXPONENT_BIAS - RGB9E5_MANTISSA_BITS)};
+    return glm::vec3(static_cast<float>(packed & 0x1ffu),
+                     static_cast<float>((packed >> 9) & 0x1ffu),
+                     static_cast<float>((packed >> 18) & 0x1ffu)) * scale;
+}
+
+auto cubeFaceDirection(uint32_t face, const glm::vec2& uv) -> glm::vec3 {
+    glm::vec2 st {uv * 2.0f - 1.0f};
+    switch (face) {
+    case 0:
+        return glm::vec3(1.0f, -st.y, -st.x);
+    case 1:
+        return glm::vec3(-1.0f, -st.y, st.x);
+    case 2:
+        return glm::vec3(st.x, 1.0f, st.y);
+    case 3:
+        return glm::vec3(st.x, -1.0f, -st.y);
+    case 4:
+        return glm::vec3(st.x, -st.y, 1.0f);
+    default:
+        return glm::vec3(-st.x, -st.y, -1.0f);
+    }
+}
+
+auto skyRadiance(const SkySettings& sky, const glm::vec3& direction) -> glm::vec3 {
+    glm::vec3 normalised {glm::normalize(direction)};
+    if (normalised.y < 0.0f) {
+        return sky.ground;
+    }
+    glm::vec3 radiance {glm::mix(sky.horizon, sky.zenith, std::sqrt(normalised.y))};
+    float angle {std::acos(std::clamp(glm::dot(normalised, glm::normalize(sky.sunDirection)), -1.0f, 1.0f))};
+    float edge {std::clamp((angle - 0.9f * sky.sunAngularRadius) / (0.1f * sky.sunAngularRadius), 0.0f, 1.0f)};
+    // 1 - smoothstep, as the shader has it
+    return radiance + sky.sunColor * (1.0f - edge * edge * (3.0f - 2.0f * edge));
+}
+
+auto environmentCacheKey(const SkySettings& sky, const EnvironmentSettings& settings) -> uint64_t {
+    uint64_t hash {0xcbf29ce484222325ull};
+    hashBytes(hash, &CACHE_VERSION, sizeof(CACHE_VERSION));
+    hashVec3(hash, sky.zenith);
+    hashVec3(hash, sky.horizon);
+    hashVec3(hash, sky.ground);
+    hashVec3(hash, sky.sunDirection);
+    hashVec3(hash, sky.sunColor);
+    hashBytes(hash, &sky.sunAngularRadius, sizeof(float));
+    // intensity is applied when lighting, so it doesn't change the maps
+    hashBytes(hash, &settings.sourceSize, sizeof(uint32_t));
+    hashBytes(hash, &settings.irradianceSize, sizeof(uint32_t));
+    hashBytes(hash, &settings.prefilterSize, sizeof(uint32_t));
+    hashBytes(hash, &settings.prefilterLevels, sizeof(uint32_t));
+    hashBytes(hash, &settings.sampleCount, sizeof(uint32_t));
+    return hash;
+}
+
+auto EnvironmentCache::faceTexels(uint32_t level) const -> size_t {
+    size_t size {std::max(prefilterSize >> level, 1u)};
+    return size * size;
+}
+
+void writeEnvironmentCache(std::ostream& out, const EnvironmentCache& cache) {
+    out.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    writeValue(out, CACHE_VERSION);
+    writeValue(out, cache.key);
+    writeValue(out, cache.irradianceSize);
+    writeValue(out, cache.prefilterSize);
+    writeValue(out, cache.prefilterLevels);
+    out.write(reinterpret_cast<const char*>(cache.irradiance.data()),
+              cache.irradiance.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(cache.prefiltered.data()),
+              cache.prefiltered.size() * sizeof(uint32_t));
+}
+
+auto readEnvironmentCache(std::istream& in,
+                          uint64_t expectedKey) -> std::expected<EnvironmentCache, ENVIRONMENT_ERROR> {
+    char magic[sizeof(CACHE_MAGIC)] {};
+    if (!in.read(magic, sizeof(magic))) {
+        return std::unexpected(ENVIRONMENT_ERROR::badFile);
+    }
+    if (!std::equal(magic, magic + sizeof(magic), CACHE_MAGIC)) {
+        return std::unexpected(ENVIRONMENT_ERROR::badHeader);
+    }
+    uint32_t version {0};
+    EnvironmentCache cache {};
+    if (!readValue(in, version)) {
+        return std::unexpected(ENVIRONMENT_ERROR::truncated);
+    }
+    if (version != CACHE_VERSION) {
+        return std::unexpected(ENVIRONMENT_ERROR::version);
+    }
+    if (!readValue(in, cache.key) || !readValue(in, cache.irradianceSize)
+        || !readValue(in, cache.prefilterSize) || !readValue(in, cache.prefilterLevels)) {
+        return std::unexpected(ENVIRONMENT_ERROR::truncated);
+    }
+    if (cache.key != expectedKey) {
+        return std::unexpected(ENVIRONMENT_ERROR::staleKey);
+    }
+    // anything larger than a 16K face is corrupt rather than a real cache
+    if (cache.irradianceSize == 0 || cache.irradianceSize > 16384
+        || cache.prefilterSize == 0 || cache.prefilterSize > 16384
+        || cache.prefilterLevels == 0 || cache.prefilterLevels > mipLevels(cache.prefilterSize)) {
+        return std::unexpected(ENVIRONMENT_ERROR::badHeader);
+    }
+    cache.irradiance.resize(6 * static_cast<size_t>(cache.irradianceSize) * cache.irradianceSize);
+    size_t prefiltered {0};
+    for (uint32_t level {0}; level < cache.prefilterLevels; level++) {
+        prefiltered += 6 * cache.faceTexels(level);
+    }
+    cache.prefiltered.resize(prefiltered);
+    if (!in.read(reinterpret_cast<char*>(cache.irradiance.data()),
+                 cache.irradiance.size() * sizeof(uint32_t))
+        || !in.read(reinterpret_cast<char*>(cache.prefiltered.data()),
+                    cache.prefiltered.size() * sizeof(uint32_t))) {
+        return std::unexpected(ENVIRONMENT_ERROR::truncated);
+    }
+    return cache;
+}
+
+EnvironmentMap::EnvironmentMap(const std::string& shaderDirectory, EnvironmentSettings settings)
+:   m_skyShader {shaderDirectory + "/fullscreen.vert.glsl",
+                 shaderDirectory + "/environment_sky.frag.glsl"},
+    m_irradianceShader {shaderDirectory + "/fullscreen.vert.glsl",
+                        shaderDirectory + "/environment_irradiance.frag.glsl"},
+    m_prefilterShader {shaderDirectory + "/fullscreen.vert.glsl",
+                       shaderDirectory + "/environment_prefilter.frag.glsl"},
+    m_settings {settings}
+{
+    m_settings.sourceSize = std::max(m_settings.sourceSize, 1u);
+    m_settings.irradianceSize = std::max(m_settings.irradianceSize, 1u);
+    m_settings.prefilterSize = std::max(m_settings.prefilterSize, 1u);
+    m_settings.prefilterLevels = std::clamp(m_settings.prefilterLevels, 1u,
+                                            mipLevels(m_settings.prefilterSize));
+    m_settings.sampleCount = std::max(m_settings.sampleCount, 1u);
+    if (!m_skyShader.isValid() || !m_irradianceShader.isValid() || !m_prefilterShader.isValid()) {
+        std::cout << "Failed to create environment shaders.\n";
+        return;
+    }
+    glGenVertexArrays(1, &m_emptyVao);
+    glGenFramebuffers(1, &m_fbo);
+}
+
+EnvironmentMap::~EnvironmentMap() {
+    // deleting a bound texture leaves its unit empty, not on the fallback
+    rebindFallback(IRRADIANCE_MAP_UNIT, m_irradianceMap);
+    rebindFallback(PREFILTERED_MAP_UNIT, m_prefilteredMap);
+    glDeleteTextures(1, &m_irradianceMap);
+    glDeleteTextures(1, &m_prefilteredMap);
+    glDeleteFramebuffers(1, &m_fbo);
+    glDeleteVertexArrays(1, &m_emptyVao);
+}
+
+auto EnvironmentMap::generate(const SkySettings& sky) -> EnvironmentCache {
+    EnvironmentCache cache {};
+    if (m_fbo == 0) {
+        return cache;
+    }
+    MAGE_PROFILE_SCOPE("EnvironmentMap::generate");
+    auto start {std::chrono::steady_clock::now()};
+    GLint previousFbo {0};
+    GLint previousViewport[4] {};
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFbo);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+    GLboolean depthTest {glIsEnabled(GL_DEPTH_TEST)};
+    GLboolean cullFace {glIsEnabled(GL_CULL_FACE)};
+    GLboolean blend {glIsEnabled(GL_BLEND)};
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_BLEND);
+    glBindVertexArray(m_emptyVao);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glActiveTexture(GL_TEXTURE0);
+
+    // the sky, mipmapped so the convolutions can read blurred levels
+    uint32_t sourceLevels {mipLevels(m_settings.sourceSize)};
+    GLuint source {_createCubemap(GL_RGBA16F, GL_RGBA, GL_FLOAT, m_settings.sourceSize, sourceLevels)};
+    m_skyShader.use();
+    m_skyShader.setUniform("zenith", sky.zenith);
+    m_skyShader.setUniform("horizon", sky.horizon);
+    m_skyShader.setUniform("ground", sky.ground);
+    m_skyShader.setUniform("sunDirection", sky.sunDirection);
+    m_skyShader.setUniform("sunColor", sky.sunColor);
+    m_skyShader.setUniform("sunAngularRadius", sky.sunAngularRadius);
+    for (uint32_t face {0}; face < 6; face++) {
+        _renderFace(m_skyShader, source, face, 0, m_settings.sourceSize);
+    }
+    glBindTexture(GL_TEXTURE_CUBE_MAP, source);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+    GLuint irradiance {_createCubemap(GL_RGBA16F, GL_RGBA, GL_FLOAT, m_settings.irradianceSize, 1)};
+    m_irradianceShader.use();
+    m_irradianceShader.setUniform("source", 0);
+    // a 32 texel level is ample for a cosine lobe
+    m_irradianceShader.setUniform("sourceLod",
+                                  std::max(std::log2(static_cast<float>(m_settings.sourceSize) / 32.0f), 0.0f));
+    glBindTexture(GL_TEXTURE_CUBE_MAP, source);
+    for (uint32_t face {0}; face < 6; face++) {
+        _renderFace(m_irradianceShader, irradiance, face, 0, m_settings.irradianceSize);
+    }
+
+    GLuint prefiltered {_createCubemap(GL_RGBA16F, GL_RGBA, GL_FLOAT,
+                                       m_settings.prefilterSize, m_settings.prefilterLevels)};
+    m_prefilterShader.use();
+    m_prefilterShader.setUniform("source", 0);
+    m_prefilterShader.setUniform("sourceSize", static_cast<float>(m_settings.sourceSize));
+    m_prefilterShader.setUniform("sampleCount", static_cast<int>(m_settings.sampleCount));
+    for (uint32_t level {0}; level < m_settings.prefilterLevels; level++) {
+        float roughness {m_settings.prefilterLevels > 1
+                         ? static_cast<float>(level) / static_cast<float>(m_settings.prefilterLevels - 1)
+                         : 0.0f};
+        m_prefilterShader.setUniform("roughness", roughness);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, source);
+        for (uint32_t face {0}; face < 6; face++) {
+            _renderFace(m_prefilterShader, prefiltered, face, level,
+                        std::max(m_settings.prefilterSize >> level, 1u));
+        }
+    }
+
+    cache.key = environmentCacheKey(sky, m_settings);
+    cache.irradianceSize = m_settings.irradianceSize;
+    cache.prefilterSize = m_settings.prefilterSize;
+    cache.prefilterLevels = m_settings.prefilterLevels;
+    for (uint32_t face {0}; face < 6; face++) {
+        _readFace(irradiance, face, 0, m_settings.irradianceSize, cache.irradiance);
+    }
+    for (uint32_t level {0}; level < m_settings.prefilterLevels; level++) {
+        for (uint32_t face {0}; face < 6; face++) {
+            _readFace(prefiltered, face, level, std::max(m_settings.prefilterSize >> level, 1u),
+                      cache.prefiltered);
+        }
+    }
+    glDeleteTextures(1, &source);
+    glDeleteTextures(1, &irradiance);
+    glDeleteTextures(1, &prefiltered);
+
+    glBindVertexArray(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+    glViewport(previousViewport[0], previousViewport[1],
+               previousViewport[2], previousViewport[3]);
+    if (depthTest) {
+        glEnable(GL_DEPTH_TEST);
+    }
+    if (cullFace) {
+        glEnable(GL_CULL_FACE);
+    }
+    if (blend) {
+        glEnable(GL_BLEND);
+    }
+
+    load(cache);
+    m_loadedFromCache = false;
+    m_lastBuildMs = elapsedMs(start);
+    return cache;
+}
+
+auto EnvironmentMap::load(const EnvironmentCache& cache) -> bool {
+    MAGE_PROFILE_SCOPE("EnvironmentMap::load");
+    auto start {std::chrono::steady_clock::now()};
+    size_t prefiltered {0};
+    for (uint32_t level {0}; level < cache.prefilterLevels; level++) {
+        prefiltered += 6 * cache.faceTexels(level);
+    }
+    if (cache.irradianceSize == 0 || cache.prefilterLevels == 0
+        || cache.irradiance.size() != 6 * static_cast<size_t>(cache.irradianceSize) * cache.irradianceSize
+        || cache.prefiltered.size() != prefiltered) {
+        std::cout << "Environment cache sizes don't match its data.\n";
+        return false;
+    }
+    glDeleteTextures(1, &m_irradianceMap);
+    glDeleteTextures(1, &m_prefilteredMap);
+    m_irradianceMap = _createCubemap(GL_RGB9_E5, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV,
+                                     cache.irradianceSize, 1);
+    for (uint32_t face {0}; face < 6; face++) {
+        size_t texels {static_cast<size_t>(cache.irradianceSize) * cache.irradianceSize};
+        glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, 0, 0,
+                        cache.irradianceSize, cache.irradianceSize,
+                        GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, cache.irradiance.data() + face * texels);
+    }
+    m_prefilteredMap = _createCubemap(GL_RGB9_E5, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV,
+                                      cache.prefilterSize, cache.prefilterLevels);
+    const uint32_t* texels {cache.prefiltered.data()};
+    for (uint32_t level {0}; level < cache.prefilterLevels; level++) {
+        GLsizei size {static_cast<GLsizei>(std::max(cache.prefilterSize >> level, 1u))};
+        for (uint32_t face {0}; face < 6; face++) {
+            glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, 0, 0, size, size,
+                            GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, texels);
+            texels += cache.faceTexels(level);
+        }
+    }
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    MAGE_COUNT_UPLOAD((cache.irradiance.size() + cache.prefiltered.size()) * sizeof(uint32_t));
+    m_prefilterLevels = cache.prefilterLevels;
+    m_isValid = true;
+    m_loadedFromCache = true;
+    glFinish();
+    m_lastBuildMs = elapsedMs(start);
+    return true;
+}
+
+void EnvironmentMap::loadOrGenerate(const SkySettings& sky, const std::string& cachePath) {
+    if (!cachePath.empty()) {
+        std::ifstream file {cachePath, std::ios::binary};
+        auto cache {readEnvironmentCache(file, environmentCacheKey(sky, m_settings))};
+        if (cache.has_value() && load(*cache)) {
+            return;
+        }
+    }
+    EnvironmentCache cache {generate(sky)};
+    if (cachePath.empty() || !m_isValid) {
+        return;
+    }
+    std::ofstream file {cachePath, std::ios::binary};
+    writeEnvironmentCache(file, cache);
+    if (!file) {
+        std::cout << "Failed to write " << cachePath << ".\n";
+    }
+}
+
+void EnvironmentMap::bind(const Shader& shader) const {
+    glActiveTexture(GL_TEXTURE0 + IRRADIANCE_MAP_UNIT);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, m_irradianceMap);
+    glActiveTexture(GL_TEXTURE0 + PREFILTERED_MAP_UNIT);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, m_prefilteredMap);
+    glActiveTexture(GL_TEXTURE0);
+    shader.use();
+    shader.setUniform("irradianceMap", IRRADIANCE_MAP_UNIT);
+    shader.setUniform("prefilteredMap", PREFILTERED_MAP_UNIT);
+    shader.setUniform("environmentLevels", static_cast<int>(m_isValid ? m_prefilterLevels : 0));
+    shader.setUniform("environmentIntensity", m_settings.intensity);
+}
+
+void EnvironmentMap::unbind(const Shader& shader) {
+    glActiveTexture(GL_TEXTURE0 + IRRADIANCE_MAP_UNIT);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, s_fallbackCubemap);
+    glActiveTexture(GL_TEXTURE0 + PREFILTERED_MAP_UNIT);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, s_fallbackCubemap);
+    glActiveTexture(GL_TEXTURE0);
+    shader.use();
+    shader.setUniform("irradianceMap", IRRADIANCE_MAP_UNIT);
+    shader.setUniform("prefilteredMap", PREFILTERED_MAP_UNIT);
+    shader.setUniform("environmentLevels", 0);
+}
+
+void EnvironmentMap::createFallbacks() {
+    // the previous context's texture went with it, so there is nothing to delete
+    glGenTextures(1, &s_fallbackCubemap);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, s_fallbackCubemap);
+    uint32_t black {0};
+    for (uint32_t face {0}; face < 6; face++) {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGBA8, 1, 1, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, &black);
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
+    glActiveTexture(GL_TEXTURE0 + IRRADIANCE_MAP_UNIT);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, s_fallbackCubemap);
+    glActiveTexture(GL_TEXTURE0 + PREFILTERED_MAP_UNIT);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, s_fallbackCubemap);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+}
+
+void EnvironmentMap::_renderFace(const Shader& shader,
+                                 GLuint target,
+                                 uint32_t face,
+                                 uint32_t level,
+                                 uint32_t size) {
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, target, level);
+    glViewport(0, 0, size, size);
+    shader.setUniform("face", static_cast<int>(face));
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    MAGE_COUNT_DRAW_CALLS(1);
+}
+
+void EnvironmentMap::_readFace(GLuint texture,
+                               uint32_t face,
+                               uint32_t level,
+                               uint32_t size,
+                               std::vector<uint32_t>& texels) const {
+    std::vector<float> rgb(static_cast<size_t>(size) * size * 3);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+    glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB, GL_FLOAT, rgb.data());
+    for (size_t i {0}; i < rgb.size(); i += 3) {
+        texels.push_back(packRgb9e5(glm::vec3(rgb[i], rgb[i + 1], rgb[i + 2])));
+    }
+}
+
+auto EnvironmentMap::_createCubemap(GLenum internalFormat,
+                                    GLenum format,
+                                    GLenum type,
+                                    uint32_t size,
+                                    uint32_t levels) const -> GLuint {
+    GLuint texture {0};
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+    for (uint32_t level {0}; level < levels; level++) {
+        GLsizei levelSize {static_cast<GLsizei>(std::max(size >> level, 1u))};
+        for (uint32_t face {0}; face < 6; face++) {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, internalFormat,
+                         levelSize, levelSize, 0, format, type, nullptr);
+        }
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
+                    levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels - 1));
+    return texture;
+}
+
+Skybox::Skybox(const std::string& shaderDirectory)
+:   m_shader {shaderDirectory + "/skybox.vert.glsl",
+              shaderDirectory + "/skybox.frag.glsl"}
+{
+    if (!m_shader.isValid()) {
+        std::cout << "Failed to create skybox shader.\n";
+        return;
+    }
+    glGenVertexArrays(1, &m_emptyVao);
+}
+
+Skybox::~Skybox() {
+    glDeleteVertexArrays(1, &m_emptyVao);
+}
+
+void Skybox::draw(const glm::mat4& view,
+                  const glm::mat4& projection,
+                  GLuint cubemap,
+                  float lod,
+                  float intensity) {
+    if (m_emptyVao == 0) {
+        return;
+    }
+    MAGE_PROFILE_GPU_SCOPE("Skybox::draw");
+    GLint depthFunc {GL_LESS};
+    GLboolean depthMask {GL_TRUE};
+    glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+    GLboolean depthTest {glIsEnabled(GL_DEPTH_TEST)};
+    glEnable(GL_DEPTH_TEST);
+    // the triangle sits exactly on the cleared depth of 1.0
+    glDepthFunc(GL_LEQUAL);
+    glDepthMask(GL_FALSE);
+
+    // only the view's rotation: the sky is infinitely far away
+    glm::mat4 clipToWorld {glm::inverse(glm::mat4(glm::mat3(view))) * glm::inverse(projection)};
+    m_shader.use();
+    m_shader.setUniform("clipToWorld", clipToWorld);
+    m_shader.setUniform("skybox", 0);
+    m_shader.setUniform("lod", lod);
+    m_shader.setUniform("intensity", intensity);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+    glBindVertexArray(m_emptyVao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    MAGE_COUNT_DRAW_CALLS(1);
+    glBindVertexArray(0);
+
+    glDepthFunc(depthFunc);
+    glDepthMask(depthMask);
+    if (!depthTest) {
+        glDisable(GL_DEPTH_TEST);
+    }
+}
+
+}
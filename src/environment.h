@@ -0,0 +1,193 @@
+#ifndef ENVIRONMENT_H
+#define ENVIRONMENT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <expected>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <shader.h>
+
+namespace sjd {
+
+enum class ENVIRONMENT_ERROR {
+    badFile,
+    badHeader,
+    // written by another version of the format
+    version,
+    // made from a different sky or with different settings
+    staleKey,
+    truncated
+};
+
+// shared exponent HDR color, as GL_RGB9_E5 stores it; negative channels
+// clamp to zero
+auto packRgb9e5(const glm::vec3& color) -> uint32_t;
+auto unpackRgb9e5(uint32_t packed) -> glm::vec3;
+
+// direction through texel coordinate uv of a cube face, faces in GL order
+// (+x, -x, +y, -y, +z, -z); must match faceDirection() in the environment
+// shaders
+auto cubeFaceDirection(uint32_t face, const glm::vec2& uv) -> glm::vec3;
+
+// A procedural sky: a gradient from the horizon up to the zenith, a flat
+// ground color below, and a sun disc. Linear HDR colors.
+struct SkySettings {
+    glm::vec3 zenith {0.15f, 0.3f, 0.8f};
+    glm::vec3 horizon {0.7f, 0.8f, 0.95f};
+    glm::vec3 ground {0.2f, 0.18f, 0.15f};
+    // towards the sun
+    glm::vec3 sunDirection {0.3f, 0.6f, 0.2f};
+    glm::vec3 sunColor {40.0f, 36.0f, 30.0f};
+    float sunAngularRadius {0.02f};
+};
+
+// the CPU twin of environment_sky.frag.glsl
+auto skyRadiance(const SkySettings& sky, const glm::vec3& direction) -> glm::vec3;
+
+struct EnvironmentSettings {
+    // face size of the sky the maps are convolved from
+    uint32_t sourceSize {256};
+    uint32_t irradianceSize {32};
+    // face size of the sharpest specular level; each level halves it
+    uint32_t prefilterSize {128};
+    // levels from roughness 0 to 1
+    uint32_t prefilterLevels {6};
+    // GGX importance samples per prefiltered texel
+    uint32_t sampleCount {256};
+    float intensity {1.0f};
+};
+
+// identifies what a cache was made from, so a changed sky or changed
+// settings regenerate the maps instead of loading stale ones
+auto environmentCacheKey(const SkySettings& sky, const EnvironmentSettings& settings) -> uint64_t;
+
+// The maps as stored on disk: RGB9E5 texels, six faces per level, levels
+// sharpest first, rows in GL order.
+struct EnvironmentCache {
+    uint64_t key {0};
+    uint32_t irradianceSize {0};
+    uint32_t prefilterSize {0};
+    uint32_t prefilterLevels {0};
+    std::vector<uint32_t> irradiance;
+    std::vector<uint32_t> prefiltered;
+
+    // texels in one face of a prefiltered level
+    auto faceTexels(uint32_t level) const -> size_t;
+};
+
+void writeEnvironmentCache(std::ostream& out, const EnvironmentCache& cache);
+auto readEnvironmentCache(std::istream& in,
+                          uint64_t expectedKey) -> std::expected<EnvironmentCache, ENVIRONMENT_ERROR>;
+
+// Image based ambient lighting for blinn_phong16.frag.glsl.
+//
+// generate() renders the sky into a mipmapped cubemap, then convolves it
+// into a cosine weighted irradiance map for diffuse ambient light and a
+// chain of GGX prefiltered levels for glossy reflections, one level per
+// roughness step. Both are read back and stored as RGB9E5, at 4 bytes a
+// texel, which is also how they are cached: loadOrGenerate() skips all of
+// the convolution when a cache made from the same sky and settings exists.
+class EnvironmentMap {
+public:
+    EnvironmentMap(const std::string& shaderDirectory, EnvironmentSettings settings = {});
+    ~EnvironmentMap();
+
+    EnvironmentMap(const EnvironmentMap&) = delete;
+    EnvironmentMap& operator=(const EnvironmentMap&) = delete;
+
+    // true once maps have been generated or loaded
+    auto isValid() const -> bool { return m_isValid; }
+    auto settings() const -> const EnvironmentSettings& { return m_settings; }
+    auto irradianceMap() const -> const GLuint& { return m_irradianceMap; }
+    // level 0 is the mirror-sharp sky, which the skybox can draw directly
+    auto prefilteredMap() const -> const GLuint& { return m_prefilteredMap; }
+    auto prefilterLevels() const -> const uint32_t& { return m_prefilterLevels; }
+    auto loadedFromCache() const -> const bool& { return m_loadedFromCache; }
+    // wall time of the last generate() or load, including the GPU's share
+    auto lastBuildMs() const -> const double& { return m_lastBuildMs; }
+
+    void setIntensity(float intensity) { m_settings.intensity = intensity; }
+
+    // convolves the maps on the GPU and returns them as they are cached
+    auto generate(const SkySettings& sky) -> EnvironmentCache;
+    auto load(const EnvironmentCache& cache) -> bool;
+
+    // loads cachePath when it holds maps of this sky and settings, and
+    // otherwise generates them and writes the cache; an empty path never
+    // caches
+    void loadOrGenerate(const SkySettings& sky, const std::string& cachePath);
+
+    // binds the maps to IRRADIANCE_MAP_UNIT and PREFILTERED_MAP_UNIT and
+    // turns on the lighting shader's environment term
+    void bind(const Shader& shader) const;
+
+    // rebinds the fallbacks and falls back to the flat ambient term in a
+    // lighting shader that has no environment
+    static void unbind(const Shader& shader);
+
+    // 1x1 black cubemaps bound to both units, so a lighting shader drawn
+    // without an environment still samples complete cubemaps; called by
+    // initRenderContext()
+    static void createFallbacks();
+
+private:
+    // draws shader's face into one face and level of target
+    void _renderFace(const Shader& shader, GLuint target, uint32_t face, uint32_t level, uint32_t size);
+    // appends one face and level of a float cubemap as RGB9E5
+    void _readFace(GLuint texture, uint32_t face, uint32_t level, uint32_t size,
+                   std::vector<uint32_t>& texels) const;
+    auto _createCubemap(GLenum internalFormat,
+                        GLenum format,
+                        GLenum type,
+                        uint32_t size,
+                        uint32_t levels) const -> GLuint;
+
+    Shader m_skyShader;
+    Shader m_irradianceShader;
+    Shader m_prefilterShader;
+    EnvironmentSettings m_settings;
+    bool m_isValid {false};
+    bool m_loadedFromCache {false};
+    double m_lastBuildMs {0.0};
+    GLuint m_emptyVao {0};
+    GLuint m_fbo {0};
+    GLuint m_irradianceMap {0};
+    GLuint m_prefilteredMap {0};
+    uint32_t m_prefilterLevels {0};
+};
+
+// Draws a cubemap behind everything else.
+//
+// Draw it after the opaque geometry: one fullscreen triangle at the far
+// plane with GL_LEQUAL depth testing, so early depth testing rejects every
+// pixel already covered and the sky is only shaded where it is visible.
+class Skybox {
+public:
+    Skybox(const std::string& shaderDirectory);
+    ~Skybox();
+
+    Skybox(const Skybox&) = delete;
+    Skybox& operator=(const Skybox&) = delete;
+
+    auto isValid() const -> bool { return m_shader.isValid(); }
+
+    // lod picks a blurrier level of a prefiltered map; depth state is
+    // restored afterwards
+    void draw(const glm::mat4& view,
+              const glm::mat4& projection,
+              GLuint cubemap,
+              float lod = 0.0f,
+              float intensity = 1.0f);
+
+private:
+    Shader m_shader;
+    GLuint m_emptyVao {0};
+};
+
+}
+#endif
@@ -0,0 +1,383 @@
+#include <frame_capture.h>
+#include <profiler.h>
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+namespace sjd {
+
+namespace {
+
+auto crcTable() -> const std::array<uint32_t, 256>& {
+    static const std::array<uint32_t, 256> table {[](){
+        std::array<uint32_t, 256> entries {};
+        for (uint32_t i {0}; i < 256; i++) {
+            uint32_t c {i};
+            for (int bit {0}; bit < 8; bit++) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[i] = c;
+        }
+        return entries;
+    }()};
+    return table;
+}
+
+auto crc32(const uint8_t* data, size_t size, uint32_t crc = 0xffffffffu) -> uint32_t {
+    const std::array<uint32_t, 256>& table {crcTable()};
+    for (size_t i {0}; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+void appendBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// returns where the chunk starts, for endChunk() once its data is appended
+auto beginChunk(std::vector<uint8_t>& out, const char* type) -> size_t {
+    size_t start {out.size()};
+    appendBigEndian(out, 0);
+    out.insert(out.end(), type, type + 4);
+    return start;
+}
+
+void endChunk(std::vector<uint8_t>& out, size_t start) {
+    uint32_t length {static_cast<uint32_t>(out.size() - start - 8)};
+    for (size_t i {0}; i < 4; i++) {
+        out[start + i] = static_cast<uint8_t>(length >> (24 - 8 * i));
+    }
+    uint32_t crc {crc32(out.data() + start + 4, out.size() - start - 4)};
+    appendBigEndian(out, crc ^ 0xffffffffu);
+}
+
+// appends a zlib stream of stored deflate blocks
+void storeZlib(const std::vector<uint8_t>& data, std::vector<uint8_t>& out) {
+    const size_t MAX_BLOCK {65535};
+    out.reserve(out.size() + data.size() + data.size() / MAX_BLOCK * 5 + 16);
+    out.push_back(0x78);
+    out.push_back(0x01);
+    size_t offset {0};
+    do {
+        uint16_t length {static_cast<uint16_t>(std::min(MAX_BLOCK, data.size() - offset))};
+        bool last {offset + length == data.size()};
+        out.push_back(last ? 1 : 0);
+        out.push_back(static_cast<uint8_t>(length));
+        out.push_back(static_cast<uint8_t>(length >> 8));
+        out.push_back(static_cast<uint8_t>(~length));
+        out.push_back(static_cast<uint8_t>(~length >> 8));
+        out.insert(out.end(), data.begin() + offset, data.begin() + offset + length);
+        offset += length;
+    } while (offset < data.size());
+
+    uint32_t a {1};
+    uint32_t b {0};
+    for (uint8_t byte : data) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    appendBigEndian(out, (b << 16) | a);
+}
+
+auto clampByte(float value) -> uint8_t {
+    return static_cast<uint8_t>(std::clamp(value + 0.5f, 0.0f, 255.0f));
+}
+
+}
+
+auto encodePng(uint32_t width,
+               uint32_t height,
+               const std::vector<uint8_t>& rgba) -> std::vector<uint8_t> {
+    EncodeBuffers buffers {};
+    encodePng(width, height, rgba, buffers);
+    return std::move(buffers.output);
+}
+
+void encodePng(uint32_t width,
+               uint32_t height,
+               const std::vector<uint8_t>& rgba,
+               EncodeBuffers& buffers) {
+    std::vector<uint8_t>& scanlines {buffers.scanlines};
+    scanlines.clear();
+    scanlines.reserve(static_cast<size_t>(width * 3 + 1) * height);
+    for (uint32_t y {0}; y < height; y++) {
+        const uint8_t* row {rgba.data() + static_cast<size_t>(height - 1 - y) * width * 4};
+        scanlines.push_back(0);
+        for (uint32_t x {0}; x < width; x++) {
+            scanlines.insert(scanlines.end(), row + x * 4, row + x * 4 + 3);
+        }
+    }
+
+    std::vector<uint8_t>& png {buffers.output};
+    png.assign({0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'});
+    size_t chunk {beginChunk(png, "IHDR")};
+    appendBigEndian(png, width);
+    appendBigEndian(png, height);
+    // 8-bit truecolour, deflate, no filtering beyond type 0, no interlace
+    png.insert(png.end(), {8, 2, 0, 0, 0});
+    endChunk(png, chunk);
+    chunk = beginChunk(png, "IDAT");
+    storeZlib(scanlines, png);
+    endChunk(png, chunk);
+    endChunk(png, beginChunk(png, "IEND"));
+}
+
+void writeY4mHeader(std::ostream& out, uint32_t width, uint32_t height, uint32_t fps) {
+    out << "YUV4MPEG2 W" << width << " H" << height << " F" << fps
+        << ":1 Ip A1:1 C420jpeg\n";
+}
+
+void writeY4mFrame(std::ostream& out,
+                   uint32_t width,
+                   uint32_t height,
+                   const std::vector<uint8_t>& rgba) {
+    EncodeBuffers buffers {};
+    writeY4mFrame(out, width, height, rgba, buffers);
+}
+
+void writeY4mFrame(std::ostream& out,
+                   uint32_t width,
+                   uint32_t height,
+                   const std::vector<uint8_t>& rgba,
+                   EncodeBuffers& buffers) {
+    uint32_t chromaWidth {(width + 1) / 2};
+    uint32_t chromaHeight {(height + 1) / 2};
+    std::vector<uint8_t>& planes {buffers.output};
+    planes.resize(static_cast<size_t>(width) * height
+                  + 2 * static_cast<size_t>(chromaWidth) * chromaHeight);
+    uint8_t* luma {planes.data()};
+    uint8_t* cb {luma + static_cast<size_t>(width) * height};
+    uint8_t* cr {cb + static_cast<size_t>(chromaWidth) * chromaHeight};
+
+    auto pixel = [&](uint32_t x, uint32_t y) -> const uint8_t* {
+        return rgba.data() + (static_cast<size_t>(height - 1 - y) * width + x) * 4;
+    };
+    for (uint32_t y {0}; y < height; y++) {
+        for (uint32_t x {0}; x < width; x++) {
+            const uint8_t* p {pixel(x, y)};
+            luma[static_cast<size_t>(y) * width + x] =
+                clampByte(0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2]);
+        }
+    }
+    // each chroma sample averages the 2x2 block it covers
+    for (uint32_t cy {0}; cy < chromaHeight; cy++) {
+        for (uint32_t cx {0}; cx < chromaWidth; cx++) {
+            float r {0.0f};
+            float g {0.0f};
+            float b {0.0f};
+            float count {0.0f};
+            for (uint32_t y {cy * 2}; y < std::min(cy * 2 + 2, height); y++) {
+                for (uint32_t x {cx * 2}; x < std::min(cx * 2 + 2, width); x++) {
+                    const uint8_t* p {pixel(x, y)};
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                    count += 1.0f;
+                }
+            }
+            r /= count;
+            g /= count;
+            b /= count;
+            size_t index {static_cast<size_t>(cy) * chromaWidth + cx};
+            cb[index] = clampByte(128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b);
+            cr[index] = clampByte(128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b);
+        }
+    }
+    out << "FRAME\n";
+    out.write(reinterpret_cast<const char*>(planes.data()), planes.size());
+}
+
+FrameCapture::FrameCapture(uint32_t width, uint32_t height, CaptureSettings settings)
+:   m_width {width},
+    m_height {height},
+    m_settings {settings}
+{
+    if (width == 0 || height == 0) {
+        std::cout << "Failed to create frame capture: empty frame size.\n";
+        return;
+    }
+    size_t frameBytes {static_cast<size_t>(width) * height * 4};
+    m_readbacks.resize(std::max<size_t>(m_settings.bufferCount, 1));
+    GLint previousPack {0};
+    glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &previousPack);
+    for (Readback& readback : m_readbacks) {
+        glGenBuffers(1, &readback.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, previousPack);
+
+    for (size_t i {0}; i < POOL_SIZE; i++) {
+        m_pool.push_back(std::make_unique<Frame>());
+        m_pool.back()->pixels.resize(frameBytes);
+        m_free.push(m_pool.back().get());
+    }
+
+    if (m_settings.format == CAPTURE_FORMAT::Y4M) {
+        m_stream.open(m_settings.path, std::ios::binary);
+        if (!m_stream) {
+            std::cout << "Failed to open capture file " << m_settings.path << ".\n";
+            return;
+        }
+        writeY4mHeader(m_stream, width, height, m_settings.fps);
+    }
+    m_encoder = std::thread {&FrameCapture::_encodeLoop, this};
+    m_isValid = true;
+}
+
+FrameCapture::~FrameCapture() {
+    if (m_encoder.joinable()) {
+        finish();
+        m_stopping.store(true, std::memory_order_release);
+        m_queuedCount.release();
+        m_encoder.join();
+    }
+    for (Readback& readback : m_readbacks) {
+        if (readback.fence) {
+            glDeleteSync(readback.fence);
+        }
+        glDeleteBuffers(1, &readback.pbo);
+    }
+}
+
+void FrameCapture::capture(GLuint framebuffer) {
+    if (!m_isValid) {
+        return;
+    }
+    MAGE_PROFILE_SCOPE("FrameCapture::capture");
+    poll();
+    if (m_inFlight == m_readbacks.size()) {
+        // the GPU is a whole ring behind
+        m_stalls++;
+        _collect(m_readbacks[m_oldest], true);
+        m_oldest = (m_oldest + 1) % m_readbacks.size();
+        m_inFlight--;
+    }
+
+    Readback& readback {m_readbacks[(m_oldest + m_inFlight) % m_readbacks.size()]};
+    GLint previousRead {0};
+    GLint previousPack {0};
+    GLint previousAlignment {4};
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousRead);
+    glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &previousPack);
+    glGetIntegerv(GL_PACK_ALIGNMENT, &previousAlignment);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    // with a pack buffer bound this only queues the copy
+    glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.frame = m_captured++;
+    m_inFlight++;
+    glPixelStorei(GL_PACK_ALIGNMENT, previousAlignment);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, previousPack);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, previousRead);
+}
+
+void FrameCapture::poll() {
+    while (m_inFlight > 0 && _collect(m_readbacks[m_oldest], false)) {
+        m_oldest = (m_oldest + 1) % m_readbacks.size();
+        m_inFlight--;
+    }
+}
+
+void FrameCapture::finish() {
+    if (!m_isValid) {
+        return;
+    }
+    MAGE_PROFILE_SCOPE("FrameCapture::finish");
+    while (m_inFlight > 0) {
+        _collect(m_readbacks[m_oldest], true);
+        m_oldest = (m_oldest + 1) % m_readbacks.size();
+        m_inFlight--;
+    }
+    while (m_encoded.load(std::memory_order_acquire) < m_captured) {
+        std::this_thread::yield();
+    }
+}
+
+bool FrameCapture::_collect(Readback& readback, bool wait) {
+    // the flush bit makes sure the fence is submitted, or it never signals
+    GLuint64 timeout {wait ? 1000000000ull : 0};
+    GLenum status {glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout)};
+    while (wait && status == GL_TIMEOUT_EXPIRED) {
+        status = glClientWaitSync(readback.fence, 0, timeout);
+    }
+    if (status == GL_TIMEOUT_EXPIRED) {
+        return false;
+    }
+    glDeleteSync(readback.fence);
+    readback.fence = nullptr;
+
+    Frame* frame {nullptr};
+    if (!m_free.pop(frame)) {
+        // every pooled frame is waiting on the encoder
+        m_stalls++;
+        while (!m_free.pop(frame)) {
+            std::this_thread::yield();
+        }
+    }
+    GLint previousPack {0};
+    glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &previousPack);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    const void* data {glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame->pixels.size(), GL_MAP_READ_BIT)};
+    if (data) {
+        std::memcpy(frame->pixels.data(), data, frame->pixels.size());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    else {
+        std::cout << "Failed to map capture buffer for frame " << readback.frame << ".\n";
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, previousPack);
+
+    frame->index = readback.frame;
+    m_queued.push(frame);
+    m_queuedCount.release();
+    return true;
+}
+
+void FrameCapture::_encodeLoop() {
+    Profiler::instance().setThreadName("capture encoder");
+    while (true) {
+        m_queuedCount.acquire();
+        Frame* frame {nullptr};
+        if (!m_queued.pop(frame)) {
+            if (m_stopping.load(std::memory_order_acquire)) {
+                return;
+            }
+            continue;
+        }
+        _encode(*frame);
+        m_free.push(frame);
+        m_encoded.fetch_add(1, std::memory_order_release);
+    }
+}
+
+void FrameCapture::_encode(const Frame& frame) {
+    MAGE_PROFILE_SCOPE("FrameCapture::encode");
+    if (m_settings.format == CAPTURE_FORMAT::Y4M) {
+        writeY4mFrame(m_stream, m_width, m_height, frame.pixels, m_buffers);
+        if (m_queued.size() == 0) {
+            m_stream.flush();
+        }
+        return;
+    }
+    char suffix[32] {};
+    std::snprintf(suffix, sizeof(suffix), "_%06llu.png",
+                  static_cast<unsigned long long>(frame.index));
+    std::ofstream file {m_settings.path + suffix, std::ios::binary};
+    encodePng(m_width, m_height, frame.pixels, m_buffers);
+    file.write(reinterpret_cast<const char*>(m_buffers.output.data()), m_buffers.output.size());
+    if (!file) {
+        std::cout << "Failed to write " << m_settings.path + suffix << ".\n";
+    }
+}
+
+}
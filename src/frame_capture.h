@@ -0,0 +1,149 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <glad/glad.h>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <semaphore>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spsc_ring.h>
+
+namespace sjd {
+
+enum class CAPTURE_FORMAT {
+    // one file per frame, path_000000.png onwards
+    PNG,
+    // one YUV4MPEG2 stream at path, 4:2:0 full range BT.601
+    Y4M
+};
+
+// rgba holds width * height RGBA8 pixels, bottom row first as GL returns
+// them; both writers flip to top row first and drop alpha.
+//
+// PNG data is deflate "stored" blocks: no compression, so the encoder
+// keeps up with every frame at the cost of file size.
+auto encodePng(uint32_t width,
+               uint32_t height,
+               const std::vector<uint8_t>& rgba) -> std::vector<uint8_t>;
+void writeY4mHeader(std::ostream& out, uint32_t width, uint32_t height, uint32_t fps);
+void writeY4mFrame(std::ostream& out,
+                   uint32_t width,
+                   uint32_t height,
+                   const std::vector<uint8_t>& rgba);
+
+// Working memory kept between frames, so encoding a sequence only
+// allocates until the buffers have grown to the frame size.
+struct EncodeBuffers {
+    std::vector<uint8_t> scanlines;
+    // the whole file after encodePng, the Y, Cb and Cr planes after
+    // writeY4mFrame
+    std::vector<uint8_t> output;
+};
+
+void encodePng(uint32_t width,
+               uint32_t height,
+               const std::vector<uint8_t>& rgba,
+               EncodeBuffers& buffers);
+void writeY4mFrame(std::ostream& out,
+                   uint32_t width,
+                   uint32_t height,
+                   const std::vector<uint8_t>& rgba,
+                   EncodeBuffers& buffers);
+
+struct CaptureSettings {
+    CAPTURE_FORMAT format {CAPTURE_FORMAT::PNG};
+    std::string path {"capture"};
+    uint32_t fps {60};
+    // readbacks in flight; the frame mapped is this many frames old
+    size_t bufferCount {3};
+};
+
+// Captures frames without stalling the render thread.
+//
+// capture() issues glReadPixels into a pixel buffer object and fences it,
+// so the copy happens on the GPU timeline. Later calls map whichever
+// buffers' fences have signalled, copy them into a pooled frame and hand
+// that to an encoder thread, which writes PNG or Y4M. The render thread
+// only waits when every buffer is still in flight, or every pooled frame
+// is still queued for the encoder; both are counted as stalls.
+class FrameCapture {
+public:
+    FrameCapture(uint32_t width, uint32_t height, CaptureSettings settings = {});
+    // finishes and encodes every frame still in flight
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    auto isValid() const -> bool { return m_isValid; }
+    auto width() const -> const uint32_t& { return m_width; }
+    auto height() const -> const uint32_t& { return m_height; }
+    auto framesCaptured() const -> const uint64_t& { return m_captured; }
+    auto framesEncoded() const -> uint64_t { return m_encoded.load(std::memory_order_acquire); }
+    auto stalls() const -> const uint64_t& { return m_stalls; }
+
+    // queues a readback of the colour buffer of a single-sampled
+    // framebuffer, 0 for the window's back buffer
+    void capture(GLuint framebuffer);
+
+    // hands every finished readback to the encoder without waiting
+    void poll();
+
+    // waits for every readback and for the encoder to write them all
+    void finish();
+
+private:
+    static const size_t POOL_SIZE = 8;
+
+    struct Readback {
+        GLuint pbo {0};
+        GLsync fence {nullptr};
+        uint64_t frame {0};
+    };
+
+    struct Frame {
+        uint64_t index {0};
+        std::vector<uint8_t> pixels;
+    };
+
+    // blocks on the fence when wait is set, otherwise returns false if
+    // the GPU hasn't finished the copy yet
+    bool _collect(Readback& readback, bool wait);
+    void _encodeLoop();
+    void _encode(const Frame& frame);
+
+    uint32_t m_width;
+    uint32_t m_height;
+    CaptureSettings m_settings;
+    bool m_isValid {false};
+    std::vector<Readback> m_readbacks;
+    // oldest readback still in flight
+    size_t m_oldest {0};
+    size_t m_inFlight {0};
+    uint64_t m_captured {0};
+    uint64_t m_stalls {0};
+
+    // frames travel to the encoder through m_queued and come back through
+    // m_free, and the encoder reuses m_buffers, so once they have grown
+    // neither thread allocates pixel memory or locks per frame; a PNG
+    // sequence still opens a file per frame
+    std::vector<std::unique_ptr<Frame>> m_pool;
+    SpscRing<Frame*, POOL_SIZE> m_queued;
+    SpscRing<Frame*, POOL_SIZE> m_free;
+    std::counting_semaphore<> m_queuedCount {0};
+    std::atomic<bool> m_stopping {false};
+    std::atomic<uint64_t> m_encoded {0};
+    std::ofstream m_stream;
+    // only touched by the encoder thread
+    EncodeBuffers m_buffers;
+    std::thread m_encoder;
+};
+
+}
+#endif
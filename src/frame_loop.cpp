@@ -0,0 +1,155 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <frame_loop.h>
+#include <profiler.h>
+#include <cmath>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <timeapi.h>
+#endif
+
+namespace sjd {
+
+FixedStepClock::FixedStepClock(FixedStepSettings settings)
+:   m_settings {settings}
+{}
+
+auto FixedStepClock::alpha() const -> float {
+    return static_cast<float>(m_accumulator / m_settings.stepSeconds);
+}
+
+auto FixedStepClock::advance(double frameSeconds) -> uint32_t {
+    m_accumulator += std::max(frameSeconds, 0.0);
+    uint32_t steps {0};
+    while (m_accumulator >= m_settings.stepSeconds && steps < m_settings.maxSteps) {
+        m_accumulator -= m_settings.stepSeconds;
+        steps++;
+    }
+    if (m_accumulator >= m_settings.stepSeconds) {
+        // keep the fraction so interpolation doesn't jump, drop whole steps
+        double kept {std::fmod(m_accumulator, m_settings.stepSeconds)};
+        m_dropped += m_accumulator - kept;
+        m_accumulator = kept;
+    }
+    m_steps += steps;
+    return steps;
+}
+
+void FixedStepClock::reset() {
+    m_accumulator = 0.0;
+    m_dropped = 0.0;
+    m_steps = 0;
+}
+
+FramePacer::FramePacer(FramePacingSettings settings)
+:   m_settings {settings}
+{
+    setVsync(m_settings.vsync);
+#ifdef _WIN32
+    if (m_settings.targetFrameSeconds > 0.0) {
+        m_timerPeriodRaised = timeBeginPeriod(1) == TIMERR_NOERROR;
+    }
+#endif
+}
+
+FramePacer::~FramePacer() {
+#ifdef _WIN32
+    if (m_timerPeriodRaised) {
+        timeEndPeriod(1);
+    }
+#endif
+}
+
+void FramePacer::setVsync(bool vsync) {
+    m_settings.vsync = vsync;
+    if (glfwGetCurrentContext() != nullptr) {
+        glfwSwapInterval(vsync ? 1 : 0);
+    }
+}
+
+auto FramePacer::beginFrame() -> double {
+    if (m_settings.targetFrameSeconds > 0.0 && m_started) {
+        _wait();
+    }
+    Clock::time_point now {Clock::now()};
+    double frameSeconds {m_started
+        ? std::chrono::duration<double>(now - m_lastFrame).count()
+        : 0.0};
+    m_lastFrame = now;
+    m_started = true;
+    return frameSeconds;
+}
+
+void FramePacer::markInputSampled() {
+    m_inputSampled = Clock::now();
+    m_inputMarked = true;
+}
+
+void FramePacer::endFrame() {
+    if (!m_settings.measureLatency || !m_inputMarked) {
+        return;
+    }
+    if (glfwGetCurrentContext() != nullptr) {
+        glFinish();
+    }
+    std::chrono::duration<double, std::milli> latency {Clock::now() - m_inputSampled};
+    m_latencyMs.push_back(latency.count());
+    while (m_latencyMs.size() > m_settings.latencyHistory) {
+        m_latencyMs.pop_front();
+    }
+    m_inputMarked = false;
+}
+
+auto FramePacer::latency() const -> LatencyStats {
+    LatencyStats stats {};
+    stats.samples = m_latencyMs.size();
+    if (stats.samples == 0) {
+        return stats;
+    }
+    std::vector<double> sorted(m_latencyMs.begin(), m_latencyMs.end());
+    std::sort(sorted.begin(), sorted.end());
+    for (double ms : sorted) {
+        stats.meanMs += ms;
+    }
+    stats.meanMs /= static_cast<double>(sorted.size());
+    stats.p95Ms = sorted[std::min(sorted.size() - 1, sorted.size() * 95 / 100)];
+    stats.maxMs = sorted.back();
+    return stats;
+}
+
+void FramePacer::_wait() {
+    MAGE_PROFILE_SCOPE("FramePacer::wait");
+    m_spinSeconds = 0.0;
+    auto target {std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(m_settings.targetFrameSeconds))};
+    Clock::time_point deadline {m_lastFrame + target};
+    Clock::time_point now {Clock::now()};
+    if (now >= deadline) {
+        return;
+    }
+    auto margin {std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(m_sleepMargin))};
+    if (deadline - now > margin) {
+        Clock::time_point wake {deadline - margin};
+        std::this_thread::sleep_until(wake);
+        // grow the margin straight away when a sleep overshoots it, and
+        // let it shrink back once sleeps are accurate again; the cap keeps
+        // a coarse OS timer from turning the wait into a busy loop, at the
+        // cost of finishing late
+        double overshoot {std::chrono::duration<double>(Clock::now() - wake).count()};
+        m_sleepMargin = std::max(overshoot, m_sleepMargin * 0.9);
+        m_sleepMargin = std::clamp(m_sleepMargin, 0.0002,
+                                   std::min(MAX_SLEEP_MARGIN, m_settings.targetFrameSeconds));
+    }
+    Clock::time_point spinStart {Clock::now()};
+    while (Clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    m_spinSeconds = std::chrono::duration<double>(Clock::now() - spinStart).count();
+}
+
+}
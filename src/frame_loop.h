@@ -0,0 +1,266 @@
+#ifndef FRAME_LOOP_H
+#define FRAME_LOOP_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace sjd {
+
+struct FixedStepSettings {
+    double stepSeconds {1.0 / 60.0};
+    // steps run for one frame at most; the rest of a long hitch is dropped
+    // so a slow frame can't leave the simulation further behind each time
+    uint32_t maxSteps {8};
+};
+
+// Turns variable frame times into a whole number of fixed steps, plus the
+// fraction of a step left over that renders interpolate by.
+class FixedStepClock {
+public:
+    FixedStepClock(FixedStepSettings settings = {});
+
+    auto settings() const -> const FixedStepSettings& { return m_settings; }
+    // steps run since construction or reset()
+    auto steps() const -> const uint64_t& { return m_steps; }
+    // time thrown away by the maxSteps limit
+    auto droppedSeconds() const -> const double& { return m_dropped; }
+    // how far the frame is past the last step, in [0, 1)
+    auto alpha() const -> float;
+
+    // adds a frame's time and returns how many steps to run for it
+    auto advance(double frameSeconds) -> uint32_t;
+    void reset();
+
+private:
+    FixedStepSettings m_settings;
+    double m_accumulator {0.0};
+    double m_dropped {0.0};
+    uint64_t m_steps {0};
+};
+
+// Runs a simulation on a fixed step from the render thread's frame times.
+//
+// step(state, stepSeconds, stepIndex) advances state by one step and must
+// depend on nothing but its arguments for runs to be reproducible; read
+// input through the step index or from a buffer filled before advance().
+// State needs an interpolate(a, b, alpha) found by argument-dependent
+// lookup, as CameraState and Transform have.
+template <typename State>
+class FixedStepSimulation {
+public:
+    using StepFunction = std::function<void(State&, double, uint64_t)>;
+
+    FixedStepSimulation(State initial, StepFunction step, FixedStepSettings settings = {})
+    :   m_clock {settings},
+        m_step {std::move(step)},
+        m_previous {initial},
+        m_current {std::move(initial)}
+    {}
+
+    auto clock() const -> const FixedStepClock& { return m_clock; }
+    auto previous() const -> const State& { return m_previous; }
+    auto current() const -> const State& { return m_current; }
+
+    // runs the steps frameSeconds covers and returns the state to draw,
+    // which trails the latest step by less than one step
+    auto advance(double frameSeconds) -> State {
+        uint32_t steps {m_clock.advance(frameSeconds)};
+        uint64_t index {m_clock.steps() - steps};
+        for (uint32_t i {0}; i < steps; i++) {
+            m_previous = m_current;
+            m_step(m_current, m_clock.settings().stepSeconds, index + i);
+        }
+        return interpolate(m_previous, m_current, m_clock.alpha());
+    }
+
+private:
+    FixedStepClock m_clock;
+    StepFunction m_step;
+    State m_previous;
+    State m_current;
+};
+
+// Runs a simulation on its own thread, a fixed step apart in wall-clock
+// time, and lets the render thread sample it at any moment.
+//
+// Each step is computed on a private copy and published under a lock held
+// only long enough to copy two states, so neither thread waits on the
+// other's work. The same step function gives the same states as
+// FixedStepSimulation; only when they are drawn differs.
+template <typename State>
+class SimulationThread {
+public:
+    using StepFunction = std::function<void(State&, double, uint64_t)>;
+    using Clock = std::chrono::steady_clock;
+
+    SimulationThread(State initial, StepFunction step, FixedStepSettings settings = {})
+    :   m_settings {settings},
+        m_step {std::move(step)},
+        m_previous {initial},
+        m_current {std::move(initial)}
+    {}
+    ~SimulationThread() { stop(); }
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    auto settings() const -> const FixedStepSettings& { return m_settings; }
+    auto isRunning() const -> bool { return m_thread.joinable(); }
+    auto steps() const -> uint64_t { return m_steps.load(std::memory_order_acquire); }
+    auto droppedSteps() const -> uint64_t { return m_dropped.load(std::memory_order_relaxed); }
+
+    void start() {
+        if (isRunning()) {
+            return;
+        }
+        m_stopping.store(false, std::memory_order_relaxed);
+        m_thread = std::thread {&SimulationThread::_run, this};
+    }
+
+    // finishes the step in progress; the state stays readable afterwards
+    void stop() {
+        if (!isRunning()) {
+            return;
+        }
+        m_stopping.store(true, std::memory_order_relaxed);
+        m_thread.join();
+    }
+
+    // the most recent step
+    auto latest() const -> State {
+        std::lock_guard<std::mutex> lock {m_mutex};
+        return m_current;
+    }
+
+    // the state one step behind now, interpolated between the last two
+    // steps by how long ago the latest was published
+    auto sample() const -> State {
+        std::lock_guard<std::mutex> lock {m_mutex};
+        std::chrono::duration<double> since {Clock::now() - m_publishedAt};
+        double alpha {std::clamp(since.count() / m_settings.stepSeconds, 0.0, 1.0)};
+        return interpolate(m_previous, m_current, static_cast<float>(alpha));
+    }
+
+private:
+    void _run() {
+        auto step {std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(m_settings.stepSeconds))};
+        State working {latest()};
+        uint64_t index {m_steps.load(std::memory_order_relaxed)};
+        auto due {Clock::now()};
+        while (!m_stopping.load(std::memory_order_relaxed)) {
+            State before {working};
+            m_step(working, m_settings.stepSeconds, index);
+            index++;
+            {
+                std::lock_guard<std::mutex> lock {m_mutex};
+                m_previous = std::move(before);
+                m_current = working;
+                m_publishedAt = due;
+            }
+            m_steps.store(index, std::memory_order_release);
+
+            due += step;
+            auto now {Clock::now()};
+            if (now - due > step * m_settings.maxSteps) {
+                // too far behind to catch up, as with FixedStepClock's limit
+                m_dropped.fetch_add((now - due) / step, std::memory_order_relaxed);
+                due = now;
+            }
+            std::this_thread::sleep_until(due);
+        }
+    }
+
+    FixedStepSettings m_settings;
+    StepFunction m_step;
+    mutable std::mutex m_mutex;
+    State m_previous;
+    State m_current;
+    Clock::time_point m_publishedAt {Clock::now()};
+    std::atomic<uint64_t> m_steps {0};
+    std::atomic<uint64_t> m_dropped {0};
+    std::atomic<bool> m_stopping {false};
+    std::thread m_thread;
+};
+
+struct FramePacingSettings {
+    // 0 leaves the rate to vsync, or runs uncapped without it
+    double targetFrameSeconds {0.0};
+    // applied to the current context's swap interval on construction
+    bool vsync {true};
+    // records the time from markInputSampled() until the frame is finished
+    // on the GPU, which costs a glFinish() per frame
+    bool measureLatency {false};
+    size_t latencyHistory {240};
+};
+
+struct LatencyStats {
+    size_t samples {0};
+    double meanMs {0.0};
+    double p95Ms {0.0};
+    double maxMs {0.0};
+};
+
+// the most a pacer's sleeps end early by, however badly the OS oversleeps
+const double MAX_SLEEP_MARGIN {0.002};
+
+// Holds frames to a target rate with as little sleeping past the deadline
+// as the OS allows.
+//
+// The pacer sleeps for the frame's remaining time less the largest
+// oversleep seen recently, capped at MAX_SLEEP_MARGIN, then yields for what
+// is left. The wait is at the start of the frame, so input polled straight
+// after beginFrame() is as fresh as possible when the frame is drawn. On
+// Windows a pacer with a target raises the system timer resolution to 1 ms
+// while it lives; without that, sleeps end on a 15.6 ms tick.
+class FramePacer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    FramePacer(FramePacingSettings settings = {});
+    ~FramePacer();
+
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+
+    auto settings() const -> const FramePacingSettings& { return m_settings; }
+    // how early sleeps currently end to allow for oversleeping
+    auto sleepMarginSeconds() const -> const double& { return m_sleepMargin; }
+    // time the last beginFrame() spent yielding after its sleep
+    auto spinSeconds() const -> const double& { return m_spinSeconds; }
+
+    void setVsync(bool vsync);
+
+    // waits until the next frame is due, then returns the seconds since
+    // the previous beginFrame(), or 0.0 on the first call
+    auto beginFrame() -> double;
+    // call as input is polled; the latest call before endFrame() counts
+    void markInputSampled();
+    // call after swapping buffers
+    void endFrame();
+
+    auto latency() const -> LatencyStats;
+
+private:
+    void _wait();
+
+    FramePacingSettings m_settings;
+    Clock::time_point m_lastFrame {};
+    bool m_started {false};
+    double m_sleepMargin {0.001};
+    double m_spinSeconds {0.0};
+    bool m_timerPeriodRaised {false};
+    Clock::time_point m_inputSampled {};
+    bool m_inputMarked {false};
+    std::deque<double> m_latencyMs;
+};
+
+}
+#endif
@@ -0,0 +1,145 @@
+#include <framebuffer.h>
+#include <profiler.h>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+namespace sjd {
+
+Framebuffer::Framebuffer(uint32_t width, uint32_t height, uint16_t samples)
+:   m_width {width},
+    m_height {height},
+    m_samples {samples > 1 ? samples : static_cast<uint16_t>(0)}
+{
+    m_isValid = _create();
+    if (!m_isValid) {
+        std::cout << "Failed to create offscreen framebuffer.\n";
+    }
+}
+
+Framebuffer::~Framebuffer() {
+    _destroy();
+}
+
+void Framebuffer::bind() const {
+    MAGE_COUNT_STATE_CHANGE();
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glViewport(0, 0, m_width, m_height);
+}
+
+void Framebuffer::resize(uint32_t width, uint32_t height) {
+    if (width == m_width && height == m_height) {
+        return;
+    }
+    GLint previousFbo {0};
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFbo);
+    bool wasBound {static_cast<GLuint>(previousFbo) == m_fbo};
+
+    _destroy();
+    m_width = width;
+    m_height = height;
+    m_isValid = _create();
+    if (!m_isValid) {
+        std::cout << "Failed to resize offscreen framebuffer.\n";
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, wasBound ? m_fbo : previousFbo);
+}
+
+auto Framebuffer::readPixels() -> std::vector<uint8_t> {
+    MAGE_PROFILE_SCOPE("Framebuffer::readPixels");
+    std::vector<uint8_t> pixels(static_cast<size_t>(m_width) * m_height * 4);
+    if (!m_isValid) {
+        return pixels;
+    }
+    GLint previousRead {0};
+    GLint previousDraw {0};
+    GLint previousAlignment {4};
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousRead);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousDraw);
+    glGetIntegerv(GL_PACK_ALIGNMENT, &previousAlignment);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbo);
+    if (m_samples > 1) {
+        // multisampled storage cannot be read directly
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_resolveFbo);
+        glBlitFramebuffer(0, 0, m_width, m_height,
+                          0, 0, m_width, m_height,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_resolveFbo);
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+    glPixelStorei(GL_PACK_ALIGNMENT, previousAlignment);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, previousRead);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousDraw);
+    return pixels;
+}
+
+bool Framebuffer::_create() {
+    if (m_width == 0 || m_height == 0) {
+        return false;
+    }
+    glGenRenderbuffers(1, &m_color);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_color);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, m_samples, GL_RGBA8, m_width, m_height);
+    glGenRenderbuffers(1, &m_depthStencil);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_depthStencil);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, m_samples, GL_DEPTH24_STENCIL8, m_width, m_height);
+
+    glGenFramebuffers(1, &m_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depthStencil);
+    bool complete {glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE};
+
+    if (m_samples > 1) {
+        glGenRenderbuffers(1, &m_resolveColor);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_resolveColor);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_width, m_height);
+        glGenFramebuffers(1, &m_resolveFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_resolveFbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_resolveColor);
+        complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return complete;
+}
+
+void Framebuffer::abandon() {
+    m_fbo = m_color = m_depthStencil = m_resolveFbo = m_resolveColor = 0;
+    m_isValid = false;
+}
+
+void Framebuffer::_destroy() {
+    if (m_fbo == 0) {
+        return;
+    }
+    glDeleteFramebuffers(1, &m_fbo);
+    glDeleteRenderbuffers(1, &m_color);
+    glDeleteRenderbuffers(1, &m_depthStencil);
+    glDeleteFramebuffers(1, &m_resolveFbo);
+    glDeleteRenderbuffers(1, &m_resolveColor);
+    m_fbo = m_color = m_depthStencil = m_resolveFbo = m_resolveColor = 0;
+}
+
+auto countDifferentPixels(const std::vector<uint8_t>& a,
+                          const std::vector<uint8_t>& b,
+                          uint8_t tolerance) -> size_t {
+    if (a.size() != b.size()) {
+        return std::max(a.size(), b.size()) / 4;
+    }
+    size_t different {0};
+    for (size_t i {0}; i + 3 < a.size(); i += 4) {
+        for (size_t channel {0}; channel < 4; channel++) {
+            if (std::abs(a[i + channel] - b[i + channel]) > tolerance) {
+                different++;
+                break;
+            }
+        }
+    }
+    return different;
+}
+
+}
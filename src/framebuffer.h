@@ -0,0 +1,63 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sjd {
+
+// An offscreen RGBA8 colour target with a depth-stencil attachment. This
+// is what a headless context renders into, as it has no window surface.
+class Framebuffer {
+public:
+    // samples > 1 allocates multisampled storage, resolved on readback
+    Framebuffer(uint32_t width, uint32_t height, uint16_t samples = 0);
+    ~Framebuffer();
+
+    Framebuffer(const Framebuffer&) = delete;
+    Framebuffer& operator=(const Framebuffer&) = delete;
+
+    auto isValid() const -> const bool& { return m_isValid; }
+    auto id() const -> const GLuint& { return m_fbo; }
+    auto width() const -> const uint32_t& { return m_width; }
+    auto height() const -> const uint32_t& { return m_height; }
+    auto samples() const -> const uint16_t& { return m_samples; }
+
+    // binds for drawing and reading and sets the viewport to match
+    void bind() const;
+
+    // reallocates the attachments; the contents are lost
+    void resize(uint32_t width, uint32_t height);
+
+    // tightly packed RGBA8 rows, bottom row first as GL returns them
+    auto readPixels() -> std::vector<uint8_t>;
+
+    // forgets the GL objects without deleting them, once their context is gone
+    void abandon();
+
+private:
+    bool _create();
+    void _destroy();
+
+    uint32_t m_width;
+    uint32_t m_height;
+    uint16_t m_samples;
+    bool m_isValid {false};
+    GLuint m_fbo {0};
+    GLuint m_color {0};
+    GLuint m_depthStencil {0};
+    // single-sample copy that multisampled contents are blitted into
+    GLuint m_resolveFbo {0};
+    GLuint m_resolveColor {0};
+};
+
+// number of pixels whose channels differ by more than tolerance; images of
+// different sizes count every pixel of the larger one as different
+auto countDifferentPixels(const std::vector<uint8_t>& a,
+                          const std::vector<uint8_t>& b,
+                          uint8_t tolerance = 0) -> size_t;
+
+}
+#endif
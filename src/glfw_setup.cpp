@@ -1,19 +1,68 @@
 #include <glfw_setup.h>
+#include <cstdlib>
+#include <memory>
 
 namespace sjd {
 
+// one context is current per process, so one headless target is enough;
+// whatever is left at exit is dropped, as its context is already gone
+struct HeadlessTarget {
+    std::unique_ptr<Framebuffer> framebuffer {};
+    ~HeadlessTarget() {
+        if (framebuffer) {
+            framebuffer->abandon();
+        }
+    }
+};
+static HeadlessTarget s_headlessTarget {};
+
+// frees the last context's target, deleting its GL objects only if that
+// context is still current rather than destroyed by glfwTerminate()
+static void releaseHeadlessTarget() {
+    if (!s_headlessTarget.framebuffer) {
+        return;
+    }
+    if (glfwGetCurrentContext() == NULL) {
+        s_headlessTarget.framebuffer->abandon();
+    }
+    s_headlessTarget.framebuffer.reset();
+}
+
+auto contextBackendFromEnvironment() -> CONTEXT_BACKEND {
+    const char* value {std::getenv("MAGE_CONTEXT_BACKEND")};
+    if (!value) {
+        return CONTEXT_BACKEND::WINDOWED;
+    }
+    std::string backend {value};
+    if (backend == "egl") {
+        return CONTEXT_BACKEND::EGL;
+    }
+    if (backend == "osmesa") {
+        return CONTEXT_BACKEND::OSMESA;
+    }
+    return CONTEXT_BACKEND::WINDOWED;
+}
+
 auto createCursorLockedWindow(uint32_t windowWidth,
                               uint32_t windowHeight,
                               const std::string& windowName,
-                              uint16_t msaaBuffers) -> GLFWwindow*{
-    initializeGlfw(OPENGL_MAJOR_VERSION, OPENGL_MINOR_VERSION);
+                              uint16_t msaaBuffers,
+                              CONTEXT_BACKEND backend) -> GLFWwindow*{
+    MAGE_PROFILE_SCOPE("createCursorLockedWindow");
+    initializeGlfw(OPENGL_MAJOR_VERSION, OPENGL_MINOR_VERSION, backend);
     setMultiSampling(msaaBuffers);
 
-    ErrWindow<GLFWwindow*> window = createCoreWindow(windowWidth,
-                                             windowHeight,
-                                             windowName);
+    ErrWindow<GLFWwindow*> window = backend == CONTEXT_BACKEND::WINDOWED
+                                    ? createCoreWindow(windowWidth,
+                                                       windowHeight,
+                                                       windowName)
+                                    : createHeadlessContext(windowWidth,
+                                                            windowHeight,
+                                                            msaaBuffers);
     if (window.has_value()){
         configureViewPort(*window, windowWidth, windowHeight, msaaBuffers);
+        configure3Denv();
+        Profiler::instance().resetGpuTimers();
     }
     else {
         switch (window.error()){
@@ -23,18 +72,23 @@ auto createCursorLockedWindow(uint32_t windowWidth,
         case GLFW_ERROR::GLAD:
             std::cout << "Failed to initialised GLAD.\n";
             break;
+        case GLFW_ERROR::FRAMEBUFFER:
+            std::cout << "Failed to create headless framebuffer.\n";
+            break;
         default:
             std::cout << "Unknown GFLW Error.\n";
             break;
         }
     }
-    configure3Denv();
-    return *window;
+    // no context was made current, so there is nothing to configure
+    return window.value_or(nullptr);
 }
 
 auto createCoreWindow(uint32_t windowWidth,
                       uint32_t windowHeight,
                       const std::string& windowName) -> ErrWindow<GLFWwindow*> {
+    // a window has no headless target, not the last context's
+    releaseHeadlessTarget();
 
     GLFWwindow* window = glfwCreateWindow(windowWidth, 
                             windowHeight, 
@@ -54,6 +108,41 @@ auto createCoreWindow(uint32_t windowWidth,
     return window;
 }
 
+auto createHeadlessContext(uint32_t width,
+                           uint32_t height,
+                           uint16_t msaaBuffers) -> ErrWindow<GLFWwindow*> {
+    releaseHeadlessTarget();
+
+    GLFWwindow* window = glfwCreateWindow(width, height, "headless", NULL, NULL);
+    if (!window) {
+        glfwTerminate();
+        return std::unexpected(GLFW_ERROR::WINDOW);
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        glfwTerminate();
+        return std::unexpected(GLFW_ERROR::GLAD);
+    }
+    // a surfaceless context has no default framebuffer to draw into
+    s_headlessTarget.framebuffer = std::make_unique<Framebuffer>(width, height, msaaBuffers);
+    if (!s_headlessTarget.framebuffer->isValid()) {
+        s_headlessTarget.framebuffer.reset();
+        glfwTerminate();
+        return std::unexpected(GLFW_ERROR::FRAMEBUFFER);
+    }
+    s_headlessTarget.framebuffer->bind();
+    return window;
+}
+
+auto headlessFramebuffer() -> Framebuffer* {
+    return s_headlessTarget.framebuffer.get();
+}
+
+void terminateGlfw() {
+    releaseHeadlessTarget();
+    glfwTerminate();
+}
+
 void configureViewPort(GLFWwindow* window,
                        uint32_t windowWidth,
                        uint32_t windowHeight,
@@ -69,17 +158,40 @@ void configureViewPort(GLFWwindow* window,
                                    []([[maybe_unused]] GLFWwindow* window,
                                       int width,
                                       int height){
+                                          if (s_headlessTarget.framebuffer) {
+                                              s_headlessTarget.framebuffer->resize(width, height);
+                                          }
                                           glViewport(0, 0, width, height);
                                       }
     );
 }
 
-void initializeGlfw(uint16_t MajorOpenGLVersion, uint16_t MinorOpenGLVersion) {
+void initializeGlfw(uint16_t MajorOpenGLVersion,
+                    uint16_t MinorOpenGLVersion,
+                    CONTEXT_BACKEND backend) {
+    // init hints outlive glfwTerminate(), so always set the platform
+    glfwInitHint(GLFW_PLATFORM, backend == CONTEXT_BACKEND::WINDOWED
+                                ? GLFW_ANY_PLATFORM
+                                : GLFW_PLATFORM_NULL);
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, MajorOpenGLVersion);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, MinorOpenGLVersion);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+    switch (backend) {
+    case CONTEXT_BACKEND::EGL:
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        break;
+    case CONTEXT_BACKEND::OSMESA:
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        break;
+    default:
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_NATIVE_CONTEXT_API);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        break;
+    }
 }
 
 void setMultiSampling(uint16_t buffers){
@@ -94,6 +206,8 @@ void configure3Denv() {
     glEnable(GL_FRAMEBUFFER_SRGB);
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
+    // filter across cube map face edges, for the environment maps
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 }
 
 }
@@ -6,6 +6,9 @@
 #include <iostream>
 #include <expected>
 
+#include <framebuffer.h>
+#include <profiler.h>
+
 namespace sjd {
 
 const uint16_t OPENGL_MAJOR_VERSION = 3;
@@ -13,16 +16,32 @@ const uint16_t OPENGL_MINOR_VERSION = 3;
 
 enum class GLFW_ERROR {
     WINDOW,
-    GLAD
+    GLAD,
+    FRAMEBUFFER
+};
+
+// WINDOWED opens a visible window on the desktop; EGL and OSMESA create a
+// context on GLFW's null platform that needs no display and renders into
+// an offscreen framebuffer instead (EGL surfaceless or Mesa's llvmpipe)
+enum class CONTEXT_BACKEND {
+    WINDOWED,
+    EGL,
+    OSMESA
 };
 
+// reads MAGE_CONTEXT_BACKEND ("egl" or "osmesa"), so CI and render farm
+// machines can go headless without code changes; WINDOWED when unset
+auto contextBackendFromEnvironment() -> CONTEXT_BACKEND;
+
 template <typename T>
 using ErrWindow = std::expected<T, GLFW_ERROR>;
 
+// nullptr, with the reason printed, when no window or context was created
 auto createCursorLockedWindow(uint32_t windowWidth,
                       uint32_t windowHeight,
                       const std::string& windowName,
-                      uint16_t msaaBuffers = 1) -> GLFWwindow*;
+                      uint16_t msaaBuffers = 1,
+                      CONTEXT_BACKEND backend = contextBackendFromEnvironment()) -> GLFWwindow*;
 
 std::string printHelloTest(bool todo);
 
@@ -30,7 +49,25 @@ auto createCoreWindow(uint32_t windowWidth,
                       uint32_t windowHeight,
                       const std::string& windowName) -> ErrWindow<GLFWwindow*>;
 
-void initializeGlfw(uint16_t MajorOpenGLVersion, uint16_t MinorOpenGLVersion);
+// expects initializeGlfw() to have been called with a headless backend;
+// the returned window is invisible and its offscreen framebuffer is bound
+auto createHeadlessContext(uint32_t width,
+                           uint32_t height,
+                           uint16_t msaaBuffers = 1) -> ErrWindow<GLFWwindow*>;
+
+// the render target of the current headless context, nullptr when windowed
+auto headlessFramebuffer() -> Framebuffer*;
+
+// frees the headless target while its context is still current, then
+// terminates GLFW; prefer it to glfwTerminate() once a context exists
+void terminateGlfw();
+
+void initializeGlfw(uint16_t MajorOpenGLVersion,
+                    uint16_t MinorOpenGLVersion,
+                    CONTEXT_BACKEND backend = CONTEXT_BACKEND::WINDOWED);
+// MSAA on the window; scenes drawn through a PostProcessChain get FXAA
+// instead and should pass 1 here, as the window only receives a fullscreen
+// triangle
 void setMultiSampling(uint16_t buffers);
 void configureViewPort(GLFWwindow* window,
                        uint32_t windowWidth,
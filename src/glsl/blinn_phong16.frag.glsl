@@ -2,6 +2,7 @@
 in vec2 texCoords;
 in vec3 fragNormal;
 in vec3 fragPos;
+in float viewDepth;
 
 out vec4 FragColor;
 
@@ -31,6 +32,8 @@ struct PointLight {
     float quadratic;
 };
 const int NUM_POINT_LIGHTS = 16;
+// must match MAX_SHADOW_CASCADES in shadow_map.h
+const int NUM_CASCADES = 4;
 
 uniform vec3 viewPos;
 uniform DirLight dirLight;
@@ -38,7 +41,23 @@ uniform PointLight pointLights[NUM_POINT_LIGHTS];
 uniform Material material;
 uniform int numPointLights;
 
-vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir);
+// cascaded shadow map for dirLight; numCascades == 0 disables shadowing
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 lightSpaceMatrices[NUM_CASCADES];
+uniform float cascadeSplits[NUM_CASCADES];
+uniform float shadowTexelSize;
+uniform int numCascades;
+
+// irradiance and prefiltered specular cubemaps from EnvironmentMap, in
+// place of dirLight.ambient; environmentLevels == 0 keeps the flat term
+uniform samplerCube irradianceMap;
+uniform samplerCube prefilteredMap;
+uniform int environmentLevels;
+uniform float environmentIntensity;
+
+vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow);
+float calcDirShadow(vec3 normal, vec3 lightDir);
+vec3 calcAmbient(vec3 normal, vec3 viewDir);
 vec3 calcPointLight(PointLight light, vec3 normal, vec3 viewDir);
 
 void main()
@@ -48,16 +67,17 @@ void main()
     vec3 viewDir = normalize(viewPos - fragPos);
 
     // phase 1: Directional lighting
-    vec3 dirResult = calcDirLight(dirLight, norm, viewDir);
+    float shadow = calcDirShadow(norm, normalize(-dirLight.direction));
+    vec3 dirResult = calcDirLight(dirLight, norm, viewDir, shadow);
     // point lighting
-    vec3 pointResult = {0, 0, 0};
+    vec3 pointResult = vec3(0.0);
     for (int i = 0; i < numPointLights; i++) {
         pointResult += calcPointLight(pointLights[i], norm, viewDir);
     }
-    FragColor = vec4(dirResult + pointResult, 1.0);
+    FragColor = vec4(calcAmbient(norm, viewDir) + dirResult + pointResult, 1.0);
 }
 
-vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow)
 {
     vec3 lightDir = normalize(-light.direction);
     vec3 halfwayDir = normalize(lightDir + viewDir);
@@ -66,11 +86,63 @@ vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
-    // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, texCoords));
+    // combine results; the ambient term is added by calcAmbient()
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, texCoords));
     vec3 specular = light.specular * spec * vec3(texture(material.specular, texCoords));
-    return (ambient + diffuse + specular);
+    return (1.0 - shadow) * (diffuse + specular);
+}
+
+vec3 calcAmbient(vec3 normal, vec3 viewDir)
+{
+    vec3 diffuseColor = vec3(texture(material.diffuse, texCoords));
+    if (environmentLevels == 0) {
+        return dirLight.ambient * diffuseColor;
+    }
+    vec3 specularColor = vec3(texture(material.specular, texCoords));
+    // Blinn-Phong exponent to the roughness the levels were filtered for,
+    // through the Beckmann slope alpha = sqrt(2 / (n + 2)) and roughness
+    // = sqrt(alpha)
+    float roughness = pow(2.0 / (material.shininess + 2.0), 0.25);
+    vec3 reflectDir = reflect(-viewDir, normal);
+    vec3 irradiance = texture(irradianceMap, normal).rgb;
+    vec3 reflection = textureLod(prefilteredMap, reflectDir,
+                                 roughness * float(environmentLevels - 1)).rgb;
+    // Schlick's approximation for a dielectric, 4% at normal incidence
+    float fresnel = 0.04 + 0.96 * pow(1.0 - max(dot(normal, viewDir), 0.0), 5.0);
+    return environmentIntensity * (irradiance * diffuseColor + fresnel * reflection * specularColor);
+}
+
+// returns 0.0 when fully lit, 1.0 when fully in shadow
+float calcDirShadow(vec3 normal, vec3 lightDir)
+{
+    if (numCascades == 0) {
+        return 0.0;
+    }
+    int cascade = numCascades - 1;
+    for (int i = 0; i < numCascades; i++) {
+        if (viewDepth < cascadeSplits[i]) {
+            cascade = i;
+            break;
+        }
+    }
+    vec4 lightSpacePos = lightSpaceMatrices[cascade] * vec4(fragPos, 1.0);
+    vec3 projCoords = lightSpacePos.xyz / lightSpacePos.w * 0.5 + 0.5;
+    if (projCoords.z > 1.0) {
+        return 0.0;
+    }
+    // grazing surfaces need a larger bias to avoid acne
+    float bias = max(0.002 * (1.0 - dot(normal, lightDir)), 0.0005);
+    float lit = 0.0;
+    // 3x3 taps, each one a hardware-filtered 2x2 comparison
+    for (int x = -1; x <= 1; x++) {
+        for (int y = -1; y <= 1; y++) {
+            vec2 offset = vec2(x, y) * shadowTexelSize;
+            lit += texture(shadowMap, vec4(projCoords.xy + offset,
+                                           float(cascade),
+                                           projCoords.z - bias));
+        }
+    }
+    return 1.0 - lit / 9.0;
 }
 
 vec3 calcPointLight(PointLight light, vec3 normal, vec3 viewDir) {
@@ -0,0 +1,6 @@
+#version 330 core
+// depth-only pass: no colour output, the rasteriser writes depth for us
+
+void main()
+{
+}
@@ -0,0 +1,47 @@
+#version 330 core
+in vec2 texCoords;
+out vec3 irradiance;
+
+uniform samplerCube source;
+// a blurred level of the source; the integral is smooth anyway
+uniform float sourceLod;
+uniform int face;
+
+const float PI = 3.14159265359;
+const int PHI_STEPS = 64;
+const int THETA_STEPS = 16;
+
+// must match cubeFaceDirection() in environment.cpp
+vec3 faceDirection(int face, vec2 uv)
+{
+    vec2 st = uv * 2.0 - 1.0;
+    if (face == 0) return vec3(1.0, -st.y, -st.x);
+    if (face == 1) return vec3(-1.0, -st.y, st.x);
+    if (face == 2) return vec3(st.x, 1.0, st.y);
+    if (face == 3) return vec3(st.x, -1.0, -st.y);
+    if (face == 4) return vec3(st.x, -st.y, 1.0);
+    return vec3(-st.x, -st.y, -1.0);
+}
+
+// cosine weighted integral of the hemisphere about the normal, divided by
+// pi so a lambertian surface only has to multiply it by its albedo
+void main()
+{
+    vec3 normal = normalize(faceDirection(face, texCoords));
+    vec3 up = abs(normal.y) < 0.999 ? vec3(0.0, 1.0, 0.0) : vec3(0.0, 0.0, 1.0);
+    vec3 right = normalize(cross(up, normal));
+    up = cross(normal, right);
+
+    vec3 sum = vec3(0.0);
+    // midpoint rule over a regular grid of azimuth and elevation
+    for (int p = 0; p < PHI_STEPS; p++) {
+        float phi = (float(p) + 0.5) * 2.0 * PI / float(PHI_STEPS);
+        for (int t = 0; t < THETA_STEPS; t++) {
+            float theta = (float(t) + 0.5) * 0.5 * PI / float(THETA_STEPS);
+            vec3 tangent = vec3(sin(theta) * cos(phi), sin(theta) * sin(phi), cos(theta));
+            vec3 direction = tangent.x * right + tangent.y * up + tangent.z * normal;
+            sum += textureLod(source, direction, sourceLod).rgb * cos(theta) * sin(theta);
+        }
+    }
+    irradiance = PI * sum / float(PHI_STEPS * THETA_STEPS);
+}
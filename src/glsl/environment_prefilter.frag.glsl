@@ -0,0 +1,84 @@
+#version 330 core
+in vec2 texCoords;
+out vec3 radiance;
+
+uniform samplerCube source;
+// face size of the source's first level
+uniform float sourceSize;
+uniform float roughness;
+uniform int sampleCount;
+uniform int face;
+
+const float PI = 3.14159265359;
+
+// must match cubeFaceDirection() in environment.cpp
+vec3 faceDirection(int face, vec2 uv)
+{
+    vec2 st = uv * 2.0 - 1.0;
+    if (face == 0) return vec3(1.0, -st.y, -st.x);
+    if (face == 1) return vec3(-1.0, -st.y, st.x);
+    if (face == 2) return vec3(st.x, 1.0, st.y);
+    if (face == 3) return vec3(st.x, -1.0, -st.y);
+    if (face == 4) return vec3(st.x, -st.y, 1.0);
+    return vec3(-st.x, -st.y, -1.0);
+}
+
+// Van der Corput sequence; bitfieldReverse needs GLSL 4.00
+float radicalInverse(uint bits)
+{
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return float(bits) * 2.3283064365386963e-10;
+}
+
+// GGX distributed halfway vector about normal, alpha = roughness squared
+vec3 importanceSampleGgx(vec2 xi, vec3 normal, float alpha)
+{
+    float phi = 2.0 * PI * xi.x;
+    float cosTheta = sqrt((1.0 - xi.y) / (1.0 + (alpha * alpha - 1.0) * xi.y));
+    float sinTheta = sqrt(1.0 - cosTheta * cosTheta);
+    vec3 halfway = vec3(cos(phi) * sinTheta, sin(phi) * sinTheta, cosTheta);
+    vec3 up = abs(normal.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+    vec3 tangent = normalize(cross(up, normal));
+    vec3 bitangent = cross(normal, tangent);
+    return normalize(tangent * halfway.x + bitangent * halfway.y + normal * halfway.z);
+}
+
+// split sum approximation: the view is taken to be along the normal, so
+// each texel is the GGX lobe about its own direction
+void main()
+{
+    vec3 normal = normalize(faceDirection(face, texCoords));
+    if (roughness <= 0.0) {
+        radiance = textureLod(source, normal, 0.0).rgb;
+        return;
+    }
+    float alpha = roughness * roughness;
+    // solid angle of one source texel
+    float texelAngle = 4.0 * PI / (6.0 * sourceSize * sourceSize);
+    vec3 sum = vec3(0.0);
+    float weight = 0.0;
+    for (int i = 0; i < sampleCount; i++) {
+        vec2 xi = vec2(float(i) / float(sampleCount), radicalInverse(uint(i)));
+        vec3 halfway = importanceSampleGgx(xi, normal, alpha);
+        vec3 light = normalize(2.0 * dot(normal, halfway) * halfway - normal);
+        float nDotL = dot(normal, light);
+        if (nDotL > 0.0) {
+            // read unlikely samples from blurrier levels, so a few hundred
+            // samples don't alias on small bright features like the sun
+            float nDotH = max(dot(normal, halfway), 0.0);
+            float a2 = alpha * alpha;
+            float denominator = nDotH * nDotH * (a2 - 1.0) + 1.0;
+            float distribution = a2 / (PI * denominator * denominator);
+            float pdf = distribution / 4.0 + 0.0001;
+            float sampleAngle = 1.0 / (float(sampleCount) * pdf + 0.0001);
+            float lod = max(0.5 * log2(sampleAngle / texelAngle) + 1.0, 0.0);
+            sum += textureLod(source, light, lod).rgb * nDotL;
+            weight += nDotL;
+        }
+    }
+    radiance = sum / max(weight, 0.0001);
+}
@@ -0,0 +1,38 @@
+#version 330 core
+in vec2 texCoords;
+out vec3 radiance;
+
+// the cube face being rendered, in GL order from +x
+uniform int face;
+uniform vec3 zenith;
+uniform vec3 horizon;
+uniform vec3 ground;
+uniform vec3 sunDirection;
+uniform vec3 sunColor;
+uniform float sunAngularRadius;
+
+// must match cubeFaceDirection() in environment.cpp
+vec3 faceDirection(int face, vec2 uv)
+{
+    vec2 st = uv * 2.0 - 1.0;
+    if (face == 0) return vec3(1.0, -st.y, -st.x);
+    if (face == 1) return vec3(-1.0, -st.y, st.x);
+    if (face == 2) return vec3(st.x, 1.0, st.y);
+    if (face == 3) return vec3(st.x, -1.0, -st.y);
+    if (face == 4) return vec3(st.x, -st.y, 1.0);
+    return vec3(-st.x, -st.y, -1.0);
+}
+
+// must match skyRadiance() in environment.cpp
+void main()
+{
+    vec3 direction = normalize(faceDirection(face, texCoords));
+    if (direction.y < 0.0) {
+        radiance = ground;
+        return;
+    }
+    radiance = mix(horizon, zenith, sqrt(direction.y));
+    // the disc fades out over its outer tenth
+    float angle = acos(clamp(dot(direction, normalize(sunDirection)), -1.0, 1.0));
+    radiance += sunColor * (1.0 - smoothstep(0.9 * sunAngularRadius, sunAngularRadius, angle));
+}
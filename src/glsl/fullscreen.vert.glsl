@@ -0,0 +1,11 @@
+#version 330 core
+out vec2 texCoords;
+
+// one oversized triangle covering the viewport, drawn with
+// glDrawArrays(GL_TRIANGLES, 0, 3) and no vertex buffer
+void main()
+{
+    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    texCoords = pos;
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
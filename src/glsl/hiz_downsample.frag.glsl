@@ -0,0 +1,46 @@
+#version 330 core
+out float farthestDepth;
+
+// the scene depth texture for level 0, otherwise the hi-z texture itself
+uniform sampler2D source;
+uniform int sourceLevel;
+uniform bool firstLevel;
+
+float fetchDepth(ivec2 coord, ivec2 maxCoord)
+{
+    return texelFetch(source, clamp(coord, ivec2(0), maxCoord), sourceLevel).r;
+}
+
+void main()
+{
+    ivec2 dst = ivec2(gl_FragCoord.xy);
+    ivec2 srcSize = textureSize(source, sourceLevel);
+    ivec2 maxCoord = srcSize - 1;
+    if (firstLevel) {
+        farthestDepth = fetchDepth(dst, maxCoord);
+        return;
+    }
+
+    ivec2 src = dst * 2;
+    float depth = max(max(fetchDepth(src, maxCoord),
+                          fetchDepth(src + ivec2(1, 0), maxCoord)),
+                      max(fetchDepth(src + ivec2(0, 1), maxCoord),
+                          fetchDepth(src + ivec2(1, 1), maxCoord)));
+
+    // odd sized levels: the last row/column also covers the leftover texels
+    ivec2 dstSize = max(srcSize / 2, ivec2(1));
+    bool extraX = (srcSize.x & 1) != 0 && dst.x == dstSize.x - 1;
+    bool extraY = (srcSize.y & 1) != 0 && dst.y == dstSize.y - 1;
+    if (extraX) {
+        depth = max(depth, max(fetchDepth(src + ivec2(2, 0), maxCoord),
+                               fetchDepth(src + ivec2(2, 1), maxCoord)));
+    }
+    if (extraY) {
+        depth = max(depth, max(fetchDepth(src + ivec2(0, 2), maxCoord),
+                               fetchDepth(src + ivec2(1, 2), maxCoord)));
+    }
+    if (extraX && extraY) {
+        depth = max(depth, fetchDepth(src + ivec2(2, 2), maxCoord));
+    }
+    farthestDepth = depth;
+}
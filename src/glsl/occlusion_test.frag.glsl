@@ -0,0 +1,32 @@
+#version 330 core
+
+uniform sampler2D hiZ;
+// screen-space bounds of the mesh as uv min (xy) and max (zw)
+uniform vec4 screenRect;
+uniform float nearestDepth;
+uniform int level;
+
+// faces parallel to the screen can round to exactly their own depth
+const float DEPTH_EPSILON = 0.00001;
+
+void main()
+{
+    // levels are floor(size / 2) with odd leftovers folded into the last
+    // texel, so the covering texel is the level 0 texel shifted, not the uv
+    // scaled by this level's size
+    ivec2 baseSize = textureSize(hiZ, 0);
+    ivec2 size = textureSize(hiZ, level);
+    ivec2 lo = clamp(ivec2(screenRect.xy * vec2(baseSize)) >> level, ivec2(0), size - 1);
+    ivec2 hi = clamp(ivec2(screenRect.zw * vec2(baseSize)) >> level, ivec2(0), size - 1);
+
+    // level is chosen so this covers at most 2x2 texels
+    float farthest = 0.0;
+    for (int y = lo.y; y <= hi.y; y++) {
+        for (int x = lo.x; x <= hi.x; x++) {
+            farthest = max(farthest, texelFetch(hiZ, ivec2(x, y), level).r);
+        }
+    }
+    if (nearestDepth > farthest + DEPTH_EPSILON) {
+        discard;
+    }
+}
@@ -0,0 +1,8 @@
+#version 330 core
+
+// a single point in the middle of the viewport; the fragment shader decides
+// whether it survives, which is all the occlusion query counts
+void main()
+{
+    gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,16 @@
+#version 330 core
+in vec2 corner;
+in float lifeFraction;
+out vec4 FragColor;
+
+uniform vec4 colour;
+
+// additive and unsorted, so fade by scaling the colour rather than alpha
+void main()
+{
+    float falloff = 1.0 - dot(corner, corner);
+    if (falloff <= 0.0) {
+        discard;
+    }
+    FragColor = vec4(colour.rgb * colour.a * falloff * (1.0 - lifeFraction), 1.0);
+}
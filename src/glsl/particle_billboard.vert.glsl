@@ -0,0 +1,29 @@
+#version 330 core
+// per instance, straight from the particle buffer
+layout(location = 0) in vec4 aPositionAge;
+layout(location = 1) in vec4 aVelocityLifetime;
+
+out vec2 corner;
+out float lifeFraction;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float size;
+
+// a camera-facing quad per particle, drawn as a 4 vertex triangle strip
+// with no vertex buffer of its own
+void main()
+{
+    float age = aPositionAge.w;
+    float lifetime = aVelocityLifetime.w;
+    corner = vec2(gl_VertexID & 1, (gl_VertexID >> 1) & 1) * 2.0 - 1.0;
+    lifeFraction = age / max(lifetime, 1e-6);
+    if (age >= lifetime) {
+        // outside the clip volume, so dead particles cost no fragments
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        return;
+    }
+    vec4 viewPos = view * vec4(aPositionAge.xyz, 1.0);
+    viewPos.xy += corner * size * 0.5;
+    gl_Position = projection * viewPos;
+}
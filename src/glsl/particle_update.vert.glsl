@@ -0,0 +1,29 @@
+#version 330 core
+layout(location = 0) in vec4 aPositionAge;
+layout(location = 1) in vec4 aVelocityLifetime;
+
+// captured by transform feedback into the other particle buffer
+out vec4 positionAge;
+out vec4 velocityLifetime;
+
+uniform float deltaTime;
+uniform vec3 gravity;
+uniform float drag;
+
+void main()
+{
+    vec3 position = aPositionAge.xyz;
+    float age = aPositionAge.w;
+    vec3 velocity = aVelocityLifetime.xyz;
+    float lifetime = aVelocityLifetime.w;
+    // dead and unused slots have age >= lifetime and are copied unchanged
+    if (age < lifetime) {
+        // semi-implicit Euler, matching integrateParticle()
+        velocity += gravity * deltaTime;
+        velocity *= max(1.0 - drag * deltaTime, 0.0);
+        position += velocity * deltaTime;
+        age += deltaTime;
+    }
+    positionAge = vec4(position, age);
+    velocityLifetime = vec4(velocity, lifetime);
+}
@@ -0,0 +1,70 @@
+#version 330 core
+in vec2 texCoords;
+out vec3 bloom;
+
+// the HDR scene for the first level, otherwise the previous bloom level
+uniform sampler2D source;
+uniform vec2 sourceTexelSize;
+uniform bool firstLevel;
+uniform float threshold;
+uniform float knee;
+
+vec3 sampleAt(vec2 offset)
+{
+    return texture(source, texCoords + offset * sourceTexelSize).rgb;
+}
+
+// quadratic ramp from threshold - knee up to threshold, linear above it
+vec3 prefilter(vec3 color)
+{
+    float brightness = max(color.r, max(color.g, color.b));
+    float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+    soft = soft * soft / (4.0 * knee + 0.00001);
+    float contribution = max(soft, brightness - threshold) / max(brightness, 0.00001);
+    return color * contribution;
+}
+
+// weighting by inverse luma keeps single very bright texels from flickering
+float karisWeight(vec3 color)
+{
+    return 1.0 / (1.0 + dot(color, vec3(0.2126, 0.7152, 0.0722)));
+}
+
+// 13 bilinear taps as five overlapping 2x2 boxes
+void main()
+{
+    vec3 a = sampleAt(vec2(-2.0, 2.0));
+    vec3 b = sampleAt(vec2(0.0, 2.0));
+    vec3 c = sampleAt(vec2(2.0, 2.0));
+    vec3 d = sampleAt(vec2(-2.0, 0.0));
+    vec3 e = sampleAt(vec2(0.0, 0.0));
+    vec3 f = sampleAt(vec2(2.0, 0.0));
+    vec3 g = sampleAt(vec2(-2.0, -2.0));
+    vec3 h = sampleAt(vec2(0.0, -2.0));
+    vec3 i = sampleAt(vec2(2.0, -2.0));
+    vec3 j = sampleAt(vec2(-1.0, 1.0));
+    vec3 k = sampleAt(vec2(1.0, 1.0));
+    vec3 l = sampleAt(vec2(-1.0, -1.0));
+    vec3 m = sampleAt(vec2(1.0, -1.0));
+
+    vec3 inner = (j + k + l + m) * 0.25;
+    vec3 topLeft = (a + b + d + e) * 0.25;
+    vec3 topRight = (b + c + e + f) * 0.25;
+    vec3 bottomLeft = (d + e + g + h) * 0.25;
+    vec3 bottomRight = (e + f + h + i) * 0.25;
+
+    if (!firstLevel) {
+        bloom = inner * 0.5 + (topLeft + topRight + bottomLeft + bottomRight) * 0.125;
+        return;
+    }
+
+    float wInner = 0.5 * karisWeight(inner);
+    float wTopLeft = 0.125 * karisWeight(topLeft);
+    float wTopRight = 0.125 * karisWeight(topRight);
+    float wBottomLeft = 0.125 * karisWeight(bottomLeft);
+    float wBottomRight = 0.125 * karisWeight(bottomRight);
+    vec3 color = inner * wInner + topLeft * wTopLeft + topRight * wTopRight
+               + bottomLeft * wBottomLeft + bottomRight * wBottomRight;
+    color /= wInner + wTopLeft + wTopRight + wBottomLeft + wBottomRight;
+    bloom = prefilter(color);
+}
@@ -0,0 +1,23 @@
+#version 330 core
+in vec2 texCoords;
+out vec3 bloom;
+
+// the smaller bloom level; the result is added onto the larger one
+uniform sampler2D source;
+uniform vec2 filterRadius;
+
+// 3x3 tent filter
+void main()
+{
+    vec2 r = filterRadius;
+    vec3 color = texture(source, texCoords).rgb * 4.0;
+    color += (texture(source, texCoords + vec2(-r.x, 0.0)).rgb
+            + texture(source, texCoords + vec2(r.x, 0.0)).rgb
+            + texture(source, texCoords + vec2(0.0, -r.y)).rgb
+            + texture(source, texCoords + vec2(0.0, r.y)).rgb) * 2.0;
+    color += texture(source, texCoords + vec2(-r.x, -r.y)).rgb
+           + texture(source, texCoords + vec2(r.x, -r.y)).rgb
+           + texture(source, texCoords + vec2(-r.x, r.y)).rgb
+           + texture(source, texCoords + vec2(r.x, r.y)).rgb;
+    bloom = color / 16.0;
+}
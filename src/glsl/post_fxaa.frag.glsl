@@ -0,0 +1,40 @@
+#version 330 core
+in vec2 texCoords;
+out vec4 FragColor;
+
+// tone mapped, sRGB encoded colour with luma in alpha
+uniform sampler2D image;
+uniform vec2 texelSize;
+
+const float SPAN_MAX = 8.0;
+const float REDUCE_MUL = 1.0 / 8.0;
+const float REDUCE_MIN = 1.0 / 128.0;
+
+// blurs along the edge direction estimated from the four diagonal
+// neighbours, falling back to a shorter blur if the longer one
+// leaves the local luma range
+void main()
+{
+    float lumaNW = texture(image, texCoords + vec2(-1.0, 1.0) * texelSize).a;
+    float lumaNE = texture(image, texCoords + vec2(1.0, 1.0) * texelSize).a;
+    float lumaSW = texture(image, texCoords + vec2(-1.0, -1.0) * texelSize).a;
+    float lumaSE = texture(image, texCoords + vec2(1.0, -1.0) * texelSize).a;
+    vec4 centre = texture(image, texCoords);
+    float lumaMin = min(centre.a, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(centre.a, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    vec2 dir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)),
+                    (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * REDUCE_MUL,
+                          REDUCE_MIN);
+    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir * rcpDirMin, vec2(-SPAN_MAX), vec2(SPAN_MAX)) * texelSize;
+
+    vec3 colorA = 0.5 * (texture(image, texCoords + dir * (1.0 / 3.0 - 0.5)).rgb
+                       + texture(image, texCoords + dir * (2.0 / 3.0 - 0.5)).rgb);
+    vec3 colorB = colorA * 0.5 + 0.25 * (texture(image, texCoords - dir * 0.5).rgb
+                                       + texture(image, texCoords + dir * 0.5).rgb);
+    float lumaB = dot(colorB, vec3(0.299, 0.587, 0.114));
+    vec3 color = (lumaB < lumaMin || lumaB > lumaMax) ? colorA : colorB;
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,35 @@
+#version 330 core
+in vec2 texCoords;
+out vec4 FragColor;
+
+uniform sampler2D scene;
+uniform sampler2D bloom;
+uniform float bloomIntensity;
+uniform float exposure;
+// FXAA reads luma from alpha instead of recomputing it for every tap
+uniform bool lumaInAlpha;
+
+// ACES filmic curve fitted by Narkowicz
+vec3 tonemapAces(vec3 x)
+{
+    return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+vec3 linearToSrgb(vec3 color)
+{
+    vec3 low = color * 12.92;
+    vec3 high = 1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055;
+    return mix(low, high, step(vec3(0.0031308), color));
+}
+
+void main()
+{
+    vec3 hdr = texture(scene, texCoords).rgb;
+    if (bloomIntensity > 0.0) {
+        // added rather than mixed in, so bloom never dims the scene
+        hdr += texture(bloom, texCoords).rgb * bloomIntensity;
+    }
+    vec3 color = linearToSrgb(tonemapAces(hdr * exposure));
+    float alpha = lumaInAlpha ? dot(color, vec3(0.299, 0.587, 0.114)) : 1.0;
+    FragColor = vec4(color, alpha);
+}
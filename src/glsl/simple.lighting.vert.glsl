@@ -6,15 +6,21 @@ layout(location = 2) in vec2 aTexCoords;
 out vec3 fragNormal;
 out vec3 fragPos;
 out vec2 texCoords;
+out float viewDepth;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// must match depth_only.vert.glsl so the depth pre-pass can use GL_EQUAL
+invariant gl_Position;
+
 void main()
 {
     fragPos = vec3(model * vec4(aPos, 1.0));
     fragNormal = mat3(transpose(inverse(model))) * aNormal;
     texCoords = aTexCoords;
+    // distance along the view axis, used to pick a shadow cascade
+    viewDepth = -(view * vec4(fragPos, 1.0)).z;
     gl_Position = projection * view * vec4(fragPos, 1.0);
 }
@@ -0,0 +1,47 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+layout(location = 3) in uvec4 aJoints;
+layout(location = 4) in vec4 aWeights;
+
+out vec3 fragNormal;
+out vec3 fragPos;
+out vec2 texCoords;
+out float viewDepth;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+// three texels per joint, the top rows of model * joint * inverse bind
+uniform samplerBuffer jointPalette;
+// first joint of the first instance; each instance is one character
+uniform int paletteOffset;
+uniform int jointCount;
+
+invariant gl_Position;
+
+void main()
+{
+    int first = paletteOffset + gl_InstanceID * jointCount;
+    vec4 rows[3] = vec4[3](vec4(0.0), vec4(0.0), vec4(0.0));
+    for (int influence = 0; influence < 4; influence++) {
+        float weight = aWeights[influence];
+        if (weight > 0.0) {
+            int texel = (first + int(aJoints[influence])) * 3;
+            rows[0] += weight * texelFetch(jointPalette, texel);
+            rows[1] += weight * texelFetch(jointPalette, texel + 1);
+            rows[2] += weight * texelFetch(jointPalette, texel + 2);
+        }
+    }
+    vec4 position = vec4(aPos, 1.0);
+    fragPos = vec3(dot(rows[0], position), dot(rows[1], position), dot(rows[2], position));
+    // joints are rigid or uniformly scaled, so the blend's upper 3x3 is
+    // close enough to its inverse transpose once normalised
+    fragNormal = normalize(vec3(dot(rows[0].xyz, aNormal),
+                                dot(rows[1].xyz, aNormal),
+                                dot(rows[2].xyz, aNormal)));
+    texCoords = aTexCoords;
+    viewDepth = -(view * vec4(fragPos, 1.0)).z;
+    gl_Position = projection * view * vec4(fragPos, 1.0);
+}
@@ -0,0 +1,12 @@
+#version 330 core
+in vec3 direction;
+out vec4 FragColor;
+
+uniform samplerCube skybox;
+uniform float lod;
+uniform float intensity;
+
+void main()
+{
+    FragColor = vec4(intensity * textureLod(skybox, direction, lod).rgb, 1.0);
+}
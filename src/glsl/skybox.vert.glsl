@@ -0,0 +1,17 @@
+#version 330 core
+out vec3 direction;
+
+// inverse projection followed by the inverse of the view's rotation
+uniform mat4 clipToWorld;
+
+// one oversized triangle like fullscreen.vert.glsl, placed on the far plane
+// so GL_LEQUAL only lets it through where nothing else was drawn
+void main()
+{
+    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+    gl_Position = vec4(pos, 1.0, 1.0);
+    // every point on the far plane is linear in screen space, so this
+    // interpolates correctly without normalising per vertex
+    vec4 world = clipToWorld * vec4(pos, 1.0, 1.0);
+    direction = world.xyz / world.w;
+}
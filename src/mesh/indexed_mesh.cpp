@@ -0,0 +1,110 @@
+#include <mesh/indexed_mesh.h>
+#include <profiler.h>
+#include <algorithm>
+
+namespace sjd {
+
+IndexedMesh::IndexedMesh(MeshData data,
+                         size_t lodLevels,
+                         float lodReduction)
+:   m_data {std::move(data)}
+{
+    _createBuffers(buildLodChain(m_data.positions, m_data.indices, lodLevels, lodReduction));
+}
+
+IndexedMesh::IndexedMesh(MeshData data, const LodChain& lods)
+:   m_data {std::move(data)}
+{
+    _createBuffers(lods);
+}
+
+void IndexedMesh::_createBuffers(const LodChain& lods) {
+    for (const std::vector<uint32_t>& level : lods) {
+        m_lods.push_back({m_lodIndices.size() * sizeof(uint32_t),
+                          static_cast<GLsizei>(level.size())});
+        m_lodIndices.insert(m_lodIndices.end(), level.begin(), level.end());
+    }
+    m_selector = LodSelector {m_lods.size()};
+    setLocalBounds(m_data.bounds());
+
+    glGenVertexArrays(1, &m_vao);
+    glGenBuffers(1, &m_vbo);
+    glGenBuffers(1, &m_ebo);
+    bufferData();
+    defineVAOPointers();
+}
+
+IndexedMesh::~IndexedMesh() {
+    glDeleteVertexArrays(1, &m_vao);
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteBuffers(1, &m_ebo);
+}
+
+unsigned int IndexedMesh::defineVAOPointers() {
+    const GLsizei stride {8 * sizeof(float)};
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+    return m_vao;
+}
+
+void IndexedMesh::bufferData() {
+    std::vector<float> vertices;
+    vertices.reserve(m_data.vertexCount() * 8);
+    for (size_t i {0}; i < m_data.vertexCount(); i++) {
+        glm::vec3 normal {i < m_data.normals.size() ? m_data.normals[i] : glm::vec3(0.0f)};
+        glm::vec2 uv {i < m_data.texCoords.size() ? m_data.texCoords[i] : glm::vec2(0.0f)};
+        vertices.insert(vertices.end(), {m_data.positions[i].x, m_data.positions[i].y, m_data.positions[i].z,
+                                         normal.x, normal.y, normal.z,
+                                         uv.x, uv.y});
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    MAGE_COUNT_UPLOAD(vertices.size() * sizeof(float));
+    // the element buffer binding is VAO state, so bind the VAO first
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_lodIndices.size() * sizeof(uint32_t),
+                 m_lodIndices.data(), GL_STATIC_DRAW);
+    MAGE_COUNT_UPLOAD(m_lodIndices.size() * sizeof(uint32_t));
+    glBindVertexArray(0);
+}
+
+void IndexedMesh::draw(glm::mat4 projection, glm::mat4 view, sjd::Shader& shader) {
+    if (m_lods.empty()) {
+        return;
+    }
+    shader.use();
+    shader.setUniform("model", m_model);
+    shader.setUniform("view", view);
+    shader.setUniform("projection", projection);
+    const LodRange& lod {m_lods[m_currentLod]};
+    glBindVertexArray(m_vao);
+    glDrawElements(GL_TRIANGLES, lod.count, GL_UNSIGNED_INT, (void*)lod.offset);
+    MAGE_COUNT_DRAW_CALLS(1);
+    glBindVertexArray(0);
+}
+
+void IndexedMesh::selectLod(Camera& camera, uint32_t viewportHeight) {
+    AABB bounds {worldBounds()};
+    if (bounds.isEmpty() || m_lods.size() < 2) {
+        return;
+    }
+    float radius {glm::length(bounds.extent())};
+    float distance {glm::length(bounds.center() - camera.getPos())};
+    float size {projectedSize(radius, distance, glm::radians(camera.getZoom()), viewportHeight)};
+    m_currentLod = std::min(m_selector.select(m_currentLod, size), m_lods.size() - 1);
+}
+
+void IndexedMesh::forceLod(size_t level) {
+    m_currentLod = std::min(level, m_lods.size() - 1);
+}
+
+}
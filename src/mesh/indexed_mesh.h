@@ -0,0 +1,67 @@
+#ifndef INDEXED_MESH_H
+#define INDEXED_MESH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include <camera.h>
+#include <mesh/mesh.h>
+#include <mesh/mesh_data.h>
+#include <mesh/lod.h>
+#include <mesh/simplify.h>
+
+namespace sjd {
+
+// An indexed triangle mesh with a chain of simplified index buffers that
+// share one vertex buffer. All levels live in a single element buffer.
+class IndexedMesh : public Mesh {
+public:
+    IndexedMesh(MeshData data,
+                size_t lodLevels = 1,
+                float lodReduction = 0.5f);
+    // takes levels built beforehand, so meshes with the same geometry
+    // only pay for simplification once
+    IndexedMesh(MeshData data, const LodChain& lods);
+    ~IndexedMesh();
+
+    IndexedMesh(const IndexedMesh&) = delete;
+    IndexedMesh& operator=(const IndexedMesh&) = delete;
+
+    unsigned int defineVAOPointers() override;
+
+    void bufferData() override;
+
+    void draw(glm::mat4 projection, glm::mat4 view, sjd::Shader& shader) override;
+
+    auto data() const -> const MeshData& { return m_data; }
+    auto lodCount() const -> size_t { return m_lods.size(); }
+    auto currentLod() const -> const size_t& { return m_currentLod; }
+    auto lodTriangleCount(size_t level) const -> size_t { return m_lods[level].count / 3; }
+
+    void setLodSelector(const LodSelector& selector) { m_selector = selector; }
+
+    // picks this frame's level from the mesh's projected size as seen by
+    // the camera; call once per frame before draw()
+    void selectLod(Camera& camera, uint32_t viewportHeight);
+
+    void forceLod(size_t level);
+
+private:
+    struct LodRange {
+        size_t offset;
+        GLsizei count;
+    };
+
+    void _createBuffers(const LodChain& lods);
+
+    MeshData m_data;
+    std::vector<uint32_t> m_lodIndices;
+    std::vector<LodRange> m_lods;
+    LodSelector m_selector;
+    size_t m_currentLod {0};
+    unsigned int m_ebo {0};
+};
+
+}
+#endif
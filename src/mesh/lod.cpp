@@ -0,0 +1,46 @@
+#include <mesh/lod.h>
+#include <algorithm>
+#include <cmath>
+
+namespace sjd {
+
+auto projectedSize(float boundsRadius,
+                   float distance,
+                   float fovY,
+                   uint32_t viewportHeight) -> float {
+    // inside the sphere it covers the whole screen
+    if (distance <= boundsRadius) {
+        return static_cast<float>(viewportHeight);
+    }
+    float halfHeight {std::tan(fovY * 0.5f) * distance};
+    return boundsRadius / halfHeight * static_cast<float>(viewportHeight);
+}
+
+LodSelector::LodSelector(size_t levelCount,
+                         float finestThreshold,
+                         float hysteresis)
+:   m_hysteresis {hysteresis}
+{
+    float threshold {finestThreshold};
+    for (size_t level {1}; level < levelCount; level++) {
+        m_thresholds.push_back(threshold);
+        threshold *= 0.5f;
+    }
+}
+
+auto LodSelector::select(size_t currentLevel, float screenSize) const -> size_t {
+    size_t level {std::min(currentLevel, m_thresholds.size())};
+    // coarser: must drop clearly below the boundary under the current level
+    while (level < m_thresholds.size()
+           && screenSize < m_thresholds[level] * (1.0f - m_hysteresis)) {
+        level++;
+    }
+    // finer: must rise clearly above the boundary over the current level
+    while (level > 0
+           && screenSize > m_thresholds[level - 1] * (1.0f + m_hysteresis)) {
+        level--;
+    }
+    return level;
+}
+
+}
@@ -0,0 +1,41 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace sjd {
+
+// height in pixels covered by a bounding sphere seen through a
+// perspective camera with vertical field of view fovY (radians)
+auto projectedSize(float boundsRadius,
+                   float distance,
+                   float fovY,
+                   uint32_t viewportHeight) -> float;
+
+// Picks a level of detail from projected screen size. Level i is used
+// while the mesh covers at least thresholds[i] pixels; the hysteresis
+// band stops a mesh sitting on a threshold from popping between levels.
+class LodSelector {
+public:
+    // finestThreshold is the size at which level 0 gives way to level 1,
+    // every further level halves it
+    LodSelector(size_t levelCount = 1,
+                float finestThreshold = 256.0f,
+                float hysteresis = 0.1f);
+
+    auto levelCount() const -> size_t { return m_thresholds.size() + 1; }
+    auto threshold(size_t level) const -> const float& { return m_thresholds[level]; }
+    auto hysteresis() const -> const float& { return m_hysteresis; }
+
+    auto select(size_t currentLevel, float screenSize) const -> size_t;
+
+private:
+    // m_thresholds[i] is the boundary between level i and level i + 1
+    std::vector<float> m_thresholds;
+    float m_hysteresis;
+};
+
+}
+#endif
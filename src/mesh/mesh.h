@@ -5,6 +5,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <material.h>
+#include <bounds.h>
+#include <shader.h>
 
 namespace sjd {
 
@@ -46,6 +48,20 @@ public:
         m_model = glm::rotate(m_model, radians, glm::vec3(0.0f, 0.0f, 1.0f));
     }
 
+    // world-space origin of the mesh, used for draw ordering
+    glm::vec3 position() const {
+        return glm::vec3(m_model[3]);
+    }
+
+    // model-space bounds of the geometry; empty bounds are never culled
+    void setLocalBounds(const sjd::AABB& bounds) {
+        m_localBounds = bounds;
+    }
+
+    sjd::AABB worldBounds() const {
+        return m_localBounds.transformed(m_model);
+    }
+
     virtual void draw(glm::mat4 projection, glm::mat4 view, sjd::Shader& shader) = 0;
 
 protected:
@@ -53,6 +69,7 @@ protected:
     unsigned int m_vbo;
     glm::mat4 m_model;
     sjd::Material m_material;
+    sjd::AABB m_localBounds;
 };
 }
 #endif
@@ -0,0 +1,63 @@
+#include <mesh/mesh_data.h>
+#include <glm/gtc/constants.hpp>
+#include <cmath>
+
+namespace sjd {
+
+auto makeUvSphere(uint32_t slices, uint32_t stacks) -> MeshData {
+    MeshData data {};
+    // the seam column is duplicated so texture coordinates wrap cleanly
+    for (uint32_t stack {0}; stack <= stacks; stack++) {
+        float v {static_cast<float>(stack) / static_cast<float>(stacks)};
+        float phi {v * glm::pi<float>()};
+        for (uint32_t slice {0}; slice <= slices; slice++) {
+            float u {static_cast<float>(slice) / static_cast<float>(slices)};
+            float theta {u * 2.0f * glm::pi<float>()};
+            glm::vec3 normal {std::cos(theta) * std::sin(phi),
+                              std::cos(phi),
+                              std::sin(theta) * std::sin(phi)};
+            data.positions.push_back(normal);
+            data.normals.push_back(normal);
+            data.texCoords.emplace_back(u, 1.0f - v);
+        }
+    }
+    uint32_t row {slices + 1};
+    for (uint32_t stack {0}; stack < stacks; stack++) {
+        for (uint32_t slice {0}; slice < slices; slice++) {
+            uint32_t a {stack * row + slice};
+            uint32_t b {a + row};
+            // wound counter-clockwise when seen from outside
+            if (stack != 0) {
+                data.indices.insert(data.indices.end(), {a, a + 1, b});
+            }
+            if (stack != stacks - 1) {
+                data.indices.insert(data.indices.end(), {a + 1, b + 1, b});
+            }
+        }
+    }
+    return data;
+}
+
+auto makeGrid(uint32_t cells) -> MeshData {
+    MeshData data {};
+    uint32_t row {cells + 1};
+    for (uint32_t z {0}; z <= cells; z++) {
+        for (uint32_t x {0}; x <= cells; x++) {
+            glm::vec2 uv {static_cast<float>(x) / static_cast<float>(cells),
+                          static_cast<float>(z) / static_cast<float>(cells)};
+            data.positions.emplace_back(uv.x - 0.5f, 0.0f, uv.y - 0.5f);
+            data.normals.emplace_back(0.0f, 1.0f, 0.0f);
+            data.texCoords.push_back(uv);
+        }
+    }
+    for (uint32_t z {0}; z < cells; z++) {
+        for (uint32_t x {0}; x < cells; x++) {
+            uint32_t a {z * row + x};
+            uint32_t b {a + row};
+            data.indices.insert(data.indices.end(), {a, b, a + 1, a + 1, b, b + 1});
+        }
+    }
+    return data;
+}
+
+}
@@ -0,0 +1,39 @@
+#ifndef MESH_DATA_H
+#define MESH_DATA_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#include <bounds.h>
+
+namespace sjd {
+
+// CPU-side geometry for an indexed triangle mesh; the attribute arrays
+// are parallel and match the layout of simple.lighting.vert.glsl
+struct MeshData {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> texCoords;
+    std::vector<uint32_t> indices;
+
+    auto vertexCount() const -> size_t { return positions.size(); }
+    auto triangleCount() const -> size_t { return indices.size() / 3; }
+
+    auto bounds() const -> AABB {
+        AABB box {};
+        for (const glm::vec3& position : positions) {
+            box.expand(position);
+        }
+        return box;
+    }
+};
+
+// unit-radius sphere centred on the origin
+auto makeUvSphere(uint32_t slices, uint32_t stacks) -> MeshData;
+
+// flat square of size 1 in the xz-plane, facing +y, split into cells
+auto makeGrid(uint32_t cells) -> MeshData;
+
+}
+#endif
@@ -0,0 +1,304 @@
+#include <mesh/simplify.h>
+#include <algorithm>
+#include <array>
+#include <map>
+#include <queue>
+#include <tuple>
+
+namespace sjd {
+
+namespace {
+
+// symmetric 4x4 error quadric, upper triangle only
+struct Quadric {
+    std::array<double, 10> q {};
+
+    static auto fromPlane(const glm::dvec3& n, double d, double weight) -> Quadric {
+        Quadric result {};
+        result.q = {n.x * n.x, n.x * n.y, n.x * n.z, n.x * d,
+                               n.y * n.y, n.y * n.z, n.y * d,
+                                          n.z * n.z, n.z * d,
+                                                     d * d};
+        for (double& value : result.q) {
+            value *= weight;
+        }
+        return result;
+    }
+
+    Quadric& operator+=(const Quadric& other) {
+        for (size_t i {0}; i < q.size(); i++) {
+            q[i] += other.q[i];
+        }
+        return *this;
+    }
+
+    auto error(const glm::dvec3& p) const -> double {
+        return q[0] * p.x * p.x + 2.0 * q[1] * p.x * p.y + 2.0 * q[2] * p.x * p.z + 2.0 * q[3] * p.x
+             + q[4] * p.y * p.y + 2.0 * q[5] * p.y * p.z + 2.0 * q[6] * p.y
+             + q[7] * p.z * p.z + 2.0 * q[8] * p.z
+             + q[9];
+    }
+};
+
+struct Collapse {
+    double cost;
+    uint32_t from;
+    uint32_t to;
+    uint32_t fromVersion;
+    uint32_t toVersion;
+
+    bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+// border planes are weighted well above surface planes so outlines hold
+const double BORDER_WEIGHT {10.0};
+// reject collapses that turn a triangle by more than ~78 degrees
+const double MIN_NORMAL_DOT {0.2};
+
+class Simplifier {
+public:
+    Simplifier(const std::vector<glm::vec3>& positions,
+               const std::vector<uint32_t>& indices)
+    :   m_positions {positions.begin(), positions.end()},
+        m_quadrics(positions.size()),
+        m_vertexTriangles(positions.size()),
+        m_versions(positions.size(), 0),
+        m_locked(positions.size(), false)
+    {
+        size_t triangleCount {indices.size() / 3};
+        m_triangles.reserve(triangleCount);
+        for (size_t t {0}; t < triangleCount; t++) {
+            std::array<uint32_t, 3> tri {indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2]};
+            if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) {
+                continue;
+            }
+            for (uint32_t v : tri) {
+                m_vertexTriangles[v].push_back(static_cast<uint32_t>(m_triangles.size()));
+            }
+            m_triangles.push_back(tri);
+        }
+        m_triangleAlive.assign(m_triangles.size(), true);
+        m_liveTriangles = m_triangles.size();
+
+        _lockSeams();
+        _accumulateQuadrics();
+        for (uint32_t t {0}; t < m_triangles.size(); t++) {
+            for (size_t e {0}; e < 3; e++) {
+                uint32_t a {m_triangles[t][e]};
+                uint32_t b {m_triangles[t][(e + 1) % 3]};
+                _pushCollapse(a, b);
+                _pushCollapse(b, a);
+            }
+        }
+    }
+
+    auto run(size_t targetTriangles, double maxError) -> std::vector<uint32_t> {
+        while (m_liveTriangles > targetTriangles && !m_heap.empty()) {
+            Collapse collapse {m_heap.top()};
+            m_heap.pop();
+            if (collapse.cost > maxError) {
+                break;
+            }
+            if (collapse.fromVersion != m_versions[collapse.from]
+                || collapse.toVersion != m_versions[collapse.to]) {
+                continue;
+            }
+            if (!_collapseIsValid(collapse.from, collapse.to)) {
+                continue;
+            }
+            _applyCollapse(collapse.from, collapse.to);
+        }
+
+        std::vector<uint32_t> result;
+        result.reserve(m_liveTriangles * 3);
+        for (size_t t {0}; t < m_triangles.size(); t++) {
+            if (m_triangleAlive[t]) {
+                result.insert(result.end(), m_triangles[t].begin(), m_triangles[t].end());
+            }
+        }
+        return result;
+    }
+
+private:
+    void _lockSeams() {
+        std::map<std::tuple<float, float, float>, uint32_t> firstAtPosition;
+        for (uint32_t v {0}; v < m_positions.size(); v++) {
+            glm::vec3 p {m_positions[v]};
+            auto [it, inserted] = firstAtPosition.try_emplace(std::make_tuple(p.x, p.y, p.z), v);
+            if (!inserted) {
+                m_locked[v] = true;
+                m_locked[it->second] = true;
+            }
+        }
+    }
+
+    void _accumulateQuadrics() {
+        // edges seen once are open borders
+        std::map<std::pair<uint32_t, uint32_t>, int> edgeUse;
+        for (const auto& tri : m_triangles) {
+            for (size_t e {0}; e < 3; e++) {
+                uint32_t a {tri[e]};
+                uint32_t b {tri[(e + 1) % 3]};
+                edgeUse[{std::min(a, b), std::max(a, b)}]++;
+            }
+        }
+        for (const auto& tri : m_triangles) {
+            glm::dvec3 p0 {m_positions[tri[0]]};
+            glm::dvec3 normal {glm::cross(m_positions[tri[1]] - p0, m_positions[tri[2]] - p0)};
+            double doubleArea {glm::length(normal)};
+            if (doubleArea <= 0.0) {
+                continue;
+            }
+            normal /= doubleArea;
+            Quadric plane {Quadric::fromPlane(normal, -glm::dot(normal, p0), doubleArea * 0.5)};
+            for (uint32_t v : tri) {
+                m_quadrics[v] += plane;
+            }
+            for (size_t e {0}; e < 3; e++) {
+                uint32_t a {tri[e]};
+                uint32_t b {tri[(e + 1) % 3]};
+                if (edgeUse[{std::min(a, b), std::max(a, b)}] != 1) {
+                    continue;
+                }
+                glm::dvec3 edge {m_positions[b] - m_positions[a]};
+                glm::dvec3 borderNormal {glm::cross(edge, normal)};
+                double length {glm::length(borderNormal)};
+                if (length <= 0.0) {
+                    continue;
+                }
+                borderNormal /= length;
+                Quadric border {Quadric::fromPlane(borderNormal,
+                                                   -glm::dot(borderNormal, m_positions[a]),
+                                                   BORDER_WEIGHT * glm::dot(edge, edge))};
+                m_quadrics[a] += border;
+                m_quadrics[b] += border;
+            }
+        }
+    }
+
+    void _pushCollapse(uint32_t from, uint32_t to) {
+        if (m_locked[from]) {
+            return;
+        }
+        Quadric combined {m_quadrics[from]};
+        combined += m_quadrics[to];
+        double cost {std::max(combined.error(m_positions[to]), 0.0)};
+        m_heap.push({cost, from, to, m_versions[from], m_versions[to]});
+    }
+
+    bool _collapseIsValid(uint32_t from, uint32_t to) const {
+        for (uint32_t t : m_vertexTriangles[from]) {
+            if (!m_triangleAlive[t]) {
+                continue;
+            }
+            const auto& tri {m_triangles[t]};
+            if (tri[0] == to || tri[1] == to || tri[2] == to) {
+                continue;
+            }
+            std::array<glm::dvec3, 3> before {m_positions[tri[0]], m_positions[tri[1]], m_positions[tri[2]]};
+            std::array<glm::dvec3, 3> after {before};
+            for (size_t i {0}; i < 3; i++) {
+                if (tri[i] == from) {
+                    after[i] = m_positions[to];
+                }
+            }
+            glm::dvec3 oldNormal {glm::cross(before[1] - before[0], before[2] - before[0])};
+            glm::dvec3 newNormal {glm::cross(after[1] - after[0], after[2] - after[0])};
+            double oldLength {glm::length(oldNormal)};
+            double newLength {glm::length(newNormal)};
+            if (newLength <= 0.0 || oldLength <= 0.0) {
+                return false;
+            }
+            if (glm::dot(oldNormal, newNormal) < MIN_NORMAL_DOT * oldLength * newLength) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void _applyCollapse(uint32_t from, uint32_t to) {
+        for (uint32_t t : m_vertexTriangles[from]) {
+            if (!m_triangleAlive[t]) {
+                continue;
+            }
+            auto& tri {m_triangles[t]};
+            if (tri[0] == to || tri[1] == to || tri[2] == to) {
+                m_triangleAlive[t] = false;
+                m_liveTriangles--;
+                continue;
+            }
+            for (uint32_t& v : tri) {
+                if (v == from) {
+                    v = to;
+                }
+            }
+            m_vertexTriangles[to].push_back(t);
+        }
+        m_vertexTriangles[from].clear();
+        m_quadrics[to] += m_quadrics[from];
+        m_locked[from] = true;
+        m_versions[from]++;
+        m_versions[to]++;
+
+        // every edge around the surviving vertex has a new cost
+        auto& triangles {m_vertexTriangles[to]};
+        triangles.erase(std::remove_if(triangles.begin(), triangles.end(),
+                                       [this](uint32_t t){ return !m_triangleAlive[t]; }),
+                        triangles.end());
+        for (uint32_t t : triangles) {
+            for (uint32_t neighbour : m_triangles[t]) {
+                if (neighbour != to) {
+                    _pushCollapse(neighbour, to);
+                    _pushCollapse(to, neighbour);
+                }
+            }
+        }
+    }
+
+    std::vector<glm::dvec3> m_positions;
+    std::vector<Quadric> m_quadrics;
+    std::vector<std::array<uint32_t, 3>> m_triangles;
+    std::vector<bool> m_triangleAlive;
+    std::vector<std::vector<uint32_t>> m_vertexTriangles;
+    std::vector<uint32_t> m_versions;
+    std::vector<bool> m_locked;
+    size_t m_liveTriangles {0};
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> m_heap;
+};
+
+}
+
+auto simplifyMesh(const std::vector<glm::vec3>& positions,
+                  const std::vector<uint32_t>& indices,
+                  size_t targetIndexCount,
+                  float maxError) -> std::vector<uint32_t> {
+    if (targetIndexCount >= indices.size()) {
+        return indices;
+    }
+    Simplifier simplifier {positions, indices};
+    return simplifier.run(targetIndexCount / 3, maxError);
+}
+
+auto buildLodChain(const std::vector<glm::vec3>& positions,
+                   const std::vector<uint32_t>& indices,
+                   size_t levelCount,
+                   float reduction) -> std::vector<std::vector<uint32_t>> {
+    std::vector<std::vector<uint32_t>> chain;
+    if (levelCount == 0) {
+        return chain;
+    }
+    chain.push_back(indices);
+    for (size_t level {1}; level < levelCount; level++) {
+        const std::vector<uint32_t>& previous {chain.back()};
+        auto target {static_cast<size_t>(static_cast<float>(previous.size() / 3) * reduction) * 3};
+        std::vector<uint32_t> simplified {simplifyMesh(positions, previous, target)};
+        // stop once the simplifier can make no further progress
+        if (simplified.size() >= previous.size()) {
+            break;
+        }
+        chain.push_back(std::move(simplified));
+    }
+    return chain;
+}
+
+}
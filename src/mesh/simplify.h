@@ -0,0 +1,33 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace sjd {
+
+// Edge-collapse simplification driven by quadric error metrics (Garland &
+// Heckbert). Vertices are collapsed onto one of their neighbours rather
+// than moved, so every level indexes the original vertex buffer and a LOD
+// chain is just a set of index buffers.
+//
+// Vertices that share a position with another vertex (uv or normal seams)
+// are never removed, and open borders are held in place by extra planes.
+auto simplifyMesh(const std::vector<glm::vec3>& positions,
+                  const std::vector<uint32_t>& indices,
+                  size_t targetIndexCount,
+                  float maxError = std::numeric_limits<float>::max()) -> std::vector<uint32_t>;
+
+// index buffers for successively coarser levels; level 0 is the input
+using LodChain = std::vector<std::vector<uint32_t>>;
+
+// each level aims for `reduction` times the triangles of the previous one
+auto buildLodChain(const std::vector<glm::vec3>& positions,
+                   const std::vector<uint32_t>& indices,
+                   size_t levelCount,
+                   float reduction = 0.5f) -> LodChain;
+
+}
+#endif
@@ -0,0 +1,194 @@
+#include <mesh/skinned_mesh.h>
+#include <profiler.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+
+namespace sjd {
+
+namespace {
+
+// position, normal, uv as floats, then four joint bytes and four weight bytes
+struct SkinnedVertex {
+    float position[3];
+    float normal[3];
+    float texCoords[2];
+    uint8_t joints[4];
+    uint8_t weights[4];
+};
+
+// weights as normalised bytes that still sum to exactly 255
+auto quantiseWeights(glm::vec4 weights) -> std::array<uint8_t, 4> {
+    float total {weights.x + weights.y + weights.z + weights.w};
+    if (total <= 0.0f) {
+        return {255, 0, 0, 0};
+    }
+    std::array<uint8_t, 4> bytes {};
+    int sum {0};
+    size_t largest {0};
+    for (size_t i {0}; i < 4; i++) {
+        bytes[i] = static_cast<uint8_t>(std::lround(255.0f * weights[i] / total));
+        sum += bytes[i];
+        largest = bytes[i] > bytes[largest] ? i : largest;
+    }
+    bytes[largest] = static_cast<uint8_t>(bytes[largest] + (255 - sum));
+    return bytes;
+}
+
+}
+
+auto makeSkinnedCylinder(uint32_t segments,
+                         uint32_t rings,
+                         uint32_t joints,
+                         float spacing) -> SkinnedMeshData {
+    SkinnedMeshData data {};
+    segments = std::max(segments, 3u);
+    rings = std::max(rings, 2u);
+    joints = std::max(joints, 1u);
+    float height {spacing * static_cast<float>(joints - 1)};
+    for (uint32_t ring {0}; ring < rings; ring++) {
+        float v {static_cast<float>(ring) / static_cast<float>(rings - 1)};
+        float y {v * height};
+        // position along the chain in joints, split between its two ends
+        float along {joints > 1 ? v * static_cast<float>(joints - 1) : 0.0f};
+        uint32_t lower {std::min(static_cast<uint32_t>(along), joints - 1)};
+        uint32_t upper {std::min(lower + 1, joints - 1)};
+        float blend {along - static_cast<float>(lower)};
+        for (uint32_t segment {0}; segment <= segments; segment++) {
+            float u {static_cast<float>(segment) / static_cast<float>(segments)};
+            float angle {2.0f * glm::pi<float>() * u};
+            glm::vec3 normal {std::cos(angle), 0.0f, std::sin(angle)};
+            data.mesh.positions.push_back(glm::vec3(0.5f * normal.x, y, 0.5f * normal.z));
+            data.mesh.normals.push_back(normal);
+            data.mesh.texCoords.push_back(glm::vec2(u, v));
+            data.joints.push_back(glm::u8vec4(static_cast<uint8_t>(lower),
+                                              static_cast<uint8_t>(upper), 0, 0));
+            data.weights.push_back(glm::vec4(1.0f - blend, blend, 0.0f, 0.0f));
+        }
+    }
+    uint32_t stride {segments + 1};
+    for (uint32_t ring {0}; ring + 1 < rings; ring++) {
+        for (uint32_t segment {0}; segment < segments; segment++) {
+            uint32_t a {ring * stride + segment};
+            uint32_t b {a + stride};
+            data.mesh.indices.insert(data.mesh.indices.end(), {a, b, a + 1, a + 1, b, b + 1});
+        }
+    }
+    return data;
+}
+
+SkinnedMesh::SkinnedMesh(SkinnedMeshData data)
+:   m_data {std::move(data)}
+{
+    for (const glm::u8vec4& joints : m_data.joints) {
+        for (int i {0}; i < 4; i++) {
+            m_usedJointCount = std::max(m_usedJointCount, static_cast<uint32_t>(joints[i]) + 1);
+        }
+    }
+    // a single character needs no stride until setInstances() gives one
+    m_jointCount = m_usedJointCount;
+    // the rest pose; animated characters may move outside it
+    setLocalBounds(m_data.mesh.bounds());
+
+    glGenVertexArrays(1, &m_vao);
+    glGenBuffers(1, &m_vbo);
+    glGenBuffers(1, &m_ebo);
+    bufferData();
+    defineVAOPointers();
+}
+
+SkinnedMesh::~SkinnedMesh() {
+    glDeleteVertexArrays(1, &m_vao);
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteBuffers(1, &m_ebo);
+}
+
+unsigned int SkinnedMesh::defineVAOPointers() {
+    const GLsizei stride {sizeof(SkinnedVertex)};
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(SkinnedVertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(SkinnedVertex, normal));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(SkinnedVertex, texCoords));
+    glEnableVertexAttribArray(2);
+    // integer attribute, read as a uvec4 of palette indices
+    glVertexAttribIPointer(3, 4, GL_UNSIGNED_BYTE, stride, (void*)offsetof(SkinnedVertex, joints));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(SkinnedVertex, weights));
+    glEnableVertexAttribArray(4);
+    glBindVertexArray(0);
+    return m_vao;
+}
+
+void SkinnedMesh::bufferData() {
+    std::vector<SkinnedVertex> vertices(m_data.mesh.vertexCount());
+    for (size_t i {0}; i < vertices.size(); i++) {
+        SkinnedVertex& vertex {vertices[i]};
+        glm::vec3 normal {i < m_data.mesh.normals.size() ? m_data.mesh.normals[i] : glm::vec3(0.0f)};
+        glm::vec2 uv {i < m_data.mesh.texCoords.size() ? m_data.mesh.texCoords[i] : glm::vec2(0.0f)};
+        glm::u8vec4 joints {i < m_data.joints.size() ? m_data.joints[i] : glm::u8vec4(0)};
+        glm::vec4 weights {i < m_data.weights.size() ? m_data.weights[i] : glm::vec4(0.0f)};
+        std::array<uint8_t, 4> quantised {quantiseWeights(weights)};
+        for (int c {0}; c < 3; c++) {
+            vertex.position[c] = m_data.mesh.positions[i][c];
+            vertex.normal[c] = normal[c];
+        }
+        vertex.texCoords[0] = uv.x;
+        vertex.texCoords[1] = uv.y;
+        for (int c {0}; c < 4; c++) {
+            vertex.joints[c] = joints[c];
+            vertex.weights[c] = quantised[c];
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(SkinnedVertex), vertices.data(), GL_STATIC_DRAW);
+    MAGE_COUNT_UPLOAD(vertices.size() * sizeof(SkinnedVertex));
+    // the element buffer binding is VAO state, so bind the VAO first
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_data.mesh.indices.size() * sizeof(uint32_t),
+                 m_data.mesh.indices.data(), GL_STATIC_DRAW);
+    MAGE_COUNT_UPLOAD(m_data.mesh.indices.size() * sizeof(uint32_t));
+    glBindVertexArray(0);
+}
+
+void SkinnedMesh::draw(glm::mat4 projection, glm::mat4 view, sjd::Shader& shader) {
+    shader.use();
+    shader.setUniform("view", view);
+    shader.setUniform("projection", projection);
+    shader.setUniform("paletteOffset", static_cast<int>(m_firstJoint));
+    shader.setUniform("jointCount", static_cast<int>(m_jointCount));
+    drawInstances();
+}
+
+void SkinnedMesh::drawInstances() {
+    if (m_data.mesh.indices.empty() || m_instanceCount == 0) {
+        return;
+    }
+    glBindVertexArray(m_vao);
+    glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(m_data.mesh.indices.size()),
+                            GL_UNSIGNED_INT, (void*)0, static_cast<GLsizei>(m_instanceCount));
+    MAGE_COUNT_DRAW_CALLS(1);
+    glBindVertexArray(0);
+}
+
+bool SkinnedMesh::setInstances(const Skeleton& skeleton, uint32_t firstJoint, uint32_t count) {
+    if (skeleton.jointCount() < m_usedJointCount) {
+        std::cout << "Failed to set skinned mesh instances: the skeleton has "
+                  << skeleton.jointCount() << " joints but the mesh uses "
+                  << m_usedJointCount << ".\n";
+        return false;
+    }
+    // joints no vertex is weighted to still take palette entries
+    m_jointCount = static_cast<uint32_t>(skeleton.jointCount());
+    m_firstJoint = firstJoint;
+    m_instanceCount = count;
+    return true;
+}
+
+}
@@ -0,0 +1,83 @@
+#ifndef SKINNED_MESH_H
+#define SKINNED_MESH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#include <animation.h>
+#include <mesh/mesh.h>
+#include <mesh/mesh_data.h>
+
+namespace sjd {
+
+// geometry bound to a skeleton; joints and weights are parallel to
+// mesh.positions, with up to four influences per vertex
+struct SkinnedMeshData {
+    MeshData mesh;
+    std::vector<glm::u8vec4> joints;
+    // renormalised to sum to one on upload
+    std::vector<glm::vec4> weights;
+};
+
+// capped cylinder of radius 0.5 up the y axis over a makeJointChain()
+// skeleton, each ring weighted between the two joints nearest to it
+auto makeSkinnedCylinder(uint32_t segments,
+                         uint32_t rings,
+                         uint32_t joints,
+                         float spacing) -> SkinnedMeshData;
+
+// An indexed mesh deformed in skinned.lighting.vert.glsl by a joint
+// palette from AnimationSystem.
+//
+// The palette already holds each character's model transform, so this
+// mesh's own model matrix is unused. draw() renders every character in a
+// run of consecutive palette entries as instances of one draw call; bind
+// the palette with AnimationSystem::bindPalette() first.
+//
+// DepthPrePass can't lay down depth for these meshes: its depth_only.vert
+// ignores the joints, so the skinned colour pass would fail its GL_EQUAL
+// test. Draw them after the pre-pass with the ordinary depth test.
+class SkinnedMesh : public Mesh {
+public:
+    SkinnedMesh(SkinnedMeshData data);
+    ~SkinnedMesh();
+
+    SkinnedMesh(const SkinnedMesh&) = delete;
+    SkinnedMesh& operator=(const SkinnedMesh&) = delete;
+
+    unsigned int defineVAOPointers() override;
+
+    void bufferData() override;
+
+    void draw(glm::mat4 projection, glm::mat4 view, sjd::Shader& shader) override;
+    // the draw call alone, for a program that is already bound with its
+    // uniforms set, such as one capturing the skinned vertices with
+    // transform feedback, where the program can't be rebound mid-capture
+    void drawInstances();
+
+    auto data() const -> const SkinnedMeshData& { return m_data; }
+    // one more than the highest joint the vertices reference
+    auto usedJointCount() const -> const uint32_t& { return m_usedJointCount; }
+    // each character's stride through the palette, the joint count of the
+    // skeleton last given to setInstances()
+    auto jointCount() const -> const uint32_t& { return m_jointCount; }
+
+    // the characters draw() renders: count of them, each with all of
+    // skeleton's joints, starting from joint firstJoint of the palette;
+    // false, changing nothing, when the skeleton has fewer joints than
+    // the vertices reference
+    bool setInstances(const Skeleton& skeleton, uint32_t firstJoint, uint32_t count);
+
+private:
+    SkinnedMeshData m_data;
+    uint32_t m_usedJointCount {0};
+    uint32_t m_jointCount {0};
+    uint32_t m_firstJoint {0};
+    uint32_t m_instanceCount {1};
+    unsigned int m_ebo {0};
+};
+
+}
+#endif
@@ -0,0 +1,322 @@
+#include <occlusion_culling.h>
+#include <profiler.h>
+#include <algorithm>
+#include <cmath>
+
+namespace sjd {
+
+// kept clear of the low units that material samplers are bound to
+const GLint HIZ_TEXTURE_UNIT {15};
+
+auto projectBounds(const AABB& worldBounds,
+                   const glm::mat4& viewProjection) -> ScreenRect {
+    ScreenRect rect {};
+    glm::vec3 ndcMin {std::numeric_limits<float>::max()};
+    glm::vec3 ndcMax {std::numeric_limits<float>::lowest()};
+    for (const glm::vec3& corner : worldBounds.corners()) {
+        glm::vec4 clip {viewProjection * glm::vec4(corner, 1.0f)};
+        if (clip.w <= 0.00001f || clip.z < -clip.w) {
+            rect.crossesNearPlane = true;
+            return rect;
+        }
+        glm::vec3 ndc {glm::vec3(clip) / clip.w};
+        ndcMin = glm::min(ndcMin, ndc);
+        ndcMax = glm::max(ndcMax, ndc);
+    }
+    rect.offscreen = ndcMax.x < -1.0f || ndcMax.y < -1.0f
+                  || ndcMin.x > 1.0f || ndcMin.y > 1.0f;
+    rect.min = glm::clamp(glm::vec2(ndcMin) * 0.5f + 0.5f, 0.0f, 1.0f);
+    rect.max = glm::clamp(glm::vec2(ndcMax) * 0.5f + 0.5f, 0.0f, 1.0f);
+    rect.nearestDepth = ndcMin.z * 0.5f + 0.5f;
+    return rect;
+}
+
+auto hiZMipLevel(const ScreenRect& rect,
+                 uint32_t width,
+                 uint32_t height,
+                 uint32_t levelCount) -> uint32_t {
+    glm::vec2 sizePx {(rect.max - rect.min) * glm::vec2(width, height)};
+    float longestSide {std::max(sizePx.x, sizePx.y)};
+    if (longestSide <= 1.0f || levelCount == 0) {
+        return 0;
+    }
+    // one texel or less at this level, so at most 2x2 texels once unaligned
+    auto level {static_cast<uint32_t>(std::ceil(std::log2(longestSide)))};
+    return std::min(level, levelCount - 1);
+}
+
+auto hiZLevelCount(uint32_t width, uint32_t height) -> uint32_t {
+    uint32_t longestSide {std::max(std::max(width, height), 1u)};
+    return 1 + static_cast<uint32_t>(std::floor(std::log2(longestSide)));
+}
+
+HiZBuffer::HiZBuffer(const std::string& shaderDirectory)
+:   m_downsampleShader {shaderDirectory + "/fullscreen.vert.glsl",
+                        shaderDirectory + "/hiz_downsample.frag.glsl"}
+{
+    if (!m_downsampleShader.isValid()) {
+        std::cout << "Failed to create Hi-Z downsample shader.\n";
+    }
+    // core profile refuses to draw without a bound vertex array
+    glGenVertexArrays(1, &m_emptyVao);
+}
+
+HiZBuffer::~HiZBuffer() {
+    glDeleteVertexArrays(1, &m_emptyVao);
+    glDeleteFramebuffers(1, &m_depthCopyFbo);
+    glDeleteFramebuffers(1, &m_pyramidFbo);
+    glDeleteTextures(1, &m_depthCopy);
+    glDeleteTextures(1, &m_pyramid);
+}
+
+void HiZBuffer::build(GLuint sourceFramebuffer, uint32_t width, uint32_t height) {
+    if (!isValid() || width == 0 || height == 0) {
+        return;
+    }
+    MAGE_PROFILE_GPU_SCOPE("HiZBuffer::build");
+    GLint previousFbo {0};
+    GLint previousViewport[4] {};
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFbo);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+    GLboolean depthTest {glIsEnabled(GL_DEPTH_TEST)};
+
+    if (width != m_width || height != m_height) {
+        _resize(width, height);
+    }
+
+    // the window's depth buffer cannot be sampled, so take a copy first
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, sourceFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_depthCopyFbo);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+                      GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+    glDisable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_pyramidFbo);
+    glBindVertexArray(m_emptyVao);
+    m_downsampleShader.use();
+    m_downsampleShader.setUniform("source", 0);
+    m_downsampleShader.setUniform("sourceLevel", 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    for (uint32_t level {0}; level < m_levels; level++) {
+        uint32_t levelWidth {std::max(width >> level, 1u)};
+        uint32_t levelHeight {std::max(height >> level, 1u)};
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, m_pyramid, level);
+        glViewport(0, 0, levelWidth, levelHeight);
+        if (level == 0) {
+            glBindTexture(GL_TEXTURE_2D, m_depthCopy);
+            m_downsampleShader.setUniform("firstLevel", true);
+        }
+        else {
+            // restrict sampling to the previous level so reading and
+            // writing the same texture is not a feedback loop
+            glBindTexture(GL_TEXTURE_2D, m_pyramid);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+            m_downsampleShader.setUniform("firstLevel", false);
+        }
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    MAGE_COUNT_DRAW_CALLS(m_levels);
+    glBindTexture(GL_TEXTURE_2D, m_pyramid);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_levels - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+
+    if (depthTest) {
+        glEnable(GL_DEPTH_TEST);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+    glViewport(previousViewport[0], previousViewport[1],
+               previousViewport[2], previousViewport[3]);
+}
+
+void HiZBuffer::_resize(uint32_t width, uint32_t height) {
+    m_width = width;
+    m_height = height;
+    m_levels = hiZLevelCount(width, height);
+
+    if (m_depthCopy == 0) {
+        glGenTextures(1, &m_depthCopy);
+        glGenTextures(1, &m_pyramid);
+        glGenFramebuffers(1, &m_depthCopyFbo);
+        glGenFramebuffers(1, &m_pyramidFbo);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, m_depthCopy);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0,
+                 GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+    glBindTexture(GL_TEXTURE_2D, m_pyramid);
+    for (uint32_t level {0}; level < m_levels; level++) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_R32F,
+                     std::max(width >> level, 1u), std::max(height >> level, 1u),
+                     0, GL_RED, GL_FLOAT, NULL);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_levels - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_depthCopyFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                           GL_TEXTURE_2D, m_depthCopy, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+OcclusionCuller::OcclusionCuller(const std::string& shaderDirectory)
+:   m_hiZ {shaderDirectory},
+    m_testShader {shaderDirectory + "/occlusion_test.vert.glsl",
+                  shaderDirectory + "/occlusion_test.frag.glsl"}
+{
+    if (!m_testShader.isValid()) {
+        std::cout << "Failed to create occlusion test shader.\n";
+    }
+    glGenVertexArrays(1, &m_emptyVao);
+}
+
+OcclusionCuller::~OcclusionCuller() {
+    glDeleteVertexArrays(1, &m_emptyVao);
+    for (FrameQueries& frame : m_frames) {
+        glDeleteQueries(frame.queries.size(), frame.queries.data());
+    }
+}
+
+void OcclusionCuller::render(const std::vector<Mesh*>& meshes,
+                             const glm::mat4& projection,
+                             const glm::mat4& view,
+                             Shader& shader) {
+    MAGE_PROFILE_GPU_SCOPE("OcclusionCuller::render");
+    FrameQueries& frame {m_frames[m_frame % QUERY_FRAMES]};
+    _resolveStats(frame);
+    frame.used = 0;
+    frame.untestable = 0;
+    frame.issued = false;
+    m_viewProjection = projection * view;
+    m_frame++;
+
+    if (!m_enabled || !m_hasHistory || !isValid()) {
+        for (Mesh* mesh : meshes) {
+            mesh->draw(projection, view, shader);
+        }
+        return;
+    }
+
+    // phase 1: one single-fragment test per mesh, nothing written
+    GLboolean depthTest {glIsEnabled(GL_DEPTH_TEST)};
+    GLboolean colorMask[4] {};
+    GLboolean depthMask {};
+    glGetBooleanv(GL_COLOR_WRITEMASK, colorMask);
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+    glDisable(GL_DEPTH_TEST);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    glActiveTexture(GL_TEXTURE0 + HIZ_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, m_hiZ.texture());
+    glBindVertexArray(m_emptyVao);
+    m_testShader.use();
+    m_testShader.setUniform("hiZ", HIZ_TEXTURE_UNIT);
+
+    std::vector<GLuint> meshQueries(meshes.size(), 0);
+    for (size_t i {0}; i < meshes.size(); i++) {
+        AABB bounds {meshes[i]->worldBounds()};
+        if (bounds.isEmpty()) {
+            continue;
+        }
+        ScreenRect rect {projectBounds(bounds, m_previousViewProjection)};
+        if (rect.crossesNearPlane || rect.offscreen) {
+            frame.untestable++;
+            continue;
+        }
+        uint32_t level {hiZMipLevel(rect, m_hiZ.width(), m_hiZ.height(), m_hiZ.levelCount())};
+        m_testShader.setUniform("screenRect", glm::vec4(rect.min, rect.max));
+        m_testShader.setUniform("nearestDepth", rect.nearestDepth);
+        m_testShader.setUniform("level", static_cast<int>(level));
+
+        meshQueries[i] = _acquireQuery(frame);
+        glBeginQuery(GL_SAMPLES_PASSED, meshQueries[i]);
+        glDrawArrays(GL_POINTS, 0, 1);
+        glEndQuery(GL_SAMPLES_PASSED);
+        MAGE_COUNT_DRAW_CALLS(1);
+    }
+
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glColorMask(colorMask[0], colorMask[1], colorMask[2], colorMask[3]);
+    glDepthMask(depthMask);
+    if (depthTest) {
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    // phase 2: the GPU skips draws whose test produced no samples; the
+    // wait happens on the GPU timeline, the CPU carries straight on
+    for (size_t i {0}; i < meshes.size(); i++) {
+        if (meshQueries[i] != 0) {
+            glBeginConditionalRender(meshQueries[i], GL_QUERY_WAIT);
+            meshes[i]->draw(projection, view, shader);
+            glEndConditionalRender();
+        }
+        else {
+            meshes[i]->draw(projection, view, shader);
+        }
+    }
+    frame.issued = true;
+}
+
+void OcclusionCuller::endFrame(GLuint sourceFramebuffer,
+                               uint32_t width,
+                               uint32_t height) {
+    if (!m_enabled || !isValid()) {
+        m_hasHistory = false;
+        return;
+    }
+    m_hiZ.build(sourceFramebuffer, width, height);
+    m_previousViewProjection = m_viewProjection;
+    m_hasHistory = true;
+}
+
+void OcclusionCuller::_resolveStats(FrameQueries& frame) {
+    if (!frame.issued) {
+        return;
+    }
+    OcclusionStats stats {};
+    stats.untestable = frame.untestable;
+    if (frame.used > 0) {
+        // queries complete in order, so the last one stands for all of them
+        GLint available {GL_FALSE};
+        glGetQueryObjectiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            return;
+        }
+        for (size_t i {0}; i < frame.used; i++) {
+            GLuint samples {0};
+            glGetQueryObjectuiv(frame.queries[i], GL_QUERY_RESULT, &samples);
+            if (samples == 0) {
+                stats.rejected++;
+            }
+        }
+    }
+    stats.tested = frame.used;
+    m_stats = stats;
+}
+
+auto OcclusionCuller::_acquireQuery(FrameQueries& frame) -> GLuint {
+    if (frame.used == frame.queries.size()) {
+        size_t grown {std::max<size_t>(frame.queries.size() * 2, 64)};
+        size_t previous {frame.queries.size()};
+        frame.queries.resize(grown);
+        glGenQueries(grown - previous, frame.queries.data() + previous);
+    }
+    return frame.queries[frame.used++];
+}
+
+}
@@ -0,0 +1,134 @@
+#ifndef OCCLUSION_CULLING_H
+#define OCCLUSION_CULLING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <bounds.h>
+#include <shader.h>
+#include <mesh/mesh.h>
+
+namespace sjd {
+
+// bounds of a mesh on screen: uv in [0,1] and window depth in [0,1]
+struct ScreenRect {
+    glm::vec2 min {0.0f};
+    glm::vec2 max {0.0f};
+    float nearestDepth {0.0f};
+    // the box reaches behind the eye, so it cannot be tested
+    bool crossesNearPlane {false};
+    bool offscreen {false};
+};
+
+auto projectBounds(const AABB& worldBounds,
+                   const glm::mat4& viewProjection) -> ScreenRect;
+
+// pyramid level at which the rect spans at most 2x2 texels
+auto hiZMipLevel(const ScreenRect& rect,
+                 uint32_t width,
+                 uint32_t height,
+                 uint32_t levelCount) -> uint32_t;
+
+auto hiZLevelCount(uint32_t width, uint32_t height) -> uint32_t;
+
+// Max-reduced depth pyramid built from a frame's depth buffer.
+class HiZBuffer {
+public:
+    HiZBuffer(const std::string& shaderDirectory);
+    ~HiZBuffer();
+
+    HiZBuffer(const HiZBuffer&) = delete;
+    HiZBuffer& operator=(const HiZBuffer&) = delete;
+
+    auto isValid() const -> bool { return m_downsampleShader.isValid(); }
+    auto texture() const -> const GLuint& { return m_pyramid; }
+    auto width() const -> const uint32_t& { return m_width; }
+    auto height() const -> const uint32_t& { return m_height; }
+    auto levelCount() const -> const uint32_t& { return m_levels; }
+
+    // copies the depth of sourceFramebuffer (0 for the window) and reduces
+    // it down to 1x1; the depth format must be GL_DEPTH24_STENCIL8
+    void build(GLuint sourceFramebuffer, uint32_t width, uint32_t height);
+
+private:
+    void _resize(uint32_t width, uint32_t height);
+
+    Shader m_downsampleShader;
+    GLuint m_emptyVao {0};
+    GLuint m_depthCopyFbo {0};
+    GLuint m_depthCopy {0};
+    GLuint m_pyramidFbo {0};
+    GLuint m_pyramid {0};
+    uint32_t m_width {0};
+    uint32_t m_height {0};
+    uint32_t m_levels {0};
+};
+
+struct OcclusionStats {
+    uint32_t tested {0};
+    uint32_t rejected {0};
+    uint32_t untestable {0};
+};
+
+// Tests mesh bounds against the previous frame's Hi-Z pyramid on the GPU
+// and draws each mesh under glBeginConditionalRender, so occluded meshes
+// are skipped without the CPU ever waiting on a query result.
+//
+// The test reprojects against last frame's depth, so a mesh that was
+// hidden last frame and is uncovered this frame appears one frame late.
+class OcclusionCuller {
+public:
+    OcclusionCuller(const std::string& shaderDirectory);
+    ~OcclusionCuller();
+
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    auto isValid() const -> bool {
+        return m_hiZ.isValid() && m_testShader.isValid();
+    }
+    // counters from the most recent frame whose queries have completed
+    auto stats() const -> const OcclusionStats& { return m_stats; }
+    auto hiZ() const -> const HiZBuffer& { return m_hiZ; }
+
+    void setEnabled(bool enabled) { m_enabled = enabled; }
+
+    void render(const std::vector<Mesh*>& meshes,
+                const glm::mat4& projection,
+                const glm::mat4& view,
+                Shader& shader);
+
+    // builds the pyramid from this frame's depth for use in the next one
+    void endFrame(GLuint sourceFramebuffer, uint32_t width, uint32_t height);
+
+private:
+    static const size_t QUERY_FRAMES = 2;
+
+    struct FrameQueries {
+        std::vector<GLuint> queries;
+        size_t used {0};
+        uint32_t untestable {0};
+        bool issued {false};
+    };
+
+    void _resolveStats(FrameQueries& frame);
+    auto _acquireQuery(FrameQueries& frame) -> GLuint;
+
+    HiZBuffer m_hiZ;
+    Shader m_testShader;
+    GLuint m_emptyVao {0};
+    bool m_enabled {true};
+    bool m_hasHistory {false};
+    glm::mat4 m_viewProjection {1.0f};
+    glm::mat4 m_previousViewProjection {1.0f};
+    std::array<FrameQueries, QUERY_FRAMES> m_frames {};
+    size_t m_frame {0};
+    OcclusionStats m_stats {};
+};
+
+}
+#endif
@@ -0,0 +1,215 @@
+#include <particles.h>
+#include <profiler.h>
+#include <algorithm>
+#include <cstddef>
+
+namespace sjd {
+
+static_assert(sizeof(Particle) == 8 * sizeof(float), "Particle must match the shaders' two vec4s");
+
+void integrateParticle(Particle& particle, float deltaSeconds, const glm::vec3& gravity, float drag) {
+    if (particle.age >= particle.lifetime) {
+        return;
+    }
+    particle.velocity += gravity * deltaSeconds;
+    particle.velocity *= std::max(1.0f - drag * deltaSeconds, 0.0f);
+    particle.position += particle.velocity * deltaSeconds;
+    particle.age += deltaSeconds;
+}
+
+ParticleSystem::ParticleSystem(const std::string& shaderDirectory, ParticleSettings settings)
+:   m_updateShader {shaderDirectory + "/particle_update.vert.glsl",
+                    std::vector<std::string> {"positionAge", "velocityLifetime"}},
+    m_drawShader {shaderDirectory + "/particle_billboard.vert.glsl",
+                  shaderDirectory + "/particle_billboard.frag.glsl"},
+    m_settings {settings}
+{
+    m_settings.capacity = std::max(m_settings.capacity, 1u);
+    m_settings.maxSpawnPerFrame = std::clamp(m_settings.maxSpawnPerFrame, 1u, m_settings.capacity);
+    if (!m_updateShader.isValid() || !m_drawShader.isValid()) {
+        std::cout << "Failed to create particle shaders.\n";
+        return;
+    }
+    // zeroed slots are dead, so both buffers start empty
+    std::vector<Particle> empty(m_settings.capacity);
+    GLsizeiptr bytes {static_cast<GLsizeiptr>(empty.size() * sizeof(Particle))};
+    glGenBuffers(2, m_buffers.data());
+    glGenVertexArrays(2, m_updateVaos.data());
+    glGenVertexArrays(2, m_drawVaos.data());
+    for (size_t i {0}; i < m_buffers.size(); i++) {
+        glBindBuffer(GL_ARRAY_BUFFER, m_buffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, bytes, empty.data(), GL_DYNAMIC_COPY);
+        _defineAttributes(m_updateVaos[i], m_buffers[i], 0);
+        _defineAttributes(m_drawVaos[i], m_buffers[i], 1);
+    }
+    glGenBuffers(1, &m_spawnBuffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, m_spawnBuffer);
+    glBufferData(GL_COPY_READ_BUFFER,
+                 static_cast<GLsizeiptr>(m_settings.maxSpawnPerFrame * sizeof(Particle)),
+                 nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    m_pending.reserve(m_settings.maxSpawnPerFrame);
+    m_isValid = glGetError() == GL_NO_ERROR;
+    if (!m_isValid) {
+        std::cout << "Failed to create particle buffers.\n";
+    }
+}
+
+ParticleSystem::~ParticleSystem() {
+    glDeleteVertexArrays(2, m_drawVaos.data());
+    glDeleteVertexArrays(2, m_updateVaos.data());
+    glDeleteBuffers(2, m_buffers.data());
+    glDeleteBuffers(1, &m_spawnBuffer);
+}
+
+void ParticleSystem::setSettings(const ParticleSettings& settings) {
+    // the buffers were sized at construction
+    uint32_t capacity {m_settings.capacity};
+    uint32_t maxSpawnPerFrame {m_settings.maxSpawnPerFrame};
+    m_settings = settings;
+    m_settings.capacity = capacity;
+    m_settings.maxSpawnPerFrame = maxSpawnPerFrame;
+}
+
+void ParticleSystem::emit(const Particle& particle) {
+    if (m_pending.size() >= m_settings.maxSpawnPerFrame) {
+        m_droppedSpawns++;
+        return;
+    }
+    m_pending.push_back(particle);
+}
+
+void ParticleSystem::emit(const std::vector<Particle>& particles) {
+    size_t room {m_settings.maxSpawnPerFrame - m_pending.size()};
+    size_t taken {std::min(room, particles.size())};
+    m_pending.insert(m_pending.end(), particles.begin(), particles.begin() + taken);
+    m_droppedSpawns += particles.size() - taken;
+}
+
+void ParticleSystem::update(float deltaSeconds) {
+    if (!m_isValid) {
+        return;
+    }
+    MAGE_PROFILE_GPU_SCOPE("particles::update");
+    _spawn();
+    if (m_activeSlots == 0) {
+        return;
+    }
+    size_t next {1 - m_current};
+    m_updateShader.use();
+    m_updateShader.setUniform("deltaTime", deltaSeconds);
+    m_updateShader.setUniform("gravity", m_settings.gravity);
+    m_updateShader.setUniform("drag", m_settings.drag);
+
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(m_updateVaos[m_current]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_buffers[next]);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(m_activeSlots));
+    glEndTransformFeedback();
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindVertexArray(0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    MAGE_COUNT_DRAW_CALLS(1);
+    m_current = next;
+}
+
+void ParticleSystem::draw(const glm::mat4& view, const glm::mat4& projection) const {
+    if (!m_isValid || m_activeSlots == 0) {
+        return;
+    }
+    MAGE_PROFILE_GPU_SCOPE("particles::draw");
+    GLboolean blend {glIsEnabled(GL_BLEND)};
+    GLint blendSrcRgb {0};
+    GLint blendDstRgb {0};
+    GLint blendSrcAlpha {0};
+    GLint blendDstAlpha {0};
+    glGetIntegerv(GL_BLEND_SRC_RGB, &blendSrcRgb);
+    glGetIntegerv(GL_BLEND_DST_RGB, &blendDstRgb);
+    glGetIntegerv(GL_BLEND_SRC_ALPHA, &blendSrcAlpha);
+    glGetIntegerv(GL_BLEND_DST_ALPHA, &blendDstAlpha);
+    GLboolean depthMask {GL_TRUE};
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+    // additive blending doesn't depend on draw order, so nothing is sorted
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glDepthMask(GL_FALSE);
+
+    m_drawShader.use();
+    m_drawShader.setUniform("view", view);
+    m_drawShader.setUniform("projection", projection);
+    m_drawShader.setUniform("size", m_settings.size);
+    m_drawShader.setUniform("colour", m_settings.colour);
+    glBindVertexArray(m_drawVaos[m_current]);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(m_activeSlots));
+    glBindVertexArray(0);
+    MAGE_COUNT_DRAW_CALLS(1);
+
+    glDepthMask(depthMask);
+    glBlendFuncSeparate(blendSrcRgb, blendDstRgb, blendSrcAlpha, blendDstAlpha);
+    if (!blend) {
+        glDisable(GL_BLEND);
+    }
+}
+
+auto ParticleSystem::readParticles() const -> std::vector<Particle> {
+    std::vector<Particle> particles(m_activeSlots);
+    if (!m_isValid || particles.empty()) {
+        return particles;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, m_buffers[m_current]);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0,
+                       static_cast<GLsizeiptr>(particles.size() * sizeof(Particle)),
+                       particles.data());
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    return particles;
+}
+
+void ParticleSystem::_spawn() {
+    if (m_pending.empty()) {
+        return;
+    }
+    GLsizeiptr bytes {static_cast<GLsizeiptr>(m_pending.size() * sizeof(Particle))};
+    glBindBuffer(GL_COPY_READ_BUFFER, m_spawnBuffer);
+    // orphan the last frame's spawns rather than wait for their copy
+    glBufferData(GL_COPY_READ_BUFFER,
+                 static_cast<GLsizeiptr>(m_settings.maxSpawnPerFrame * sizeof(Particle)),
+                 nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_COPY_READ_BUFFER, 0, bytes, m_pending.data());
+    MAGE_COUNT_UPLOAD(static_cast<uint64_t>(bytes));
+
+    // the ring may wrap, which splits the copy in two
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffers[m_current]);
+    uint32_t count {static_cast<uint32_t>(m_pending.size())};
+    uint32_t copied {0};
+    while (copied < count) {
+        uint32_t run {std::min(count - copied, m_settings.capacity - m_cursor)};
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                            static_cast<GLintptr>(copied * sizeof(Particle)),
+                            static_cast<GLintptr>(m_cursor * sizeof(Particle)),
+                            static_cast<GLsizeiptr>(run * sizeof(Particle)));
+        copied += run;
+        m_cursor = (m_cursor + run) % m_settings.capacity;
+        m_activeSlots = std::max(m_activeSlots, m_cursor == 0 ? m_settings.capacity : m_cursor);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    m_pending.clear();
+}
+
+void ParticleSystem::_defineAttributes(GLuint vao, GLuint buffer, GLuint divisor) {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Particle),
+                          reinterpret_cast<void*>(offsetof(Particle, position)));
+    glVertexAttribDivisor(0, divisor);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Particle),
+                          reinterpret_cast<void*>(offsetof(Particle, velocity)));
+    glVertexAttribDivisor(1, divisor);
+    glBindVertexArray(0);
+}
+
+}
@@ -0,0 +1,104 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <shader.h>
+
+namespace sjd {
+
+// one slot of a particle buffer, laid out as the shaders read it; a slot
+// is dead once age reaches lifetime, so zeroed slots are dead too
+struct Particle {
+    glm::vec3 position {0.0f};
+    float age {0.0f};
+    glm::vec3 velocity {0.0f};
+    float lifetime {0.0f};
+};
+
+// the step particle_update.vert.glsl applies, for reference and tests
+void integrateParticle(Particle& particle, float deltaSeconds, const glm::vec3& gravity, float drag);
+
+struct ParticleSettings {
+    // slots on the GPU; once full, new particles replace the oldest slots
+    uint32_t capacity {1u << 20};
+    // emit() calls past this many between updates are dropped
+    uint32_t maxSpawnPerFrame {1u << 14};
+    glm::vec3 gravity {0.0f, -9.81f, 0.0f};
+    // fraction of velocity lost per second
+    float drag {0.1f};
+    // billboard width and height in world units
+    float size {0.05f};
+    glm::vec4 colour {1.0f, 0.6f, 0.2f, 1.0f};
+};
+
+// Particles simulated entirely on the GPU with transform feedback.
+//
+// Two buffers hold every slot. update() draws the current one as points
+// through particle_update.vert.glsl with rasterisation off, capturing the
+// results into the other, then swaps them. New particles are uploaded to
+// a small spawn buffer and copied into the ring of slots on the GPU, so
+// the only per-frame upload is the new particles themselves.
+//
+// Only slots that have ever held a particle are updated and drawn. draw()
+// renders each slot as an instanced, additively blended billboard; dead
+// slots are moved outside the clip volume instead of being compacted, as
+// compaction would need the live count read back every frame.
+class ParticleSystem {
+public:
+    ParticleSystem(const std::string& shaderDirectory, ParticleSettings settings = {});
+    ~ParticleSystem();
+
+    ParticleSystem(const ParticleSystem&) = delete;
+    ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+    auto isValid() const -> const bool& { return m_isValid; }
+    auto settings() const -> const ParticleSettings& { return m_settings; }
+    // capacity and maxSpawnPerFrame keep their construction values
+    void setSettings(const ParticleSettings& settings);
+    // slots updated and drawn each frame, live or not
+    auto activeSlots() const -> const uint32_t& { return m_activeSlots; }
+    // particles emitted past maxSpawnPerFrame and never simulated
+    auto droppedSpawns() const -> const uint64_t& { return m_droppedSpawns; }
+
+    // queued for the next update()
+    void emit(const Particle& particle);
+    void emit(const std::vector<Particle>& particles);
+
+    void update(float deltaSeconds);
+    // draws into the bound framebuffer, depth tested but not written
+    void draw(const glm::mat4& view, const glm::mat4& projection) const;
+
+    // copies the active slots back from the GPU; slow, for tests and tools
+    auto readParticles() const -> std::vector<Particle>;
+
+private:
+    void _spawn();
+    void _defineAttributes(GLuint vao, GLuint buffer, GLuint divisor);
+
+    Shader m_updateShader;
+    Shader m_drawShader;
+    ParticleSettings m_settings;
+    bool m_isValid {false};
+
+    std::array<GLuint, 2> m_buffers {};
+    // m_updateVaos[i] reads m_buffers[i] per vertex, m_drawVaos[i] per instance
+    std::array<GLuint, 2> m_updateVaos {};
+    std::array<GLuint, 2> m_drawVaos {};
+    GLuint m_spawnBuffer {0};
+    // index of the buffer holding the latest state
+    size_t m_current {0};
+    // next slot a spawned particle goes into
+    uint32_t m_cursor {0};
+    uint32_t m_activeSlots {0};
+    uint64_t m_droppedSpawns {0};
+    std::vector<Particle> m_pending;
+};
+
+}
+#endif
@@ -0,0 +1,373 @@
+#include <post_process.h>
+#include <profiler.h>
+#include <algorithm>
+#include <cmath>
+
+namespace sjd {
+
+auto postEffectName(POST_EFFECT effect) -> const char* {
+    switch (effect) {
+    case POST_EFFECT::BLOOM_DOWNSAMPLE:
+        return "post::bloomDownsample";
+    case POST_EFFECT::BLOOM_UPSAMPLE:
+        return "post::bloomUpsample";
+    case POST_EFFECT::TONEMAP:
+        return "post::tonemap";
+    case POST_EFFECT::FXAA:
+        return "post::fxaa";
+    }
+    return "post::unknown";
+}
+
+auto bloomLevelCount(uint32_t width,
+                     uint32_t height,
+                     uint32_t maxLevels) -> uint32_t {
+    uint32_t levels {0};
+    while (levels < maxLevels
+           && (width >> (levels + 1)) >= 2
+           && (height >> (levels + 1)) >= 2) {
+        levels++;
+    }
+    return levels;
+}
+
+auto tonemapAces(float x) -> float {
+    return std::clamp((x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f),
+                      0.0f, 1.0f);
+}
+
+auto linearToSrgb(float x) -> float {
+    if (x <= 0.0031308f) {
+        return x * 12.92f;
+    }
+    return 1.055f * std::pow(x, 1.0f / 2.4f) - 0.055f;
+}
+
+PostProcessChain::PostProcessChain(const std::string& shaderDirectory,
+                                   uint32_t width,
+                                   uint32_t height,
+                                   PostSettings settings)
+:   m_downsampleShader {shaderDirectory + "/fullscreen.vert.glsl",
+                        shaderDirectory + "/post_bloom_downsample.frag.glsl"},
+    m_upsampleShader {shaderDirectory + "/fullscreen.vert.glsl",
+                      shaderDirectory + "/post_bloom_upsample.frag.glsl"},
+    m_tonemapShader {shaderDirectory + "/fullscreen.vert.glsl",
+                     shaderDirectory + "/post_tonemap.frag.glsl"},
+    m_fxaaShader {shaderDirectory + "/fullscreen.vert.glsl",
+                  shaderDirectory + "/post_fxaa.frag.glsl"},
+    m_settings {settings},
+    m_width {std::max(width, 1u)},
+    m_height {std::max(height, 1u)}
+{
+    if (!m_downsampleShader.isValid() || !m_upsampleShader.isValid()
+        || !m_tonemapShader.isValid() || !m_fxaaShader.isValid()) {
+        std::cout << "Failed to create post-processing shaders.\n";
+        return;
+    }
+    glGenVertexArrays(1, &m_emptyVao);
+    if (!_createTargets()) {
+        std::cout << "Failed to create post-processing framebuffers.\n";
+        return;
+    }
+    m_isValid = true;
+}
+
+PostProcessChain::~PostProcessChain() {
+    _deleteTargets();
+    glDeleteVertexArrays(1, &m_emptyVao);
+}
+
+void PostProcessChain::setSettings(const PostSettings& settings) {
+    bool levelsChanged {settings.bloomLevels != m_settings.bloomLevels};
+    m_settings = settings;
+    if (levelsChanged && m_isValid) {
+        _deleteTargets();
+        m_isValid = _createTargets();
+    }
+}
+
+void PostProcessChain::resize(uint32_t width, uint32_t height) {
+    width = std::max(width, 1u);
+    height = std::max(height, 1u);
+    if (width == m_width && height == m_height) {
+        return;
+    }
+    m_width = width;
+    m_height = height;
+    if (m_emptyVao == 0) {
+        return;
+    }
+    _deleteTargets();
+    m_isValid = _createTargets();
+}
+
+void PostProcessChain::bindSceneTarget() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, m_sceneFbo);
+    glViewport(0, 0, m_width, m_height);
+    MAGE_COUNT_STATE_CHANGE();
+}
+
+void PostProcessChain::apply(GLuint outputFramebuffer,
+                             uint32_t outputWidth,
+                             uint32_t outputHeight) {
+    if (!m_isValid) {
+        return;
+    }
+    MAGE_PROFILE_SCOPE("PostProcessChain::apply");
+    GLint previousFbo {0};
+    GLint previousViewport[4] {};
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFbo);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+    GLboolean depthTest {glIsEnabled(GL_DEPTH_TEST)};
+    GLboolean srgb {glIsEnabled(GL_FRAMEBUFFER_SRGB)};
+    GLboolean blend {glIsEnabled(GL_BLEND)};
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_FRAMEBUFFER_SRGB);
+    glDisable(GL_BLEND);
+    glBindVertexArray(m_emptyVao);
+
+    bool bloom {m_settings.bloom && m_bloomLevels > 0};
+    if (bloom) {
+        _downsampleBloom();
+        _upsampleBloom();
+    }
+
+    {
+        MAGE_PROFILE_GPU_SCOPE(postEffectName(POST_EFFECT::TONEMAP));
+        if (m_settings.fxaa) {
+            glBindFramebuffer(GL_FRAMEBUFFER, m_ldrFbo);
+            glViewport(0, 0, m_width, m_height);
+        }
+        else {
+            glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+            glViewport(0, 0, outputWidth, outputHeight);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_sceneColor);
+        glActiveTexture(GL_TEXTURE1);
+        _bindBloomLevel(0);
+        m_tonemapShader.use();
+        m_tonemapShader.setUniform("scene", 0);
+        m_tonemapShader.setUniform("bloom", 1);
+        m_tonemapShader.setUniform("bloomIntensity", bloom ? m_settings.bloomIntensity : 0.0f);
+        m_tonemapShader.setUniform("exposure", m_settings.exposure);
+        m_tonemapShader.setUniform("lumaInAlpha", m_settings.fxaa);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        MAGE_COUNT_DRAW_CALLS(1);
+    }
+
+    if (m_settings.fxaa) {
+        MAGE_PROFILE_GPU_SCOPE(postEffectName(POST_EFFECT::FXAA));
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+        glViewport(0, 0, outputWidth, outputHeight);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_ldrColor);
+        m_fxaaShader.use();
+        m_fxaaShader.setUniform("image", 0);
+        m_fxaaShader.setUniform("texelSize", glm::vec2(1.0f / static_cast<float>(m_width),
+                                                       1.0f / static_cast<float>(m_height)));
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        MAGE_COUNT_DRAW_CALLS(1);
+    }
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+    if (depthTest) {
+        glEnable(GL_DEPTH_TEST);
+    }
+    if (srgb) {
+        glEnable(GL_FRAMEBUFFER_SRGB);
+    }
+    if (blend) {
+        glEnable(GL_BLEND);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+    glViewport(previousViewport[0], previousViewport[1],
+               previousViewport[2], previousViewport[3]);
+}
+
+auto PostProcessChain::gpuCostMs(POST_EFFECT effect) const -> double {
+    const std::deque<FrameRecord>& frames {Profiler::instance().frames()};
+    std::string name {postEffectName(effect)};
+    for (auto frame {frames.rbegin()}; frame != frames.rend(); frame++) {
+        for (const GpuEvent& event : frame->gpuEvents) {
+            if (name == event.name) {
+                return frame->gpuTimeMs(name);
+            }
+        }
+    }
+    return 0.0;
+}
+
+void PostProcessChain::_downsampleBloom() {
+    MAGE_PROFILE_GPU_SCOPE(postEffectName(POST_EFFECT::BLOOM_DOWNSAMPLE));
+    glBindFramebuffer(GL_FRAMEBUFFER, m_bloomFbo);
+    glActiveTexture(GL_TEXTURE0);
+    m_downsampleShader.use();
+    m_downsampleShader.setUniform("source", 0);
+    m_downsampleShader.setUniform("threshold", m_settings.bloomThreshold);
+    m_downsampleShader.setUniform("knee", m_settings.bloomThreshold * m_settings.bloomKnee);
+
+    uint32_t sourceWidth {m_width};
+    uint32_t sourceHeight {m_height};
+    for (uint32_t level {0}; level < m_bloomLevels; level++) {
+        uint32_t levelWidth {std::max(m_width >> (level + 1), 1u)};
+        uint32_t levelHeight {std::max(m_height >> (level + 1), 1u)};
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, m_bloomChain, level);
+        glViewport(0, 0, levelWidth, levelHeight);
+        if (level == 0) {
+            glBindTexture(GL_TEXTURE_2D, m_sceneColor);
+        }
+        else {
+            _bindBloomLevel(level - 1);
+        }
+        m_downsampleShader.setUniform("firstLevel", level == 0);
+        m_downsampleShader.setUniform("sourceTexelSize",
+                                      glm::vec2(1.0f / static_cast<float>(sourceWidth),
+                                                1.0f / static_cast<float>(sourceHeight)));
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        sourceWidth = levelWidth;
+        sourceHeight = levelHeight;
+    }
+    MAGE_COUNT_DRAW_CALLS(m_bloomLevels);
+}
+
+void PostProcessChain::_upsampleBloom() {
+    MAGE_PROFILE_GPU_SCOPE(postEffectName(POST_EFFECT::BLOOM_UPSAMPLE));
+    glBindFramebuffer(GL_FRAMEBUFFER, m_bloomFbo);
+    glActiveTexture(GL_TEXTURE0);
+    m_upsampleShader.use();
+    m_upsampleShader.setUniform("source", 0);
+    float aspect {static_cast<float>(m_width) / static_cast<float>(m_height)};
+    m_upsampleShader.setUniform("filterRadius", glm::vec2(m_settings.bloomRadius,
+                                                          m_settings.bloomRadius * aspect));
+    GLint blendSrcRgb {0};
+    GLint blendDstRgb {0};
+    GLint blendSrcAlpha {0};
+    GLint blendDstAlpha {0};
+    GLint blendEquationRgb {0};
+    GLint blendEquationAlpha {0};
+    glGetIntegerv(GL_BLEND_SRC_RGB, &blendSrcRgb);
+    glGetIntegerv(GL_BLEND_DST_RGB, &blendDstRgb);
+    glGetIntegerv(GL_BLEND_SRC_ALPHA, &blendSrcAlpha);
+    glGetIntegerv(GL_BLEND_DST_ALPHA, &blendDstAlpha);
+    glGetIntegerv(GL_BLEND_EQUATION_RGB, &blendEquationRgb);
+    glGetIntegerv(GL_BLEND_EQUATION_ALPHA, &blendEquationAlpha);
+    // each level keeps its own downsample and adds the blurred level below
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glBlendEquation(GL_FUNC_ADD);
+    for (uint32_t level {m_bloomLevels - 1}; level > 0; level--) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, m_bloomChain, level - 1);
+        glViewport(0, 0, std::max(m_width >> level, 1u), std::max(m_height >> level, 1u));
+        _bindBloomLevel(level);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    glBlendFuncSeparate(blendSrcRgb, blendDstRgb, blendSrcAlpha, blendDstAlpha);
+    glBlendEquationSeparate(blendEquationRgb, blendEquationAlpha);
+    glDisable(GL_BLEND);
+    MAGE_COUNT_DRAW_CALLS(m_bloomLevels - 1);
+}
+
+void PostProcessChain::_bindBloomLevel(uint32_t level) const {
+    // restrict sampling to one level so reading and writing the same
+    // texture is not a feedback loop
+    glBindTexture(GL_TEXTURE_2D, m_bloomChain);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level);
+}
+
+bool PostProcessChain::_createTargets() {
+    m_bloomLevels = bloomLevelCount(m_width, m_height, m_settings.bloomLevels);
+
+    glGenTextures(1, &m_sceneColor);
+    glBindTexture(GL_TEXTURE_2D, m_sceneColor);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, m_width, m_height, 0,
+                 GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenRenderbuffers(1, &m_sceneDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_sceneDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_width, m_height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    // 11/11/10 float is half the bandwidth of RGBA16F and bloom has no alpha
+    glGenTextures(1, &m_bloomChain);
+    glBindTexture(GL_TEXTURE_2D, m_bloomChain);
+    for (uint32_t level {0}; level < std::max(m_bloomLevels, 1u); level++) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_R11F_G11F_B10F,
+                     std::max(m_width >> (level + 1), 1u),
+                     std::max(m_height >> (level + 1), 1u),
+                     0, GL_RGB, GL_FLOAT, NULL);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    glGenTextures(1, &m_ldrColor);
+    glBindTexture(GL_TEXTURE_2D, m_ldrColor);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_width, m_height, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLint previousFbo {0};
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFbo);
+    bool complete {true};
+
+    glGenFramebuffers(1, &m_sceneFbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_sceneFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, m_sceneColor, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                              GL_RENDERBUFFER, m_sceneDepth);
+    complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    glGenFramebuffers(1, &m_bloomFbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_bloomFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, m_bloomChain, 0);
+    complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    glGenFramebuffers(1, &m_ldrFbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_ldrFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, m_ldrColor, 0);
+    complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+    return complete;
+}
+
+void PostProcessChain::_deleteTargets() {
+    glDeleteFramebuffers(1, &m_sceneFbo);
+    glDeleteFramebuffers(1, &m_bloomFbo);
+    glDeleteFramebuffers(1, &m_ldrFbo);
+    glDeleteTextures(1, &m_sceneColor);
+    glDeleteTextures(1, &m_bloomChain);
+    glDeleteTextures(1, &m_ldrColor);
+    glDeleteRenderbuffers(1, &m_sceneDepth);
+    m_sceneFbo = 0;
+    m_bloomFbo = 0;
+    m_ldrFbo = 0;
+    m_sceneColor = 0;
+    m_bloomChain = 0;
+    m_ldrColor = 0;
+    m_sceneDepth = 0;
+}
+
+}
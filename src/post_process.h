@@ -0,0 +1,125 @@
+#ifndef POST_PROCESS_H
+#define POST_PROCESS_H
+
+#include <glad/glad.h>
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include <shader.h>
+
+namespace sjd {
+
+struct PostSettings {
+    bool bloom {true};
+    // scene luminance at which pixels start to bloom
+    float bloomThreshold {1.0f};
+    // width of the soft ramp below the threshold, as a fraction of it
+    float bloomKnee {0.5f};
+    float bloomIntensity {0.05f};
+    // upsample tent filter radius in uv units of the larger level
+    float bloomRadius {0.005f};
+    // levels in the chain, the first one at half resolution
+    uint32_t bloomLevels {6};
+    float exposure {1.0f};
+    // replaces hardware MSAA; leave the window at msaaBuffers = 1
+    bool fxaa {true};
+};
+
+// each one is timed as a separate MAGE_PROFILE_GPU_SCOPE
+enum class POST_EFFECT {
+    BLOOM_DOWNSAMPLE,
+    BLOOM_UPSAMPLE,
+    // bloom composite, exposure, tone mapping and sRGB encode in one pass
+    TONEMAP,
+    FXAA
+};
+const size_t POST_EFFECT_COUNT = 4;
+
+auto postEffectName(POST_EFFECT effect) -> const char*;
+
+// bloom levels that fit a width x height scene, starting at half size and
+// stopping before either side drops under 2 texels
+auto bloomLevelCount(uint32_t width,
+                     uint32_t height,
+                     uint32_t maxLevels) -> uint32_t;
+
+// ACES filmic curve fitted by Narkowicz, the CPU twin of post_tonemap.frag.glsl
+auto tonemapAces(float x) -> float;
+auto linearToSrgb(float x) -> float;
+
+// HDR scene target followed by bloom, tone mapping and FXAA.
+//
+// Render the scene into sceneFramebuffer(), then apply() writes the final
+// image to any framebuffer. Bloom works on a half resolution mip chain:
+// a 13-tap downsample with the threshold folded into the first level, then
+// a tent filtered upsample added back up the chain. Tone mapping is fused
+// with the bloom composite, and stores luma in alpha for FXAA to read, so
+// with everything on the chain costs one full resolution pass per effect
+// that needs neighbouring tone mapped pixels.
+class PostProcessChain {
+public:
+    PostProcessChain(const std::string& shaderDirectory,
+                     uint32_t width,
+                     uint32_t height,
+                     PostSettings settings = {});
+    ~PostProcessChain();
+
+    PostProcessChain(const PostProcessChain&) = delete;
+    PostProcessChain& operator=(const PostProcessChain&) = delete;
+
+    auto isValid() const -> bool { return m_isValid; }
+    auto settings() const -> const PostSettings& { return m_settings; }
+    auto width() const -> const uint32_t& { return m_width; }
+    auto height() const -> const uint32_t& { return m_height; }
+    // RGBA16F colour and a GL_DEPTH24_STENCIL8 depth buffer
+    auto sceneFramebuffer() const -> const GLuint& { return m_sceneFbo; }
+    auto sceneTexture() const -> const GLuint& { return m_sceneColor; }
+    auto bloomTexture() const -> const GLuint& { return m_bloomChain; }
+    auto bloomLevels() const -> const uint32_t& { return m_bloomLevels; }
+
+    void setSettings(const PostSettings& settings);
+    void resize(uint32_t width, uint32_t height);
+
+    // binds the scene target and sets the viewport to cover it
+    void bindSceneTarget() const;
+
+    // runs every enabled effect and writes the result to outputFramebuffer,
+    // scaled to outputWidth x outputHeight when that differs from the scene.
+    // The output is already sRGB encoded, so GL_FRAMEBUFFER_SRGB is turned
+    // off for the chain and restored after it.
+    void apply(GLuint outputFramebuffer, uint32_t outputWidth, uint32_t outputHeight);
+
+    // most recent GPU time of an effect found in the profiler's history, or
+    // 0.0 while its timer queries are still in flight
+    auto gpuCostMs(POST_EFFECT effect) const -> double;
+
+private:
+    bool _createTargets();
+    void _deleteTargets();
+    void _downsampleBloom();
+    void _upsampleBloom();
+    void _bindBloomLevel(uint32_t level) const;
+
+    Shader m_downsampleShader;
+    Shader m_upsampleShader;
+    Shader m_tonemapShader;
+    Shader m_fxaaShader;
+    PostSettings m_settings;
+    bool m_isValid {false};
+    uint32_t m_width {0};
+    uint32_t m_height {0};
+    uint32_t m_bloomLevels {0};
+    GLuint m_emptyVao {0};
+    GLuint m_sceneFbo {0};
+    GLuint m_sceneColor {0};
+    GLuint m_sceneDepth {0};
+    GLuint m_bloomFbo {0};
+    GLuint m_bloomChain {0};
+    // tone mapped image FXAA reads from
+    GLuint m_ldrFbo {0};
+    GLuint m_ldrColor {0};
+};
+
+}
+#endif
@@ -0,0 +1,367 @@
+#include <profiler.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace sjd {
+
+static thread_local uint16_t t_scopeDepth {0};
+
+static auto steadyNowNs() -> uint64_t {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void writeJsonString(std::ostream& out, const char* text) {
+    out << '"';
+    for (const char* c {text}; c && *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\';
+        }
+        out << *c;
+    }
+    out << '"';
+}
+
+auto FrameRecord::cpuTimeMs(const std::string& name) const -> double {
+    uint64_t total {0};
+    for (const CpuEvent& event : cpuEvents) {
+        if (name == event.name) {
+            total += event.durationNs;
+        }
+    }
+    return static_cast<double>(total) / 1.0e6;
+}
+
+auto FrameRecord::gpuTimeMs(const std::string& name) const -> double {
+    uint64_t total {0};
+    for (const GpuEvent& event : gpuEvents) {
+        if (name == event.name) {
+            total += event.durationNs;
+        }
+    }
+    return static_cast<double>(total) / 1.0e6;
+}
+
+GpuTimer::~GpuTimer() {
+    for (Slot& slot : m_slots) {
+        glDeleteQueries(1, &slot.start);
+        glDeleteQueries(1, &slot.end);
+    }
+}
+
+bool GpuTimer::begin(uint64_t frame, uint64_t cpuStartNs) {
+    if (m_active) {
+        return false;
+    }
+    Slot& slot {m_slots[m_next]};
+    if (slot.start == 0) {
+        glGenQueries(1, &slot.start);
+        glGenQueries(1, &slot.end);
+    }
+    // the GPU has fallen QUERY_FRAMES behind: drop the old sample rather
+    // than wait for it
+    slot.frame = frame;
+    slot.cpuStartNs = cpuStartNs;
+    slot.pending = false;
+    glQueryCounter(slot.start, GL_TIMESTAMP);
+    m_active = true;
+    return true;
+}
+
+void GpuTimer::end() {
+    if (!m_active) {
+        return;
+    }
+    glQueryCounter(m_slots[m_next].end, GL_TIMESTAMP);
+    m_slots[m_next].pending = true;
+    m_next = (m_next + 1) % QUERY_FRAMES;
+    m_active = false;
+}
+
+void GpuTimer::abandon() {
+    m_slots = {};
+    m_next = 0;
+    m_active = false;
+}
+
+auto Profiler::instance() -> Profiler& {
+    static Profiler profiler {};
+    return profiler;
+}
+
+Profiler::Profiler()
+:   m_epochNs {steadyNowNs()}
+{
+}
+
+auto Profiler::now() const -> uint64_t {
+    return steadyNowNs() - m_epochNs;
+}
+
+void Profiler::setHistorySize(size_t frames) {
+    m_historySize = std::max<size_t>(frames, 1);
+    while (m_history.size() > m_historySize) {
+        m_history.pop_front();
+    }
+}
+
+auto Profiler::lastFrame() const -> const FrameRecord& {
+    static const FrameRecord empty {};
+    return m_history.empty() ? empty : m_history.back();
+}
+
+auto Profiler::threadRingCount() const -> size_t {
+    std::lock_guard<std::mutex> lock {m_ringsMutex};
+    return m_rings.size();
+}
+
+void Profiler::setThreadName(const std::string& name) {
+    ThreadRing* ring {_threadRing()};
+    if (!ring) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock {m_ringsMutex};
+    ring->name = name;
+}
+
+void Profiler::beginFrame() {
+    m_current = FrameRecord {};
+    m_current.frame = m_frame;
+    m_current.startNs = now();
+}
+
+void Profiler::endFrame() {
+    m_current.frame = m_frame;
+    m_current.durationNs = now() - m_current.startNs;
+    m_current.counters.drawCalls = m_drawCalls.exchange(0, std::memory_order_relaxed);
+    m_current.counters.stateChanges = m_stateChanges.exchange(0, std::memory_order_relaxed);
+    m_current.counters.uploadBytes = m_uploadBytes.exchange(0, std::memory_order_relaxed);
+    _drainRings(m_current);
+    _resolveGpuTimers();
+
+    m_history.push_back(std::move(m_current));
+    while (m_history.size() > m_historySize) {
+        m_history.pop_front();
+    }
+    m_current = FrameRecord {};
+    m_frame++;
+}
+
+void Profiler::clear() {
+    FrameRecord discarded {};
+    _drainRings(discarded);
+    m_history.clear();
+    m_current = FrameRecord {};
+    m_drawCalls.store(0, std::memory_order_relaxed);
+    m_stateChanges.store(0, std::memory_order_relaxed);
+    m_uploadBytes.store(0, std::memory_order_relaxed);
+    m_dropped.store(0, std::memory_order_relaxed);
+}
+
+void Profiler::recordCpu(const char* name, uint64_t startNs, uint64_t endNs, uint16_t depth) {
+    ThreadRing* ring {_threadRing()};
+    CpuEvent event {name, startNs, endNs - startNs, 0, depth};
+    if (!ring) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    event.threadId = ring->id;
+    if (!ring->events.push(event)) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Profiler::resetGpuTimers() {
+    // the queries went with the old context; the timers start afresh
+    for (auto& [name, timer] : m_gpuTimers) {
+        timer->abandon();
+    }
+    m_activeGpuTimers.clear();
+}
+
+bool Profiler::beginGpu(const char* name) {
+    auto found {m_gpuTimers.find(std::string_view{name})};
+    if (found == m_gpuTimers.end()) {
+        found = m_gpuTimers.emplace(name, std::make_unique<GpuTimer>()).first;
+    }
+    GpuTimer& timer {*found->second};
+    if (!timer.begin(m_frame, now())) {
+        // already open further out, so its one slot is taken
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    m_activeGpuTimers.push_back(&timer);
+    return true;
+}
+
+void Profiler::endGpu() {
+    if (!m_activeGpuTimers.empty()) {
+        m_activeGpuTimers.back()->end();
+        m_activeGpuTimers.pop_back();
+    }
+}
+
+void Profiler::writeChromeTrace(std::ostream& out) const {
+    const uint32_t gpuThreadId {0xffff};
+    out << "{\"traceEvents\":[\n";
+    bool first {true};
+    auto separator {[&](){
+        out << (first ? "" : ",\n");
+        first = false;
+    }};
+    {
+        std::lock_guard<std::mutex> lock {m_ringsMutex};
+        for (const std::unique_ptr<ThreadRing>& ring : m_rings) {
+            separator();
+            std::string name {ring->name.empty() ? "thread " + std::to_string(ring->id) : ring->name};
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << ring->id
+                << ",\"args\":{\"name\":";
+            writeJsonString(out, name.c_str());
+            out << "}}";
+        }
+    }
+    separator();
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << gpuThreadId
+        << ",\"args\":{\"name\":\"GPU\"}}";
+
+    // trace timestamps are in microseconds
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    for (const FrameRecord& frame : m_history) {
+        separator();
+        out << "{\"name\":\"frame " << frame.frame << "\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":0,\"tid\":0"
+            << ",\"ts\":" << frame.startNs / 1000.0 << ",\"dur\":" << frame.durationNs / 1000.0
+            << ",\"args\":{\"drawCalls\":" << frame.counters.drawCalls
+            << ",\"stateChanges\":" << frame.counters.stateChanges
+            << ",\"uploadBytes\":" << frame.counters.uploadBytes << "}}";
+        for (const CpuEvent& event : frame.cpuEvents) {
+            separator();
+            out << "{\"name\":";
+            writeJsonString(out, event.name);
+            out << ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.threadId
+                << ",\"ts\":" << event.startNs / 1000.0 << ",\"dur\":" << event.durationNs / 1000.0 << "}";
+        }
+        for (const GpuEvent& event : frame.gpuEvents) {
+            separator();
+            out << "{\"name\":";
+            writeJsonString(out, event.name);
+            out << ",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0,\"tid\":" << gpuThreadId
+                << ",\"ts\":" << event.startNs / 1000.0 << ",\"dur\":" << event.durationNs / 1000.0 << "}";
+        }
+        separator();
+        out << "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":0,\"ts\":" << frame.startNs / 1000.0
+            << ",\"args\":{\"drawCalls\":" << frame.counters.drawCalls
+            << ",\"stateChanges\":" << frame.counters.stateChanges << "}}";
+    }
+    out << "\n]}\n";
+}
+
+auto Profiler::exportChromeTrace(const std::string& path) const -> bool {
+    std::ofstream file {path};
+    if (!file) {
+        std::cout << "Failed to open trace file at: " << path << "\n";
+        return false;
+    }
+    writeChromeTrace(file);
+    return static_cast<bool>(file);
+}
+
+Profiler::RingLease::~RingLease() {
+    if (ring) {
+        Profiler& profiler {Profiler::instance()};
+        std::lock_guard<std::mutex> lock {profiler.m_ringsMutex};
+        ring->inUse = false;
+    }
+}
+
+auto Profiler::_threadRing() -> ThreadRing* {
+    // taken once per thread; the profiler owns the ring so events outlive
+    // a thread that exits mid-frame, and the next thread reuses it, under
+    // the lock, as that thread's sole producer
+    static thread_local RingLease t_lease {};
+    static thread_local bool t_refused {false};
+    if (t_lease.ring || t_refused) {
+        return t_lease.ring;
+    }
+    std::lock_guard<std::mutex> lock {m_ringsMutex};
+    for (const std::unique_ptr<ThreadRing>& ring : m_rings) {
+        if (!ring->inUse) {
+            ring->inUse = true;
+            ring->name.clear();
+            t_lease.ring = ring.get();
+            return t_lease.ring;
+        }
+    }
+    if (m_rings.size() == MAX_THREAD_RINGS) {
+        t_refused = true;
+        return nullptr;
+    }
+    m_rings.push_back(std::make_unique<ThreadRing>());
+    t_lease.ring = m_rings.back().get();
+    t_lease.ring->id = static_cast<uint32_t>(m_rings.size() - 1);
+    return t_lease.ring;
+}
+
+void Profiler::_drainRings(FrameRecord& frame) {
+    std::lock_guard<std::mutex> lock {m_ringsMutex};
+    for (const std::unique_ptr<ThreadRing>& ring : m_rings) {
+        ring->events.drain([&](const CpuEvent& event){
+            frame.cpuEvents.push_back(event);
+        });
+    }
+}
+
+void Profiler::_resolveGpuTimers() {
+    for (auto& [name, timer] : m_gpuTimers) {
+        timer->resolve([&](uint64_t frame, uint64_t cpuStartNs, uint64_t durationNs){
+            GpuEvent event {name.c_str(), cpuStartNs, durationNs};
+            if (frame == m_current.frame) {
+                m_current.gpuEvents.push_back(event);
+                return;
+            }
+            for (FrameRecord& record : m_history) {
+                if (record.frame == frame) {
+                    record.gpuEvents.push_back(event);
+                    return;
+                }
+            }
+        });
+    }
+}
+
+ProfileScope::ProfileScope(const char* name)
+:   m_name {name}
+{
+    Profiler& profiler {Profiler::instance()};
+    if (profiler.isEnabled()) {
+        m_recording = true;
+        m_startNs = profiler.now();
+        t_scopeDepth++;
+    }
+}
+
+ProfileScope::~ProfileScope() {
+    if (m_recording) {
+        t_scopeDepth--;
+        Profiler& profiler {Profiler::instance()};
+        profiler.recordCpu(m_name, m_startNs, profiler.now(), t_scopeDepth);
+    }
+}
+
+GpuProfileScope::GpuProfileScope(const char* name) {
+    Profiler& profiler {Profiler::instance()};
+    if (profiler.isEnabled()) {
+        m_timing = profiler.beginGpu(name);
+    }
+}
+
+GpuProfileScope::~GpuProfileScope() {
+    if (m_timing) {
+        Profiler::instance().endGpu();
+    }
+}
+
+}
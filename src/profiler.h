@@ -0,0 +1,285 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <spsc_ring.h>
+
+namespace sjd {
+
+// a closed CPU scope; names must be string literals or otherwise outlive
+// the profiler, as only the pointer is stored
+struct CpuEvent {
+    const char* name {nullptr};
+    uint64_t startNs {0};
+    uint64_t durationNs {0};
+    uint32_t threadId {0};
+    uint16_t depth {0};
+};
+
+// GPU time between two GL_TIMESTAMP queries, placed on the timeline at the
+// CPU time its scope was opened; the name is the profiler's own copy
+struct GpuEvent {
+    const char* name {nullptr};
+    uint64_t startNs {0};
+    uint64_t durationNs {0};
+};
+
+struct FrameCounters {
+    uint32_t drawCalls {0};
+    uint32_t stateChanges {0};
+    uint64_t uploadBytes {0};
+};
+
+struct FrameRecord {
+    uint64_t frame {0};
+    uint64_t startNs {0};
+    uint64_t durationNs {0};
+    FrameCounters counters {};
+    std::vector<CpuEvent> cpuEvents;
+    // arrive QUERY_FRAMES or more frames late, once the GPU is done
+    std::vector<GpuEvent> gpuEvents;
+
+    auto cpuTimeMs(const std::string& name) const -> double;
+    auto gpuTimeMs(const std::string& name) const -> double;
+};
+
+// Double-buffered pair of GL_TIMESTAMP queries. A slot is only read back
+// when it is about to be reused and its result is available, so the CPU
+// never waits on the GPU. Unlike GL_TIME_ELAPSED, timestamps nest, so
+// timers may be open inside one another; only a timer can't be opened
+// inside itself.
+class GpuTimer {
+public:
+    static const size_t QUERY_FRAMES = 2;
+
+    GpuTimer() = default;
+    ~GpuTimer();
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    // false, starting nothing, when the timer is already open
+    bool begin(uint64_t frame, uint64_t cpuStartNs);
+    void end();
+    // drops the queries without deleting them, once their context is gone
+    void abandon();
+
+    // calls onResult(frame, cpuStartNs, durationNs) for each finished slot
+    template <typename Callback>
+    void resolve(Callback&& onResult) {
+        for (Slot& slot : m_slots) {
+            if (!slot.pending) {
+                continue;
+            }
+            // the end is written last, so the start is ready once it is
+            GLint available {GL_FALSE};
+            glGetQueryObjectiv(slot.end, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                continue;
+            }
+            GLuint64 start {0};
+            GLuint64 end {0};
+            glGetQueryObjectui64v(slot.start, GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(slot.end, GL_QUERY_RESULT, &end);
+            slot.pending = false;
+            onResult(slot.frame, slot.cpuStartNs, static_cast<uint64_t>(end > start ? end - start : 0));
+        }
+    }
+
+private:
+    struct Slot {
+        GLuint start {0};
+        GLuint end {0};
+        uint64_t frame {0};
+        uint64_t cpuStartNs {0};
+        bool pending {false};
+    };
+
+    std::array<Slot, QUERY_FRAMES> m_slots {};
+    size_t m_next {0};
+    bool m_active {false};
+};
+
+// Collects nested CPU scopes from any thread, GPU scopes from the thread
+// that owns the GL context, and per-frame counters.
+//
+// Each thread records into its own lock-free ring, which endFrame() drains
+// on the main thread, so recording a scope never takes a lock. Events that
+// don't fit in a ring before the next drain are dropped and counted. A
+// thread's ring is handed to the next new thread once it exits, and events
+// from threads beyond MAX_THREAD_RINGS running at once are dropped too.
+class Profiler {
+public:
+    static const size_t RING_CAPACITY = 4096;
+    static const size_t MAX_THREAD_RINGS = 64;
+
+    static auto instance() -> Profiler&;
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    auto isEnabled() const -> bool { return m_enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+
+    // number of completed frames kept for queries and export
+    void setHistorySize(size_t frames);
+    auto frames() const -> const std::deque<FrameRecord>& { return m_history; }
+    // the most recently completed frame; empty before the first endFrame()
+    auto lastFrame() const -> const FrameRecord&;
+    auto droppedEvents() const -> uint64_t { return m_dropped.load(std::memory_order_relaxed); }
+    // rings held by running threads and waiting to be reused
+    auto threadRingCount() const -> size_t;
+
+    // names the calling thread in exported traces
+    void setThreadName(const std::string& name);
+
+    void beginFrame();
+    // drains every thread's ring and resolves whichever GPU timers are ready
+    void endFrame();
+    // forgets the history and any events not yet drained
+    void clear();
+    // GPU timers belong to the context current when they were first used;
+    // call once a new context has replaced it
+    void resetGpuTimers();
+
+    void recordCpu(const char* name, uint64_t startNs, uint64_t endNs, uint16_t depth);
+
+    // GPU scopes must be opened and closed on the GL thread, innermost
+    // first, and may nest. Scopes with equal names share a timer, wherever
+    // the names are stored, so a scope opened inside one of the same name
+    // can't be timed: beginGpu() returns false and counts a dropped event
+    bool beginGpu(const char* name);
+    void endGpu();
+
+    void countDrawCalls(uint32_t count) {
+        m_drawCalls.fetch_add(count, std::memory_order_relaxed);
+    }
+    void countStateChange() {
+        m_stateChanges.fetch_add(1, std::memory_order_relaxed);
+    }
+    void countUpload(uint64_t bytes) {
+        m_uploadBytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    // Chrome's trace event format, viewable in chrome://tracing or Perfetto
+    void writeChromeTrace(std::ostream& out) const;
+    auto exportChromeTrace(const std::string& path) const -> bool;
+
+    // nanoseconds since the profiler was created
+    auto now() const -> uint64_t;
+
+private:
+    Profiler();
+
+    struct ThreadRing {
+        uint32_t id {0};
+        std::string name;
+        // false once its thread has exited, until another thread takes it
+        bool inUse {true};
+        SpscRing<CpuEvent, RING_CAPACITY> events;
+    };
+
+    // hands a thread's ring back when the thread exits
+    struct RingLease {
+        ThreadRing* ring {nullptr};
+        ~RingLease();
+    };
+
+    // lets the timers be found by a const char* without building a string
+    struct NameHash {
+        using is_transparent = void;
+        auto operator()(std::string_view name) const -> size_t {
+            return std::hash<std::string_view>{}(name);
+        }
+    };
+
+    // nullptr once MAX_THREAD_RINGS threads hold one
+    auto _threadRing() -> ThreadRing*;
+    void _drainRings(FrameRecord& frame);
+    void _resolveGpuTimers();
+
+    std::atomic<bool> m_enabled {true};
+    uint64_t m_epochNs {0};
+
+    mutable std::mutex m_ringsMutex;
+    std::vector<std::unique_ptr<ThreadRing>> m_rings;
+    std::atomic<uint64_t> m_dropped {0};
+
+    std::atomic<uint32_t> m_drawCalls {0};
+    std::atomic<uint32_t> m_stateChanges {0};
+    std::atomic<uint64_t> m_uploadBytes {0};
+
+    // never erased, so events can point at the keys for as long as the
+    // profiler lives whatever the caller's name pointed at
+    std::unordered_map<std::string, std::unique_ptr<GpuTimer>, NameHash, std::equal_to<>> m_gpuTimers;
+    // the open GPU scopes, innermost last
+    std::vector<GpuTimer*> m_activeGpuTimers;
+
+    FrameRecord m_current {};
+    uint64_t m_frame {0};
+    size_t m_historySize {120};
+    std::deque<FrameRecord> m_history;
+};
+
+// RAII marker that records the time between construction and destruction
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name);
+    ~ProfileScope();
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* m_name;
+    uint64_t m_startNs {0};
+    bool m_recording {false};
+};
+
+class GpuProfileScope {
+public:
+    explicit GpuProfileScope(const char* name);
+    ~GpuProfileScope();
+
+    GpuProfileScope(const GpuProfileScope&) = delete;
+    GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+    bool m_timing {false};
+};
+
+}
+
+// define MAGE_DISABLE_PROFILING to compile every marker out
+#ifndef MAGE_DISABLE_PROFILING
+#define MAGE_PROFILE_CONCAT_INNER(a, b) a##b
+#define MAGE_PROFILE_CONCAT(a, b) MAGE_PROFILE_CONCAT_INNER(a, b)
+#define MAGE_PROFILE_SCOPE(name) \
+    sjd::ProfileScope MAGE_PROFILE_CONCAT(profileScope_, __LINE__) {name}
+#define MAGE_PROFILE_GPU_SCOPE(name) \
+    sjd::ProfileScope MAGE_PROFILE_CONCAT(profileScope_, __LINE__) {name}; \
+    sjd::GpuProfileScope MAGE_PROFILE_CONCAT(gpuProfileScope_, __LINE__) {name}
+#define MAGE_COUNT_DRAW_CALLS(count) sjd::Profiler::instance().countDrawCalls(count)
+#define MAGE_COUNT_STATE_CHANGE() sjd::Profiler::instance().countStateChange()
+#define MAGE_COUNT_UPLOAD(bytes) sjd::Profiler::instance().countUpload(bytes)
+#else
+#define MAGE_PROFILE_SCOPE(name)
+#define MAGE_PROFILE_GPU_SCOPE(name)
+#define MAGE_COUNT_DRAW_CALLS(count)
+#define MAGE_COUNT_STATE_CHANGE()
+#define MAGE_COUNT_UPLOAD(bytes)
+#endif
+
+#endif
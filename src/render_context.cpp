@@ -0,0 +1,12 @@
+#include <render_context.h>
+#include <environment.h>
+#include <shadow_map.h>
+
+namespace sjd {
+
+void initRenderContext() {
+    CascadedShadowMap::createFallback();
+    EnvironmentMap::createFallbacks();
+}
+
+}
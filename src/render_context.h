@@ -0,0 +1,14 @@
+#ifndef RENDER_CONTEXT_H
+#define RENDER_CONTEXT_H
+
+namespace sjd {
+
+// Sets up what the renderer keeps per GL context: a complete fallback
+// texture of the right type on each unit in RESERVED_SAMPLERS, so a program
+// drawn before anything else is bound there still samples one. Textures die
+// with their context, so call it after every context is created and made
+// current, e.g. once createCursorLockedWindow() returns a window.
+void initRenderContext();
+
+}
+#endif
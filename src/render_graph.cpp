@@ -0,0 +1,585 @@
+#include <render_graph.h>
+#include <profiler.h>
+#include <algorithm>
+#include <iostream>
+#include <queue>
+
+namespace sjd {
+
+static auto uploadFormat(GLenum internalFormat) -> std::pair<GLenum, GLenum> {
+    switch (internalFormat) {
+    case GL_DEPTH24_STENCIL8:
+        return {GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8};
+    case GL_DEPTH_COMPONENT16:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32F:
+        return {GL_DEPTH_COMPONENT, GL_FLOAT};
+    case GL_R8:
+    case GL_R16F:
+    case GL_R32F:
+        return {GL_RED, GL_FLOAT};
+    case GL_RG8:
+    case GL_RG16F:
+    case GL_RG32F:
+        return {GL_RG, GL_FLOAT};
+    case GL_R11F_G11F_B10F:
+    case GL_RGB8:
+    case GL_RGB16F:
+        return {GL_RGB, GL_FLOAT};
+    default:
+        return {GL_RGBA, GL_FLOAT};
+    }
+}
+
+auto TextureDesc::bytes() const -> size_t {
+    size_t bytesPerPixel {4};
+    switch (internalFormat) {
+    case GL_R8:
+        bytesPerPixel = 1;
+        break;
+    case GL_R16F:
+    case GL_RG8:
+    case GL_DEPTH_COMPONENT16:
+        bytesPerPixel = 2;
+        break;
+    case GL_RG32F:
+    case GL_RGBA16F:
+        bytesPerPixel = 8;
+        break;
+    case GL_RGB16F:
+        bytesPerPixel = 6;
+        break;
+    case GL_RGBA32F:
+        bytesPerPixel = 16;
+        break;
+    default:
+        break;
+    }
+    return static_cast<size_t>(width) * height * bytesPerPixel;
+}
+
+auto TextureDesc::isDepth() const -> bool {
+    return internalFormat == GL_DEPTH24_STENCIL8
+        || internalFormat == GL_DEPTH_COMPONENT16
+        || internalFormat == GL_DEPTH_COMPONENT24
+        || internalFormat == GL_DEPTH_COMPONENT32F;
+}
+
+TexturePool::~TexturePool() {
+    for (Entry& entry : m_entries) {
+        glDeleteTextures(1, &entry.texture);
+    }
+}
+
+auto TexturePool::acquire(const TextureDesc& desc) -> GLuint {
+    for (Entry& entry : m_entries) {
+        if (!entry.inUse && entry.desc == desc) {
+            entry.inUse = true;
+            entry.idleFrames = 0;
+            return entry.texture;
+        }
+    }
+    Entry entry {desc, 0, true, 0};
+    auto [format, type] {uploadFormat(desc.internalFormat)};
+    glGenTextures(1, &entry.texture);
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height,
+                 0, format, type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    MAGE_COUNT_UPLOAD(desc.bytes());
+    m_allocations++;
+    m_entries.push_back(entry);
+    return entry.texture;
+}
+
+void TexturePool::release(GLuint texture) {
+    for (Entry& entry : m_entries) {
+        if (entry.texture == texture) {
+            entry.inUse = false;
+            return;
+        }
+    }
+}
+
+void TexturePool::endFrame(uint32_t maxIdleFrames) {
+    for (Entry& entry : m_entries) {
+        entry.idleFrames++;
+        if (!entry.inUse && entry.idleFrames > maxIdleFrames) {
+            glDeleteTextures(1, &entry.texture);
+            entry.texture = 0;
+        }
+    }
+    size_t before {m_entries.size()};
+    std::erase_if(m_entries, [](const Entry& entry){ return entry.texture == 0; });
+    if (m_entries.size() != before) {
+        m_generation++;
+    }
+}
+
+auto TexturePool::allocatedBytes() const -> size_t {
+    size_t total {0};
+    for (const Entry& entry : m_entries) {
+        total += entry.desc.bytes();
+    }
+    return total;
+}
+
+auto PassContext::texture(ResourceHandle handle) const -> GLuint {
+    return m_graph.texture(handle);
+}
+
+auto RenderGraph::PassBuilder::read(ResourceHandle handle) -> PassBuilder& {
+    m_graph.m_passes[m_pass].reads.push_back(handle);
+    m_graph.m_compiled = false;
+    return *this;
+}
+
+auto RenderGraph::PassBuilder::write(ResourceHandle handle) -> PassBuilder& {
+    m_graph.m_passes[m_pass].writes.push_back(handle);
+    m_graph.m_compiled = false;
+    return *this;
+}
+
+auto RenderGraph::PassBuilder::sideEffect() -> PassBuilder& {
+    m_graph.m_passes[m_pass].sideEffect = true;
+    m_graph.m_compiled = false;
+    return *this;
+}
+
+auto RenderGraph::PassBuilder::execute(PassCallback callback) -> PassBuilder& {
+    m_graph.m_passes[m_pass].callback = std::move(callback);
+    return *this;
+}
+
+RenderGraph::~RenderGraph() {
+    _deleteFramebuffers();
+}
+
+auto RenderGraph::createTexture(const std::string& name, const TextureDesc& desc) -> ResourceHandle {
+    Resource resource {};
+    resource.name = name;
+    resource.desc = desc;
+    m_resources.push_back(resource);
+    m_compiled = false;
+    return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+auto RenderGraph::importTexture(const std::string& name,
+                                GLuint texture,
+                                const TextureDesc& desc) -> ResourceHandle {
+    ResourceHandle handle {createTexture(name, desc)};
+    m_resources[handle].imported = true;
+    m_resources[handle].texture = texture;
+    return handle;
+}
+
+auto RenderGraph::importFramebuffer(const std::string& name,
+                                    GLuint framebuffer,
+                                    uint32_t width,
+                                    uint32_t height) -> ResourceHandle {
+    ResourceHandle handle {createTexture(name, TextureDesc {width, height, GL_RGBA8})};
+    m_resources[handle].imported = true;
+    m_resources[handle].isFramebuffer = true;
+    m_resources[handle].framebuffer = framebuffer;
+    return handle;
+}
+
+auto RenderGraph::addPass(const std::string& name) -> PassBuilder {
+    Pass pass {};
+    pass.name = name;
+    m_passes.push_back(pass);
+    m_compiled = false;
+    return PassBuilder {*this, m_passes.size() - 1};
+}
+
+void RenderGraph::markOutput(ResourceHandle handle) {
+    if (_validHandle(handle)) {
+        m_resources[handle].output = true;
+        m_compiled = false;
+    }
+}
+
+auto RenderGraph::compile() -> std::expected<GraphStats, GRAPH_ERROR> {
+    for (const Pass& pass : m_passes) {
+        for (ResourceHandle handle : pass.reads) {
+            if (!_validHandle(handle)) {
+                return std::unexpected(GRAPH_ERROR::badHandle);
+            }
+        }
+        for (ResourceHandle handle : pass.writes) {
+            if (!_validHandle(handle)) {
+                return std::unexpected(GRAPH_ERROR::badHandle);
+            }
+        }
+        for (ResourceHandle handle : pass.writes) {
+            if (m_resources[handle].isFramebuffer && pass.writes.size() > 1) {
+                std::cout << "Render graph pass " << pass.name << " writes "
+                          << m_resources[handle].name << " alongside other targets.\n";
+                return std::unexpected(GRAPH_ERROR::mixedTargets);
+            }
+        }
+    }
+    _cull();
+    // a transient read by a live pass must be written by one
+    for (const Pass& pass : m_passes) {
+        if (pass.culled) {
+            continue;
+        }
+        for (ResourceHandle handle : pass.reads) {
+            if (m_resources[handle].imported) {
+                continue;
+            }
+            bool written {false};
+            for (const Pass& writer : m_passes) {
+                written = written || (!writer.culled
+                                      && std::ranges::find(writer.writes, handle) != writer.writes.end());
+            }
+            if (!written) {
+                std::cout << "Render graph pass " << pass.name << " reads "
+                          << m_resources[handle].name << " before anything writes it.\n";
+                return std::unexpected(GRAPH_ERROR::readBeforeWrite);
+            }
+        }
+    }
+    auto sorted {_sort()};
+    if (!sorted.has_value()) {
+        return std::unexpected(sorted.error());
+    }
+    _assignSlots();
+    m_compiled = true;
+    return m_stats;
+}
+
+auto RenderGraph::execute(TexturePool& pool) -> std::expected<GraphStats, GRAPH_ERROR> {
+    MAGE_PROFILE_SCOPE("RenderGraph::execute");
+    if (!m_compiled) {
+        auto compiled {compile()};
+        if (!compiled.has_value()) {
+            return compiled;
+        }
+    }
+    if (pool.generation() != m_poolGeneration) {
+        _deleteFramebuffers();
+        m_poolGeneration = pool.generation();
+    }
+    for (Slot& slot : m_slots) {
+        slot.texture = pool.acquire(slot.desc);
+    }
+    GLint previousFbo {0};
+    GLint previousViewport[4] {};
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFbo);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+    for (size_t index : m_order) {
+        const Pass& pass {m_passes[index]};
+        PassContext context {*this};
+        context.m_framebuffer = _framebufferFor(pass);
+        if (!pass.writes.empty()) {
+            const TextureDesc& target {m_resources[pass.writes.front()].desc};
+            context.m_width = target.width;
+            context.m_height = target.height;
+            glBindFramebuffer(GL_FRAMEBUFFER, context.m_framebuffer);
+            glViewport(0, 0, target.width, target.height);
+        }
+        if (pass.callback) {
+            pass.callback(context);
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+    glViewport(previousViewport[0], previousViewport[1],
+               previousViewport[2], previousViewport[3]);
+    for (Slot& slot : m_slots) {
+        pool.release(slot.texture);
+    }
+    return m_stats;
+}
+
+void RenderGraph::clear() {
+    m_resources.clear();
+    m_passes.clear();
+    m_order.clear();
+    m_slots.clear();
+    m_stats = GraphStats {};
+    m_compiled = false;
+}
+
+auto RenderGraph::executionOrder() const -> std::vector<std::string> {
+    std::vector<std::string> names;
+    for (size_t index : m_order) {
+        names.push_back(m_passes[index].name);
+    }
+    return names;
+}
+
+auto RenderGraph::isCulled(const std::string& passName) const -> bool {
+    for (const Pass& pass : m_passes) {
+        if (pass.name == passName) {
+            return pass.culled;
+        }
+    }
+    return true;
+}
+
+auto RenderGraph::texture(ResourceHandle handle) const -> GLuint {
+    if (!_validHandle(handle)) {
+        return 0;
+    }
+    const Resource& resource {m_resources[handle]};
+    if (resource.imported) {
+        return resource.texture;
+    }
+    return resource.used ? m_slots[resource.slot].texture : 0;
+}
+
+auto RenderGraph::physicalSlot(ResourceHandle handle) const -> size_t {
+    return _validHandle(handle) ? m_resources[handle].slot : 0;
+}
+
+void RenderGraph::printReport(std::ostream& out) const {
+    out << "Render graph: " << m_stats.passes - m_stats.culledPasses << " of "
+        << m_stats.passes << " passes run, " << m_stats.transientResources
+        << " transient textures in " << m_stats.physicalTextures << " allocations, "
+        << m_stats.peakTransientBytes / 1024 << " KiB peak ("
+        << m_stats.unaliasedTransientBytes / 1024 << " KiB without aliasing)\n";
+    for (size_t index : m_order) {
+        out << "  " << m_passes[index].name << "\n";
+    }
+    for (const Resource& resource : m_resources) {
+        if (resource.used && !resource.imported) {
+            out << "  " << resource.name << ": passes " << resource.firstUse << "-"
+                << resource.lastUse << ", slot " << resource.slot << "\n";
+        }
+    }
+}
+
+auto RenderGraph::_validHandle(ResourceHandle handle) const -> bool {
+    return handle < m_resources.size();
+}
+
+void RenderGraph::_cull() {
+    // walk back from the outputs, keeping only passes something needs
+    std::vector<bool> needed(m_resources.size(), false);
+    for (Pass& pass : m_passes) {
+        pass.culled = true;
+    }
+    bool changed {true};
+    while (changed) {
+        changed = false;
+        for (Pass& pass : m_passes) {
+            if (!pass.culled) {
+                continue;
+            }
+            bool live {pass.sideEffect};
+            for (ResourceHandle handle : pass.writes) {
+                const Resource& resource {m_resources[handle]};
+                live = live || needed[handle] || resource.output || resource.imported;
+            }
+            if (live) {
+                pass.culled = false;
+                changed = true;
+                for (ResourceHandle handle : pass.reads) {
+                    needed[handle] = true;
+                }
+            }
+        }
+    }
+    m_stats = GraphStats {};
+    m_stats.passes = m_passes.size();
+    m_stats.culledPasses = std::ranges::count_if(m_passes, [](const Pass& pass){ return pass.culled; });
+}
+
+auto RenderGraph::_sort() -> std::expected<void, GRAPH_ERROR> {
+    // writers of a resource run in declaration order, and readers that
+    // don't also write it run after the last of them
+    std::vector<std::vector<size_t>> edges(m_passes.size());
+    std::vector<size_t> incoming(m_passes.size(), 0);
+    for (ResourceHandle handle {0}; handle < m_resources.size(); handle++) {
+        std::vector<size_t> writers;
+        for (size_t i {0}; i < m_passes.size(); i++) {
+            if (!m_passes[i].culled && std::ranges::find(m_passes[i].writes, handle) != m_passes[i].writes.end()) {
+                writers.push_back(i);
+            }
+        }
+        for (size_t i {1}; i < writers.size(); i++) {
+            edges[writers[i - 1]].push_back(writers[i]);
+        }
+        if (writers.empty()) {
+            continue;
+        }
+        for (size_t i {0}; i < m_passes.size(); i++) {
+            const Pass& pass {m_passes[i]};
+            bool reads {std::ranges::find(pass.reads, handle) != pass.reads.end()};
+            bool writes {std::ranges::find(pass.writes, handle) != pass.writes.end()};
+            if (!pass.culled && reads && !writes) {
+                edges[writers.back()].push_back(i);
+            }
+        }
+    }
+    for (const std::vector<size_t>& targets : edges) {
+        for (size_t target : targets) {
+            incoming[target]++;
+        }
+    }
+    // ties go to the earlier declared pass so the order is stable
+    std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> ready;
+    for (size_t i {0}; i < m_passes.size(); i++) {
+        if (!m_passes[i].culled && incoming[i] == 0) {
+            ready.push(i);
+        }
+    }
+    m_order.clear();
+    while (!ready.empty()) {
+        size_t pass {ready.top()};
+        ready.pop();
+        m_order.push_back(pass);
+        for (size_t target : edges[pass]) {
+            if (--incoming[target] == 0) {
+                ready.push(target);
+            }
+        }
+    }
+    if (m_order.size() != m_passes.size() - m_stats.culledPasses) {
+        std::cout << "Render graph has a cycle between its passes.\n";
+        m_order.clear();
+        return std::unexpected(GRAPH_ERROR::cycle);
+    }
+    return {};
+}
+
+void RenderGraph::_assignSlots() {
+    for (Resource& resource : m_resources) {
+        resource.used = false;
+    }
+    for (size_t step {0}; step < m_order.size(); step++) {
+        const Pass& pass {m_passes[m_order[step]]};
+        for (const std::vector<ResourceHandle>* handles : {&pass.reads, &pass.writes}) {
+            for (ResourceHandle handle : *handles) {
+                Resource& resource {m_resources[handle]};
+                if (!resource.used) {
+                    resource.used = true;
+                    resource.firstUse = step;
+                }
+                resource.lastUse = step;
+            }
+        }
+    }
+
+    // outputs are read after the graph has run, so nothing may reuse them
+    for (Resource& resource : m_resources) {
+        if (resource.used && resource.output && !m_order.empty()) {
+            resource.lastUse = m_order.size() - 1;
+        }
+    }
+
+    // hand each transient a slot at its first use and give the slot back
+    // after its last, so later transients of the same size reuse it
+    m_slots.clear();
+    std::vector<bool> slotFree;
+    size_t liveBytes {0};
+    for (size_t step {0}; step < m_order.size(); step++) {
+        for (Resource& resource : m_resources) {
+            if (!resource.used || resource.imported || resource.firstUse != step) {
+                continue;
+            }
+            m_stats.transientResources++;
+            m_stats.unaliasedTransientBytes += resource.desc.bytes();
+            liveBytes += resource.desc.bytes();
+            size_t free {m_slots.size()};
+            for (size_t slot {0}; slot < m_slots.size() && free == m_slots.size(); slot++) {
+                if (slotFree[slot] && m_slots[slot].desc == resource.desc) {
+                    free = slot;
+                }
+            }
+            if (free < m_slots.size()) {
+                resource.slot = free;
+            }
+            else {
+                resource.slot = m_slots.size();
+                m_slots.push_back({resource.desc, 0});
+                slotFree.push_back(false);
+            }
+            slotFree[resource.slot] = false;
+        }
+        m_stats.peakTransientBytes = std::max(m_stats.peakTransientBytes, liveBytes);
+        for (const Resource& resource : m_resources) {
+            if (resource.used && !resource.imported && resource.lastUse == step) {
+                slotFree[resource.slot] = true;
+                liveBytes -= resource.desc.bytes();
+            }
+        }
+    }
+    m_stats.physicalTextures = m_slots.size();
+}
+
+auto RenderGraph::_framebufferFor(const Pass& pass) -> GLuint {
+    std::vector<GLuint> colors;
+    GLuint depth {0};
+    for (ResourceHandle handle : pass.writes) {
+        const Resource& resource {m_resources[handle]};
+        if (resource.isFramebuffer) {
+            // drawn straight into the imported target, the pass's only write
+            return resource.framebuffer;
+        }
+        GLuint texture {resource.imported ? resource.texture : m_slots[resource.slot].texture};
+        if (resource.desc.isDepth()) {
+            depth = texture;
+        }
+        else {
+            colors.push_back(texture);
+        }
+    }
+    if (colors.empty() && depth == 0) {
+        return 0;
+    }
+    std::vector<GLuint> key {colors};
+    key.push_back(depth);
+    auto cached {m_framebuffers.find(key)};
+    if (cached != m_framebuffers.end()) {
+        return cached->second;
+    }
+
+    GLuint fbo {0};
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    std::vector<GLenum> drawBuffers;
+    for (size_t i {0}; i < colors.size(); i++) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colors[i], 0);
+        drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+    }
+    if (depth != 0) {
+        bool stencil {false};
+        for (ResourceHandle handle : pass.writes) {
+            stencil = stencil || m_resources[handle].desc.internalFormat == GL_DEPTH24_STENCIL8;
+        }
+        glFramebufferTexture2D(GL_FRAMEBUFFER,
+                               stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT,
+                               GL_TEXTURE_2D, depth, 0);
+    }
+    if (drawBuffers.empty()) {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+    else {
+        glDrawBuffers(drawBuffers.size(), drawBuffers.data());
+    }
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "Render graph pass " << pass.name << " has an incomplete framebuffer.\n";
+    }
+    m_framebuffers[key] = fbo;
+    return fbo;
+}
+
+void RenderGraph::_deleteFramebuffers() {
+    for (auto& [key, fbo] : m_framebuffers) {
+        glDeleteFramebuffers(1, &fbo);
+    }
+    m_framebuffers.clear();
+}
+
+}
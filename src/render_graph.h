@@ -0,0 +1,227 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace sjd {
+
+struct TextureDesc {
+    uint32_t width {0};
+    uint32_t height {0};
+    GLenum internalFormat {GL_RGBA8};
+
+    auto bytes() const -> size_t;
+    auto isDepth() const -> bool;
+    auto operator==(const TextureDesc&) const -> bool = default;
+};
+
+// Owns GL textures and hands them out by description. Textures released
+// this frame are reused by later requests for the same description, and
+// ones left idle for a few frames are freed.
+class TexturePool {
+public:
+    TexturePool() = default;
+    ~TexturePool();
+
+    TexturePool(const TexturePool&) = delete;
+    TexturePool& operator=(const TexturePool&) = delete;
+
+    auto acquire(const TextureDesc& desc) -> GLuint;
+    void release(GLuint texture);
+    // frees textures that have not been acquired for maxIdleFrames calls
+    void endFrame(uint32_t maxIdleFrames = 3);
+
+    auto textureCount() const -> size_t { return m_entries.size(); }
+    auto allocatedBytes() const -> size_t;
+    // textures created since the pool was made, to spot churn
+    auto allocations() const -> const size_t& { return m_allocations; }
+    // changes whenever a texture is freed, so holders of framebuffers
+    // built on pooled textures know to rebuild them
+    auto generation() const -> const size_t& { return m_generation; }
+
+private:
+    struct Entry {
+        TextureDesc desc {};
+        GLuint texture {0};
+        bool inUse {false};
+        uint32_t idleFrames {0};
+    };
+
+    std::vector<Entry> m_entries;
+    size_t m_allocations {0};
+    size_t m_generation {0};
+};
+
+enum class GRAPH_ERROR {
+    cycle,
+    readBeforeWrite,
+    badHandle,
+    // a pass writes an imported framebuffer and other targets too
+    mixedTargets
+};
+
+using ResourceHandle = uint32_t;
+
+struct GraphStats {
+    size_t passes {0};
+    size_t culledPasses {0};
+    size_t transientResources {0};
+    // textures actually allocated once transients share memory
+    size_t physicalTextures {0};
+    // the most transient memory live during any one pass; the allocations
+    // can add up to more when formats keep transients from sharing
+    size_t peakTransientBytes {0};
+    // what the transients would take without aliasing
+    size_t unaliasedTransientBytes {0};
+};
+
+class RenderGraph;
+
+// what a pass's execute callback sees of the graph
+class PassContext {
+public:
+    auto texture(ResourceHandle handle) const -> GLuint;
+    auto framebuffer() const -> const GLuint& { return m_framebuffer; }
+    auto width() const -> const uint32_t& { return m_width; }
+    auto height() const -> const uint32_t& { return m_height; }
+
+private:
+    friend class RenderGraph;
+    PassContext(const RenderGraph& graph) : m_graph {graph} {}
+
+    const RenderGraph& m_graph;
+    GLuint m_framebuffer {0};
+    uint32_t m_width {0};
+    uint32_t m_height {0};
+};
+
+using PassCallback = std::function<void(const PassContext&)>;
+
+// A frame described as passes that declare what they read and write.
+//
+// compile() needs no GL context: it culls every pass that contributes
+// nothing to an output, orders the rest so each reader runs after all of
+// the writers of what it reads, works out how long each transient texture
+// lives, and lets transients whose lifetimes don't overlap share memory.
+// execute() then binds a framebuffer built from each pass's outputs and
+// runs the passes in that order.
+//
+// A resource written by several passes is built up in declaration order,
+// e.g. an opaque pass followed by a transparent pass onto the same target.
+class RenderGraph {
+public:
+    class PassBuilder {
+    public:
+        auto read(ResourceHandle handle) -> PassBuilder&;
+        auto write(ResourceHandle handle) -> PassBuilder&;
+        // never culled, e.g. a pass that only updates a persistent buffer
+        auto sideEffect() -> PassBuilder&;
+        auto execute(PassCallback callback) -> PassBuilder&;
+
+    private:
+        friend class RenderGraph;
+        PassBuilder(RenderGraph& graph, size_t pass) : m_graph {graph}, m_pass {pass} {}
+
+        RenderGraph& m_graph;
+        size_t m_pass;
+    };
+
+    RenderGraph() = default;
+    ~RenderGraph();
+
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    // a texture that only lives within the frame, allocated from the pool
+    auto createTexture(const std::string& name, const TextureDesc& desc) -> ResourceHandle;
+    // a texture owned elsewhere that the graph must not alias
+    auto importTexture(const std::string& name, GLuint texture, const TextureDesc& desc) -> ResourceHandle;
+    // a render target owned elsewhere, e.g. the window or headless target;
+    // a pass writing one is drawn straight into it, so it may write nothing
+    // else
+    auto importFramebuffer(const std::string& name,
+                           GLuint framebuffer,
+                           uint32_t width,
+                           uint32_t height) -> ResourceHandle;
+
+    auto addPass(const std::string& name) -> PassBuilder;
+
+    // passes writing an imported resource count as outputs already
+    void markOutput(ResourceHandle handle);
+
+    auto compile() -> std::expected<GraphStats, GRAPH_ERROR>;
+    // compiles first if the graph changed since the last compile
+    auto execute(TexturePool& pool) -> std::expected<GraphStats, GRAPH_ERROR>;
+
+    // drops every pass and resource but keeps cached framebuffers
+    void clear();
+
+    auto stats() const -> const GraphStats& { return m_stats; }
+    // pass names in execution order after compile()
+    auto executionOrder() const -> std::vector<std::string>;
+    auto isCulled(const std::string& passName) const -> bool;
+    // the GL texture behind a resource during or after execute(); a
+    // transient output stays valid until the pool hands it out again
+    auto texture(ResourceHandle handle) const -> GLuint;
+    // index of the shared texture slot a transient was assigned
+    auto physicalSlot(ResourceHandle handle) const -> size_t;
+
+    void printReport(std::ostream& out) const;
+
+private:
+    struct Resource {
+        std::string name;
+        TextureDesc desc {};
+        bool imported {false};
+        GLuint texture {0};
+        GLuint framebuffer {0};
+        bool isFramebuffer {false};
+        bool output {false};
+        // filled in by compile()
+        size_t firstUse {0};
+        size_t lastUse {0};
+        size_t slot {0};
+        bool used {false};
+    };
+
+    struct Pass {
+        std::string name;
+        std::vector<ResourceHandle> reads;
+        std::vector<ResourceHandle> writes;
+        bool sideEffect {false};
+        PassCallback callback {};
+        bool culled {false};
+    };
+
+    struct Slot {
+        TextureDesc desc {};
+        GLuint texture {0};
+    };
+
+    auto _validHandle(ResourceHandle handle) const -> bool;
+    void _cull();
+    auto _sort() -> std::expected<void, GRAPH_ERROR>;
+    void _assignSlots();
+    auto _framebufferFor(const Pass& pass) -> GLuint;
+    void _deleteFramebuffers();
+
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+    std::vector<size_t> m_order;
+    std::vector<Slot> m_slots;
+    std::map<std::vector<GLuint>, GLuint> m_framebuffers;
+    size_t m_poolGeneration {0};
+    GraphStats m_stats {};
+    bool m_compiled {false};
+};
+
+}
+#endif
@@ -0,0 +1,1358 @@
+#include <scene_io.h>
+#include <profiler.h>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <optional>
+#include <string_view>
+
+namespace sjd {
+
+namespace {
+
+const char BINARY_MAGIC[8] {'M', 'A', 'G', 'E', 'S', 'C', 'N', '\0'};
+const uint32_t BINARY_VERSION {1};
+const size_t BINARY_HEADER_BYTES {sizeof(BINARY_MAGIC) + sizeof(uint32_t)};
+// the kind byte and payload size in front of every binary record
+const size_t RECORD_HEADER_BYTES {1 + sizeof(uint32_t)};
+// output is handed to the stream in writes of about this size
+const size_t FLUSH_BYTES {1 << 20};
+// objects formatted per task by SceneWriter::writeObjects()
+const size_t OBJECT_BATCH {1024};
+
+// also the binary record kinds; end closes a binary scene
+enum class PRIM_KIND : uint8_t {
+    end = 0,
+    mesh = 1,
+    material = 2,
+    object = 3
+};
+
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float) && sizeof(glm::vec2) == 2 * sizeof(float),
+              "binary scenes copy attribute arrays as packed floats");
+
+const char USDA_HEADER[] {
+    "#usda 1.0\n"
+    "(\n"
+    "    defaultPrim = \"World\"\n"
+    "    metersPerUnit = 1\n"
+    "    upAxis = \"Y\"\n"
+    ")\n"
+    "\n"
+};
+
+// ---- writing
+
+void appendNumber(std::string& out, float value) {
+    char text[32];
+    // shortest text that reads back as the same float
+    std::to_chars_result result {std::to_chars(text, text + sizeof(text), value)};
+    out.append(text, result.ptr);
+}
+
+void appendNumber(std::string& out, uint32_t value) {
+    char text[16];
+    std::to_chars_result result {std::to_chars(text, text + sizeof(text), value)};
+    out.append(text, result.ptr);
+}
+
+void appendTuple(std::string& out, const float* values, size_t width) {
+    out += '(';
+    for (size_t i {0}; i < width; i++) {
+        if (i > 0) {
+            out += ", ";
+        }
+        appendNumber(out, values[i]);
+    }
+    out += ')';
+}
+
+// count tuples of width floats
+void appendTupleArray(std::string& out, const float* values, size_t count, size_t width) {
+    out += '[';
+    for (size_t i {0}; i < count; i++) {
+        if (i > 0) {
+            out += ", ";
+        }
+        appendTuple(out, values + i * width, width);
+    }
+    out += ']';
+}
+
+void appendUsdaMesh(std::string& out, const SceneMesh& mesh) {
+    const MeshData& data {mesh.data};
+    out += "    def Mesh \"";
+    out += mesh.name;
+    out += "\"\n    {\n";
+    AABB box {data.bounds()};
+    if (!box.isEmpty()) {
+        out += "        float3[] extent = [";
+        appendTuple(out, &box.min.x, 3);
+        out += ", ";
+        appendTuple(out, &box.max.x, 3);
+        out += "]\n";
+    }
+    out += "        int[] faceVertexCounts = [";
+    for (size_t i {0}; i < data.triangleCount(); i++) {
+        out += i > 0 ? ", 3" : "3";
+    }
+    out += "]\n        int[] faceVertexIndices = [";
+    for (size_t i {0}; i < data.indices.size(); i++) {
+        if (i > 0) {
+            out += ", ";
+        }
+        appendNumber(out, data.indices[i]);
+    }
+    out += "]\n";
+    if (!data.normals.empty()) {
+        out += "        normal3f[] normals = ";
+        appendTupleArray(out, &data.normals[0].x, data.normals.size(), 3);
+        out += " (\n            interpolation = \"vertex\"\n        )\n";
+    }
+    out += "        point3f[] points = ";
+    appendTupleArray(out, data.positions.empty() ? nullptr : &data.positions[0].x, data.positions.size(), 3);
+    out += '\n';
+    if (!data.texCoords.empty()) {
+        out += "        texCoord2f[] primvars:st = ";
+        appendTupleArray(out, &data.texCoords[0].x, data.texCoords.size(), 2);
+        out += " (\n            interpolation = \"vertex\"\n        )\n";
+    }
+    out += "        uniform token subdivisionScheme = \"none\"\n    }\n";
+}
+
+void appendUsdaColor(std::string& out, const char* name, const glm::vec3& color) {
+    out += "        custom color3f mage:";
+    out += name;
+    out += " = ";
+    appendTuple(out, &color.x, 3);
+    out += '\n';
+}
+
+void appendUsdaMaterial(std::string& out, const SceneMaterial& material) {
+    out += "    def Material \"";
+    out += material.name;
+    out += "\"\n    {\n";
+    appendUsdaColor(out, "ambient", material.material.m_ambient);
+    appendUsdaColor(out, "diffuse", material.material.m_diffuse);
+    appendUsdaColor(out, "specular", material.material.m_specular);
+    out += "        custom float mage:shininess = ";
+    appendNumber(out, material.material.m_shininess);
+    out += "\n    }\n";
+}
+
+void appendUsdaObject(std::string& out,
+                      const SceneObject& object,
+                      const std::string& meshName,
+                      const std::string* materialName) {
+    out += "    def \"";
+    out += object.name;
+    out += "\" (\n";
+    if (materialName != nullptr) {
+        out += "        prepend apiSchemas = [\"MaterialBindingAPI\"]\n";
+    }
+    out += "        instanceable = true\n        prepend references = </Prototypes/";
+    out += meshName;
+    out += ">\n    )\n    {\n";
+    if (materialName != nullptr) {
+        out += "        rel material:binding = </Materials/";
+        out += *materialName;
+        out += ">\n";
+    }
+    const Transform& transform {object.transform};
+    out += "        double3 xformOp:translate = ";
+    appendTuple(out, &transform.position.x, 3);
+    // USD quaternions are real part first
+    float orient[4] {transform.rotation.w, transform.rotation.x, transform.rotation.y, transform.rotation.z};
+    out += "\n        quatf xformOp:orient = ";
+    appendTuple(out, orient, 4);
+    out += "\n        float3 xformOp:scale = ";
+    appendTuple(out, &transform.scale.x, 3);
+    out += "\n        uniform token[] xformOpOrder = "
+           "[\"xformOp:translate\", \"xformOp:orient\", \"xformOp:scale\"]\n    }\n";
+}
+
+void appendBytes(std::string& out, const void* data, size_t bytes) {
+    out.append(static_cast<const char*>(data), bytes);
+}
+
+template <typename T>
+void appendValue(std::string& out, const T& value) {
+    appendBytes(out, &value, sizeof(T));
+}
+
+void appendName(std::string& out, const std::string& name) {
+    appendValue(out, static_cast<uint32_t>(name.size()));
+    appendBytes(out, name.data(), name.size());
+}
+
+// returns where the payload size goes once the payload is written
+auto beginRecord(std::string& out, PRIM_KIND kind) -> size_t {
+    appendValue(out, static_cast<uint8_t>(kind));
+    appendValue(out, uint32_t {0});
+    return out.size() - sizeof(uint32_t);
+}
+
+void endRecord(std::string& out, size_t sizeOffset) {
+    uint32_t payload {static_cast<uint32_t>(out.size() - sizeOffset - sizeof(uint32_t))};
+    std::memcpy(&out[sizeOffset], &payload, sizeof(payload));
+}
+
+void appendBinaryMesh(std::string& out, const SceneMesh& mesh) {
+    const MeshData& data {mesh.data};
+    size_t record {beginRecord(out, PRIM_KIND::mesh)};
+    appendName(out, mesh.name);
+    appendValue(out, static_cast<uint32_t>(data.positions.size()));
+    appendValue(out, static_cast<uint32_t>(data.indices.size()));
+    appendValue(out, static_cast<uint8_t>(!data.normals.empty()));
+    appendValue(out, static_cast<uint8_t>(!data.texCoords.empty()));
+    appendBytes(out, data.positions.data(), data.positions.size() * sizeof(glm::vec3));
+    appendBytes(out, data.normals.data(), data.normals.size() * sizeof(glm::vec3));
+    appendBytes(out, data.texCoords.data(), data.texCoords.size() * sizeof(glm::vec2));
+    appendBytes(out, data.indices.data(), data.indices.size() * sizeof(uint32_t));
+    endRecord(out, record);
+}
+
+void appendBinaryMaterial(std::string& out, const SceneMaterial& material) {
+    size_t record {beginRecord(out, PRIM_KIND::material)};
+    appendName(out, material.name);
+    appendValue(out, material.material.m_ambient);
+    appendValue(out, material.material.m_diffuse);
+    appendValue(out, material.material.m_specular);
+    appendValue(out, material.material.m_shininess);
+    endRecord(out, record);
+}
+
+void appendBinaryObject(std::string& out, const SceneObject& object) {
+    size_t record {beginRecord(out, PRIM_KIND::object)};
+    appendName(out, object.name);
+    appendValue(out, object.mesh);
+    appendValue(out, object.material);
+    const Transform& transform {object.transform};
+    appendValue(out, transform.position);
+    float orient[4] {transform.rotation.w, transform.rotation.x, transform.rotation.y, transform.rotation.z};
+    appendValue(out, orient);
+    appendValue(out, transform.scale);
+    endRecord(out, record);
+}
+
+// ---- reading
+
+// a prim's bytes in the read buffer: USDA text from def to its closing
+// brace, or a binary record's payload
+struct PrimRange {
+    PRIM_KIND kind;
+    size_t begin;
+    size_t end;
+};
+
+struct ParsedPrim {
+    PRIM_KIND kind {PRIM_KIND::end};
+    std::optional<SCENE_ERROR> error;
+    SceneMesh mesh;
+    SceneMaterial material;
+    SceneObject object;
+    // USDA objects name their mesh and material; binary ones index them
+    std::string meshName;
+    std::string materialName;
+};
+
+// the last component of a prim path
+auto primNameOf(std::string_view path) -> std::string {
+    size_t slash {path.rfind('/')};
+    return std::string {slash == std::string_view::npos ? path : path.substr(slash + 1)};
+}
+
+// Reads the small part of USDA the scene prims are made of, and skips over
+// any other attribute or metadata without understanding it.
+class UsdaCursor {
+public:
+    UsdaCursor(std::string_view text) : m_text {text} {}
+
+    auto atEnd() const -> bool { return m_pos >= m_text.size(); }
+    auto peek() const -> char { return atEnd() ? '\0' : m_text[m_pos]; }
+
+    // whitespace, newlines and comments
+    void skipSpace() {
+        while (!atEnd()) {
+            char c {m_text[m_pos]};
+            if (c == '#') {
+                size_t newline {m_text.find('\n', m_pos)};
+                m_pos = newline == std::string_view::npos ? m_text.size() : newline;
+            }
+            else if (std::isspace(static_cast<unsigned char>(c))) {
+                m_pos++;
+            }
+            else {
+                return;
+            }
+        }
+    }
+
+    // whitespace within a line
+    void skipBlanks() {
+        while (!atEnd() && (m_text[m_pos] == ' ' || m_text[m_pos] == '\t' || m_text[m_pos] == '\r')) {
+            m_pos++;
+        }
+    }
+
+    auto consume(char c) -> bool {
+        skipSpace();
+        if (peek() != c) {
+            return false;
+        }
+        m_pos++;
+        return true;
+    }
+
+    // a keyword, type or namespaced attribute name, with a trailing [] kept
+    auto token() -> std::string_view {
+        skipBlanks();
+        size_t begin {m_pos};
+        while (!atEnd()) {
+            char c {m_text[m_pos]};
+            if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_' && c != ':' && c != '.') {
+                break;
+            }
+            m_pos++;
+        }
+        if (m_pos > begin && m_text.substr(m_pos, 2) == "[]") {
+            m_pos += 2;
+        }
+        return m_text.substr(begin, m_pos - begin);
+    }
+
+    auto quoted(std::string_view& value) -> bool {
+        return _delimited('"', '"', value);
+    }
+
+    auto path(std::string_view& value) -> bool {
+        return _delimited('<', '>', value);
+    }
+
+    template <typename T>
+    auto number(T& value) -> bool {
+        skipSpace();
+        const char* begin {m_text.data() + m_pos};
+        std::from_chars_result result {std::from_chars(begin, m_text.data() + m_text.size(), value)};
+        if (result.ec != std::errc {}) {
+            return false;
+        }
+        m_pos += static_cast<size_t>(result.ptr - begin);
+        return true;
+    }
+
+    auto tuple(float* values, size_t width) -> bool {
+        if (!consume('(')) {
+            return false;
+        }
+        for (size_t i {0}; i < width; i++) {
+            if ((i > 0 && !consume(',')) || !number(values[i])) {
+                return false;
+            }
+        }
+        return consume(')');
+    }
+
+    // calls item() for every element of a [a, b, ...] list
+    template <typename ITEM>
+    auto array(ITEM&& item) -> bool {
+        if (!consume('[')) {
+            return false;
+        }
+        if (consume(']')) {
+            return true;
+        }
+        while (true) {
+            if (!item()) {
+                return false;
+            }
+            if (consume(']')) {
+                return true;
+            }
+            if (!consume(',')) {
+                return false;
+            }
+        }
+    }
+
+    // a value of any type, ignored
+    auto skipValue() -> bool {
+        skipSpace();
+        std::string_view ignored {};
+        switch (peek()) {
+        case '"':
+            return quoted(ignored);
+        case '<':
+            return path(ignored);
+        case '[':
+            return skipBalanced('[', ']');
+        case '(':
+            return skipBalanced('(', ')');
+        case '{':
+            return skipBalanced('{', '}');
+        default: {
+            size_t begin {m_pos};
+            while (!atEnd() && !std::isspace(static_cast<unsigned char>(m_text[m_pos]))
+                   && std::strchr(",)]}", m_text[m_pos]) == nullptr) {
+                m_pos++;
+            }
+            return m_pos > begin;
+        }
+        }
+    }
+
+    // from an open bracket to the one that closes it, skipping strings
+    auto skipBalanced(char open, char close) -> bool {
+        if (peek() != open) {
+            return false;
+        }
+        size_t depth {0};
+        while (!atEnd()) {
+            char c {m_text[m_pos]};
+            if (c == '"') {
+                std::string_view ignored {};
+                if (!quoted(ignored)) {
+                    return false;
+                }
+                continue;
+            }
+            m_pos++;
+            if (c == open) {
+                depth++;
+            }
+            else if (c == close && --depth == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    auto _delimited(char open, char close, std::string_view& value) -> bool {
+        if (!consume(open)) {
+            return false;
+        }
+        size_t begin {m_pos};
+        while (!atEnd() && m_text[m_pos] != close) {
+            // escapes only matter for finding the end
+            m_pos += m_text[m_pos] == '\\' ? 2 : 1;
+        }
+        if (atEnd()) {
+            return false;
+        }
+        value = m_text.substr(begin, m_pos - begin);
+        m_pos++;
+        return true;
+    }
+
+    std::string_view m_text;
+    size_t m_pos {0};
+};
+
+auto parseVec3Array(UsdaCursor& cursor, std::vector<glm::vec3>& values) -> bool {
+    return cursor.array([&] {
+        float value[3];
+        if (!cursor.tuple(value, 3)) {
+            return false;
+        }
+        values.push_back(glm::vec3(value[0], value[1], value[2]));
+        return true;
+    });
+}
+
+auto parseVec3(UsdaCursor& cursor, glm::vec3& value) -> bool {
+    float values[3];
+    if (!cursor.tuple(values, 3)) {
+        return false;
+    }
+    value = glm::vec3(values[0], values[1], values[2]);
+    return true;
+}
+
+// the mesh's own attribute; false only when a value is malformed
+auto parseMeshAttribute(UsdaCursor& cursor,
+                        std::string_view name,
+                        MeshData& data,
+                        std::vector<uint32_t>& faceCounts) -> bool {
+    if (name == "points") {
+        return parseVec3Array(cursor, data.positions);
+    }
+    if (name == "normals") {
+        return parseVec3Array(cursor, data.normals);
+    }
+    if (name == "primvars:st") {
+        return cursor.array([&] {
+            float value[2];
+            if (!cursor.tuple(value, 2)) {
+                return false;
+            }
+            data.texCoords.push_back(glm::vec2(value[0], value[1]));
+            return true;
+        });
+    }
+    if (name == "faceVertexIndices" || name == "faceVertexCounts") {
+        std::vector<uint32_t>& values {name == "faceVertexIndices" ? data.indices : faceCounts};
+        return cursor.array([&] {
+            uint32_t value {0};
+            if (!cursor.number(value)) {
+                return false;
+            }
+            values.push_back(value);
+            return true;
+        });
+    }
+    return cursor.skipValue();
+}
+
+auto parseMaterialAttribute(UsdaCursor& cursor, std::string_view name, Material& material) -> bool {
+    if (name == "mage:ambient") {
+        return parseVec3(cursor, material.m_ambient);
+    }
+    if (name == "mage:diffuse") {
+        return parseVec3(cursor, material.m_diffuse);
+    }
+    if (name == "mage:specular") {
+        return parseVec3(cursor, material.m_specular);
+    }
+    if (name == "mage:shininess") {
+        return cursor.number(material.m_shininess);
+    }
+    return cursor.skipValue();
+}
+
+auto parseObjectAttribute(UsdaCursor& cursor, std::string_view name, ParsedPrim& prim) -> bool {
+    Transform& transform {prim.object.transform};
+    if (name == "material:binding") {
+        std::string_view path {};
+        if (!cursor.path(path)) {
+            return false;
+        }
+        prim.materialName = primNameOf(path);
+        return true;
+    }
+    if (name == "xformOp:translate") {
+        return parseVec3(cursor, transform.position);
+    }
+    if (name == "xformOp:orient") {
+        float orient[4];
+        if (!cursor.tuple(orient, 4)) {
+            return false;
+        }
+        transform.rotation = glm::quat(orient[0], orient[1], orient[2], orient[3]);
+        return true;
+    }
+    if (name == "xformOp:scale") {
+        return parseVec3(cursor, transform.scale);
+    }
+    return cursor.skipValue();
+}
+
+// polygons are split into fans; attributes must be per vertex
+auto finishMesh(MeshData& data, const std::vector<uint32_t>& faceCounts) -> bool {
+    bool triangles {std::all_of(faceCounts.begin(), faceCounts.end(), [](uint32_t count) { return count == 3; })};
+    if (!triangles) {
+        std::vector<uint32_t> polygons {std::move(data.indices)};
+        data.indices.clear();
+        size_t first {0};
+        for (uint32_t count : faceCounts) {
+            if (count < 3 || first + count > polygons.size()) {
+                return false;
+            }
+            for (uint32_t corner {1}; corner + 1 < count; corner++) {
+                data.indices.insert(data.indices.end(),
+                                    {polygons[first], polygons[first + corner], polygons[first + corner + 1]});
+            }
+            first += count;
+        }
+    }
+    if (data.indices.size() % 3 != 0
+        || (!data.normals.empty() && data.normals.size() != data.positions.size())
+        || (!data.texCoords.empty() && data.texCoords.size() != data.positions.size())) {
+        return false;
+    }
+    return std::all_of(data.indices.begin(), data.indices.end(),
+                       [&](uint32_t index) { return index < data.positions.size(); });
+}
+
+// one def, from the keyword to its closing brace
+auto parseUsdaPrim(std::string_view text, ParsedPrim& prim) -> bool {
+    UsdaCursor cursor {text};
+    cursor.skipSpace();
+    if (cursor.token() != "def") {
+        return false;
+    }
+    cursor.skipSpace();
+    std::string_view type {};
+    if (cursor.peek() != '"') {
+        type = cursor.token();
+    }
+    std::string_view name {};
+    if (!cursor.quoted(name)) {
+        return false;
+    }
+    if ((prim.kind == PRIM_KIND::mesh && type != "Mesh")
+        || (prim.kind == PRIM_KIND::material && type != "Material")) {
+        return false;
+    }
+    std::string& primName {prim.kind == PRIM_KIND::mesh       ? prim.mesh.name
+                           : prim.kind == PRIM_KIND::material ? prim.material.name
+                                                              : prim.object.name};
+    primName.assign(name);
+
+    // prim metadata, where objects reference their mesh
+    if (cursor.consume('(')) {
+        while (!cursor.consume(')')) {
+            std::string_view key {};
+            while (cursor.peek() != '=') {
+                key = cursor.token();
+                if (key.empty()) {
+                    return false;
+                }
+                cursor.skipSpace();
+            }
+            if (!cursor.consume('=')) {
+                return false;
+            }
+            cursor.skipSpace();
+            if (key == "references") {
+                std::string_view path {};
+                bool parsed {cursor.peek() == '[' ? cursor.array([&] {
+                    std::string_view item {};
+                    if (!cursor.path(item)) {
+                        return false;
+                    }
+                    path = path.empty() ? item : path;
+                    return true;
+                }) : cursor.path(path)};
+                if (!parsed) {
+                    return false;
+                }
+                prim.meshName = primNameOf(path);
+            }
+            else if (!cursor.skipValue()) {
+                return false;
+            }
+        }
+    }
+    if (!cursor.consume('{')) {
+        return false;
+    }
+
+    std::vector<uint32_t> faceCounts {};
+    while (!cursor.consume('}')) {
+        if (cursor.atEnd()) {
+            return false;
+        }
+        std::string_view first {cursor.token()};
+        if (first.empty()) {
+            return false;
+        }
+        // child prims aren't part of the scene
+        if (first == "def" || first == "over" || first == "class") {
+            while (!cursor.atEnd() && cursor.peek() != '{') {
+                if (!cursor.skipValue()) {
+                    return false;
+                }
+                cursor.skipSpace();
+            }
+            if (!cursor.skipBalanced('{', '}')) {
+                return false;
+            }
+            continue;
+        }
+        // qualifiers and a type, then the attribute's name, then maybe a value
+        std::string_view attribute {first};
+        while (true) {
+            cursor.skipBlanks();
+            char c {cursor.peek()};
+            if (c == '=' || c == '(' || c == '\n' || c == '\0') {
+                break;
+            }
+            attribute = cursor.token();
+            if (attribute.empty()) {
+                return false;
+            }
+        }
+        if (cursor.peek() == '=') {
+            cursor.consume('=');
+            bool parsed {false};
+            switch (prim.kind) {
+            case PRIM_KIND::mesh:
+                parsed = parseMeshAttribute(cursor, attribute, prim.mesh.data, faceCounts);
+                break;
+            case PRIM_KIND::material:
+                parsed = parseMaterialAttribute(cursor, attribute, prim.material.material);
+                break;
+            default:
+                parsed = parseObjectAttribute(cursor, attribute, prim);
+                break;
+            }
+            if (!parsed) {
+                return false;
+            }
+        }
+        // attribute metadata, such as interpolation
+        cursor.skipBlanks();
+        if (cursor.peek() == '(' && !cursor.skipBalanced('(', ')')) {
+            return false;
+        }
+    }
+    if (prim.kind == PRIM_KIND::mesh) {
+        return finishMesh(prim.mesh.data, faceCounts);
+    }
+    return prim.kind != PRIM_KIND::object || !prim.meshName.empty();
+}
+
+// Bounds checked reads from one binary record.
+class RecordReader {
+public:
+    RecordReader(std::string_view bytes) : m_bytes {bytes} {}
+
+    auto remaining() const -> size_t { return m_bytes.size() - m_pos; }
+
+    auto bytes(void* data, size_t count) -> bool {
+        if (count > remaining()) {
+            return false;
+        }
+        std::memcpy(data, m_bytes.data() + m_pos, count);
+        m_pos += count;
+        return true;
+    }
+
+    template <typename T>
+    auto value(T& data) -> bool {
+        return bytes(&data, sizeof(T));
+    }
+
+    template <typename T>
+    auto array(std::vector<T>& data, size_t count) -> bool {
+        if (count > remaining() / sizeof(T)) {
+            return false;
+        }
+        data.resize(count);
+        return bytes(data.data(), count * sizeof(T));
+    }
+
+    auto name(std::string& data) -> bool {
+        uint32_t size {0};
+        if (!value(size) || size > remaining()) {
+            return false;
+        }
+        data.assign(m_bytes.data() + m_pos, size);
+        m_pos += size;
+        return true;
+    }
+
+private:
+    std::string_view m_bytes;
+    size_t m_pos {0};
+};
+
+auto parseBinaryPrim(std::string_view payload, ParsedPrim& prim) -> bool {
+    RecordReader reader {payload};
+    switch (prim.kind) {
+    case PRIM_KIND::mesh: {
+        MeshData& data {prim.mesh.data};
+        uint32_t vertices {0};
+        uint32_t indices {0};
+        uint8_t hasNormals {0};
+        uint8_t hasTexCoords {0};
+        return reader.name(prim.mesh.name) && reader.value(vertices) && reader.value(indices)
+            && reader.value(hasNormals) && reader.value(hasTexCoords)
+            && reader.array(data.positions, vertices)
+            && reader.array(data.normals, hasNormals ? vertices : 0)
+            && reader.array(data.texCoords, hasTexCoords ? vertices : 0)
+            && reader.array(data.indices, indices)
+            && finishMesh(data, {});
+    }
+    case PRIM_KIND::material: {
+        Material& material {prim.material.material};
+        return reader.name(prim.material.name) && reader.value(material.m_ambient)
+            && reader.value(material.m_diffuse) && reader.value(material.m_specular)
+            && reader.value(material.m_shininess);
+    }
+    case PRIM_KIND::object: {
+        Transform& transform {prim.object.transform};
+        float orient[4];
+        if (!reader.name(prim.object.name) || !reader.value(prim.object.mesh)
+            || !reader.value(prim.object.material) || !reader.value(transform.position)
+            || !reader.value(orient) || !reader.value(transform.scale)) {
+            return false;
+        }
+        transform.rotation = glm::quat(orient[0], orient[1], orient[2], orient[3]);
+        return true;
+    }
+    default:
+        return true;
+    }
+}
+
+// where the scan of a USDA chunk left off
+struct UsdaScanState {
+    int depth {0};
+    // kind of the prims in the open scope
+    PRIM_KIND section {PRIM_KIND::end};
+    // the name given by the last def, class or over at the top level,
+    // which is the next scope's; strings in its metadata don't count
+    std::string lastName;
+    bool expectingName {false};
+};
+
+auto sectionOf(const std::string& scope) -> PRIM_KIND {
+    if (scope == "Prototypes") {
+        return PRIM_KIND::mesh;
+    }
+    if (scope == "Materials") {
+        return PRIM_KIND::material;
+    }
+    // prims of any other scope are skipped
+    return scope == "World" ? PRIM_KIND::object : PRIM_KIND::end;
+}
+
+// Finds the complete prims in text, which starts in state. Returns how much
+// of text has been dealt with, leaving state as it was there; the rest is
+// scanned again once more of the file has been read.
+auto scanUsda(std::string_view text,
+              UsdaScanState& state,
+              std::vector<PrimRange>& prims,
+              bool& malformed) -> size_t {
+    UsdaScanState scan {state};
+    size_t consumed {0};
+    bool inPrim {false};
+    size_t primStart {0};
+    size_t pos {0};
+    while (pos < text.size()) {
+        char c {text[pos]};
+        if (scan.depth == 1 && !inPrim && c != '}' && !std::isspace(static_cast<unsigned char>(c))) {
+            inPrim = true;
+            primStart = pos;
+        }
+        if (c == '#') {
+            size_t newline {text.find('\n', pos)};
+            if (newline == std::string_view::npos) {
+                break;
+            }
+            pos = newline + 1;
+            continue;
+        }
+        if (scan.depth == 0 && (std::isalpha(static_cast<unsigned char>(c)) || c == '_')) {
+            size_t end {pos};
+            while (end < text.size() && (std::isalnum(static_cast<unsigned char>(text[end])) || text[end] == '_')) {
+                end++;
+            }
+            if (end >= text.size()) {
+                break;
+            }
+            std::string_view word {text.substr(pos, end - pos)};
+            if (word == "def" || word == "class" || word == "over") {
+                // the type token, if any, is another word; the name follows it
+                scan.expectingName = true;
+            }
+            pos = end;
+            continue;
+        }
+        if (c == '"') {
+            size_t end {pos + 1};
+            while (end < text.size() && text[end] != '"') {
+                end += text[end] == '\\' ? 2 : 1;
+            }
+            if (end >= text.size()) {
+                break;
+            }
+            if (scan.depth == 0 && scan.expectingName) {
+                scan.lastName.assign(text.substr(pos + 1, end - pos - 1));
+                scan.expectingName = false;
+            }
+            pos = end + 1;
+            continue;
+        }
+        if (c == '{') {
+            if (++scan.depth == 1) {
+                scan.section = sectionOf(scan.lastName);
+                scan.lastName.clear();
+                scan.expectingName = false;
+            }
+        }
+        else if (c == '}') {
+            if (scan.depth == 0) {
+                malformed = true;
+                return consumed;
+            }
+            if (--scan.depth == 1 && inPrim) {
+                prims.push_back({scan.section, primStart, pos + 1});
+                inPrim = false;
+                consumed = pos + 1;
+                state = scan;
+            }
+            else if (scan.depth == 0) {
+                scan.section = PRIM_KIND::end;
+                consumed = pos + 1;
+                state = scan;
+            }
+        }
+        pos++;
+    }
+    if (pos == text.size() && !inPrim) {
+        consumed = pos;
+        state = scan;
+    }
+    return consumed;
+}
+
+// Finds the complete records in bytes; ended is set at the end record.
+auto scanBinary(std::string_view bytes, std::vector<PrimRange>& prims, bool& ended) -> size_t {
+    size_t pos {0};
+    while (!ended && pos + RECORD_HEADER_BYTES <= bytes.size()) {
+        uint8_t kind {static_cast<uint8_t>(bytes[pos])};
+        uint32_t payload {0};
+        std::memcpy(&payload, bytes.data() + pos + 1, sizeof(payload));
+        if (kind == static_cast<uint8_t>(PRIM_KIND::end)) {
+            ended = true;
+        }
+        else if (pos + RECORD_HEADER_BYTES + payload > bytes.size()) {
+            break;
+        }
+        // records of kinds added later are skipped
+        PRIM_KIND known {kind <= static_cast<uint8_t>(PRIM_KIND::object) ? static_cast<PRIM_KIND>(kind)
+                                                                          : PRIM_KIND::end};
+        if (!ended && known != PRIM_KIND::end) {
+            prims.push_back({known, pos + RECORD_HEADER_BYTES, pos + RECORD_HEADER_BYTES + payload});
+        }
+        pos += RECORD_HEADER_BYTES + (ended ? 0 : payload);
+    }
+    return pos;
+}
+
+// appends up to count bytes from in; false when the stream failed
+auto readMore(std::istream& in, std::string& buffer, size_t count) -> bool {
+    size_t size {buffer.size()};
+    buffer.resize(size + count);
+    in.read(buffer.data() + size, static_cast<std::streamsize>(count));
+    buffer.resize(size + static_cast<size_t>(in.gcount()));
+    return !in.bad();
+}
+
+auto meshBytes(const MeshData& data) -> uint64_t {
+    return data.positions.capacity() * sizeof(glm::vec3) + data.normals.capacity() * sizeof(glm::vec3)
+         + data.texCoords.capacity() * sizeof(glm::vec2) + data.indices.capacity() * sizeof(uint32_t);
+}
+
+}
+
+auto isValidPrimName(const std::string& name) -> bool {
+    if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) {
+        return false;
+    }
+    return std::all_of(name.begin(), name.end(), [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    });
+}
+
+SceneWriter::SceneWriter(std::ostream& out, SCENE_FORMAT format, WorkerPool* pool)
+:   m_out {out},
+    m_format {format},
+    m_pool {pool}
+{
+    m_buffer.reserve(FLUSH_BYTES + FLUSH_BYTES / 4);
+    if (m_format == SCENE_FORMAT::USDA) {
+        m_buffer += USDA_HEADER;
+    }
+    else {
+        appendBytes(m_buffer, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+        appendValue(m_buffer, BINARY_VERSION);
+    }
+}
+
+SceneWriter::~SceneWriter() {
+    finish();
+}
+
+auto SceneWriter::writeMesh(const SceneMesh& mesh) -> std::expected<uint32_t, SCENE_ERROR> {
+    if (!_enter(SECTION::meshes)) {
+        return std::unexpected(SCENE_ERROR::outOfOrder);
+    }
+    if (!isValidPrimName(mesh.name) || m_meshIndices.contains(mesh.name)) {
+        return std::unexpected(SCENE_ERROR::badName);
+    }
+    // readers take every attribute to have one entry per position
+    const MeshData& data {mesh.data};
+    if ((!data.normals.empty() && data.normals.size() != data.positions.size())
+        || (!data.texCoords.empty() && data.texCoords.size() != data.positions.size())) {
+        return std::unexpected(SCENE_ERROR::badMesh);
+    }
+    if (m_format == SCENE_FORMAT::USDA) {
+        appendUsdaMesh(m_buffer, mesh);
+    }
+    else {
+        appendBinaryMesh(m_buffer, mesh);
+    }
+    uint32_t index {static_cast<uint32_t>(m_meshNames.size())};
+    m_meshNames.push_back(mesh.name);
+    m_meshIndices.emplace(mesh.name, index);
+    m_primCount++;
+    _flush(false);
+    if (!m_out) {
+        return std::unexpected(SCENE_ERROR::badFile);
+    }
+    return index;
+}
+
+auto SceneWriter::writeMaterial(const SceneMaterial& material) -> std::expected<uint32_t, SCENE_ERROR> {
+    if (!_enter(SECTION::materials)) {
+        return std::unexpected(SCENE_ERROR::outOfOrder);
+    }
+    if (!isValidPrimName(material.name) || m_materialIndices.contains(material.name)) {
+        return std::unexpected(SCENE_ERROR::badName);
+    }
+    if (m_format == SCENE_FORMAT::USDA) {
+        appendUsdaMaterial(m_buffer, material);
+    }
+    else {
+        appendBinaryMaterial(m_buffer, material);
+    }
+    uint32_t index {static_cast<uint32_t>(m_materialNames.size())};
+    m_materialNames.push_back(material.name);
+    m_materialIndices.emplace(material.name, index);
+    m_primCount++;
+    _flush(false);
+    if (!m_out) {
+        return std::unexpected(SCENE_ERROR::badFile);
+    }
+    return index;
+}
+
+auto SceneWriter::writeObject(const SceneObject& object) -> std::expected<void, SCENE_ERROR> {
+    if (!_enter(SECTION::objects)) {
+        return std::unexpected(SCENE_ERROR::outOfOrder);
+    }
+    std::expected<void, SCENE_ERROR> valid {_checkObject(object)};
+    if (!valid) {
+        return valid;
+    }
+    _appendObject(object, m_buffer);
+    m_primCount++;
+    _flush(false);
+    if (!m_out) {
+        return std::unexpected(SCENE_ERROR::badFile);
+    }
+    return {};
+}
+
+auto SceneWriter::writeObjects(const std::vector<SceneObject>& objects) -> std::expected<void, SCENE_ERROR> {
+    if (m_pool == nullptr || m_pool->workerCount() == 0) {
+        for (const SceneObject& object : objects) {
+            std::expected<void, SCENE_ERROR> written {writeObject(object)};
+            if (!written) {
+                return written;
+            }
+        }
+        return {};
+    }
+    if (!_enter(SECTION::objects)) {
+        return std::unexpected(SCENE_ERROR::outOfOrder);
+    }
+    for (size_t i {0}; i < objects.size(); i++) {
+        std::expected<void, SCENE_ERROR> valid {_checkObject(objects[i])};
+        if (!valid) {
+            // none of them were written, so none of their names are taken
+            for (size_t claimed {0}; claimed < i; claimed++) {
+                m_objectNames.erase(objects[claimed].name);
+            }
+            return valid;
+        }
+    }
+    MAGE_PROFILE_SCOPE("SceneWriter::writeObjects");
+    // a few batches per thread at a time, so the formatted text stays small
+    size_t window {OBJECT_BATCH * 4 * (m_pool->workerCount() + 1)};
+    std::vector<std::string> batches((window + OBJECT_BATCH - 1) / OBJECT_BATCH);
+    for (size_t first {0}; first < objects.size(); first += window) {
+        size_t count {std::min(window, objects.size() - first)};
+        m_pool->run(count, OBJECT_BATCH, [&](size_t begin, size_t end) {
+            std::string& text {batches[begin / OBJECT_BATCH]};
+            text.clear();
+            for (size_t i {begin}; i < end; i++) {
+                _appendObject(objects[first + i], text);
+            }
+        });
+        for (size_t batch {0}; batch * OBJECT_BATCH < count; batch++) {
+            m_buffer += batches[batch];
+            _flush(false);
+        }
+        m_primCount += count;
+        if (!m_out) {
+            return std::unexpected(SCENE_ERROR::badFile);
+        }
+    }
+    return {};
+}
+
+void SceneWriter::finish() {
+    if (m_section == SECTION::finished) {
+        return;
+    }
+    // the default prim exists even in a scene without objects
+    _enter(SECTION::objects);
+    if (m_format == SCENE_FORMAT::USDA) {
+        m_buffer += "}\n";
+    }
+    else {
+        endRecord(m_buffer, beginRecord(m_buffer, PRIM_KIND::end));
+    }
+    m_section = SECTION::finished;
+    _flush(true);
+    m_out.flush();
+}
+
+auto SceneWriter::_enter(SECTION section) -> bool {
+    if (section < m_section || m_section == SECTION::finished) {
+        return false;
+    }
+    if (section == m_section || m_format == SCENE_FORMAT::BINARY) {
+        m_section = section;
+        return true;
+    }
+    if (m_section != SECTION::none) {
+        m_buffer += "}\n\n";
+    }
+    switch (section) {
+    case SECTION::meshes:
+        // abstract, so the prototypes themselves aren't drawn
+        m_buffer += "class \"Prototypes\"\n{\n";
+        break;
+    case SECTION::materials:
+        m_buffer += "def Scope \"Materials\"\n{\n";
+        break;
+    default:
+        m_buffer += "def Xform \"World\"\n{\n";
+        break;
+    }
+    m_section = section;
+    return true;
+}
+
+auto SceneWriter::_checkObject(const SceneObject& object) -> std::expected<void, SCENE_ERROR> {
+    if (!isValidPrimName(object.name) || m_objectNames.contains(object.name)) {
+        return std::unexpected(SCENE_ERROR::badName);
+    }
+    if (object.mesh >= m_meshNames.size()
+        || (object.material != NO_MATERIAL && object.material >= m_materialNames.size())) {
+        return std::unexpected(SCENE_ERROR::badReference);
+    }
+    m_objectNames.insert(object.name);
+    return {};
+}
+
+void SceneWriter::_appendObject(const SceneObject& object, std::string& buffer) const {
+    if (m_format == SCENE_FORMAT::USDA) {
+        appendUsdaObject(buffer, object, m_meshNames[object.mesh],
+                         object.material == NO_MATERIAL ? nullptr : &m_materialNames[object.material]);
+    }
+    else {
+        appendBinaryObject(buffer, object);
+    }
+}
+
+void SceneWriter::_flush(bool force) {
+    if (m_buffer.empty() || (!force && m_buffer.size() < FLUSH_BYTES)) {
+        return;
+    }
+    m_out.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+    m_bytesWritten += m_buffer.size();
+    m_buffer.clear();
+}
+
+auto readScene(std::istream& in,
+               const SceneCallbacks& callbacks,
+               const SceneReadSettings& settings) -> std::expected<SceneReadStats, SCENE_ERROR> {
+    MAGE_PROFILE_SCOPE("readScene");
+    if (!in) {
+        return std::unexpected(SCENE_ERROR::badFile);
+    }
+    size_t chunkBytes {std::max(settings.chunkBytes, BINARY_HEADER_BYTES)};
+    SceneReadStats stats {};
+    std::string buffer {};
+    if (!readMore(in, buffer, chunkBytes)) {
+        return std::unexpected(SCENE_ERROR::badFile);
+    }
+    stats.bytes = buffer.size();
+
+    SCENE_FORMAT format {SCENE_FORMAT::USDA};
+    if (buffer.starts_with("#usda")) {
+        format = SCENE_FORMAT::USDA;
+    }
+    else if (buffer.size() >= BINARY_HEADER_BYTES
+             && std::memcmp(buffer.data(), BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0) {
+        uint32_t version {0};
+        std::memcpy(&version, buffer.data() + sizeof(BINARY_MAGIC), sizeof(version));
+        if (version != BINARY_VERSION) {
+            return std::unexpected(SCENE_ERROR::version);
+        }
+        format = SCENE_FORMAT::BINARY;
+        buffer.erase(0, BINARY_HEADER_BYTES);
+    }
+    else {
+        return std::unexpected(SCENE_ERROR::badHeader);
+    }
+
+    UsdaScanState usdaState {};
+    bool ended {false};
+    std::vector<PrimRange> ranges {};
+    std::vector<ParsedPrim> parsed {};
+    std::unordered_map<std::string, uint32_t> meshIndices {};
+    std::unordered_map<std::string, uint32_t> materialIndices {};
+    while (true) {
+        ranges.clear();
+        bool malformed {false};
+        size_t consumed {format == SCENE_FORMAT::USDA ? scanUsda(buffer, usdaState, ranges, malformed)
+                                                      : scanBinary(buffer, ranges, ended)};
+        if (malformed) {
+            return std::unexpected(SCENE_ERROR::parse);
+        }
+
+        parsed.clear();
+        parsed.resize(ranges.size());
+        auto parse {[&](size_t begin, size_t end) {
+            MAGE_PROFILE_SCOPE("readScene::parse");
+            for (size_t i {begin}; i < end; i++) {
+                ParsedPrim& prim {parsed[i]};
+                prim.kind = ranges[i].kind;
+                if (prim.kind == PRIM_KIND::end) {
+                    continue;
+                }
+                std::string_view text {buffer.data() + ranges[i].begin, ranges[i].end - ranges[i].begin};
+                bool ok {format == SCENE_FORMAT::USDA ? parseUsdaPrim(text, prim) : parseBinaryPrim(text, prim)};
+                if (!ok) {
+                    prim.error = SCENE_ERROR::parse;
+                }
+            }
+        }};
+        if (settings.pool != nullptr) {
+            settings.pool->run(parsed.size(), settings.batchSize, parse);
+        }
+        else {
+            parse(0, parsed.size());
+        }
+
+        uint64_t buffered {buffer.capacity() + parsed.capacity() * sizeof(ParsedPrim)
+                           + ranges.capacity() * sizeof(PrimRange)};
+        for (const ParsedPrim& prim : parsed) {
+            buffered += meshBytes(prim.mesh.data);
+        }
+        stats.peakBufferedBytes = std::max(stats.peakBufferedBytes, buffered);
+
+        // handed over in file order, resolving references as they go
+        for (ParsedPrim& prim : parsed) {
+            if (prim.error) {
+                return std::unexpected(*prim.error);
+            }
+            switch (prim.kind) {
+            case PRIM_KIND::mesh:
+                if (!meshIndices.emplace(prim.mesh.name, static_cast<uint32_t>(stats.meshes)).second) {
+                    return std::unexpected(SCENE_ERROR::badName);
+                }
+                stats.meshes++;
+                if (callbacks.mesh) {
+                    callbacks.mesh(std::move(prim.mesh));
+                }
+                break;
+            case PRIM_KIND::material:
+                if (!materialIndices.emplace(prim.material.name, static_cast<uint32_t>(stats.materials)).second) {
+                    return std::unexpected(SCENE_ERROR::badName);
+                }
+                stats.materials++;
+                if (callbacks.material) {
+                    callbacks.material(std::move(prim.material));
+                }
+                break;
+            case PRIM_KIND::object:
+                if (format == SCENE_FORMAT::USDA) {
+                    auto mesh {meshIndices.find(prim.meshName)};
+                    if (mesh == meshIndices.end()) {
+                        return std::unexpected(SCENE_ERROR::badReference);
+                    }
+                    prim.object.mesh = mesh->second;
+                    prim.object.material = NO_MATERIAL;
+                    if (!prim.materialName.empty()) {
+                        auto material {materialIndices.find(prim.materialName)};
+                        if (material == materialIndices.end()) {
+                            return std::unexpected(SCENE_ERROR::badReference);
+                        }
+                        prim.object.material = material->second;
+                    }
+                }
+                else if (prim.object.mesh >= stats.meshes
+                         || (prim.object.material != NO_MATERIAL && prim.object.material >= stats.materials)) {
+                    return std::unexpected(SCENE_ERROR::badReference);
+                }
+                stats.objects++;
+                if (callbacks.object) {
+                    callbacks.object(std::move(prim.object));
+                }
+                break;
+            default:
+                break;
+            }
+        }
+        buffer.erase(0, consumed);
+
+        if (ended || in.eof()) {
+            break;
+        }
+        size_t before {buffer.size()};
+        if (!readMore(in, buffer, chunkBytes)) {
+            return std::unexpected(SCENE_ERROR::badFile);
+        }
+        stats.bytes += buffer.size() - before;
+    }
+
+    bool complete {format == SCENE_FORMAT::USDA ? usdaState.depth == 0 && buffer.empty() : ended};
+    if (!complete) {
+        return std::unexpected(SCENE_ERROR::truncated);
+    }
+    return stats;
+}
+
+auto writeSceneDocument(std::ostream& out,
+                        const SceneDocument& document,
+                        SCENE_FORMAT format) -> std::expected<void, SCENE_ERROR> {
+    SceneWriter writer {out, format};
+    for (const SceneMesh& mesh : document.meshes) {
+        std::expected<uint32_t, SCENE_ERROR> written {writer.writeMesh(mesh)};
+        if (!written) {
+            return std::unexpected(written.error());
+        }
+    }
+    for (const SceneMaterial& material : document.materials) {
+        std::expected<uint32_t, SCENE_ERROR> written {writer.writeMaterial(material)};
+        if (!written) {
+            return std::unexpected(written.error());
+        }
+    }
+    std::expected<void, SCENE_ERROR> written {writer.writeObjects(document.objects)};
+    if (!written) {
+        return written;
+    }
+    writer.finish();
+    if (!out) {
+        return std::unexpected(SCENE_ERROR::badFile);
+    }
+    return {};
+}
+
+auto readSceneDocument(std::istream& in,
+                       const SceneReadSettings& settings) -> std::expected<SceneDocument, SCENE_ERROR> {
+    SceneDocument document {};
+    SceneCallbacks callbacks {
+        [&](SceneMesh&& mesh) { document.meshes.push_back(std::move(mesh)); },
+        [&](SceneMaterial&& material) { document.materials.push_back(std::move(material)); },
+        [&](SceneObject&& object) { document.objects.push_back(std::move(object)); },
+    };
+    std::expected<SceneReadStats, SCENE_ERROR> read {readScene(in, callbacks, settings)};
+    if (!read) {
+        return std::unexpected(read.error());
+    }
+    return document;
+}
+
+}
@@ -0,0 +1,183 @@
+#ifndef SCENE_IO_H
+#define SCENE_IO_H
+
+#include <cstdint>
+#include <expected>
+#include <functional>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <material.h>
+#include <mesh/mesh_data.h>
+#include <transform.h>
+#include <worker_pool.h>
+
+namespace sjd {
+
+enum class SCENE_ERROR {
+    badFile,
+    badHeader,
+    // written by another version of the binary layout
+    version,
+    // not a USD identifier, or a mesh, material or object name used twice
+    badName,
+    // normals or texture coordinates that don't match the positions
+    badMesh,
+    // an object names a mesh or material that doesn't exist
+    badReference,
+    // meshes, then materials, then objects
+    outOfOrder,
+    parse,
+    truncated
+};
+
+enum class SCENE_FORMAT {
+    // USDA text that USD tools can open
+    USDA,
+    // the same prims as length prefixed records of raw arrays
+    BINARY
+};
+
+// objects without a material
+const uint32_t NO_MATERIAL {std::numeric_limits<uint32_t>::max()};
+
+// Geometry shared by any number of objects, as a USD prototype.
+struct SceneMesh {
+    std::string name;
+    MeshData data;
+};
+
+struct SceneMaterial {
+    std::string name;
+    Material material;
+};
+
+// An instance of a mesh; mesh and material index the scene's meshes and
+// materials in the order they were written.
+struct SceneObject {
+    std::string name;
+    uint32_t mesh {0};
+    uint32_t material {NO_MATERIAL};
+    Transform transform {};
+};
+
+// A whole scene held in memory, for scenes small enough to want that.
+struct SceneDocument {
+    std::vector<SceneMesh> meshes;
+    std::vector<SceneMaterial> materials;
+    std::vector<SceneObject> objects;
+};
+
+// [A-Za-z_][A-Za-z0-9_]*, the names USD allows for prims
+auto isValidPrimName(const std::string& name) -> bool;
+
+// Writes a scene one prim at a time, never holding more than the names of
+// its prims and one output buffer.
+//
+// USDA puts meshes in an abstract /Prototypes class, materials in
+// /Materials, and objects in /World as typeless prims that reference their
+// mesh, bind their material and carry translate, orient and scale ops.
+// Each section is one scope that is closed when the next begins, so prims
+// must arrive meshes first, then materials, then objects. Blinn-Phong
+// material values have no UsdPreviewSurface equivalent and are written as
+// mage: custom attributes.
+class SceneWriter {
+public:
+    // out must outlive the writer
+    SceneWriter(std::ostream& out, SCENE_FORMAT format, WorkerPool* pool = nullptr);
+    // finishes the scene if finish() wasn't called
+    ~SceneWriter();
+
+    SceneWriter(const SceneWriter&) = delete;
+    SceneWriter& operator=(const SceneWriter&) = delete;
+
+    // return the index objects refer to it by
+    auto writeMesh(const SceneMesh& mesh) -> std::expected<uint32_t, SCENE_ERROR>;
+    auto writeMaterial(const SceneMaterial& material) -> std::expected<uint32_t, SCENE_ERROR>;
+    auto writeObject(const SceneObject& object) -> std::expected<void, SCENE_ERROR>;
+    // formats the objects on the pool's threads, in batches, and writes
+    // them in order
+    auto writeObjects(const std::vector<SceneObject>& objects) -> std::expected<void, SCENE_ERROR>;
+
+    // closes the open scope and flushes; nothing may be written after it
+    void finish();
+
+    auto primCount() const -> const uint64_t& { return m_primCount; }
+    auto bytesWritten() const -> const uint64_t& { return m_bytesWritten; }
+
+private:
+    enum class SECTION { none, meshes, materials, objects, finished };
+
+    auto _enter(SECTION section) -> bool;
+    // also claims the object's name, as its prim path must be unique
+    auto _checkObject(const SceneObject& object) -> std::expected<void, SCENE_ERROR>;
+    void _appendObject(const SceneObject& object, std::string& buffer) const;
+    // writes the buffer out once it's large enough to be worth a write
+    void _flush(bool force);
+
+    std::ostream& m_out;
+    SCENE_FORMAT m_format;
+    WorkerPool* m_pool;
+    SECTION m_section {SECTION::none};
+    std::string m_buffer;
+    std::vector<std::string> m_meshNames;
+    std::vector<std::string> m_materialNames;
+    std::unordered_map<std::string, uint32_t> m_meshIndices;
+    std::unordered_map<std::string, uint32_t> m_materialIndices;
+    std::unordered_set<std::string> m_objectNames;
+    uint64_t m_primCount {0};
+    uint64_t m_bytesWritten {0};
+};
+
+// Receives prims in file order; any callback may be left empty.
+struct SceneCallbacks {
+    std::function<void(SceneMesh&&)> mesh;
+    std::function<void(SceneMaterial&&)> material;
+    std::function<void(SceneObject&&)> object;
+};
+
+struct SceneReadSettings {
+    // bytes read from the stream at a time; a prim larger than this grows
+    // the chunk until it fits
+    size_t chunkBytes {4 << 20};
+    // prims handed to a thread at a time
+    size_t batchSize {256};
+    // parses on the calling thread alone when empty
+    WorkerPool* pool {nullptr};
+};
+
+struct SceneReadStats {
+    uint64_t meshes {0};
+    uint64_t materials {0};
+    uint64_t objects {0};
+    uint64_t bytes {0};
+    // the most the reader held at once: file text and parsed prims not yet
+    // handed to the callbacks
+    uint64_t peakBufferedBytes {0};
+};
+
+// Reads either format, picked from the file's first bytes.
+//
+// The stream is read a chunk at a time. Only the chunk is scanned on the
+// calling thread, for the byte ranges of the complete prims it holds; those
+// are parsed in parallel on the pool, then handed to the callbacks in file
+// order before the next chunk is read, so memory stays bounded by the chunk
+// size however large the scene is. Object references are resolved against
+// the meshes and materials read so far.
+auto readScene(std::istream& in,
+               const SceneCallbacks& callbacks,
+               const SceneReadSettings& settings = {}) -> std::expected<SceneReadStats, SCENE_ERROR>;
+
+auto writeSceneDocument(std::ostream& out,
+                        const SceneDocument& document,
+                        SCENE_FORMAT format) -> std::expected<void, SCENE_ERROR>;
+auto readSceneDocument(std::istream& in,
+                       const SceneReadSettings& settings = {}) -> std::expected<SceneDocument, SCENE_ERROR>;
+
+}
+#endif
@@ -5,6 +5,7 @@ namespace sjd {
 Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath)
 : m_isValid {false}
 {
+    MAGE_PROFILE_SCOPE("Shader::build");
     // Attempt to read shader files into memory
     auto vertexCode {_loadShaderFile(vertexPath)};
     if (!vertexCode.has_value()){
@@ -37,11 +38,13 @@ Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath)
     glDeleteShader(vertShader.value());
     glDeleteShader(fragShader.value());
     m_isValid = true;
+    _assignReservedSamplers();
 }
 
 Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath, const std::string& geometryPath)
 : m_isValid {false}
 {
+    MAGE_PROFILE_SCOPE("Shader::build");
     // Attempt to read shader files into memory
     auto vertexCode {_loadShaderFile(vertexPath)};
     if (!vertexCode.has_value()){
@@ -87,6 +90,33 @@ Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath, c
     glDeleteShader(geomShader.value());
     glDeleteShader(fragShader.value());
     m_isValid = true;
+    _assignReservedSamplers();
+}
+
+Shader::Shader(const std::string& vertexPath, const std::vector<std::string>& feedbackVaryings)
+: m_isValid {false}
+{
+    MAGE_PROFILE_SCOPE("Shader::build");
+    auto vertexCode {_loadShaderFile(vertexPath)};
+    if (!vertexCode.has_value()){
+        std::cout << "Failed to load vertex shader at: " << vertexPath << "\n";
+        return;
+    }
+
+    auto vertShader {_compileSubShader(ShaderType::vertex, vertexCode.value())};
+    if (!vertShader.has_value()){
+        std::cout << "Failed to compile vertex shader.\n";
+        return;
+    }
+
+    if (!_linkProgram(vertShader.value(), feedbackVaryings)) {
+        std::cout << "Failed to link shader program.\n";
+        return;
+    }
+
+    glDeleteShader(vertShader.value());
+    m_isValid = true;
+    _assignReservedSamplers();
 }
 
 void Shader::setUniform(const std::string& name, bool value) const {
@@ -101,10 +131,18 @@ void Shader::setUniform(const std::string& name, float value) const {
     glUniform1f(glGetUniformLocation(m_id, name.c_str()), value); 
 }
 
+void Shader::setUniform(const std::string& name, const glm::vec2& vec) const {
+    glUniform2fv(glGetUniformLocation(m_id, name.c_str()), 1, &vec[0]);
+}
+
 void Shader::setUniform(const std::string& name, const glm::vec3& vec) const {
     glUniform3fv(glGetUniformLocation(m_id, name.c_str()), 1, &vec[0]);
 }
 
+void Shader::setUniform(const std::string& name, const glm::vec4& vec) const {
+    glUniform4fv(glGetUniformLocation(m_id, name.c_str()), 1, &vec[0]);
+}
+
 void Shader::setUniform(const std::string& name, const glm::mat4& mat) const {
     glUniformMatrix4fv(glGetUniformLocation(m_id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
 }
@@ -197,6 +235,21 @@ bool Shader::_linkProgram(GLuint vertShader, GLuint fragShader, GLuint geomShade
     return _reportLinkingErrors(m_id);
 }
 
+bool Shader::_linkProgram(GLuint vertShader, const std::vector<std::string>& feedbackVaryings) {
+    m_id = glCreateProgram();
+    glAttachShader(m_id, vertShader);
+    // varyings have to be named before linking
+    std::vector<const GLchar*> names;
+    for (const std::string& varying : feedbackVaryings) {
+        names.push_back(varying.c_str());
+    }
+    glTransformFeedbackVaryings(m_id, static_cast<GLsizei>(names.size()), names.data(),
+                                GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(m_id);
+
+    return _reportLinkingErrors(m_id);
+}
+
 bool Shader::_reportLinkingErrors(GLuint programId) {
     int success {};
     glGetProgramiv(programId, GL_LINK_STATUS, &success);
@@ -213,4 +266,17 @@ bool Shader::_reportLinkingErrors(GLuint programId) {
     return true;
 }
 
+void Shader::_assignReservedSamplers() const {
+    GLint previous {0};
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+    glUseProgram(m_id);
+    for (const ReservedSampler& sampler : RESERVED_SAMPLERS) {
+        GLint location {glGetUniformLocation(m_id, sampler.name)};
+        if (location >= 0) {
+            glUniform1i(location, sampler.unit);
+        }
+    }
+    glUseProgram(static_cast<GLuint>(previous));
+}
+
 }
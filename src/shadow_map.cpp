@@ -0,0 +1,274 @@
+#include <shadow_map.h>
+#include <profiler.h>
+#include <algorithm>
+#include <cmath>
+
+namespace sjd {
+
+// the current context's fallback, see CascadedShadowMap::createFallback()
+static GLuint s_fallbackDepthArray {0};
+
+auto computeCascadeSplits(float nearPlane,
+                          float farPlane,
+                          size_t cascadeCount,
+                          float lambda) -> std::vector<float> {
+    std::vector<float> splits(cascadeCount + 1);
+    for (size_t i {0}; i <= cascadeCount; i++) {
+        float fraction {static_cast<float>(i) / static_cast<float>(cascadeCount)};
+        float logSplit {nearPlane * std::pow(farPlane / nearPlane, fraction)};
+        float uniformSplit {nearPlane + (farPlane - nearPlane) * fraction};
+        splits[i] = lambda * logSplit + (1.0f - lambda) * uniformSplit;
+    }
+    // guard the ends against rounding in pow()
+    splits.front() = nearPlane;
+    splits.back() = farPlane;
+    return splits;
+}
+
+auto frustumSliceCorners(const glm::mat4& view,
+                         float fovY,
+                         float aspect,
+                         float nearDist,
+                         float farDist) -> std::array<glm::vec3, 8> {
+    glm::mat4 invView {glm::inverse(view)};
+    float tanHalfFov {std::tan(fovY * 0.5f)};
+    std::array<glm::vec3, 8> corners {};
+    size_t i {0};
+    for (float dist : {nearDist, farDist}) {
+        float halfHeight {dist * tanHalfFov};
+        float halfWidth {halfHeight * aspect};
+        for (float y : {-halfHeight, halfHeight}) {
+            for (float x : {-halfWidth, halfWidth}) {
+                corners[i++] = glm::vec3(invView * glm::vec4(x, y, -dist, 1.0f));
+            }
+        }
+    }
+    return corners;
+}
+
+auto fitCascade(const std::array<glm::vec3, 8>& corners,
+                const glm::vec3& lightDir,
+                uint32_t resolution,
+                float casterMargin) -> glm::mat4 {
+    glm::vec3 center {0.0f};
+    for (const glm::vec3& corner : corners) {
+        center += corner;
+    }
+    center /= static_cast<float>(corners.size());
+
+    // a sphere keeps the extents fixed as the camera rotates, so the only
+    // thing that can move the cascade is translation
+    float radius {0.0f};
+    for (const glm::vec3& corner : corners) {
+        radius = std::max(radius, glm::length(corner - center));
+    }
+    radius = std::ceil(radius * 16.0f) / 16.0f;
+
+    glm::vec3 dir {glm::normalize(lightDir)};
+    glm::vec3 up {std::abs(dir.y) > 0.99f
+                  ? glm::vec3(0.0f, 0.0f, 1.0f)
+                  : glm::vec3(0.0f, 1.0f, 0.0f)};
+    // a light view anchored at the origin gives a fixed texel grid to snap to
+    glm::mat4 lightView {glm::lookAt(glm::vec3(0.0f), dir, up)};
+
+    glm::vec3 lightCenter {lightView * glm::vec4(center, 1.0f)};
+    float texelSize {2.0f * radius / static_cast<float>(resolution)};
+    lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+    lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+
+    // the light looks down -z: casters between the sphere and the light
+    // are kept by pushing the near plane towards the light by casterMargin
+    glm::mat4 lightProjection {glm::ortho(lightCenter.x - radius,
+                                          lightCenter.x + radius,
+                                          lightCenter.y - radius,
+                                          lightCenter.y + radius,
+                                          -(lightCenter.z + radius + casterMargin),
+                                          -(lightCenter.z - radius))};
+    return lightProjection * lightView;
+}
+
+CascadedShadowMap::CascadedShadowMap(const std::string& vertexPath,
+                                     const std::string& fragmentPath,
+                                     ShadowSettings settings)
+:   m_depthShader {vertexPath, fragmentPath},
+    m_settings {settings}
+{
+    m_settings.cascadeCount = std::clamp<size_t>(m_settings.cascadeCount,
+                                                 1,
+                                                 MAX_SHADOW_CASCADES);
+    if (!m_depthShader.isValid()) {
+        std::cout << "Failed to create shadow map depth shader.\n";
+        return;
+    }
+    if (!_createTargets()) {
+        std::cout << "Failed to create shadow map framebuffer.\n";
+        return;
+    }
+    setCaching(m_settings.cacheStaticCascades);
+    m_isValid = true;
+}
+
+CascadedShadowMap::~CascadedShadowMap() {
+    glDeleteFramebuffers(1, &m_fbo);
+    glDeleteTextures(1, &m_depthArray);
+}
+
+void CascadedShadowMap::setCaching(bool enabled) {
+    m_settings.cacheStaticCascades = enabled;
+    for (size_t i {0}; i < m_settings.cascadeCount; i++) {
+        m_cascades[i].cached = _isCached(i);
+        m_cascades[i].dirty = true;
+    }
+}
+
+void CascadedShadowMap::update(Camera& camera,
+                               float aspect,
+                               float nearPlane,
+                               float farPlane,
+                               const glm::vec3& lightDir) {
+    std::vector<float> splits {computeCascadeSplits(nearPlane,
+                                                    farPlane,
+                                                    m_settings.cascadeCount,
+                                                    m_settings.splitLambda)};
+    glm::mat4 view {camera.getViewMatrix()};
+    float fovY {glm::radians(camera.getZoom())};
+    bool lightChanged {glm::any(glm::greaterThan(glm::abs(lightDir - m_lightDir),
+                                                 glm::vec3(0.0001f)))};
+    m_lightDir = lightDir;
+
+    for (size_t i {0}; i < m_settings.cascadeCount; i++) {
+        Cascade& cascade {m_cascades[i]};
+        glm::mat4 lightSpace {fitCascade(frustumSliceCorners(view,
+                                                             fovY,
+                                                             aspect,
+                                                             splits[i],
+                                                             splits[i + 1]),
+                                         lightDir,
+                                         m_settings.resolution,
+                                         m_settings.casterMargin)};
+        if (!cascade.cached) {
+            cascade.dirty = true;
+        }
+        else if (lightChanged || m_staticCastersDirty || lightSpace != cascade.lightSpace) {
+            cascade.dirty = true;
+        }
+        cascade.lightSpace = lightSpace;
+        cascade.farSplit = splits[i + 1];
+    }
+    m_staticCastersDirty = false;
+}
+
+void CascadedShadowMap::render(const std::vector<Mesh*>& staticCasters,
+                               const std::vector<Mesh*>& dynamicCasters) {
+    m_cascadesRendered = 0;
+    if (!m_isValid) {
+        return;
+    }
+    MAGE_PROFILE_GPU_SCOPE("CascadedShadowMap::render");
+    GLint previousFbo {0};
+    GLint previousViewport[4] {};
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFbo);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glViewport(0, 0, m_settings.resolution, m_settings.resolution);
+    // slope-scaled offset keeps lit surfaces from shadowing themselves
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+
+    glm::mat4 identity {1.0f};
+    for (size_t i {0}; i < m_settings.cascadeCount; i++) {
+        Cascade& cascade {m_cascades[i]};
+        if (!cascade.dirty) {
+            continue;
+        }
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthArray, 0, i);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        for (Mesh* mesh : staticCasters) {
+            mesh->draw(cascade.lightSpace, identity, m_depthShader);
+        }
+        if (!cascade.cached) {
+            for (Mesh* mesh : dynamicCasters) {
+                mesh->draw(cascade.lightSpace, identity, m_depthShader);
+            }
+        }
+        cascade.dirty = false;
+        m_cascadesRendered++;
+    }
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+    glViewport(previousViewport[0], previousViewport[1],
+               previousViewport[2], previousViewport[3]);
+}
+
+void CascadedShadowMap::bind(const Shader& shader) const {
+    glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_depthArray);
+    glActiveTexture(GL_TEXTURE0);
+    shader.use();
+    shader.setUniform("shadowMap", SHADOW_MAP_UNIT);
+    shader.setUniform("numCascades", static_cast<int>(m_isValid ? m_settings.cascadeCount : 0));
+    shader.setUniform("shadowTexelSize", 1.0f / static_cast<float>(m_settings.resolution));
+    for (size_t i {0}; i < m_settings.cascadeCount; i++) {
+        std::string index {"[" + std::to_string(i) + "]"};
+        shader.setUniform("lightSpaceMatrices" + index, m_cascades[i].lightSpace);
+        shader.setUniform("cascadeSplits" + index, m_cascades[i].farSplit);
+    }
+}
+
+void CascadedShadowMap::unbind(const Shader& shader) {
+    glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, s_fallbackDepthArray);
+    glActiveTexture(GL_TEXTURE0);
+    shader.use();
+    shader.setUniform("shadowMap", SHADOW_MAP_UNIT);
+    shader.setUniform("numCascades", 0);
+}
+
+void CascadedShadowMap::createFallback() {
+    // the previous context's texture went with it, so there is nothing to delete
+    glGenTextures(1, &s_fallbackDepthArray);
+    glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, s_fallbackDepthArray);
+    float depth {1.0f};
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, 1, 1, 1, 0,
+                 GL_DEPTH_COMPONENT, GL_FLOAT, &depth);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+bool CascadedShadowMap::_createTargets() {
+    glGenTextures(1, &m_depthArray);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_depthArray);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F,
+                 m_settings.resolution, m_settings.resolution, m_settings.cascadeCount,
+                 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    // linear filtering with compare mode gives a free 2x2 PCF per tap
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    float border[] {1.0f, 1.0f, 1.0f, 1.0f};
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    glGenFramebuffers(1, &m_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthArray, 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    bool complete {glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE};
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return complete;
+}
+
+auto CascadedShadowMap::_isCached(size_t cascade) const -> bool {
+    return m_settings.cacheStaticCascades && cascade >= m_settings.firstCachedCascade;
+}
+
+}
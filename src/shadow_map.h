@@ -0,0 +1,126 @@
+#ifndef SHADOW_MAP_H
+#define SHADOW_MAP_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <camera.h>
+#include <shader.h>
+#include <mesh/mesh.h>
+
+namespace sjd {
+
+// must match NUM_CASCADES in blinn_phong16.frag.glsl
+const size_t MAX_SHADOW_CASCADES = 4;
+
+struct ShadowSettings {
+    uint32_t resolution {2048};
+    size_t cascadeCount {MAX_SHADOW_CASCADES};
+    // blend between logarithmic (1.0) and uniform (0.0) split placement
+    float splitLambda {0.75f};
+    // extra depth towards the light so casters outside the view still cast
+    float casterMargin {50.0f};
+    // cascades from this index on hold static geometry only and are cached
+    size_t firstCachedCascade {2};
+    bool cacheStaticCascades {true};
+};
+
+// returns cascadeCount + 1 view-space distances, from nearPlane to farPlane
+auto computeCascadeSplits(float nearPlane,
+                          float farPlane,
+                          size_t cascadeCount,
+                          float lambda) -> std::vector<float>;
+
+// world-space corners of the camera frustum between two view distances
+auto frustumSliceCorners(const glm::mat4& view,
+                         float fovY,
+                         float aspect,
+                         float nearDist,
+                         float farDist) -> std::array<glm::vec3, 8>;
+
+// light view-projection enclosing the slice's bounding sphere, snapped to
+// whole shadow-map texels so it only changes when the camera moves a texel
+auto fitCascade(const std::array<glm::vec3, 8>& corners,
+                const glm::vec3& lightDir,
+                uint32_t resolution,
+                float casterMargin) -> glm::mat4;
+
+class CascadedShadowMap {
+public:
+    CascadedShadowMap(const std::string& vertexPath,
+                      const std::string& fragmentPath,
+                      ShadowSettings settings = {});
+    ~CascadedShadowMap();
+
+    CascadedShadowMap(const CascadedShadowMap&) = delete;
+    CascadedShadowMap& operator=(const CascadedShadowMap&) = delete;
+
+    auto isValid() const -> bool { return m_isValid; }
+    auto settings() const -> const ShadowSettings& { return m_settings; }
+    auto lightSpaceMatrix(size_t cascade) const -> const glm::mat4& {
+        return m_cascades[cascade].lightSpace;
+    }
+    auto splitDistance(size_t cascade) const -> const float& {
+        return m_cascades[cascade].farSplit;
+    }
+    // number of cascades redrawn by the last call to render()
+    auto cascadesRendered() const -> const size_t& { return m_cascadesRendered; }
+
+    void setCaching(bool enabled);
+
+    // call when static casters are added, removed or moved
+    void invalidateStaticCasters() { m_staticCastersDirty = true; }
+
+    // refits every cascade to the camera's frustum splits and decides
+    // which ones have to be redrawn this frame
+    void update(Camera& camera,
+                float aspect,
+                float nearPlane,
+                float farPlane,
+                const glm::vec3& lightDir);
+
+    // dynamic casters are drawn into the uncached cascades only
+    void render(const std::vector<Mesh*>& staticCasters,
+                const std::vector<Mesh*>& dynamicCasters);
+
+    // binds the shadow map array to SHADOW_MAP_UNIT and sets the lighting
+    // shader's cascade uniforms
+    void bind(const Shader& shader) const;
+
+    // turns shadowing off in a lighting shader and puts the fallback back
+    // on SHADOW_MAP_UNIT
+    static void unbind(const Shader& shader);
+
+    // a 1x1 fully lit depth array bound to SHADOW_MAP_UNIT, so a lighting
+    // shader drawn without a shadow map still samples a complete texture;
+    // called by initRenderContext()
+    static void createFallback();
+
+private:
+    struct Cascade {
+        glm::mat4 lightSpace {1.0f};
+        float farSplit {0.0f};
+        bool cached {false};
+        bool dirty {true};
+    };
+
+    bool _createTargets();
+    auto _isCached(size_t cascade) const -> bool;
+
+    Shader m_depthShader;
+    ShadowSettings m_settings;
+    bool m_isValid {false};
+    GLuint m_fbo {0};
+    GLuint m_depthArray {0};
+    std::array<Cascade, MAX_SHADOW_CASCADES> m_cascades {};
+    glm::vec3 m_lightDir {0.0f};
+    bool m_staticCastersDirty {true};
+    size_t m_cascadesRendered {0};
+};
+
+}
+#endif
@@ -0,0 +1,66 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace sjd {
+
+// Fixed-capacity lock-free queue for exactly one producer thread and one
+// consumer thread. Positions only ever increase; the slot is the position
+// modulo CAPACITY, which must be a power of two.
+template <typename T, size_t CAPACITY>
+class SpscRing {
+    static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0,
+                  "SpscRing capacity must be a power of two");
+public:
+    auto capacity() const -> size_t { return CAPACITY; }
+
+    auto size() const -> size_t {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+
+    // producer only; returns false rather than overwrite unread items
+    bool push(const T& item) {
+        size_t head {m_head.load(std::memory_order_relaxed)};
+        if (head - m_tail.load(std::memory_order_acquire) == CAPACITY) {
+            return false;
+        }
+        m_items[head & (CAPACITY - 1)] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only
+    bool pop(T& item) {
+        size_t tail {m_tail.load(std::memory_order_relaxed)};
+        if (tail == m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = m_items[tail & (CAPACITY - 1)];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only; hands every available item to visit and returns the count
+    template <typename Visitor>
+    auto drain(Visitor&& visit) -> size_t {
+        size_t tail {m_tail.load(std::memory_order_relaxed)};
+        size_t head {m_head.load(std::memory_order_acquire)};
+        for (size_t i {tail}; i != head; i++) {
+            visit(m_items[i & (CAPACITY - 1)]);
+        }
+        m_tail.store(head, std::memory_order_release);
+        return head - tail;
+    }
+
+private:
+    std::array<T, CAPACITY> m_items {};
+    // kept on separate cache lines so the two threads don't contend
+    alignas(64) std::atomic<size_t> m_head {0};
+    alignas(64) std::atomic<size_t> m_tail {0};
+};
+
+}
+#endif
@@ -0,0 +1,34 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace sjd {
+
+// position, rotation and scale of an object, kept apart rather than as a
+// matrix so two simulation steps can be blended for rendering
+struct Transform {
+    glm::vec3 position {0.0f};
+    glm::quat rotation {1.0f, 0.0f, 0.0f, 0.0f};
+    glm::vec3 scale {1.0f};
+
+    auto matrix() const -> glm::mat4 {
+        glm::mat4 model {glm::translate(glm::mat4(1.0f), position)};
+        model *= glm::mat4_cast(rotation);
+        return glm::scale(model, scale);
+    }
+};
+
+// alpha 0 gives a, 1 gives b; rotations are slerped
+inline auto interpolate(const Transform& a, const Transform& b, float alpha) -> Transform {
+    return {
+        glm::mix(a.position, b.position, alpha),
+        glm::slerp(a.rotation, b.rotation, alpha),
+        glm::mix(a.scale, b.scale, alpha),
+    };
+}
+
+}
+#endif
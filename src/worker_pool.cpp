@@ -0,0 +1,79 @@
+#include <worker_pool.h>
+#include <profiler.h>
+
+namespace sjd {
+
+WorkerPool::WorkerPool(uint32_t workerCount, const std::string& threadName) {
+    for (uint32_t worker {0}; worker < workerCount; worker++) {
+        m_workers.emplace_back(&WorkerPool::_workerLoop, this, threadName);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock {m_mutex};
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void WorkerPool::run(size_t count, size_t batchSize, const std::function<void(size_t, size_t)>& task) {
+    if (count == 0) {
+        return;
+    }
+    m_task = &task;
+    m_count = count;
+    m_batchSize = std::max(batchSize, size_t {1});
+    m_nextBatch.store(0, std::memory_order_relaxed);
+    // a single batch isn't worth waking anyone for
+    bool parallel {!m_workers.empty() && count > m_batchSize};
+    if (parallel) {
+        {
+            std::lock_guard<std::mutex> lock {m_mutex};
+            m_generation++;
+            m_busyWorkers = m_workers.size();
+        }
+        m_wake.notify_all();
+    }
+    _runBatches();
+    if (parallel) {
+        std::unique_lock<std::mutex> lock {m_mutex};
+        m_done.wait(lock, [this]{ return m_busyWorkers == 0; });
+    }
+    m_task = nullptr;
+}
+
+void WorkerPool::_workerLoop(std::string threadName) {
+    Profiler::instance().setThreadName(threadName);
+    uint64_t seen {0};
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock {m_mutex};
+            m_wake.wait(lock, [&]{ return m_stopping || m_generation != seen; });
+            if (m_stopping) {
+                return;
+            }
+            seen = m_generation;
+        }
+        _runBatches();
+        std::lock_guard<std::mutex> lock {m_mutex};
+        if (--m_busyWorkers == 0) {
+            m_done.notify_one();
+        }
+    }
+}
+
+void WorkerPool::_runBatches() {
+    size_t batches {(m_count + m_batchSize - 1) / m_batchSize};
+    for (size_t batch {m_nextBatch.fetch_add(1, std::memory_order_relaxed)};
+         batch < batches;
+         batch = m_nextBatch.fetch_add(1, std::memory_order_relaxed)) {
+        size_t begin {batch * m_batchSize};
+        (*m_task)(begin, std::min(begin + m_batchSize, m_count));
+    }
+}
+
+}
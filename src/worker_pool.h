@@ -0,0 +1,59 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sjd {
+
+// Spreads a loop of independent items over persistent worker threads.
+//
+// run() splits the items into fixed size batches that the workers and the
+// calling thread claim from a shared counter until none are left, so an
+// uneven batch never leaves the others idle, and returns once every batch
+// has finished. The workers sleep between runs.
+class WorkerPool {
+public:
+    // 0 workers runs everything on the calling thread; by default the
+    // calling thread and the workers fill every hardware thread
+    WorkerPool(uint32_t workerCount = std::max(std::thread::hardware_concurrency(), 1u) - 1,
+               const std::string& threadName = "worker");
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    auto workerCount() const -> size_t { return m_workers.size(); }
+
+    // calls task(begin, end) for every batch of up to batchSize items below
+    // count; not reentrant
+    void run(size_t count, size_t batchSize, const std::function<void(size_t, size_t)>& task);
+
+private:
+    void _workerLoop(std::string threadName);
+    // runs batches until none are left
+    void _runBatches();
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    uint64_t m_generation {0};
+    size_t m_busyWorkers {0};
+    bool m_stopping {false};
+
+    const std::function<void(size_t, size_t)>* m_task {nullptr};
+    size_t m_count {0};
+    size_t m_batchSize {1};
+    std::atomic<size_t> m_nextBatch {0};
+};
+
+}
+#endif
@@ -0,0 +1,247 @@
+// mage_bench: frame-time benchmarks over generated scenes.
+//
+// Runs from the test directory, like the tests, so the default paths
+// resolve. Exits with 1 when a result regresses past the baseline and
+// with 2 when the benchmark could not run at all.
+//
+//   mage_bench [--frames N] [--warmup N] [--width W] [--height H]
+//              [--scene NAME] [--backend egl|osmesa|windowed]
+//              [--shaders DIR] [--baseline FILE] [--output FILE]
+//              [--tolerance X] [--update-baseline] [--trace FILE]
+//              [--latency]
+#include <glfw_setup.h>
+#include <profiler.h>
+#include <render_context.h>
+#include <bench_report.h>
+#include <bench_scene.h>
+#include <frame_loop.h>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+struct BenchOptions {
+    uint32_t frames {240};
+    uint32_t warmup {20};
+    // small enough for a software rasteriser on CI
+    uint32_t width {640};
+    uint32_t height {360};
+    std::string scene {};
+    sjd::CONTEXT_BACKEND backend {sjd::CONTEXT_BACKEND::EGL};
+    std::string shaderDirectory {"../src/glsl"};
+    std::string baselinePath {"bench/baseline.json"};
+    std::string outputPath {};
+    std::string tracePath {};
+    double tolerance {-1.0};
+    bool updateBaseline {false};
+    // also report input-to-finished-frame latency per scene
+    bool latency {false};
+};
+
+// the whole of value must be a number that fits in T
+template <typename T>
+static auto parseNumber(const std::string& arg,
+                        const std::string& value,
+                        T& out) -> std::expected<void, std::string> {
+    const char* end {value.data() + value.size()};
+    std::from_chars_result result {std::from_chars(value.data(), end, out)};
+    if (result.ec != std::errc{} || result.ptr != end) {
+        return std::unexpected("bad value " + value + " for " + arg);
+    }
+    return {};
+}
+
+static auto parseOptions(int argc, char** argv) -> std::expected<BenchOptions, std::string> {
+    BenchOptions options {};
+    if (sjd::contextBackendFromEnvironment() != sjd::CONTEXT_BACKEND::WINDOWED) {
+        options.backend = sjd::contextBackendFromEnvironment();
+    }
+    for (int i {1}; i < argc; i++) {
+        std::string arg {argv[i]};
+        if (arg == "--update-baseline") {
+            options.updateBaseline = true;
+            continue;
+        }
+        if (arg == "--latency") {
+            options.latency = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return std::unexpected("missing value for " + arg);
+        }
+        std::string value {argv[++i]};
+        std::expected<void, std::string> parsed {};
+        if (arg == "--frames") {
+            parsed = parseNumber(arg, value, options.frames);
+            options.frames = std::max(options.frames, 1u);
+        }
+        else if (arg == "--warmup") {
+            parsed = parseNumber(arg, value, options.warmup);
+        }
+        else if (arg == "--width") {
+            parsed = parseNumber(arg, value, options.width);
+        }
+        else if (arg == "--height") {
+            parsed = parseNumber(arg, value, options.height);
+        }
+        else if (arg == "--scene") {
+            options.scene = value;
+        }
+        else if (arg == "--backend") {
+            if (value == "egl") {
+                options.backend = sjd::CONTEXT_BACKEND::EGL;
+            }
+            else if (value == "osmesa") {
+                options.backend = sjd::CONTEXT_BACKEND::OSMESA;
+            }
+            else if (value == "windowed") {
+                options.backend = sjd::CONTEXT_BACKEND::WINDOWED;
+            }
+            else {
+                return std::unexpected("unknown backend " + value);
+            }
+        }
+        else if (arg == "--shaders") {
+            options.shaderDirectory = value;
+        }
+        else if (arg == "--baseline") {
+            options.baselinePath = value;
+        }
+        else if (arg == "--output") {
+            options.outputPath = value;
+        }
+        else if (arg == "--trace") {
+            options.tracePath = value;
+        }
+        else if (arg == "--tolerance") {
+            parsed = parseNumber(arg, value, options.tolerance);
+        }
+        else {
+            return std::unexpected("unknown option " + arg);
+        }
+        if (!parsed.has_value()) {
+            return std::unexpected(parsed.error());
+        }
+    }
+    return options;
+}
+
+static auto runScene(const sjd::SceneSpec& spec,
+                     const BenchOptions& options,
+                     GLFWwindow* window) -> std::expected<sjd::BenchResult, std::string> {
+    sjd::Profiler& profiler {sjd::Profiler::instance()};
+    sjd::BenchScene scene {spec, options.shaderDirectory};
+    if (!scene.isValid()) {
+        return std::unexpected("failed to build scene " + spec.name);
+    }
+    std::vector<double> frameTimesMs;
+    frameTimesMs.reserve(options.frames);
+    uint32_t drawCalls {0};
+    sjd::FramePacingSettings pacing {};
+    pacing.vsync = false;
+    pacing.measureLatency = options.latency;
+    pacing.latencyHistory = options.frames;
+    sjd::FramePacer pacer {pacing};
+    for (uint32_t frame {0}; frame < options.warmup + options.frames; frame++) {
+        profiler.beginFrame();
+        pacer.beginFrame();
+        auto start {std::chrono::steady_clock::now()};
+        if (frame >= options.warmup) {
+            pacer.markInputSampled();
+        }
+        scene.render(frame, options.frames, options.width, options.height);
+        if (options.backend == sjd::CONTEXT_BACKEND::WINDOWED) {
+            glfwSwapBuffers(window);
+        }
+        pacer.endFrame();
+        // count the GPU's share of the frame too
+        glFinish();
+        double elapsedMs {std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count()};
+        profiler.endFrame();
+        if (frame >= options.warmup) {
+            frameTimesMs.push_back(elapsedMs);
+            drawCalls = std::max(drawCalls, profiler.lastFrame().counters.drawCalls);
+        }
+    }
+    if (options.latency) {
+        sjd::LatencyStats latency {pacer.latency()};
+        std::cout << spec.name << ": input to frame latency mean " << latency.meanMs
+                  << " ms, p95 " << latency.p95Ms << " ms, max " << latency.maxMs << " ms\n";
+    }
+    return sjd::summarise(spec.name, frameTimesMs, drawCalls, scene.shaderStartupMs());
+}
+
+int main(int argc, char** argv) {
+    auto options {parseOptions(argc, argv)};
+    if (!options.has_value()) {
+        std::cout << "mage_bench: " << options.error() << "\n";
+        return 2;
+    }
+    GLFWwindow* window {sjd::createCursorLockedWindow(options->width,
+                                                      options->height,
+                                                      "mage_bench",
+                                                      1,
+                                                      options->backend)};
+    if (!window) {
+        return 2;
+    }
+    sjd::initRenderContext();
+    if (options->backend == sjd::CONTEXT_BACKEND::WINDOWED) {
+        // measure the renderer, not the display's refresh rate
+        glfwSwapInterval(0);
+    }
+    std::cout << "mage_bench on " << glGetString(GL_RENDERER) << "\n";
+
+    std::vector<sjd::BenchResult> results;
+    for (const sjd::SceneSpec& spec : sjd::benchScenes()) {
+        if (!options->scene.empty() && options->scene != spec.name) {
+            continue;
+        }
+        auto result {runScene(spec, *options, window)};
+        if (!result.has_value()) {
+            std::cout << "mage_bench: " << result.error() << "\n";
+            sjd::terminateGlfw();
+            return 2;
+        }
+        std::cout << spec.name << ": p50 " << result->p50Ms << " ms, p95 " << result->p95Ms
+                  << " ms, p99 " << result->p99Ms << " ms, " << result->drawCalls
+                  << " draw calls, shader startup " << result->shaderStartupMs << " ms\n";
+        results.push_back(*result);
+    }
+    if (!options->tracePath.empty()) {
+        sjd::Profiler::instance().exportChromeTrace(options->tracePath);
+    }
+    sjd::terminateGlfw();
+
+    auto baseline {sjd::readBaseline(options->baselinePath)};
+    double tolerance {options->tolerance >= 0.0
+                      ? options->tolerance
+                      : baseline.has_value() ? baseline->tolerance : 0.2};
+    if (!options->outputPath.empty()) {
+        std::ofstream output {options->outputPath};
+        sjd::writeBenchJson(output, results, tolerance);
+    }
+    else {
+        sjd::writeBenchJson(std::cout, results, tolerance);
+    }
+
+    if (options->updateBaseline) {
+        std::ofstream output {options->baselinePath};
+        sjd::writeBenchJson(output, results, tolerance);
+        std::cout << "Baseline written to " << options->baselinePath << "\n";
+        return 0;
+    }
+    if (!baseline.has_value()) {
+        std::cout << "No usable baseline at " << options->baselinePath << ", nothing to compare.\n";
+        return 0;
+    }
+    baseline->tolerance = tolerance;
+    std::vector<sjd::BenchRegression> regressions {sjd::findRegressions(results, *baseline)};
+    for (const sjd::BenchRegression& regression : regressions) {
+        std::cout << "REGRESSION " << regression.scene << " " << regression.metric << ": "
+                  << regression.measured << " (baseline " << regression.baseline << ")\n";
+    }
+    return regressions.empty() ? 0 : 1;
+}
@@ -0,0 +1,252 @@
+#include <bench_report.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace sjd {
+
+namespace {
+
+// Just enough JSON for baseline files: nested objects of numbers.
+class JsonReader {
+public:
+    explicit JsonReader(const std::string& text)
+    :   m_text {text}
+    {
+    }
+
+    bool readBaseline(BenchBaseline& baseline) {
+        return _object([&](const std::string& key){
+            if (key == "tolerance") {
+                return _number(baseline.tolerance);
+            }
+            if (key == "scenes") {
+                return _object([&](const std::string& scene){
+                    BenchResult& result {baseline.scenes[scene]};
+                    result.scene = scene;
+                    return _object([&](const std::string& metric){
+                        double value {0.0};
+                        if (!_number(value)) {
+                            return false;
+                        }
+                        _assign(result, metric, value);
+                        return true;
+                    });
+                });
+            }
+            return _skipValue();
+        }) && (_skipSpace(), m_pos == m_text.size());
+    }
+
+private:
+    static void _assign(BenchResult& result, const std::string& metric, double value) {
+        if (metric == "frames") {
+            result.frames = static_cast<uint32_t>(value);
+        }
+        else if (metric == "mean_ms") {
+            result.meanMs = value;
+        }
+        else if (metric == "p50_ms") {
+            result.p50Ms = value;
+        }
+        else if (metric == "p95_ms") {
+            result.p95Ms = value;
+        }
+        else if (metric == "p99_ms") {
+            result.p99Ms = value;
+        }
+        else if (metric == "draw_calls") {
+            result.drawCalls = static_cast<uint32_t>(value);
+        }
+        else if (metric == "shader_startup_ms") {
+            result.shaderStartupMs = value;
+        }
+    }
+
+    void _skipSpace() {
+        while (m_pos < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_pos]))) {
+            m_pos++;
+        }
+    }
+
+    bool _expect(char c) {
+        _skipSpace();
+        if (m_pos < m_text.size() && m_text[m_pos] == c) {
+            m_pos++;
+            return true;
+        }
+        return false;
+    }
+
+    bool _string(std::string& out) {
+        if (!_expect('"')) {
+            return false;
+        }
+        out.clear();
+        while (m_pos < m_text.size() && m_text[m_pos] != '"') {
+            if (m_text[m_pos] == '\\' && m_pos + 1 < m_text.size()) {
+                m_pos++;
+            }
+            out += m_text[m_pos++];
+        }
+        return _expect('"');
+    }
+
+    bool _number(double& out) {
+        _skipSpace();
+        const char* begin {m_text.c_str() + m_pos};
+        char* end {nullptr};
+        out = std::strtod(begin, &end);
+        if (end == begin) {
+            return false;
+        }
+        m_pos += end - begin;
+        return true;
+    }
+
+    template <typename OnMember>
+    bool _object(OnMember&& onMember) {
+        if (!_expect('{')) {
+            return false;
+        }
+        if (_expect('}')) {
+            return true;
+        }
+        do {
+            std::string key;
+            if (!_string(key) || !_expect(':') || !onMember(key)) {
+                return false;
+            }
+        } while (_expect(','));
+        return _expect('}');
+    }
+
+    bool _skipValue() {
+        _skipSpace();
+        if (m_pos >= m_text.size()) {
+            return false;
+        }
+        if (m_text[m_pos] == '{') {
+            return _object([&](const std::string&){ return _skipValue(); });
+        }
+        if (m_text[m_pos] == '"') {
+            std::string ignored;
+            return _string(ignored);
+        }
+        double ignored {0.0};
+        return _number(ignored);
+    }
+
+    const std::string& m_text;
+    size_t m_pos {0};
+};
+
+}
+
+auto percentile(std::vector<double> samples, double p) -> double {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    double rank {std::ceil(std::clamp(p, 0.0, 100.0) / 100.0 * samples.size())};
+    size_t index {static_cast<size_t>(std::max(rank, 1.0)) - 1};
+    return samples[std::min(index, samples.size() - 1)];
+}
+
+auto summarise(const std::string& scene,
+               const std::vector<double>& frameTimesMs,
+               uint32_t drawCalls,
+               double shaderStartupMs) -> BenchResult {
+    BenchResult result {};
+    result.scene = scene;
+    result.frames = static_cast<uint32_t>(frameTimesMs.size());
+    for (double time : frameTimesMs) {
+        result.meanMs += time;
+    }
+    if (!frameTimesMs.empty()) {
+        result.meanMs /= frameTimesMs.size();
+    }
+    result.p50Ms = percentile(frameTimesMs, 50.0);
+    result.p95Ms = percentile(frameTimesMs, 95.0);
+    result.p99Ms = percentile(frameTimesMs, 99.0);
+    result.drawCalls = drawCalls;
+    result.shaderStartupMs = shaderStartupMs;
+    return result;
+}
+
+void writeBenchJson(std::ostream& out,
+                    const std::vector<BenchResult>& results,
+                    double tolerance) {
+    out << "{\n  \"tolerance\": " << tolerance << ",\n  \"scenes\": {";
+    for (size_t i {0}; i < results.size(); i++) {
+        const BenchResult& result {results[i]};
+        out << (i == 0 ? "\n" : ",\n")
+            << "    \"" << result.scene << "\": {"
+            << "\"frames\": " << result.frames
+            << ", \"mean_ms\": " << result.meanMs
+            << ", \"p50_ms\": " << result.p50Ms
+            << ", \"p95_ms\": " << result.p95Ms
+            << ", \"p99_ms\": " << result.p99Ms
+            << ", \"draw_calls\": " << result.drawCalls
+            << ", \"shader_startup_ms\": " << result.shaderStartupMs << "}";
+    }
+    out << "\n  }\n}\n";
+}
+
+auto parseBaseline(const std::string& json) -> std::expected<BenchBaseline, BENCH_ERROR> {
+    BenchBaseline baseline {};
+    JsonReader reader {json};
+    if (!reader.readBaseline(baseline)) {
+        return std::unexpected(BENCH_ERROR::parse);
+    }
+    return baseline;
+}
+
+auto readBaseline(const std::string& path) -> std::expected<BenchBaseline, BENCH_ERROR> {
+    std::ifstream file {path};
+    if (!file) {
+        return std::unexpected(BENCH_ERROR::badFile);
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return parseBaseline(contents.str());
+}
+
+auto findRegressions(const std::vector<BenchResult>& results,
+                     const BenchBaseline& baseline) -> std::vector<BenchRegression> {
+    std::vector<BenchRegression> regressions;
+    double allowed {1.0 + baseline.tolerance};
+    for (const BenchResult& result : results) {
+        auto found {baseline.scenes.find(result.scene)};
+        if (found == baseline.scenes.end()) {
+            continue;
+        }
+        const BenchResult& expected {found->second};
+        auto check {[&](const char* metric, double before, double now, double limit){
+            if (now > limit) {
+                regressions.push_back({result.scene, metric, before, now});
+            }
+        }};
+        auto timingLimit {[&](double before){
+            return std::max(before * allowed, before + TIMING_SLACK_MS);
+        }};
+        check("p50_ms", expected.p50Ms, result.p50Ms, timingLimit(expected.p50Ms));
+        check("p95_ms", expected.p95Ms, result.p95Ms, timingLimit(expected.p95Ms));
+        check("p99_ms", expected.p99Ms, result.p99Ms, timingLimit(expected.p99Ms));
+        check("shader_startup_ms", expected.shaderStartupMs, result.shaderStartupMs,
+              timingLimit(expected.shaderStartupMs));
+        // fewer draws than the baseline means the scene changed too
+        if (result.drawCalls != expected.drawCalls) {
+            regressions.push_back({result.scene, "draw_calls",
+                                   static_cast<double>(expected.drawCalls),
+                                   static_cast<double>(result.drawCalls)});
+        }
+    }
+    return regressions;
+}
+
+}
@@ -0,0 +1,68 @@
+#ifndef BENCH_REPORT_H
+#define BENCH_REPORT_H
+
+#include <cstdint>
+#include <expected>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace sjd {
+
+struct BenchResult {
+    std::string scene;
+    uint32_t frames {0};
+    double meanMs {0.0};
+    double p50Ms {0.0};
+    double p95Ms {0.0};
+    double p99Ms {0.0};
+    uint32_t drawCalls {0};
+    double shaderStartupMs {0.0};
+};
+
+// results keyed by scene, plus the allowed relative slowdown
+struct BenchBaseline {
+    double tolerance {0.2};
+    std::map<std::string, BenchResult> scenes;
+};
+
+struct BenchRegression {
+    std::string scene;
+    std::string metric;
+    double baseline {0.0};
+    double measured {0.0};
+};
+
+const double TIMING_SLACK_MS {2.0};
+
+enum class BENCH_ERROR {
+    badFile,
+    parse
+};
+
+// nearest-rank percentile, p in [0, 100]; sorts a copy of the samples
+auto percentile(std::vector<double> samples, double p) -> double;
+
+auto summarise(const std::string& scene,
+               const std::vector<double>& frameTimesMs,
+               uint32_t drawCalls,
+               double shaderStartupMs) -> BenchResult;
+
+// the output doubles as a baseline file
+void writeBenchJson(std::ostream& out,
+                    const std::vector<BenchResult>& results,
+                    double tolerance);
+
+auto parseBaseline(const std::string& json) -> std::expected<BenchBaseline, BENCH_ERROR>;
+auto readBaseline(const std::string& path) -> std::expected<BenchBaseline, BENCH_ERROR>;
+
+// timings may grow by the baseline's tolerance, or by TIMING_SLACK_MS if
+// that is larger, so sub-millisecond noise never fails a run; draw calls
+// must match exactly either way, as the scenes are deterministic. Scenes missing from the
+// baseline pass.
+auto findRegressions(const std::vector<BenchResult>& results,
+                     const BenchBaseline& baseline) -> std::vector<BenchRegression>;
+
+}
+#endif
@@ -0,0 +1,142 @@
+#include <bench_scene.h>
+#include <shadow_map.h>
+#include <environment.h>
+#include <profiler.h>
+#include <glm/gtc/constants.hpp>
+#include <chrono>
+#include <cmath>
+
+namespace sjd {
+
+// texture units used by blinn_phong16.frag.glsl
+const GLint DIFFUSE_UNIT {0};
+const GLint SPECULAR_UNIT {1};
+
+auto benchScenes() -> std::vector<SceneSpec> {
+    return {
+        {"many_meshes", 1024, 2, 1, 24, 3},
+        {"many_lights", 64, 16, 1, 48, 1},
+        {"many_programs", 256, 4, 32, 24, 1},
+    };
+}
+
+BenchScene::BenchScene(const SceneSpec& spec, const std::string& shaderDirectory)
+:   m_spec {spec}
+{
+    auto start {std::chrono::steady_clock::now()};
+    for (uint32_t i {0}; i < m_spec.shaderPrograms; i++) {
+        m_programs.push_back(std::make_unique<Shader>(shaderDirectory + "/simple.lighting.vert.glsl",
+                                                      shaderDirectory + "/blinn_phong16.frag.glsl"));
+        // drivers may defer work until the program is first bound
+        m_programs.back()->use();
+    }
+    glFinish();
+    m_shaderStartupMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+
+    uint32_t side {static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(m_spec.meshCount))))};
+    const float spacing {3.0f};
+    m_extent = side * spacing;
+    MeshData sphere {makeUvSphere(m_spec.sphereSlices, m_spec.sphereSlices / 2)};
+    // every mesh is the same sphere, so simplify it once
+    LodChain lods {buildLodChain(sphere.positions, sphere.indices, m_spec.lodLevels)};
+    for (uint32_t i {0}; i < m_spec.meshCount; i++) {
+        auto mesh {std::make_unique<IndexedMesh>(sphere, lods)};
+        float x {(i % side) * spacing - m_extent * 0.5f};
+        float z {(i / side) * spacing - m_extent * 0.5f};
+        // fixed per-mesh variation instead of random numbers
+        float y {std::sin(i * 0.7f) * 1.5f};
+        mesh->move(glm::vec3(x, y, z));
+        mesh->scale(glm::vec3(0.6f + 0.4f * std::abs(std::cos(i * 1.3f))));
+        m_meshes.push_back(std::move(mesh));
+    }
+
+    unsigned char white[] {255, 255, 255, 255};
+    glGenTextures(1, &m_whiteTexture);
+    glBindTexture(GL_TEXTURE_2D, m_whiteTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+BenchScene::~BenchScene() {
+    glDeleteTextures(1, &m_whiteTexture);
+}
+
+auto BenchScene::isValid() const -> bool {
+    for (const std::unique_ptr<Shader>& program : m_programs) {
+        if (!program->isValid()) {
+            return false;
+        }
+    }
+    return !m_programs.empty();
+}
+
+void BenchScene::render(uint32_t frame, uint32_t frameCount, uint32_t width, uint32_t height) {
+    MAGE_PROFILE_GPU_SCOPE("BenchScene::render");
+    float t {static_cast<float>(frame % frameCount) / static_cast<float>(frameCount)};
+    float angle {t * glm::two_pi<float>()};
+    float radius {m_extent * 0.4f + 4.0f};
+    glm::vec3 eye {radius * std::cos(angle), 6.0f + 2.0f * std::sin(2.0f * angle), radius * std::sin(angle)};
+    Camera camera {eye, glm::vec3(0.0f)};
+    glm::mat4 view {camera.getViewMatrix()};
+    glm::mat4 projection {glm::perspective(glm::radians(camera.getZoom()),
+                                           static_cast<float>(width) / static_cast<float>(height),
+                                           0.1f,
+                                           500.0f)};
+
+    glClearColor(0.1f, 0.1f, 0.12f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glActiveTexture(GL_TEXTURE0 + DIFFUSE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, m_whiteTexture);
+    glActiveTexture(GL_TEXTURE0 + SPECULAR_UNIT);
+    glBindTexture(GL_TEXTURE_2D, m_whiteTexture);
+
+    for (const std::unique_ptr<Shader>& program : m_programs) {
+        _setFrameUniforms(*program, projection, view, eye, angle);
+    }
+    for (size_t i {0}; i < m_meshes.size(); i++) {
+        IndexedMesh& mesh {*m_meshes[i]};
+        mesh.selectLod(camera, height);
+        mesh.draw(projection, view, *m_programs[i % m_programs.size()]);
+    }
+}
+
+void BenchScene::_setFrameUniforms(const Shader& shader,
+                                   const glm::mat4& projection,
+                                   const glm::mat4& view,
+                                   const glm::vec3& viewPos,
+                                   float time) const {
+    shader.use();
+    shader.setUniform("projection", projection);
+    shader.setUniform("view", view);
+    shader.setUniform("viewPos", viewPos);
+    shader.setUniform("material.diffuse", DIFFUSE_UNIT);
+    shader.setUniform("material.specular", SPECULAR_UNIT);
+    shader.setUniform("material.shininess", 32.0f);
+    shader.setUniform("dirLight.direction", glm::vec3(-0.3f, -1.0f, -0.2f));
+    shader.setUniform("dirLight.ambient", glm::vec3(0.05f));
+    shader.setUniform("dirLight.diffuse", glm::vec3(0.4f));
+    shader.setUniform("dirLight.specular", glm::vec3(0.5f));
+    CascadedShadowMap::unbind(shader);
+    EnvironmentMap::unbind(shader);
+
+    shader.setUniform("numPointLights", static_cast<int>(m_spec.pointLights));
+    for (uint32_t i {0}; i < m_spec.pointLights; i++) {
+        std::string light {"pointLights[" + std::to_string(i) + "]"};
+        // lights circle the scene at different speeds and radii
+        float orbit {time * (1.0f + 0.25f * i) + i};
+        float lightRadius {m_extent * (0.1f + 0.4f * (i + 1) / (m_spec.pointLights + 1))};
+        shader.setUniform(light + ".position", glm::vec3(lightRadius * std::cos(orbit),
+                                                         2.0f,
+                                                         lightRadius * std::sin(orbit)));
+        shader.setUniform(light + ".ambient", glm::vec3(0.02f));
+        shader.setUniform(light + ".diffuse", glm::vec3(0.8f));
+        shader.setUniform(light + ".specular", glm::vec3(1.0f));
+        shader.setUniform(light + ".constant", 1.0f);
+        shader.setUniform(light + ".linear", 0.09f);
+        shader.setUniform(light + ".quadratic", 0.032f);
+    }
+}
+
+}
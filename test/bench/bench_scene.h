@@ -0,0 +1,64 @@
+#ifndef BENCH_SCENE_H
+#define BENCH_SCENE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <shader.h>
+#include <mesh/indexed_mesh.h>
+
+namespace sjd {
+
+struct SceneSpec {
+    std::string name;
+    uint32_t meshCount {1};
+    // lit by blinn_phong16.frag.glsl, so at most 16
+    uint32_t pointLights {0};
+    // copies of the lighting program, used round-robin across meshes
+    uint32_t shaderPrograms {1};
+    uint32_t sphereSlices {32};
+    size_t lodLevels {1};
+};
+
+// the scenes mage_bench runs, in order
+auto benchScenes() -> std::vector<SceneSpec>;
+
+// A generated scene with a scripted camera. Nothing depends on the clock
+// or on random state, so every run draws exactly the same frames.
+class BenchScene {
+public:
+    BenchScene(const SceneSpec& spec, const std::string& shaderDirectory);
+    ~BenchScene();
+
+    BenchScene(const BenchScene&) = delete;
+    BenchScene& operator=(const BenchScene&) = delete;
+
+    auto isValid() const -> bool;
+    auto spec() const -> const SceneSpec& { return m_spec; }
+    // time to compile and link every program, including the first use
+    auto shaderStartupMs() const -> const double& { return m_shaderStartupMs; }
+
+    // frame `frame` of a fly-through that loops once every frameCount frames
+    void render(uint32_t frame, uint32_t frameCount, uint32_t width, uint32_t height);
+
+private:
+    void _setFrameUniforms(const Shader& shader,
+                           const glm::mat4& projection,
+                           const glm::mat4& view,
+                           const glm::vec3& viewPos,
+                           float time) const;
+
+    SceneSpec m_spec;
+    std::vector<std::unique_ptr<Shader>> m_programs;
+    std::vector<std::unique_ptr<IndexedMesh>> m_meshes;
+    GLuint m_whiteTexture {0};
+    float m_extent {0.0f};
+    double m_shaderStartupMs {0.0};
+};
+
+}
+#endif
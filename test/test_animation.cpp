@@ -0,0 +1,327 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <glfw_setup.h>
+#include <framebuffer.h>
+#include <animation.h>
+#include <mesh/skinned_mesh.h>
+#include <shadow_map.h>
+#include <environment.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include "test_fixtures.h"
+
+namespace {
+
+const std::string SHADER_DIRECTORY {"../src/glsl"};
+
+auto closeTo(const glm::vec3& a, const glm::vec3& b, float tolerance = 0.0001f) -> bool {
+    return glm::length(a - b) < tolerance;
+}
+
+auto transformPoint(const sjd::JointRows& joint, const glm::vec3& point) -> glm::vec3 {
+    glm::vec4 p {point, 1.0f};
+    return glm::vec3(glm::dot(joint.rows[0], p), glm::dot(joint.rows[1], p), glm::dot(joint.rows[2], p));
+}
+
+}
+
+TEST_CASE("Animation clips are sampled between keyframes"){
+    sjd::Skeleton skeleton {sjd::makeJointChain(2, 1.0f)};
+    REQUIRE( skeleton.isValid() );
+    sjd::AnimationClip clip {};
+    clip.duration = 2.0f;
+    sjd::AnimationTrack track {};
+    track.joint = 1;
+    track.times = {0.0f, 1.0f, 2.0f};
+    for (float x : {0.0f, 4.0f, 0.0f}) {
+        sjd::Transform key {skeleton.bindPose[1]};
+        key.position.x = x;
+        track.keys.push_back(key);
+    }
+    clip.tracks.push_back(track);
+    std::vector<sjd::Transform> pose;
+
+    WHEN("the time falls between two keys"){
+        clip.sample(skeleton, 0.25f, pose);
+        THEN("the keys are blended and untracked joints keep their bind pose"){
+            REQUIRE( pose.size() == 2 );
+            CHECK( closeTo(pose[0].position, glm::vec3(0.0f)) );
+            CHECK( closeTo(pose[1].position, glm::vec3(1.0f, 1.0f, 0.0f)) );
+        }
+    }
+    WHEN("a looping clip runs past its end"){
+        clip.sample(skeleton, 5.5f, pose);
+        THEN("it wraps round to the start"){
+            CHECK( closeTo(pose[1].position, glm::vec3(2.0f, 1.0f, 0.0f)) );
+        }
+    }
+    WHEN("a clip that doesn't loop runs past its end"){
+        clip.loop = false;
+        clip.sample(skeleton, 3.5f, pose);
+        THEN("it holds the last key"){
+            CHECK( closeTo(pose[1].position, glm::vec3(0.0f, 1.0f, 0.0f)) );
+        }
+    }
+}
+
+TEST_CASE("Joint hierarchies are evaluated from the root"){
+    sjd::Skeleton skeleton {sjd::makeJointChain(3, 1.0f)};
+    std::vector<sjd::Transform> pose {skeleton.bindPose};
+    std::vector<sjd::JointRows> palette(3);
+
+    GIVEN("the bind pose"){
+        sjd::computeSkinningPalette(skeleton, pose, glm::mat4(1.0f), palette.data());
+        THEN("every joint leaves the mesh where it is"){
+            for (const sjd::JointRows& joint : palette) {
+                CHECK( closeTo(transformPoint(joint, glm::vec3(0.3f, 1.7f, -0.2f)),
+                               glm::vec3(0.3f, 1.7f, -0.2f)) );
+            }
+        }
+    }
+    GIVEN("the root turned a quarter turn about z and a model offset"){
+        pose[0].rotation = glm::angleAxis(glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        glm::mat4 model {glm::translate(glm::mat4(1.0f), glm::vec3(10.0f, 0.0f, 0.0f))};
+        sjd::computeSkinningPalette(skeleton, pose, model, palette.data());
+        THEN("the whole chain follows the root and the model"){
+            // the tip joint rests 2 up the y axis, which now points along -x
+            CHECK( closeTo(transformPoint(palette[2], glm::vec3(0.0f, 2.0f, 0.0f)),
+                           glm::vec3(8.0f, 0.0f, 0.0f)) );
+            CHECK( closeTo(transformPoint(palette[1], glm::vec3(0.0f, 1.5f, 0.0f)),
+                           glm::vec3(8.5f, 0.0f, 0.0f)) );
+        }
+    }
+    GIVEN("only the middle joint turned"){
+        pose[1].rotation = glm::angleAxis(glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        sjd::computeSkinningPalette(skeleton, pose, glm::mat4(1.0f), palette.data());
+        THEN("the root is unaffected and the tip swings about the middle joint"){
+            CHECK( closeTo(transformPoint(palette[0], glm::vec3(0.0f, 0.5f, 0.0f)),
+                           glm::vec3(0.0f, 0.5f, 0.0f)) );
+            CHECK( closeTo(transformPoint(palette[2], glm::vec3(0.0f, 2.0f, 0.0f)),
+                           glm::vec3(-1.0f, 1.0f, 0.0f)) );
+        }
+    }
+}
+
+TEST_CASE("Characters are evaluated in parallel"){
+    sjd::Skeleton skeleton {sjd::makeJointChain(8, 0.5f)};
+    sjd::AnimationClip clip {sjd::makeSwayClip(skeleton, 1.5f, 0.4f)};
+    sjd::AnimationSystem serial {0};
+    sjd::AnimationSystem parallel {3};
+    REQUIRE( parallel.workerCount() == 3 );
+    for (int i {0}; i < 100; i++) {
+        sjd::AnimatedCharacter character {&skeleton, &clip};
+        character.model = glm::translate(glm::mat4(1.0f), glm::vec3(static_cast<float>(i), 0.0f, 0.0f));
+        character.time = 0.01f * static_cast<float>(i);
+        character.speed = 1.0f + 0.005f * static_cast<float>(i);
+        serial.addCharacter(character);
+        parallel.addCharacter(character);
+    }
+    for (int frame {0}; frame < 10; frame++) {
+        serial.update(1.0f / 60.0f);
+        parallel.update(1.0f / 60.0f);
+    }
+
+    THEN("each character has its own run of the palette"){
+        REQUIRE( parallel.palette().size() == 800 );
+        CHECK( parallel.paletteOffset(0) == 0 );
+        CHECK( parallel.paletteOffset(99) == 792 );
+    }
+    THEN("the palette is the same however many threads built it"){
+        bool same {true};
+        for (size_t joint {0}; joint < serial.palette().size(); joint++) {
+            for (int row {0}; row < 3; row++) {
+                same = same && serial.palette()[joint].rows[row] == parallel.palette()[joint].rows[row];
+            }
+        }
+        CHECK( same );
+        CHECK( std::abs(parallel.character(42).time - (0.42f + 10.0f / 60.0f * 1.21f)) < 0.0001f );
+    }
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "Skinned meshes are deformed on the GPU"){
+    REQUIRE( window != nullptr );
+    // with 6 joints the last two carry no weight but still take palette
+    // entries, so the instances' stride is the skeleton's and not the mesh's
+    auto skeletonJoints = GENERATE(4u, 6u);
+    INFO( skeletonJoints << " joint skeleton" );
+    sjd::Skeleton skeleton {sjd::makeJointChain(skeletonJoints, 1.0f)};
+    sjd::AnimationClip clip {sjd::makeSwayClip(skeleton, 2.0f, 0.6f)};
+    sjd::SkinnedMesh mesh {sjd::makeSkinnedCylinder(8, 7, 4, 1.0f)};
+    REQUIRE( mesh.usedJointCount() == 4 );
+    REQUIRE_FALSE( mesh.setInstances(sjd::makeJointChain(3, 1.0f), 0, 1) );
+    sjd::AnimationSystem animation {1};
+    for (int i {0}; i < 2; i++) {
+        sjd::AnimatedCharacter character {&skeleton, &clip};
+        character.model = glm::translate(glm::mat4(1.0f), glm::vec3(3.0f * static_cast<float>(i), 0.0f, 0.0f));
+        character.time = 0.3f + static_cast<float>(i);
+        animation.addCharacter(character);
+    }
+    animation.update(0.0f);
+    animation.upload();
+
+    // capture the skinned positions rather than rasterise them, so every
+    // vertex can be compared against the CPU
+    sjd::Shader shader {SHADER_DIRECTORY + "/skinned.lighting.vert.glsl",
+                        std::vector<std::string> {"fragPos"}};
+    REQUIRE( shader.isValid() );
+    shader.use();
+    shader.setUniform("view", glm::mat4(1.0f));
+    shader.setUniform("projection", glm::mat4(1.0f));
+    REQUIRE( mesh.setInstances(skeleton, animation.paletteOffset(0), 2) );
+    REQUIRE( mesh.jointCount() == skeletonJoints );
+    shader.setUniform("paletteOffset", static_cast<int>(animation.paletteOffset(0)));
+    shader.setUniform("jointCount", static_cast<int>(mesh.jointCount()));
+    animation.bindPalette();
+
+    const sjd::MeshData& data {mesh.data().mesh};
+    size_t captured {data.indices.size() * 2};
+    GLuint feedback {0};
+    glGenBuffers(1, &feedback);
+    glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, feedback);
+    glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, captured * sizeof(glm::vec3), nullptr, GL_STATIC_READ);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, feedback);
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBeginTransformFeedback(GL_TRIANGLES);
+    mesh.drawInstances();
+    glEndTransformFeedback();
+    glDisable(GL_RASTERIZER_DISCARD);
+    std::vector<glm::vec3> positions(captured);
+    glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, captured * sizeof(glm::vec3), positions.data());
+    glDeleteBuffers(1, &feedback);
+
+    THEN("each instance matches the CPU blend of its own joints"){
+        bool matches {true};
+        for (size_t instance {0}; instance < 2; instance++) {
+            const sjd::JointRows* joints {animation.palette().data() + animation.paletteOffset(instance)};
+            for (size_t i {0}; i < data.indices.size(); i++) {
+                uint32_t vertex {data.indices[i]};
+                glm::u8vec4 influences {mesh.data().joints[vertex]};
+                glm::vec4 weights {mesh.data().weights[vertex]};
+                glm::vec3 expected {0.0f};
+                for (int k {0}; k < 4; k++) {
+                    expected += weights[k] * transformPoint(joints[influences[k]], data.positions[vertex]);
+                }
+                // weights are quantised to bytes on upload
+                matches = matches && closeTo(positions[instance * data.indices.size() + i], expected, 0.02f);
+            }
+        }
+        CHECK( matches );
+    }
+    THEN("the animation actually moves the mesh"){
+        glm::vec3 tip {data.positions.back()};
+        CHECK( glm::length(positions[data.indices.size() - 1] - tip) > 0.1f );
+        CHECK( glGetError() == GL_NO_ERROR );
+    }
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "Skinned meshes draw with a lit material"){
+    REQUIRE( window != nullptr );
+    sjd::Framebuffer* target {sjd::headlessFramebuffer()};
+    sjd::Skeleton skeleton {sjd::makeJointChain(4, 1.0f)};
+    sjd::AnimationClip clip {sjd::makeSwayClip(skeleton, 2.0f, 0.6f)};
+    sjd::SkinnedMesh mesh {sjd::makeSkinnedCylinder(8, 7, 4, 1.0f)};
+    sjd::AnimationSystem animation {1};
+    animation.addCharacter(sjd::AnimatedCharacter {&skeleton, &clip});
+    animation.update(0.0f);
+    animation.upload();
+    REQUIRE( mesh.setInstances(skeleton, animation.paletteOffset(0), 1) );
+
+    sjd::Shader shader {SHADER_DIRECTORY + "/skinned.lighting.vert.glsl",
+                        SHADER_DIRECTORY + "/blinn_phong16.frag.glsl"};
+    REQUIRE( shader.isValid() );
+    GLint unit {-1};
+    glGetUniformiv(shader.id(), glGetUniformLocation(shader.id(), "jointPalette"), &unit);
+    CHECK( unit == sjd::JOINT_PALETTE_UNIT );
+
+    // a material texture on unit 0, where the palette used to be bound
+    GLuint white {0};
+    unsigned char texel[] {255, 255, 255, 255};
+    glGenTextures(1, &white);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, white);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glm::vec3 eye {0.0f, 2.0f, 8.0f};
+    shader.use();
+    shader.setUniform("viewPos", eye);
+    shader.setUniform("material.diffuse", 0);
+    shader.setUniform("material.specular", 0);
+    shader.setUniform("material.shininess", 32.0f);
+    shader.setUniform("dirLight.direction", glm::vec3(0.0f, -1.0f, 0.0f));
+    shader.setUniform("dirLight.ambient", glm::vec3(0.3f));
+    shader.setUniform("dirLight.diffuse", glm::vec3(0.5f));
+    shader.setUniform("dirLight.specular", glm::vec3(0.0f));
+    shader.setUniform("numPointLights", 0);
+    sjd::CascadedShadowMap::unbind(shader);
+    sjd::EnvironmentMap::unbind(shader);
+    animation.bindPalette();
+    while (glGetError() != GL_NO_ERROR) {}
+
+    target->bind();
+    glViewport(0, 0, target->width(), target->height());
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    GLuint query {0};
+    glGenQueries(1, &query);
+    glBeginQuery(GL_SAMPLES_PASSED, query);
+    mesh.draw(glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f),
+              glm::lookAt(eye, glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+              shader);
+    glEndQuery(GL_SAMPLES_PASSED);
+    CHECK( glGetError() == GL_NO_ERROR );
+    GLuint samples {0};
+    glGetQueryObjectuiv(query, GL_QUERY_RESULT, &samples);
+    CHECK( samples > 0 );
+
+    glDeleteQueries(1, &query);
+    glDeleteTextures(1, &white);
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "Animating 1000 characters", "[.][benchmark]"){
+    const uint32_t width {640};
+    const uint32_t height {360};
+    const uint32_t joints {32};
+    glfwSetWindowSize(window, width, height);
+    sjd::Framebuffer* target {sjd::headlessFramebuffer()};
+    sjd::Skeleton skeleton {sjd::makeJointChain(joints, 0.1f)};
+    sjd::AnimationClip clip {sjd::makeSwayClip(skeleton, 1.0f, 0.2f)};
+    sjd::SkinnedMesh mesh {sjd::makeSkinnedCylinder(12, joints * 2, joints, 0.1f)};
+    sjd::Shader shader {SHADER_DIRECTORY + "/skinned.lighting.vert.glsl",
+                        SHADER_DIRECTORY + "/depth_only.frag.glsl"};
+    REQUIRE( shader.isValid() );
+    glm::mat4 view {glm::lookAt(glm::vec3(0.0f, 20.0f, 60.0f), glm::vec3(0.0f),
+                                glm::vec3(0.0f, 1.0f, 0.0f))};
+    glm::mat4 projection {glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 200.0f)};
+
+    std::vector<uint32_t> workerCounts {0};
+    if (std::thread::hardware_concurrency() > 1) {
+        workerCounts.push_back(std::thread::hardware_concurrency() - 1);
+    }
+    for (uint32_t workers : workerCounts) {
+        sjd::AnimationSystem animation {workers};
+        for (int i {0}; i < 1000; i++) {
+            sjd::AnimatedCharacter character {&skeleton, &clip};
+            character.model = glm::translate(glm::mat4(1.0f),
+                                             glm::vec3(static_cast<float>(i % 40 - 20),
+                                                       0.0f,
+                                                       static_cast<float>(i / 40 - 12)));
+            character.time = 0.037f * static_cast<float>(i);
+            animation.addCharacter(character);
+        }
+        mesh.setInstances(skeleton, animation.paletteOffset(0), 1000);
+        std::string suffix {" (" + std::to_string(workers) + " workers)"};
+
+        BENCHMARK("update" + suffix){
+            animation.update(1.0f / 60.0f);
+        };
+        BENCHMARK("update, upload and draw" + suffix){
+            animation.update(1.0f / 60.0f);
+            animation.upload();
+            target->bind();
+            glViewport(0, 0, width, height);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            animation.bindPalette();
+            mesh.draw(projection, view, shader);
+            glFinish();
+        };
+    }
+}
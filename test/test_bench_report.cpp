@@ -0,0 +1,84 @@
+#include <catch2/catch_test_macros.hpp>
+#include <bench_report.h>
+#include <sstream>
+
+TEST_CASE("Percentiles use the nearest rank"){
+    std::vector<double> samples {5.0, 1.0, 4.0, 2.0, 3.0, 6.0, 7.0, 8.0, 9.0, 10.0};
+    CHECK( sjd::percentile(samples, 50.0) == 5.0 );
+    CHECK( sjd::percentile(samples, 95.0) == 10.0 );
+    CHECK( sjd::percentile(samples, 0.0) == 1.0 );
+    CHECK( sjd::percentile({}, 50.0) == 0.0 );
+}
+
+TEST_CASE("Bench results round-trip through a baseline file"){
+    std::vector<double> frameTimes(100, 10.0);
+    frameTimes.back() = 30.0;
+    sjd::BenchResult result {sjd::summarise("scene", frameTimes, 42, 12.5)};
+    CHECK( result.p50Ms == 10.0 );
+    CHECK( result.p99Ms == 10.0 );
+    CHECK( result.meanMs == 10.2 );
+
+    std::stringstream json;
+    sjd::writeBenchJson(json, {result}, 0.1);
+    auto baseline {sjd::parseBaseline(json.str())};
+    REQUIRE( baseline.has_value() );
+    CHECK( baseline->tolerance == 0.1 );
+    REQUIRE( baseline->scenes.count("scene") == 1 );
+    CHECK( baseline->scenes["scene"].drawCalls == 42 );
+    CHECK( baseline->scenes["scene"].p50Ms == 10.0 );
+    CHECK( baseline->scenes["scene"].shaderStartupMs == 12.5 );
+
+    WHEN("the baseline is malformed"){
+        THEN("parsing fails"){
+            CHECK( sjd::parseBaseline("{\"scenes\": {").error() == sjd::BENCH_ERROR::parse );
+            CHECK( sjd::readBaseline("no/such/file.json").error() == sjd::BENCH_ERROR::badFile );
+        }
+    }
+}
+
+TEST_CASE("Regressions are reported past the baseline tolerance"){
+    sjd::BenchBaseline baseline {};
+    baseline.tolerance = 0.2;
+    sjd::BenchResult expected {sjd::summarise("scene", std::vector<double>(10, 20.0), 100, 50.0)};
+    baseline.scenes["scene"] = expected;
+
+    WHEN("results are within tolerance"){
+        sjd::BenchResult result {sjd::summarise("scene", std::vector<double>(10, 23.0), 100, 55.0)};
+        THEN("nothing is reported"){
+            CHECK( sjd::findRegressions({result}, baseline).empty() );
+        }
+    }
+    WHEN("a tiny timing grows by more than the tolerance but less than the slack"){
+        baseline.scenes["scene"].shaderStartupMs = 1.0;
+        sjd::BenchResult result {sjd::summarise("scene", std::vector<double>(10, 20.0), 100, 2.5)};
+        THEN("nothing is reported"){
+            CHECK( sjd::findRegressions({result}, baseline).empty() );
+        }
+    }
+    WHEN("frame times and draw calls grow"){
+        sjd::BenchResult result {sjd::summarise("scene", std::vector<double>(10, 30.0), 101, 50.0)};
+        auto regressions {sjd::findRegressions({result}, baseline)};
+        THEN("each regressed metric is reported"){
+            REQUIRE( regressions.size() == 4 );
+            CHECK( regressions[0].metric == "p50_ms" );
+            CHECK( regressions[3].metric == "draw_calls" );
+            CHECK( regressions[3].measured == 101.0 );
+        }
+    }
+    WHEN("draw calls fall"){
+        sjd::BenchResult result {sjd::summarise("scene", std::vector<double>(10, 20.0), 99, 50.0)};
+        auto regressions {sjd::findRegressions({result}, baseline)};
+        THEN("the mismatch is reported as well"){
+            REQUIRE( regressions.size() == 1 );
+            CHECK( regressions[0].metric == "draw_calls" );
+            CHECK( regressions[0].baseline == 100.0 );
+            CHECK( regressions[0].measured == 99.0 );
+        }
+    }
+    WHEN("a scene has no baseline"){
+        sjd::BenchResult result {sjd::summarise("new scene", std::vector<double>(10, 99.0), 1, 1.0)};
+        THEN("it passes"){
+            CHECK( sjd::findRegressions({result}, baseline).empty() );
+        }
+    }
+}
@@ -0,0 +1,166 @@
+#include <catch2/catch_test_macros.hpp>
+#include <depth_prepass.h>
+#include <framebuffer.h>
+#include <glfw_setup.h>
+#include "test_fixtures.h"
+#include "test_meshes.h"
+
+// a mesh that never touches the GL, so draw ordering can be tested headless
+class PointMesh : public sjd::Mesh {
+public:
+    PointMesh(glm::vec3 location) { move(location); }
+    unsigned int defineVAOPointers() override { return 0; }
+    void bufferData() override {}
+    void draw([[maybe_unused]] glm::mat4 projection,
+              [[maybe_unused]] glm::mat4 view,
+              [[maybe_unused]] sjd::Shader& shader) override {}
+};
+
+TEST_CASE("Opaque meshes are sorted front to back"){
+    PointMesh far   {glm::vec3(0.0f, 0.0f, -20.0f)};
+    PointMesh mid   {glm::vec3(0.0f, 0.0f, -10.0f)};
+    PointMesh near  {glm::vec3(0.0f, 0.0f, -1.0f)};
+    PointMesh behind {glm::vec3(0.0f, 0.0f, 5.0f)};
+
+    WHEN("the camera is at the origin"){
+        std::vector<sjd::Mesh*> meshes {&far, &behind, &near, &mid};
+        sjd::sortFrontToBack(meshes, glm::vec3(0.0f));
+
+        THEN("the nearest mesh is drawn first regardless of direction"){
+            REQUIRE( meshes.size() == 4 );
+            CHECK( meshes[0] == &near );
+            CHECK( meshes[1] == &behind );
+            CHECK( meshes[2] == &mid );
+            CHECK( meshes[3] == &far );
+        }
+    }
+    WHEN("the camera moves past some of the meshes"){
+        std::vector<sjd::Mesh*> meshes {&near, &mid, &far};
+        sjd::sortFrontToBack(meshes, glm::vec3(0.0f, 0.0f, -18.0f));
+
+        THEN("the order follows the new camera position"){
+            CHECK( meshes[0] == &far );
+            CHECK( meshes[1] == &mid );
+            CHECK( meshes[2] == &near );
+        }
+    }
+    WHEN("two meshes are equally far away"){
+        PointMesh left  {glm::vec3(-3.0f, 0.0f, 0.0f)};
+        PointMesh right {glm::vec3(3.0f, 0.0f, 0.0f)};
+        std::vector<sjd::Mesh*> meshes {&right, &left};
+        sjd::sortFrontToBack(meshes, glm::vec3(0.0f));
+
+        THEN("their submission order is kept"){
+            CHECK( meshes[0] == &right );
+            CHECK( meshes[1] == &left );
+        }
+    }
+}
+
+TEST_CASE("Fragment statistics report the shading saved by the pre-pass"){
+    sjd::FragmentStats stats {};
+    CHECK( stats.shadedFragmentsSaved() == 0 );
+
+    stats.prePassSamples = 1000;
+    stats.colorPassSamples = 400;
+    CHECK( stats.shadedFragmentsSaved() == 600 );
+
+    stats.prePassSamples = 0;
+    CHECK( stats.shadedFragmentsSaved() == 0 );
+}
+
+namespace {
+
+// a cube with its own flat colour, which the colour pass sets before drawing
+class ColoredCube : public TestCube {
+public:
+    ColoredCube(glm::vec3 location, float size, glm::vec3 color)
+    :   TestCube {location, size},
+        m_color {color}
+    {}
+    void draw(glm::mat4 projection, glm::mat4 view, sjd::Shader& shader) override {
+        shader.use();
+        shader.setUniform("color", m_color);
+        TestCube::draw(projection, view, shader);
+    }
+private:
+    glm::vec3 m_color;
+};
+
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(WindowFixture, "The colour pass still renders after a depth pre-pass"){
+    REQUIRE( window != nullptr );
+    const uint32_t width {64};
+    const uint32_t height {48};
+    sjd::Framebuffer target {width, height};
+    REQUIRE( target.isValid() );
+    sjd::DepthPrePass prePass {"../src/glsl/depth_only.vert.glsl", "../src/glsl/depth_only.frag.glsl"};
+    REQUIRE( prePass.isValid() );
+    // the pre-pass's vertex shader, so both passes produce identical depths
+    sjd::Shader colorShader {"../src/glsl/depth_only.vert.glsl", "./test_shader_data/flat_color.frag.glsl"};
+    REQUIRE( colorShader.isValid() );
+
+    glm::vec3 eye {0.0f, 0.0f, 5.0f};
+    glm::mat4 projection {glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, 0.1f, 100.0f)};
+    glm::mat4 view {glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f))};
+    // a red cube in front of a green one that fills the whole view
+    ColoredCube front {glm::vec3(0.0f, 0.0f, 2.0f), 1.0f, glm::vec3(1.0f, 0.0f, 0.0f)};
+    ColoredCube back {glm::vec3(0.0f, 0.0f, -20.0f), 30.0f, glm::vec3(0.0f, 1.0f, 0.0f)};
+
+    // query results are read a frame late, so a few frames settle them
+    auto renderFrames = [&]{
+        for (int frame {0}; frame < 4; frame++) {
+            target.bind();
+            glViewport(0, 0, width, height);
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            std::vector<sjd::Mesh*> meshes {&back, &front};
+            prePass.render(projection, view, eye, meshes, colorShader);
+            glFinish();
+        }
+        return target.readPixels();
+    };
+    auto pixel = [&](const std::vector<uint8_t>& pixels, uint32_t x, uint32_t y){
+        const uint8_t* p {&pixels[(y * width + x) * 4]};
+        return glm::ivec3(p[0], p[1], p[2]);
+    };
+
+    // not the defaults, so restoring them wouldn't pass for restoring these
+    glDepthFunc(GL_LEQUAL);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_FALSE);
+    prePass.setEnabled(false);
+    std::vector<uint8_t> without {renderFrames()};
+    sjd::FragmentStats withoutStats {prePass.stats()};
+    prePass.setEnabled(true);
+    std::vector<uint8_t> with {renderFrames()};
+    sjd::FragmentStats withStats {prePass.stats()};
+
+    THEN("every surface passes the GL_EQUAL test and the image is unchanged"){
+        CHECK( pixel(with, width / 2, height / 2) == glm::ivec3(255, 0, 0) );
+        CHECK( pixel(with, 1, 1) == glm::ivec3(0, 255, 0) );
+        CHECK( sjd::countDifferentPixels(with, without, 0) == 0 );
+    }
+    THEN("the queries count the samples each pass let through"){
+        // drawn front to back, so each pass touches every pixel once
+        CHECK( withoutStats.prePassSamples == 0 );
+        CHECK( withoutStats.colorPassSamples == width * height );
+        CHECK( withStats.prePassSamples == width * height );
+        CHECK( withStats.colorPassSamples == width * height );
+    }
+    THEN("depth state is handed back as it was found"){
+        GLint depthFunc {0};
+        GLboolean depthMask {GL_FALSE};
+        GLboolean colorMask[4] {};
+        glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+        glGetBooleanv(GL_COLOR_WRITEMASK, colorMask);
+        CHECK( depthFunc == GL_LEQUAL );
+        CHECK( depthMask == GL_TRUE );
+        CHECK( colorMask[0] == GL_TRUE );
+        CHECK( colorMask[3] == GL_FALSE );
+        CHECK( glGetError() == GL_NO_ERROR );
+    }
+    glDepthFunc(GL_LESS);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
@@ -0,0 +1,279 @@
+#include <catch2/catch_test_macros.hpp>
+#include <glfw_setup.h>
+#include <framebuffer.h>
+#include <dynamic_resolution.h>
+#include <shader.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include "test_fixtures.h"
+
+namespace {
+
+// GPU cost of a frame that takes fullScaleMs at scale 1.0, with a few
+// percent of deterministic jitter
+auto simulatedFrameMs(double fullScaleMs, float scale, int frame) -> double {
+    double jitter {1.0 + 0.03 * std::sin(static_cast<double>(frame) * 1.7)};
+    return fullScaleMs * static_cast<double>(scale * scale) * jitter;
+}
+
+}
+
+TEST_CASE("The resolution controller holds a target frame time"){
+    sjd::DynamicResolutionSettings settings {};
+    settings.targetFrameMs = 16.0;
+
+    GIVEN("a controller at full scale"){
+        sjd::DynamicResolutionController controller {settings};
+        CHECK( controller.scale() == 1.0f );
+
+        WHEN("frames cost twice the target"){
+            controller.update(32.0);
+            THEN("it scales down on the first sample"){
+                CHECK( controller.lastChange() == sjd::SCALE_CHANGE::DOWN );
+                CHECK( controller.scale() < 0.71f );
+                CHECK( controller.scale() >= settings.minScale );
+            }
+        }
+        WHEN("the load can't be met even at the smallest scale"){
+            for (int frame {0}; frame < 100; frame++) {
+                controller.update(simulatedFrameMs(200.0, controller.scale(), frame));
+            }
+            THEN("it stops at minScale"){
+                CHECK( controller.scale() == settings.minScale );
+            }
+        }
+        WHEN("frames are well under budget"){
+            controller.update(4.0);
+            THEN("it stays at maxScale"){
+                CHECK( controller.scale() == settings.maxScale );
+                CHECK( controller.lastChange() == sjd::SCALE_CHANGE::NONE );
+            }
+        }
+    }
+    GIVEN("a controller that has been scaled down"){
+        sjd::DynamicResolutionController controller {settings};
+        controller.setScale(0.5f);
+        WHEN("the load drops"){
+            uint32_t framesBeforeUp {0};
+            while (controller.scale() == 0.5f && framesBeforeUp < 1000) {
+                controller.update(simulatedFrameMs(20.0, controller.scale(), framesBeforeUp));
+                framesBeforeUp++;
+            }
+            THEN("it waits for the headroom to settle before scaling up"){
+                CHECK( framesBeforeUp >= settings.cooldownFrames + settings.settleFrames );
+                CHECK( controller.lastChange() == sjd::SCALE_CHANGE::UP );
+                CHECK( controller.scale() > 0.5f );
+            }
+        }
+    }
+    GIVEN("a steady load near the target"){
+        sjd::DynamicResolutionController controller {settings};
+        int changes {0};
+        for (int frame {0}; frame < 600; frame++) {
+            controller.update(simulatedFrameMs(30.0, controller.scale(), frame));
+            if (frame >= 60 && controller.lastChange() != sjd::SCALE_CHANGE::NONE) {
+                changes++;
+            }
+        }
+        THEN("it converges without oscillating"){
+            CHECK( changes == 0 );
+            double settledMs {simulatedFrameMs(30.0, controller.scale(), 0)};
+            CHECK( settledMs <= settings.targetFrameMs * (1.0 + settings.overBudget) );
+            CHECK( settledMs >= settings.targetFrameMs * (1.0 - settings.underBudget) );
+        }
+    }
+    GIVEN("a narrower scale range"){
+        settings.minScale = 0.75f;
+        settings.maxScale = 0.9f;
+        sjd::DynamicResolutionController controller {settings};
+        THEN("scales stay inside it"){
+            CHECK( controller.scale() == 0.9f );
+            controller.update(100.0);
+            CHECK( controller.scale() == 0.75f );
+            controller.setScale(2.0f);
+            CHECK( controller.scale() == 0.9f );
+        }
+    }
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "Frames are rendered scaled and upscaled to the window"){
+    REQUIRE( window != nullptr );
+    sjd::Framebuffer* output {sjd::headlessFramebuffer()};
+    REQUIRE( output != nullptr );
+    sjd::DynamicResolution resolution {64, 64};
+    REQUIRE( resolution.isValid() );
+    CHECK( resolution.target().width() == 64 );
+
+    WHEN("the scale is halved"){
+        resolution.controller().setScale(0.5f);
+        resolution.beginFrame();
+        GLint viewport[4] {};
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        // only the scaled corner is drawn; the rest of the target is stale
+        glClearColor(0.0f, 0.0f, 1.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(0, 0, resolution.renderWidth(), resolution.renderHeight());
+        glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDisable(GL_SCISSOR_TEST);
+        resolution.endFrame(output->id());
+        std::vector<uint8_t> pixels {output->readPixels()};
+
+        THEN("the frame renders at half size and fills the window"){
+            CHECK( viewport[2] == 32 );
+            CHECK( viewport[3] == 32 );
+            std::vector<uint8_t> red(pixels.size());
+            for (size_t i {0}; i < red.size(); i += 4) {
+                red[i] = 255;
+                red[i + 3] = 255;
+            }
+            CHECK( sjd::countDifferentPixels(pixels, red) == 0 );
+            CHECK( glGetError() == GL_NO_ERROR );
+        }
+    }
+    WHEN("several frames complete"){
+        for (int frame {0}; frame < 6; frame++) {
+            resolution.beginFrame();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            resolution.endFrame(output->id());
+            glFinish();
+        }
+        THEN("their GPU times reach the controller"){
+            CHECK( resolution.controller().sampleCount() >= 3 );
+            CHECK( resolution.lastGpuFrameMs() > 0.0 );
+        }
+    }
+    WHEN("the window is resized"){
+        resolution.resize(128, 32);
+        resolution.beginFrame();
+        resolution.endFrame(output->id());
+        THEN("the target follows it"){
+            CHECK( resolution.target().width() == 128 );
+            CHECK( resolution.target().height() == 32 );
+            CHECK( resolution.renderWidth() == 128 );
+        }
+    }
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "Dynamic resolution under a load ramp", "[.][benchmark]"){
+    const uint32_t width {640};
+    const uint32_t height {360};
+    const int peakLoad {12};
+    glfwSetWindowSize(window, width, height);
+    sjd::Framebuffer* output {sjd::headlessFramebuffer()};
+    REQUIRE( output != nullptr );
+
+    // each unit of load is one fullscreen pass of the 13-tap bloom filter
+    sjd::Shader loadShader {"../src/glsl/fullscreen.vert.glsl",
+                            "../src/glsl/post_bloom_downsample.frag.glsl"};
+    REQUIRE( loadShader.isValid() );
+    GLuint emptyVao {0};
+    glGenVertexArrays(1, &emptyVao);
+    GLuint texture {0};
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    std::vector<uint8_t> noise(256 * 256 * 4);
+    for (size_t i {0}; i < noise.size(); i++) {
+        noise[i] = static_cast<uint8_t>((i * 2654435761u) >> 24);
+    }
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 256, 256, 0, GL_RGBA, GL_UNSIGNED_BYTE, noise.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // software rasterisers time command submission rather than drawing, so
+    // there the controller is fed the blocking CPU time of each frame
+    const char* renderer {reinterpret_cast<const char*>(glGetString(GL_RENDERER))};
+    bool software {renderer && (std::strstr(renderer, "llvmpipe") || std::strstr(renderer, "softpipe"))};
+
+    // returns the frame time the controller was fed
+    auto renderFrame = [&](sjd::DynamicResolution& resolution, int load){
+        auto start {std::chrono::steady_clock::now()};
+        resolution.beginFrame();
+        glDisable(GL_DEPTH_TEST);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glBindVertexArray(emptyVao);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        loadShader.use();
+        loadShader.setUniform("source", 0);
+        loadShader.setUniform("firstLevel", false);
+        loadShader.setUniform("sourceTexelSize", glm::vec2(1.0f / 256.0f));
+        for (int pass {0}; pass < load; pass++) {
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        glDisable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+        resolution.endFrame(output->id());
+        glFinish();
+        if (!software) {
+            return resolution.lastGpuFrameMs();
+        }
+        double cpuMs {std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count()};
+        resolution.controller().update(cpuMs);
+        return cpuMs;
+    };
+
+    // pin the scale at 1.0 to measure what the peak load costs
+    sjd::DynamicResolutionSettings calibration {};
+    calibration.minScale = 1.0f;
+    calibration.gpuTiming = !software;
+    sjd::DynamicResolution fixed {width, height, calibration};
+    double peakMs {0.0};
+    for (int frame {0}; frame < 8; frame++) {
+        peakMs = renderFrame(fixed, peakLoad);
+    }
+    REQUIRE( peakMs > 0.0 );
+
+    sjd::DynamicResolutionSettings settings {};
+    settings.targetFrameMs = peakMs * 0.5;
+    settings.gpuTiming = !software;
+    sjd::DynamicResolution resolution {width, height, settings};
+    std::cout << std::fixed << std::setprecision(2)
+              << "dynamic resolution on " << renderer << ", "
+              << (software ? "CPU" : "GPU") << " timing: peak load " << peakMs
+              << " ms at full scale, target " << settings.targetFrameMs << " ms\n"
+              << "frame, load, frame ms, smoothed ms, scale, change\n";
+
+    // ramp up, hold at the peak, then ramp back down
+    const int rampFrames {120};
+    int overBudgetFrames {0};
+    float lowestScale {settings.maxScale};
+    for (int frame {0}; frame < rampFrames * 3; frame++) {
+        int load {peakLoad};
+        if (frame < rampFrames) {
+            load = 1 + (peakLoad - 1) * frame / rampFrames;
+        }
+        else if (frame >= rampFrames * 2) {
+            load = peakLoad - (peakLoad - 1) * (frame - rampFrames * 2) / rampFrames;
+        }
+        double frameMs {renderFrame(resolution, load)};
+
+        const sjd::DynamicResolutionController& controller {resolution.controller()};
+        lowestScale = std::min(lowestScale, controller.scale());
+        if (frameMs > settings.targetFrameMs * (1.0 + settings.overBudget)) {
+            overBudgetFrames++;
+        }
+        if (frame % 10 == 0 || controller.lastChange() != sjd::SCALE_CHANGE::NONE) {
+            const char* change {controller.lastChange() == sjd::SCALE_CHANGE::DOWN ? "down"
+                                : controller.lastChange() == sjd::SCALE_CHANGE::UP ? "up"
+                                : ""};
+            std::cout << frame << ", " << load << ", " << frameMs << ", "
+                      << controller.smoothedMs() << ", " << controller.scale() << ", "
+                      << change << "\n";
+        }
+    }
+    std::cout << "frames over budget: " << overBudgetFrames << " of " << rampFrames * 3 << "\n";
+    CHECK( lowestScale < settings.maxScale );
+    CHECK( resolution.scale() > lowestScale );
+    CHECK( overBudgetFrames < rampFrames * 3 / 4 );
+
+    glDeleteTextures(1, &texture);
+    glDeleteVertexArrays(1, &emptyVao);
+}
@@ -0,0 +1,535 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <glfw_setup.h>
+#include <framebuffer.h>
+#include <environment.h>
+#include <shadow_map.h>
+#include <mesh/indexed_mesh.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include "test_fixtures.h"
+
+namespace {
+
+const std::string SHADER_DIRECTORY {"../src/glsl"};
+
+auto closeTo(const glm::vec3& a, const glm::vec3& b, float relative) -> bool {
+    return glm::length(a - b) <= relative * std::max(glm::length(b), 0.01f);
+}
+
+// small enough to convolve quickly on a software rasteriser
+auto smallSettings() -> sjd::EnvironmentSettings {
+    sjd::EnvironmentSettings settings {};
+    settings.sourceSize = 64;
+    settings.irradianceSize = 8;
+    settings.prefilterSize = 16;
+    settings.prefilterLevels = 3;
+    settings.sampleCount = 64;
+    return settings;
+}
+
+// blue above, red below and no sun, so directions are easy to tell apart
+auto twoToneSky() -> sjd::SkySettings {
+    sjd::SkySettings sky {};
+    sky.zenith = glm::vec3(0.0f, 0.0f, 1.0f);
+    sky.horizon = glm::vec3(0.0f, 0.2f, 0.6f);
+    sky.ground = glm::vec3(0.8f, 0.0f, 0.0f);
+    sky.sunColor = glm::vec3(0.0f);
+    return sky;
+}
+
+auto sampleCache(const std::vector<uint32_t>& faces,
+                 size_t levelOffset,
+                 uint32_t size,
+                 uint32_t face,
+                 uint32_t x,
+                 uint32_t y) -> glm::vec3 {
+    return sjd::unpackRgb9e5(faces[levelOffset + face * size * size + y * size + x]);
+}
+
+// a 1x1 white texture for both material maps
+auto whiteTexture() -> GLuint {
+    GLuint white {0};
+    unsigned char texel[] {255, 255, 255, 255};
+    glGenTextures(1, &white);
+    glBindTexture(GL_TEXTURE_2D, white);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    return white;
+}
+
+// a white material lit by ambient light alone, textures on units 0 and 1
+// and the shadow map off
+void setAmbientOnly(const sjd::Shader& shader, GLuint white, const glm::vec3& eye) {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, white);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, white);
+    shader.use();
+    shader.setUniform("viewPos", eye);
+    shader.setUniform("material.diffuse", 0);
+    shader.setUniform("material.specular", 1);
+    shader.setUniform("material.shininess", 32.0f);
+    shader.setUniform("dirLight.direction", glm::vec3(0.0f, -1.0f, 0.0f));
+    shader.setUniform("dirLight.ambient", glm::vec3(0.3f));
+    shader.setUniform("dirLight.diffuse", glm::vec3(0.0f));
+    shader.setUniform("dirLight.specular", glm::vec3(0.0f));
+    shader.setUniform("numPointLights", 0);
+    sjd::CascadedShadowMap::unbind(shader);
+}
+
+}
+
+TEST_CASE("HDR colors are packed with a shared exponent"){
+    WHEN("a color is exactly representable"){
+        glm::vec3 color {1.0f, 0.5f, 0.25f};
+        THEN("it survives the round trip unchanged"){
+            CHECK( sjd::unpackRgb9e5(sjd::packRgb9e5(color)) == color );
+        }
+    }
+    WHEN("colors cover a wide range"){
+        std::mt19937 random {7};
+        std::uniform_real_distribution<float> exponent {-8.0f, 12.0f};
+        std::uniform_real_distribution<float> channel {0.0f, 1.0f};
+        bool accurate {true};
+        for (int i {0}; i < 1000; i++) {
+            glm::vec3 color {glm::vec3(channel(random), channel(random), channel(random))
+                             * std::exp2(exponent(random))};
+            glm::vec3 error {glm::abs(sjd::unpackRgb9e5(sjd::packRgb9e5(color)) - color)};
+            float largest {std::max(color.x, std::max(color.y, color.z))};
+            // half a step of a 9 bit mantissa scaled to the largest channel
+            accurate = accurate && std::max(error.x, std::max(error.y, error.z)) <= largest / 256.0f;
+        }
+        THEN("each channel is within the largest channel's precision"){
+            CHECK( accurate );
+        }
+    }
+    WHEN("a color is out of range"){
+        THEN("negatives clamp to zero and huge values to the largest"){
+            CHECK( sjd::packRgb9e5(glm::vec3(-1.0f, 0.0f, -5.0f)) == 0 );
+            CHECK( sjd::unpackRgb9e5(sjd::packRgb9e5(glm::vec3(1e9f))) == glm::vec3(65408.0f) );
+        }
+    }
+}
+
+TEST_CASE("Cube face texels map to directions in GL order"){
+    THEN("face centres point along the axes"){
+        CHECK( sjd::cubeFaceDirection(0, glm::vec2(0.5f)) == glm::vec3(1.0f, 0.0f, 0.0f) );
+        CHECK( sjd::cubeFaceDirection(1, glm::vec2(0.5f)) == glm::vec3(-1.0f, 0.0f, 0.0f) );
+        CHECK( sjd::cubeFaceDirection(2, glm::vec2(0.5f)) == glm::vec3(0.0f, 1.0f, 0.0f) );
+        CHECK( sjd::cubeFaceDirection(3, glm::vec2(0.5f)) == glm::vec3(0.0f, -1.0f, 0.0f) );
+        CHECK( sjd::cubeFaceDirection(4, glm::vec2(0.5f)) == glm::vec3(0.0f, 0.0f, 1.0f) );
+        CHECK( sjd::cubeFaceDirection(5, glm::vec2(0.5f)) == glm::vec3(0.0f, 0.0f, -1.0f) );
+    }
+    THEN("the first row of the side faces is the top one"){
+        CHECK( sjd::cubeFaceDirection(0, glm::vec2(0.0f)) == glm::vec3(1.0f, 1.0f, 1.0f) );
+        CHECK( sjd::cubeFaceDirection(4, glm::vec2(0.0f)) == glm::vec3(-1.0f, 1.0f, 1.0f) );
+    }
+}
+
+TEST_CASE("Environment caches are read back only when they match"){
+    sjd::EnvironmentCache cache {};
+    cache.key = 42;
+    cache.irradianceSize = 2;
+    cache.prefilterSize = 4;
+    cache.prefilterLevels = 2;
+    for (uint32_t i {0}; i < 6 * 4; i++) {
+        cache.irradiance.push_back(sjd::packRgb9e5(glm::vec3(static_cast<float>(i))));
+    }
+    for (uint32_t i {0}; i < 6 * (16 + 4); i++) {
+        cache.prefiltered.push_back(sjd::packRgb9e5(glm::vec3(0.5f * static_cast<float>(i))));
+    }
+    std::stringstream stream {};
+    sjd::writeEnvironmentCache(stream, cache);
+    std::string bytes {stream.str()};
+
+    WHEN("the key matches"){
+        std::istringstream in {bytes};
+        auto read {sjd::readEnvironmentCache(in, 42)};
+        THEN("every map comes back as written"){
+            REQUIRE( read.has_value() );
+            CHECK( read->prefilterLevels == 2 );
+            CHECK( read->irradiance == cache.irradiance );
+            CHECK( read->prefiltered == cache.prefiltered );
+        }
+    }
+    WHEN("it was made from something else"){
+        std::istringstream in {bytes};
+        THEN("it is stale"){
+            CHECK( sjd::readEnvironmentCache(in, 43).error() == sjd::ENVIRONMENT_ERROR::staleKey );
+        }
+    }
+    WHEN("the file is cut short"){
+        std::istringstream in {bytes.substr(0, bytes.size() - 1)};
+        THEN("it is truncated"){
+            CHECK( sjd::readEnvironmentCache(in, 42).error() == sjd::ENVIRONMENT_ERROR::truncated );
+        }
+    }
+    WHEN("the file is something else entirely"){
+        std::istringstream in {"not an environment cache"};
+        std::istringstream empty {""};
+        THEN("its header is rejected"){
+            CHECK( sjd::readEnvironmentCache(in, 42).error() == sjd::ENVIRONMENT_ERROR::badHeader );
+            CHECK( sjd::readEnvironmentCache(empty, 42).error() == sjd::ENVIRONMENT_ERROR::badFile );
+        }
+    }
+    WHEN("the format version changes"){
+        std::string newer {bytes};
+        newer[4] = 2;
+        std::istringstream in {newer};
+        THEN("the old cache is not trusted"){
+            CHECK( sjd::readEnvironmentCache(in, 42).error() == sjd::ENVIRONMENT_ERROR::version );
+        }
+    }
+    THEN("the key follows the sky and the settings but not the intensity"){
+        sjd::SkySettings sky {};
+        sjd::EnvironmentSettings settings {};
+        uint64_t key {sjd::environmentCacheKey(sky, settings)};
+        settings.intensity = 2.0f;
+        CHECK( sjd::environmentCacheKey(sky, settings) == key );
+        settings.sampleCount++;
+        CHECK( sjd::environmentCacheKey(sky, settings) != key );
+        sky.sunDirection.x += 0.1f;
+        CHECK( sjd::environmentCacheKey(sky, sjd::EnvironmentSettings {}) != key );
+    }
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "Environment maps are convolved from the sky"){
+    REQUIRE( window != nullptr );
+    sjd::EnvironmentMap environment {SHADER_DIRECTORY, smallSettings()};
+
+    GIVEN("a sky of one color"){
+        sjd::SkySettings sky {};
+        sky.zenith = sky.horizon = sky.ground = glm::vec3(0.6f, 0.3f, 0.1f);
+        sky.sunColor = glm::vec3(0.0f);
+        sjd::EnvironmentCache cache {environment.generate(sky)};
+        REQUIRE( environment.isValid() );
+        THEN("irradiance and every prefiltered level are that color"){
+            bool uniform {true};
+            for (uint32_t texel : cache.irradiance) {
+                uniform = uniform && closeTo(sjd::unpackRgb9e5(texel), sky.zenith, 0.02f);
+            }
+            for (uint32_t texel : cache.prefiltered) {
+                uniform = uniform && closeTo(sjd::unpackRgb9e5(texel), sky.zenith, 0.02f);
+            }
+            CHECK( uniform );
+            CHECK( environment.prefilterLevels() == 3 );
+        }
+    }
+    GIVEN("a sky that is blue above and red below"){
+        sjd::SkySettings sky {twoToneSky()};
+        sjd::EnvironmentCache cache {environment.generate(sky)};
+        THEN("the sharpest level is the sky itself, face for face"){
+            bool matches {true};
+            for (uint32_t face {0}; face < 6; face++) {
+                for (uint32_t y {0}; y < 16; y++) {
+                    for (uint32_t x {0}; x < 16; x++) {
+                        glm::vec2 uv {(static_cast<float>(x) + 0.5f) / 16.0f,
+                                      (static_cast<float>(y) + 0.5f) / 16.0f};
+                        glm::vec3 expected {sjd::skyRadiance(sky, sjd::cubeFaceDirection(face, uv))};
+                        matches = matches && closeTo(sampleCache(cache.prefiltered, 0, 16, face, x, y),
+                                                     expected, 0.1f);
+                    }
+                }
+            }
+            CHECK( matches );
+        }
+        THEN("upward normals gather blue and downward ones red"){
+            glm::vec3 up {sampleCache(cache.irradiance, 0, 8, 2, 4, 4)};
+            glm::vec3 down {sampleCache(cache.irradiance, 0, 8, 3, 4, 4)};
+            glm::vec3 side {sampleCache(cache.irradiance, 0, 8, 0, 4, 4)};
+            CHECK( up.z > 0.5f );
+            CHECK( up.x < 0.05f );
+            CHECK( std::abs(down.x - 0.8f) < 0.02f );
+            CHECK( down.z < 0.01f );
+            // about half sky and half ground; the texel leans a little down
+            CHECK( std::abs(side.x - 0.4f) < 0.1f );
+        }
+        THEN("rougher levels are blurrier"){
+            // just above the horizon, where sky meets ground
+            glm::vec3 sharp {sampleCache(cache.prefiltered, 0, 16, 0, 8, 7)};
+            glm::vec3 rough {sampleCache(cache.prefiltered, 6 * (256 + 64), 4, 0, 2, 1)};
+            CHECK( sharp.x < 0.01f );
+            CHECK( rough.x > 0.1f );
+        }
+    }
+    CHECK( glGetError() == GL_NO_ERROR );
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "Environment maps are cached on disk"){
+    REQUIRE( window != nullptr );
+    std::string path {(std::filesystem::temp_directory_path() / "mage_environment_test.bin").string()};
+    std::remove(path.c_str());
+    sjd::SkySettings sky {twoToneSky()};
+
+    sjd::EnvironmentMap first {SHADER_DIRECTORY, smallSettings()};
+    first.loadOrGenerate(sky, path);
+    REQUIRE( first.isValid() );
+    CHECK_FALSE( first.loadedFromCache() );
+    REQUIRE( std::filesystem::exists(path) );
+
+    WHEN("the same sky is loaded again"){
+        sjd::EnvironmentMap second {SHADER_DIRECTORY, smallSettings()};
+        second.loadOrGenerate(sky, path);
+        THEN("it comes from the cache and matches texel for texel"){
+            CHECK( second.loadedFromCache() );
+            CHECK( second.prefilterLevels() == first.prefilterLevels() );
+            for (uint32_t level {0}; level < 3; level++) {
+                uint32_t size {16u >> level};
+                std::vector<uint32_t> a(size * size);
+                std::vector<uint32_t> b(size * size);
+                glBindTexture(GL_TEXTURE_CUBE_MAP, first.prefilteredMap());
+                glGetTexImage(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, level, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, a.data());
+                glBindTexture(GL_TEXTURE_CUBE_MAP, second.prefilteredMap());
+                glGetTexImage(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, level, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, b.data());
+                CHECK( a == b );
+            }
+        }
+    }
+    WHEN("the sky changes"){
+        sky.ground = glm::vec3(0.0f, 0.5f, 0.0f);
+        sjd::EnvironmentMap changed {SHADER_DIRECTORY, smallSettings()};
+        changed.loadOrGenerate(sky, path);
+        THEN("the stale cache is regenerated"){
+            CHECK_FALSE( changed.loadedFromCache() );
+            std::ifstream file {path, std::ios::binary};
+            CHECK( sjd::readEnvironmentCache(file, sjd::environmentCacheKey(sky, changed.settings())).has_value() );
+        }
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "The skybox only fills uncovered pixels"){
+    REQUIRE( window != nullptr );
+    sjd::Framebuffer* target {sjd::headlessFramebuffer()};
+    REQUIRE( target != nullptr );
+    sjd::EnvironmentMap environment {SHADER_DIRECTORY, smallSettings()};
+    environment.generate(twoToneSky());
+    sjd::Skybox skybox {SHADER_DIRECTORY};
+    REQUIRE( skybox.isValid() );
+    glm::mat4 projection {glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f)};
+
+    auto render = [&](const glm::vec3& forward, const glm::vec3& up) {
+        target->bind();
+        glViewport(0, 0, target->width(), target->height());
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClearDepth(1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // stand in for geometry over the left half
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(0, 0, target->width() / 2, target->height());
+        glClearDepth(0.5f);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glClearDepth(1.0f);
+        glDisable(GL_SCISSOR_TEST);
+        skybox.draw(glm::lookAt(glm::vec3(5.0f), glm::vec3(5.0f) + forward, up),
+                    projection, environment.prefilteredMap());
+        return target->readPixels();
+    };
+    auto pixel = [&](const std::vector<uint8_t>& pixels, uint32_t x, uint32_t y) -> const uint8_t* {
+        return pixels.data() + (y * target->width() + x) * 4;
+    };
+    uint32_t right {target->width() * 3 / 4};
+    uint32_t middle {target->height() / 2};
+
+    WHEN("looking up"){
+        std::vector<uint8_t> pixels {render(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f))};
+        THEN("the uncovered half shows the zenith and the covered half is untouched"){
+            CHECK( pixel(pixels, right, middle)[2] > 200 );
+            CHECK( pixel(pixels, right, middle)[0] == 0 );
+            CHECK( pixel(pixels, target->width() / 4, middle)[2] == 0 );
+        }
+    }
+    WHEN("looking down"){
+        std::vector<uint8_t> pixels {render(glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f))};
+        THEN("it shows the ground"){
+            CHECK( pixel(pixels, right, middle)[0] > 150 );
+            CHECK( pixel(pixels, right, middle)[2] == 0 );
+        }
+    }
+    WHEN("looking at the horizon"){
+        std::vector<uint8_t> pixels {render(glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f))};
+        THEN("the sky is above the ground"){
+            CHECK( pixel(pixels, right, target->height() - 4)[2] > 100 );
+            CHECK( pixel(pixels, right, 3)[0] > 150 );
+        }
+    }
+    THEN("depth state is restored"){
+        GLint depthFunc {0};
+        GLboolean depthMask {GL_FALSE};
+        glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+        CHECK( depthFunc == GL_LESS );
+        CHECK( depthMask == GL_TRUE );
+        CHECK( glGetError() == GL_NO_ERROR );
+    }
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "Blinn-Phong takes its ambient light from the environment"){
+    REQUIRE( window != nullptr );
+    sjd::Framebuffer* target {sjd::headlessFramebuffer()};
+    sjd::Shader shader {SHADER_DIRECTORY + "/simple.lighting.vert.glsl",
+                        SHADER_DIRECTORY + "/blinn_phong16.frag.glsl"};
+    REQUIRE( shader.isValid() );
+    sjd::EnvironmentMap environment {SHADER_DIRECTORY, smallSettings()};
+    environment.generate(twoToneSky());
+    sjd::IndexedMesh sphere {sjd::makeUvSphere(32, 16)};
+
+    GLuint white {whiteTexture()};
+    glm::vec3 eye {0.0f, 0.0f, 3.0f};
+    glm::mat4 view {glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f))};
+    glm::mat4 projection {glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f)};
+    setAmbientOnly(shader, white, eye);
+
+    auto render = [&]() {
+        target->bind();
+        glViewport(0, 0, target->width(), target->height());
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        sphere.draw(projection, view, shader);
+        return target->readPixels();
+    };
+    auto pixel = [&](const std::vector<uint8_t>& pixels, uint32_t x, uint32_t y) -> const uint8_t* {
+        return pixels.data() + (y * target->width() + x) * 4;
+    };
+    // a third of the way from the centre to the top and bottom of the sphere
+    uint32_t x {target->width() / 2};
+    uint32_t top {target->height() / 2 + target->height() / 6};
+    uint32_t bottom {target->height() / 2 - target->height() / 6};
+
+    WHEN("there is no environment"){
+        sjd::EnvironmentMap::unbind(shader);
+        std::vector<uint8_t> pixels {render()};
+        THEN("the flat ambient term lights it evenly"){
+            CHECK( pixel(pixels, x, top)[0] == pixel(pixels, x, bottom)[0] );
+            CHECK( pixel(pixels, x, top)[0] == pixel(pixels, x, top)[2] );
+            CHECK( pixel(pixels, x, top)[0] > 0 );
+        }
+    }
+    WHEN("the environment is bound"){
+        environment.bind(shader);
+        std::vector<uint8_t> pixels {render()};
+        THEN("the top is lit by the sky and the bottom by the ground"){
+            CHECK( pixel(pixels, x, top)[2] > pixel(pixels, x, top)[0] );
+            CHECK( pixel(pixels, x, bottom)[0] > pixel(pixels, x, bottom)[2] );
+        }
+    }
+    CHECK( glGetError() == GL_NO_ERROR );
+    glDeleteTextures(1, &white);
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "A lighting shader's environment maps have units of their own"){
+    REQUIRE( window != nullptr );
+    sjd::Framebuffer* target {sjd::headlessFramebuffer()};
+    sjd::Shader shader {SHADER_DIRECTORY + "/simple.lighting.vert.glsl",
+                        SHADER_DIRECTORY + "/blinn_phong16.frag.glsl"};
+    REQUIRE( shader.isValid() );
+    auto boundCubemap = [](GLint unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        GLint bound {0};
+        glGetIntegerv(GL_TEXTURE_BINDING_CUBE_MAP, &bound);
+        glActiveTexture(GL_TEXTURE0);
+        return bound;
+    };
+
+    THEN("the samplers are on the reserved units as soon as the shader is linked"){
+        GLint unit {-1};
+        glGetUniformiv(shader.id(), glGetUniformLocation(shader.id(), "irradianceMap"), &unit);
+        CHECK( unit == sjd::IRRADIANCE_MAP_UNIT );
+        glGetUniformiv(shader.id(), glGetUniformLocation(shader.id(), "prefilteredMap"), &unit);
+        CHECK( unit == sjd::PREFILTERED_MAP_UNIT );
+    }
+    THEN("it draws with a material texture bound and no environment set up"){
+        sjd::IndexedMesh sphere {sjd::makeUvSphere(8, 4)};
+        GLuint white {whiteTexture()};
+        glm::vec3 eye {0.0f, 0.0f, 3.0f};
+        setAmbientOnly(shader, white, eye);
+        while (glGetError() != GL_NO_ERROR) {}
+        target->bind();
+        glViewport(0, 0, target->width(), target->height());
+        sphere.draw(glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f),
+                    glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+                    shader);
+        CHECK( glGetError() == GL_NO_ERROR );
+        glDeleteTextures(1, &white);
+    }
+    THEN("complete fallbacks are bound there until an environment is"){
+        GLint fallback {boundCubemap(sjd::IRRADIANCE_MAP_UNIT)};
+        CHECK( fallback != 0 );
+        CHECK( boundCubemap(sjd::PREFILTERED_MAP_UNIT) == fallback );
+
+        sjd::EnvironmentMap environment {SHADER_DIRECTORY, smallSettings()};
+        environment.generate(twoToneSky());
+        environment.bind(shader);
+        CHECK( boundCubemap(sjd::IRRADIANCE_MAP_UNIT) == static_cast<GLint>(environment.irradianceMap()) );
+        CHECK( boundCubemap(sjd::PREFILTERED_MAP_UNIT) == static_cast<GLint>(environment.prefilteredMap()) );
+
+        sjd::EnvironmentMap::unbind(shader);
+        CHECK( boundCubemap(sjd::IRRADIANCE_MAP_UNIT) == fallback );
+        CHECK( boundCubemap(sjd::PREFILTERED_MAP_UNIT) == fallback );
+        CHECK( glGetError() == GL_NO_ERROR );
+    }
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "Environment startup and per-frame cost", "[.][benchmark]"){
+    const uint32_t width {640};
+    const uint32_t height {360};
+    glfwSetWindowSize(window, width, height);
+    sjd::Framebuffer* target {sjd::headlessFramebuffer()};
+    std::string path {(std::filesystem::temp_directory_path() / "mage_environment_bench.bin").string()};
+    sjd::SkySettings sky {};
+    sjd::EnvironmentMap environment {SHADER_DIRECTORY};
+    environment.loadOrGenerate(sky, path);
+
+    BENCHMARK("generate"){
+        return environment.generate(sky).prefiltered.size();
+    };
+    BENCHMARK("load from cache"){
+        environment.loadOrGenerate(sky, path);
+        return environment.loadedFromCache();
+    };
+
+    sjd::Skybox skybox {SHADER_DIRECTORY};
+    glm::mat4 view {glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.2f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f))};
+    glm::mat4 projection {glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f)};
+    target->bind();
+    glViewport(0, 0, width, height);
+    BENCHMARK("skybox, whole screen"){
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        skybox.draw(view, projection, environment.prefilteredMap());
+        glFinish();
+    };
+    BENCHMARK("skybox, screen already covered"){
+        glClearDepth(0.5f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glClearDepth(1.0f);
+        skybox.draw(view, projection, environment.prefilteredMap());
+        glFinish();
+    };
+
+    sjd::Shader shader {SHADER_DIRECTORY + "/simple.lighting.vert.glsl",
+                        SHADER_DIRECTORY + "/blinn_phong16.frag.glsl"};
+    sjd::IndexedMesh sphere {sjd::makeUvSphere(64, 32)};
+    GLuint white {whiteTexture()};
+    glm::vec3 eye {0.0f, 0.0f, 1.8f};
+    glm::mat4 sphereView {glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f))};
+    setAmbientOnly(shader, white, eye);
+    // the sphere fills most of the screen, so this is mostly shading cost
+    sjd::EnvironmentMap::unbind(shader);
+    BENCHMARK("lit sphere, flat ambient"){
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        sphere.draw(projection, sphereView, shader);
+        glFinish();
+    };
+    environment.bind(shader);
+    BENCHMARK("lit sphere, environment ambient"){
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        sphere.draw(projection, sphereView, shader);
+        glFinish();
+    };
+    glDeleteTextures(1, &white);
+    std::remove(path.c_str());
+}
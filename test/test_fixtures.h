@@ -0,0 +1,40 @@
+#ifndef TEST_FIXTURES_H
+#define TEST_FIXTURES_H
+#include <glfw_setup.h>
+#include <render_context.h>
+
+// Persistent fixtures for tests that need a current GL context, one per
+// kind of window, set up for the renderer as an application would.
+// terminateGlfw() frees the headless target while its context is still
+// current.
+
+// the usual 800x600 window, or a headless context when
+// MAGE_CONTEXT_BACKEND asks for one
+struct WindowFixture {
+    mutable GLFWwindow* window = sjd::createCursorLockedWindow(800, 600, "test_window");
+    WindowFixture(){
+        if (window) {
+            sjd::initRenderContext();
+        }
+    }
+    ~WindowFixture(){
+        sjd::terminateGlfw();
+    }
+};
+
+// an EGL context rendering into its headless framebuffer, 4:3 like the
+// window
+struct HeadlessFixture {
+    mutable GLFWwindow* window = sjd::createCursorLockedWindow(64, 48, "test_window", 1,
+                                                               sjd::CONTEXT_BACKEND::EGL);
+    HeadlessFixture(){
+        if (window) {
+            sjd::initRenderContext();
+        }
+    }
+    ~HeadlessFixture(){
+        sjd::terminateGlfw();
+    }
+};
+
+#endif
@@ -0,0 +1,315 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <glfw_setup.h>
+#include <framebuffer.h>
+#include <frame_capture.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include "test_fixtures.h"
+
+namespace {
+
+auto readBigEndian(const std::vector<uint8_t>& data, size_t offset) -> uint32_t {
+    return (static_cast<uint32_t>(data[offset]) << 24) | (static_cast<uint32_t>(data[offset + 1]) << 16)
+         | (static_cast<uint32_t>(data[offset + 2]) << 8) | static_cast<uint32_t>(data[offset + 3]);
+}
+
+// bit at a time, so it shares nothing with the encoder's table
+auto pngCrc(std::vector<uint8_t>::const_iterator begin, std::vector<uint8_t>::const_iterator end) -> uint32_t {
+    uint32_t crc {0xffffffffu};
+    for (auto byte {begin}; byte != end; byte++) {
+        crc ^= *byte;
+        for (int bit {0}; bit < 8; bit++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320u : 0u);
+        }
+    }
+    return crc ^ 0xffffffffu;
+}
+
+auto adler32(const std::vector<uint8_t>& data) -> uint32_t {
+    uint32_t a {1};
+    uint32_t b {0};
+    for (uint8_t byte : data) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+struct DecodedPng {
+    uint32_t width {0};
+    uint32_t height {0};
+    // RGB rows, top row first
+    std::vector<uint8_t> rgb;
+    bool valid {false};
+};
+
+// reads back what encodePng writes: one IDAT of stored deflate blocks,
+// checking every chunk's CRC and the zlib stream's Adler-32
+auto decodeStoredPng(const std::vector<uint8_t>& png) -> DecodedPng {
+    DecodedPng decoded {};
+    const std::vector<uint8_t> signature {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    if (png.size() < 8 || !std::equal(signature.begin(), signature.end(), png.begin())) {
+        return decoded;
+    }
+    std::vector<uint8_t> zlib;
+    bool ended {false};
+    for (size_t offset {8}; offset + 12 <= png.size();) {
+        uint32_t length {readBigEndian(png, offset)};
+        if (offset + 12 + length > png.size()) {
+            return decoded;
+        }
+        std::string type(png.begin() + offset + 4, png.begin() + offset + 8);
+        auto data {png.begin() + offset + 8};
+        if (pngCrc(data - 4, data + length) != readBigEndian(png, offset + 8 + length)) {
+            return decoded;
+        }
+        ended = type == "IEND";
+        if (type == "IHDR") {
+            decoded.width = readBigEndian(png, offset + 8);
+            decoded.height = readBigEndian(png, offset + 12);
+        }
+        else if (type == "IDAT") {
+            zlib.insert(zlib.end(), data, data + length);
+        }
+        offset += 12 + length;
+    }
+    std::vector<uint8_t> scanlines;
+    bool last {false};
+    size_t offset {2};
+    while (!last && offset + 5 <= zlib.size()) {
+        last = zlib[offset] & 1;
+        uint16_t length {static_cast<uint16_t>(zlib[offset + 1] | (zlib[offset + 2] << 8))};
+        uint16_t inverse {static_cast<uint16_t>(zlib[offset + 3] | (zlib[offset + 4] << 8))};
+        if (inverse != static_cast<uint16_t>(~length) || offset + 5 + length > zlib.size()) {
+            return decoded;
+        }
+        scanlines.insert(scanlines.end(), zlib.begin() + offset + 5, zlib.begin() + offset + 5 + length);
+        offset += 5 + length;
+    }
+    size_t stride {decoded.width * 3 + 1};
+    if (!ended || !last || offset + 4 != zlib.size() || scanlines.size() != stride * decoded.height) {
+        return decoded;
+    }
+    if (adler32(scanlines) != readBigEndian(zlib, offset)) {
+        return decoded;
+    }
+    for (uint32_t y {0}; y < decoded.height; y++) {
+        auto row {scanlines.begin() + y * stride};
+        decoded.rgb.insert(decoded.rgb.end(), row + 1, row + stride);
+    }
+    decoded.valid = true;
+    return decoded;
+}
+
+auto readFile(const std::filesystem::path& path) -> std::vector<uint8_t> {
+    std::ifstream file {path, std::ios::binary};
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+// bottom row first, like glReadPixels
+auto gradient(uint32_t width, uint32_t height) -> std::vector<uint8_t> {
+    std::vector<uint8_t> rgba(width * height * 4);
+    for (uint32_t y {0}; y < height; y++) {
+        for (uint32_t x {0}; x < width; x++) {
+            uint8_t* p {rgba.data() + (y * width + x) * 4};
+            p[0] = static_cast<uint8_t>(x);
+            p[1] = static_cast<uint8_t>(y);
+            p[2] = static_cast<uint8_t>(x + y);
+            p[3] = 255;
+        }
+    }
+    return rgba;
+}
+
+}
+
+TEST_CASE("Frames are encoded as PNG"){
+    GIVEN("an image larger than one stored deflate block"){
+        const uint32_t width {200};
+        const uint32_t height {150};
+        std::vector<uint8_t> rgba {gradient(width, height)};
+        DecodedPng decoded {decodeStoredPng(sjd::encodePng(width, height, rgba))};
+        THEN("it decodes to the same pixels, top row first"){
+            REQUIRE( decoded.valid );
+            CHECK( decoded.width == width );
+            CHECK( decoded.height == height );
+            // top-left pixel of the PNG is the last row GL returned
+            CHECK( decoded.rgb[0] == 0 );
+            CHECK( decoded.rgb[1] == height - 1 );
+            size_t mismatches {0};
+            for (uint32_t y {0}; y < height; y++) {
+                for (uint32_t x {0}; x < width; x++) {
+                    const uint8_t* expected {rgba.data() + ((height - 1 - y) * width + x) * 4};
+                    const uint8_t* actual {decoded.rgb.data() + (y * width + x) * 3};
+                    mismatches += std::equal(expected, expected + 3, actual) ? 0 : 1;
+                }
+            }
+            CHECK( mismatches == 0 );
+        }
+    }
+}
+
+TEST_CASE("Encoders reuse their buffers from frame to frame"){
+    const uint32_t width {200};
+    const uint32_t height {150};
+    std::vector<uint8_t> rgba {gradient(width, height)};
+    sjd::EncodeBuffers buffers {};
+    sjd::encodePng(width, height, rgba, buffers);
+    const uint8_t* output {buffers.output.data()};
+    const uint8_t* scanlines {buffers.scanlines.data()};
+
+    sjd::encodePng(width, height, rgba, buffers);
+    THEN("the second frame is encoded in the same memory"){
+        CHECK( buffers.output.data() == output );
+        CHECK( buffers.scanlines.data() == scanlines );
+        CHECK( buffers.output == sjd::encodePng(width, height, rgba) );
+        CHECK( decodeStoredPng(buffers.output).valid );
+    }
+    THEN("a corrupted byte fails the checksums"){
+        std::vector<uint8_t> corrupted {buffers.output};
+        corrupted[corrupted.size() / 2] ^= 1;
+        CHECK_FALSE( decodeStoredPng(corrupted).valid );
+    }
+    THEN("Y4M frames match the allocating writer"){
+        std::ostringstream reused;
+        std::ostringstream allocated;
+        sjd::writeY4mFrame(reused, width, height, rgba, buffers);
+        sjd::writeY4mFrame(allocated, width, height, rgba);
+        CHECK( reused.str() == allocated.str() );
+    }
+}
+
+TEST_CASE("Frames are encoded as 4:2:0 Y4M"){
+    std::ostringstream out;
+    sjd::writeY4mHeader(out, 3, 3, 30);
+    CHECK( out.str() == "YUV4MPEG2 W3 H3 F30:1 Ip A1:1 C420jpeg\n" );
+
+    std::vector<uint8_t> red(3 * 3 * 4, 0);
+    for (size_t i {0}; i < red.size(); i += 4) {
+        red[i] = 255;
+        red[i + 3] = 255;
+    }
+    std::ostringstream frame;
+    sjd::writeY4mFrame(frame, 3, 3, red);
+    std::string bytes {frame.str()};
+    // odd sizes round the chroma planes up
+    REQUIRE( bytes.size() == 6 + 9 + 2 * 4 );
+    CHECK( bytes.substr(0, 6) == "FRAME\n" );
+    CHECK( static_cast<uint8_t>(bytes[6]) == 76 );
+    CHECK( static_cast<uint8_t>(bytes[6 + 9]) == 85 );
+    CHECK( static_cast<uint8_t>(bytes[6 + 9 + 4]) == 255 );
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "Captured frames are read back asynchronously"){
+    REQUIRE( window != nullptr );
+    sjd::Framebuffer* target {sjd::headlessFramebuffer()};
+    REQUIRE( target != nullptr );
+    std::filesystem::path directory {std::filesystem::temp_directory_path() / "mage_capture_test"};
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    const int frames {6};
+
+    auto renderFrames = [&](sjd::FrameCapture& capture){
+        for (int frame {0}; frame < frames; frame++) {
+            target->bind();
+            float shade {static_cast<float>(frame * 40) / 255.0f};
+            glClearColor(shade, 0.0f, 1.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            capture.capture(target->id());
+        }
+        capture.finish();
+    };
+
+    WHEN("frames are captured as PNG"){
+        sjd::CaptureSettings settings {};
+        settings.path = (directory / "frame").string();
+        sjd::FrameCapture capture {64, 48, settings};
+        REQUIRE( capture.isValid() );
+        glPixelStorei(GL_PACK_ALIGNMENT, 8);
+        renderFrames(capture);
+        GLint alignment {0};
+        glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        THEN("the caller's pack alignment is left as it was"){
+            CHECK( alignment == 8 );
+        }
+        THEN("every frame is written in order with its own contents"){
+            CHECK( capture.framesCaptured() == frames );
+            CHECK( capture.framesEncoded() == frames );
+            for (int frame {0}; frame < frames; frame++) {
+                char name[32] {};
+                std::snprintf(name, sizeof(name), "frame_%06d.png", frame);
+                DecodedPng decoded {decodeStoredPng(readFile(directory / name))};
+                INFO( name );
+                REQUIRE( decoded.valid );
+                CHECK( decoded.width == 64 );
+                CHECK( decoded.height == 48 );
+                CHECK( decoded.rgb[0] == frame * 40 );
+                CHECK( decoded.rgb[2] == 255 );
+            }
+            CHECK( glGetError() == GL_NO_ERROR );
+        }
+    }
+    WHEN("frames are captured as Y4M"){
+        sjd::CaptureSettings settings {};
+        settings.format = sjd::CAPTURE_FORMAT::Y4M;
+        settings.path = (directory / "capture.y4m").string();
+        {
+            sjd::FrameCapture capture {64, 48, settings};
+            REQUIRE( capture.isValid() );
+            renderFrames(capture);
+        }
+        THEN("the stream holds a header and every frame"){
+            std::string header {"YUV4MPEG2 W64 H48 F60:1 Ip A1:1 C420jpeg\n"};
+            size_t frameBytes {6 + 64 * 48 + 2 * 32 * 24};
+            CHECK( std::filesystem::file_size(settings.path) == header.size() + frames * frameBytes );
+        }
+    }
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "Cost of capturing every frame", "[.][benchmark]"){
+    const uint32_t width {1280};
+    const uint32_t height {720};
+    glfwSetWindowSize(window, width, height);
+    sjd::Framebuffer* target {sjd::headlessFramebuffer()};
+    std::filesystem::path path {std::filesystem::temp_directory_path() / "mage_capture_bench.y4m"};
+    sjd::CaptureSettings settings {};
+    settings.format = sjd::CAPTURE_FORMAT::Y4M;
+    settings.path = path.string();
+    sjd::FrameCapture capture {width, height, settings};
+    REQUIRE( capture.isValid() );
+
+    int frame {0};
+    auto render = [&](){
+        target->bind();
+        glClearColor(static_cast<float>(frame++ % 256) / 255.0f, 0.5f, 0.25f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    };
+    BENCHMARK("capture off"){
+        render();
+        glFinish();
+    };
+    BENCHMARK("capture through PBOs"){
+        render();
+        capture.capture(target->id());
+        glFinish();
+    };
+    // the same work done synchronously on the render thread
+    std::ofstream syncStream {path.string() + ".sync", std::ios::binary};
+    BENCHMARK("glReadPixels and encode every frame"){
+        render();
+        sjd::writeY4mFrame(syncStream, width, height, target->readPixels());
+    };
+    capture.finish();
+    // with fewer cores than threads the encoder competes with rendering
+    std::cout << "async capture stalls: " << capture.stalls() << " in "
+              << capture.framesCaptured() << " frames on "
+              << std::thread::hardware_concurrency() << " hardware threads\n";
+    syncStream.close();
+    std::filesystem::remove(path);
+    std::filesystem::remove(path.string() + ".sync");
+}
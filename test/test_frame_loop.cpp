@@ -0,0 +1,208 @@
+#include <catch2/catch_test_macros.hpp>
+#include <glfw_setup.h>
+#include <camera.h>
+#include <transform.h>
+#include <frame_loop.h>
+#include <random>
+#include <vector>
+#include "test_fixtures.h"
+
+namespace {
+
+// moves and turns by a pattern of the step index alone, standing in for
+// input recorded per step
+void flyCamera(sjd::CameraState& state, double stepSeconds, uint64_t step) {
+    sjd::Camera camera {};
+    camera.setState(state);
+    camera.processMovement(step % 90 < 45 ? sjd::Camera::FORWARD : sjd::Camera::RIGHT,
+                           static_cast<float>(stepSeconds));
+    camera.processXYRotation(3.0f, step % 20 < 10 ? 1.0f : -1.0f);
+    state = camera.getState();
+}
+
+auto sameState(const sjd::CameraState& a, const sjd::CameraState& b) -> bool {
+    return a.pos == b.pos && a.yaw == b.yaw && a.pitch == b.pitch && a.zoom == b.zoom;
+}
+
+// every step's state, from a run fed frames of the given lengths
+auto recordSteps(const std::vector<double>& frames) -> std::vector<sjd::CameraState> {
+    std::vector<sjd::CameraState> steps;
+    sjd::FixedStepSimulation<sjd::CameraState> simulation {
+        sjd::CameraState {},
+        [&](sjd::CameraState& state, double stepSeconds, uint64_t step){
+            flyCamera(state, stepSeconds, step);
+            steps.push_back(state);
+        }
+    };
+    for (double frame : frames) {
+        simulation.advance(frame);
+    }
+    return steps;
+}
+
+}
+
+TEST_CASE("Frame times are split into fixed steps"){
+    // powers of two so the sums are exact
+    sjd::FixedStepClock clock {{1.0 / 64.0, 8}};
+    GIVEN("frames shorter and longer than a step"){
+        std::vector<double> frames {1.0 / 128.0, 1.0 / 32.0, 3.0 / 256.0, 1.0 / 64.0};
+        uint32_t steps {0};
+        for (double frame : frames) {
+            steps += clock.advance(frame);
+            CHECK( clock.alpha() >= 0.0f );
+            CHECK( clock.alpha() < 1.0f );
+        }
+        THEN("every whole step is run and the remainder is kept"){
+            // 2 + 8 + 3 + 4 = 17 / 256 of a second, 4.25 steps
+            CHECK( steps == 4 );
+            CHECK( clock.steps() == 4 );
+            CHECK( clock.alpha() == 0.25f );
+        }
+    }
+    GIVEN("a frame longer than maxSteps steps"){
+        uint32_t steps {clock.advance(1.0 + 1.0 / 256.0)};
+        THEN("only maxSteps run and the rest of the hitch is dropped"){
+            CHECK( steps == 8 );
+            CHECK( clock.droppedSeconds() == 56.0 / 64.0 );
+            CHECK( clock.alpha() == 0.25f );
+        }
+    }
+}
+
+TEST_CASE("Fixed-step simulation is independent of frame times"){
+    const size_t steps {240};
+    std::vector<double> even(steps, 1.0 / 60.0);
+    std::vector<double> jittered;
+    std::mt19937 random {7};
+    std::uniform_real_distribution<double> frameSeconds {0.002, 0.05};
+    double total {0.0};
+    while (total < steps / 60.0 + 0.1) {
+        jittered.push_back(frameSeconds(random));
+        total += jittered.back();
+    }
+
+    std::vector<sjd::CameraState> evenRun {recordSteps(even)};
+    std::vector<sjd::CameraState> jitteredRun {recordSteps(jittered)};
+    REQUIRE( evenRun.size() >= steps - 1 );
+    REQUIRE( jitteredRun.size() >= evenRun.size() );
+    size_t mismatches {0};
+    for (size_t i {0}; i < evenRun.size(); i++) {
+        mismatches += sameState(evenRun[i], jitteredRun[i]) ? 0 : 1;
+    }
+    CHECK( mismatches == 0 );
+}
+
+TEST_CASE("Rendered state is interpolated between the last two steps"){
+    GIVEN("camera states"){
+        sjd::CameraState a {glm::vec3(0.0f), 170.0f, 10.0f, 45.0f};
+        sjd::CameraState b {glm::vec3(2.0f, 0.0f, -4.0f), -170.0f, 20.0f, 35.0f};
+        sjd::CameraState half {sjd::interpolate(a, b, 0.5f)};
+        THEN("the ends match and yaw turns across the seam"){
+            CHECK( sameState(sjd::interpolate(a, b, 0.0f), a) );
+            CHECK( half.pos == glm::vec3(1.0f, 0.0f, -2.0f) );
+            CHECK( std::abs(half.yaw - 180.0f) < 0.001f );
+            CHECK( half.pitch == 15.0f );
+            CHECK( half.zoom == 40.0f );
+        }
+    }
+    GIVEN("transforms"){
+        sjd::Transform a {};
+        sjd::Transform b {glm::vec3(0.0f, 2.0f, 0.0f),
+                          glm::angleAxis(glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+                          glm::vec3(3.0f)};
+        sjd::Transform half {sjd::interpolate(a, b, 0.5f)};
+        THEN("rotation is slerped and the rest blended"){
+            glm::vec3 x {half.matrix() * glm::vec4(1.0f, 0.0f, 0.0f, 0.0f)};
+            // 45 degrees about y at scale 2
+            CHECK( std::abs(x.x - std::sqrt(2.0f)) < 0.0001f );
+            CHECK( std::abs(x.z + std::sqrt(2.0f)) < 0.0001f );
+            CHECK( half.position == glm::vec3(0.0f, 1.0f, 0.0f) );
+        }
+    }
+    GIVEN("a simulation advanced by part of a step"){
+        sjd::FixedStepSimulation<sjd::CameraState> simulation {sjd::CameraState {}, flyCamera,
+                                                               {1.0 / 64.0, 8}};
+        simulation.advance(1.0 / 32.0);
+        sjd::CameraState drawn {simulation.advance(1.0 / 256.0)};
+        THEN("the drawn state lies a quarter of the way into the last step"){
+            CHECK( simulation.clock().steps() == 2 );
+            CHECK( sameState(drawn, sjd::interpolate(simulation.previous(),
+                                                     simulation.current(), 0.25f)) );
+        }
+    }
+}
+
+TEST_CASE("Simulation thread steps in the background"){
+    const double step {1.0 / 240.0};
+    sjd::SimulationThread<sjd::CameraState> simulation {sjd::CameraState {}, flyCamera, {step, 8}};
+    simulation.start();
+    while (simulation.steps() < 30) {
+        sjd::CameraState drawn {simulation.sample()};
+        CHECK( std::isfinite(drawn.pos.x) );
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    simulation.stop();
+    REQUIRE( !simulation.isRunning() );
+
+    THEN("it reaches the same states as stepping on the render thread"){
+        uint64_t steps {simulation.steps()};
+        sjd::FixedStepSimulation<sjd::CameraState> reference {sjd::CameraState {}, flyCamera,
+                                                              {step, 8}};
+        while (reference.clock().steps() < steps) {
+            reference.advance(step);
+        }
+        REQUIRE( reference.clock().steps() == steps );
+        CHECK( sameState(simulation.latest(), reference.current()) );
+    }
+}
+
+TEST_CASE("Frames are paced to a target rate"){
+    const double target {0.005};
+    sjd::FramePacer pacer {{target, false}};
+    double total {0.0};
+    double spin {0.0};
+    const int frames {40};
+    CHECK( pacer.beginFrame() == 0.0 );
+    for (int frame {0}; frame < frames; frame++) {
+        total += pacer.beginFrame();
+        spin += pacer.spinSeconds();
+        CHECK( pacer.sleepMarginSeconds() <= sjd::MAX_SLEEP_MARGIN );
+    }
+    double mean {total / frames};
+    double meanSpin {spin / frames};
+    INFO( "mean frame " << mean * 1000.0 << " ms, sleep margin "
+          << pacer.sleepMarginSeconds() * 1000.0 << " ms, mean spin "
+          << meanSpin * 1000.0 << " ms" );
+    CHECK( mean >= target * 0.99 );
+    // generous, as the host may be busy
+    CHECK( mean < target * 1.6 );
+    // most of the wait is slept, only the end of it is spent yielding
+    CHECK( meanSpin < 0.001 );
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "Input to frame latency is measured"){
+    REQUIRE( window != nullptr );
+    sjd::FramePacingSettings settings {};
+    settings.measureLatency = true;
+    settings.latencyHistory = 8;
+    sjd::FramePacer pacer {settings};
+    for (int frame {0}; frame < 12; frame++) {
+        pacer.beginFrame();
+        pacer.markInputSampled();
+        glClearColor(0.1f, 0.2f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glfwSwapBuffers(window);
+        pacer.endFrame();
+    }
+    // frames without input carry no latency sample
+    pacer.beginFrame();
+    pacer.endFrame();
+
+    sjd::LatencyStats latency {pacer.latency()};
+    CHECK( latency.samples == 8 );
+    CHECK( latency.meanMs > 0.0 );
+    CHECK( latency.p95Ms <= latency.maxMs );
+    CHECK( latency.meanMs <= latency.maxMs );
+    CHECK( glGetError() == GL_NO_ERROR );
+}
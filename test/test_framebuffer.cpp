@@ -0,0 +1,120 @@
+#include <catch2/catch_test_macros.hpp>
+#include <glfw_setup.h>
+#include <framebuffer.h>
+#include "test_fixtures.h"
+
+TEST_CASE("Image comparison counts differing pixels"){
+    std::vector<uint8_t> black(4 * 4, 0);
+    std::vector<uint8_t> grey(4 * 4, 0);
+    grey[4] = 10;
+    grey[8] = 200;
+
+    CHECK( sjd::countDifferentPixels(black, black) == 0 );
+    CHECK( sjd::countDifferentPixels(black, grey) == 2 );
+    CHECK( sjd::countDifferentPixels(black, grey, 10) == 1 );
+    CHECK( sjd::countDifferentPixels(black, std::vector<uint8_t>(8 * 4, 0)) == 8 );
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "A headless context renders offscreen"){
+    REQUIRE( window != nullptr );
+    sjd::Framebuffer* target {sjd::headlessFramebuffer()};
+    REQUIRE( target != nullptr );
+    REQUIRE( target->isValid() );
+
+    WHEN("the context is created"){
+        THEN("its framebuffer matches the window and is bound"){
+            CHECK( target->width() == 64 );
+            CHECK( target->height() == 48 );
+            GLint bound {0};
+            glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &bound);
+            CHECK( static_cast<GLuint>(bound) == target->id() );
+        }
+    }
+    WHEN("the target is cleared"){
+        glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        std::vector<uint8_t> pixels {target->readPixels()};
+        THEN("every pixel reads back as the clear colour"){
+            REQUIRE( pixels.size() == 64 * 48 * 4 );
+            std::vector<uint8_t> red(pixels.size());
+            for (size_t i {0}; i < red.size(); i += 4) {
+                red[i] = 255;
+                red[i + 3] = 255;
+            }
+            CHECK( sjd::countDifferentPixels(pixels, red) == 0 );
+        }
+    }
+    WHEN("pixels are read back with a non-default pack alignment"){
+        glPixelStorei(GL_PACK_ALIGNMENT, 8);
+        std::vector<uint8_t> pixels {target->readPixels()};
+        THEN("the alignment is left as it was"){
+            GLint alignment {0};
+            glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+            CHECK( alignment == 8 );
+            CHECK( pixels.size() == 64 * 48 * 4 );
+        }
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    }
+    WHEN("the window is resized"){
+        glfwSetWindowSize(window, 128, 96);
+        THEN("the framebuffer follows it"){
+            CHECK( target->width() == 128 );
+            CHECK( target->height() == 96 );
+            CHECK( target->readPixels().size() == 128 * 96 * 4 );
+        }
+    }
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "A multisampled framebuffer is resolved on readback"){
+    sjd::Framebuffer target {32, 32, 4};
+    REQUIRE( target.isValid() );
+    CHECK( target.samples() == 4 );
+
+    target.bind();
+    glClearColor(0.0f, 1.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    std::vector<uint8_t> pixels {target.readPixels()};
+    CHECK( pixels[1] == 255 );
+    CHECK( pixels[pixels.size() - 3] == 255 );
+    CHECK( glGetError() == GL_NO_ERROR );
+}
+
+TEST_CASE("Each context gets a headless target of its own"){
+    GLFWwindow* window {sjd::createCursorLockedWindow(32, 32, "test_window", 1,
+                                                      sjd::CONTEXT_BACKEND::EGL)};
+    REQUIRE( window != nullptr );
+    REQUIRE( sjd::headlessFramebuffer() != nullptr );
+
+    WHEN("GLFW is terminated through the engine"){
+        sjd::terminateGlfw();
+        THEN("the target goes with the context"){
+            CHECK( sjd::headlessFramebuffer() == nullptr );
+        }
+    }
+    WHEN("a new context follows a bare glfwTerminate()"){
+        glfwTerminate();
+        window = sjd::createCursorLockedWindow(16, 8, "test_window", 1,
+                                               sjd::CONTEXT_BACKEND::EGL);
+        REQUIRE( window != nullptr );
+        sjd::Framebuffer* target {sjd::headlessFramebuffer()};
+        THEN("it has a fresh target sized for it"){
+            REQUIRE( target != nullptr );
+            CHECK( target->isValid() );
+            CHECK( target->width() == 16 );
+            CHECK( target->height() == 8 );
+            CHECK( target->readPixels().size() == 16 * 8 * 4 );
+            CHECK( glGetError() == GL_NO_ERROR );
+        }
+        sjd::terminateGlfw();
+    }
+    WHEN("the next context can't be created"){
+        window = sjd::createCursorLockedWindow(0, 0, "test_window", 1,
+                                               sjd::CONTEXT_BACKEND::EGL);
+        THEN("there is no window and no target"){
+            CHECK( window == nullptr );
+            CHECK( glfwGetCurrentContext() == NULL );
+            CHECK( sjd::headlessFramebuffer() == nullptr );
+        }
+        sjd::terminateGlfw();
+    }
+}
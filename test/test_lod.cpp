@@ -0,0 +1,217 @@
+#include <catch2/catch_test_macros.hpp>
+#include <glfw_setup.h>
+#include <mesh/indexed_mesh.h>
+#include <mesh/simplify.h>
+#include <iostream>
+#include "test_fixtures.h"
+
+static float surfaceArea(const sjd::MeshData& data, const std::vector<uint32_t>& indices) {
+    float area {0.0f};
+    for (size_t i {0}; i + 2 < indices.size(); i += 3) {
+        glm::vec3 a {data.positions[indices[i]]};
+        glm::vec3 b {data.positions[indices[i + 1]]};
+        glm::vec3 c {data.positions[indices[i + 2]]};
+        area += 0.5f * glm::length(glm::cross(b - a, c - a));
+    }
+    return area;
+}
+
+TEST_CASE("A mesh is simplified towards a target triangle count"){
+    sjd::MeshData sphere {sjd::makeUvSphere(64, 32)};
+    size_t target {sphere.indices.size() / 4};
+    std::vector<uint32_t> simplified {sjd::simplifyMesh(sphere.positions, sphere.indices, target)};
+
+    THEN("the triangle count is reduced to about the target"){
+        CHECK( simplified.size() % 3 == 0 );
+        CHECK( simplified.size() <= target + 6 );
+        CHECK( simplified.size() > 0 );
+    }
+    THEN("every triangle is valid and indexes the original vertices"){
+        for (size_t i {0}; i < simplified.size(); i += 3) {
+            CHECK( simplified[i] < sphere.vertexCount() );
+            CHECK( simplified[i + 1] < sphere.vertexCount() );
+            CHECK( simplified[i + 2] < sphere.vertexCount() );
+            bool degenerate {simplified[i] == simplified[i + 1]
+                             || simplified[i + 1] == simplified[i + 2]
+                             || simplified[i] == simplified[i + 2]};
+            CHECK_FALSE( degenerate );
+        }
+    }
+    THEN("the overall shape is kept"){
+        float before {surfaceArea(sphere, sphere.indices)};
+        float after {surfaceArea(sphere, simplified)};
+        INFO("area before: " << before << " after: " << after);
+        CHECK( std::abs(after - before) / before < 0.1f );
+    }
+}
+
+TEST_CASE("A flat grid collapses without error"){
+    sjd::MeshData grid {sjd::makeGrid(16)};
+    std::vector<uint32_t> simplified {sjd::simplifyMesh(grid.positions, grid.indices, 0, 0.000001f)};
+
+    INFO("triangles left: " << simplified.size() / 3);
+    CHECK( simplified.size() / 3 < grid.triangleCount() / 8 );
+    CHECK( std::abs(surfaceArea(grid, simplified) - 1.0f) < 0.0001f );
+}
+
+TEST_CASE("A LOD chain gets coarser at every level"){
+    sjd::MeshData sphere {sjd::makeUvSphere(48, 24)};
+    auto chain {sjd::buildLodChain(sphere.positions, sphere.indices, 4, 0.5f)};
+
+    REQUIRE( chain.size() == 4 );
+    CHECK( chain[0] == sphere.indices );
+    for (size_t level {1}; level < chain.size(); level++) {
+        CHECK( chain[level].size() < chain[level - 1].size() );
+    }
+}
+
+TEST_CASE("Projected size shrinks with distance"){
+    float fov {glm::radians(45.0f)};
+    float near {sjd::projectedSize(1.0f, 5.0f, fov, 1080)};
+    float far {sjd::projectedSize(1.0f, 10.0f, fov, 1080)};
+    CHECK( std::abs(near - 2.0f * far) < 0.001f );
+    CHECK( sjd::projectedSize(1.0f, 0.5f, fov, 1080) == 1080.0f );
+}
+
+TEST_CASE("LOD selection uses hysteresis around each threshold"){
+    sjd::LodSelector selector {4, 200.0f, 0.1f};
+    REQUIRE( selector.levelCount() == 4 );
+    CHECK( selector.threshold(0) == 200.0f );
+    CHECK( selector.threshold(1) == 100.0f );
+    CHECK( selector.threshold(2) == 50.0f );
+
+    WHEN("the mesh is large on screen"){
+        THEN("the finest level is used"){
+            CHECK( selector.select(0, 500.0f) == 0 );
+            CHECK( selector.select(3, 500.0f) == 0 );
+        }
+    }
+    WHEN("the mesh is tiny on screen"){
+        THEN("the coarsest level is used"){
+            CHECK( selector.select(0, 5.0f) == 3 );
+        }
+    }
+    WHEN("the mesh sits just either side of a threshold"){
+        THEN("the current level is kept"){
+            CHECK( selector.select(0, 195.0f) == 0 );
+            CHECK( selector.select(1, 205.0f) == 1 );
+        }
+    }
+    WHEN("the mesh moves clearly past a threshold"){
+        THEN("the level changes"){
+            CHECK( selector.select(0, 170.0f) == 1 );
+            CHECK( selector.select(1, 230.0f) == 0 );
+        }
+    }
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(WindowFixture,
+                             "An indexed mesh switches LOD as the camera moves away"){
+    sjd::IndexedMesh sphere {sjd::makeUvSphere(32, 16), 4};
+    REQUIRE( sphere.lodCount() == 4 );
+    sjd::Camera camera {glm::vec3(0.0f, 0.0f, 3.0f)};
+
+    sphere.selectLod(camera, 600);
+    CHECK( sphere.currentLod() == 0 );
+
+    size_t previous {sphere.currentLod()};
+    for (int step {0}; step < 200; step++) {
+        camera.processMovement(sjd::Camera::BACKWARD, 0.5f);
+        sphere.selectLod(camera, 600);
+        CHECK( sphere.currentLod() >= previous );
+        previous = sphere.currentLod();
+    }
+    CHECK( sphere.currentLod() == 3 );
+    CHECK( sphere.lodTriangleCount(3) < sphere.lodTriangleCount(0) );
+
+    // the coarsest level still draws a closed sphere
+    GLuint fbo {0};
+    GLuint depth {0};
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, 64, 64);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+    glViewport(0, 0, 64, 64);
+    glEnable(GL_DEPTH_TEST);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    sjd::Shader shader {"../src/glsl/depth_only.vert.glsl",
+                        "../src/glsl/depth_only.frag.glsl"};
+    glm::mat4 projection {glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 500.0f)};
+    GLuint query {0};
+    glGenQueries(1, &query);
+    glBeginQuery(GL_SAMPLES_PASSED, query);
+    glm::mat4 view {glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f))};
+    sphere.draw(projection, view, shader);
+    glEndQuery(GL_SAMPLES_PASSED);
+    GLuint samples {0};
+    glGetQueryObjectuiv(query, GL_QUERY_RESULT, &samples);
+    CHECK( samples > 0 );
+    CHECK( glGetError() == GL_NO_ERROR );
+
+    glDeleteQueries(1, &query);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &depth);
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(WindowFixture,
+                             "Indexed meshes can share a LOD chain built once"){
+    sjd::MeshData data {sjd::makeUvSphere(32, 16)};
+    sjd::LodChain lods {sjd::buildLodChain(data.positions, data.indices, 4)};
+    sjd::IndexedMesh first {data, lods};
+    sjd::IndexedMesh second {data, lods};
+    sjd::IndexedMesh simplified {data, 4};
+
+    REQUIRE( first.lodCount() == simplified.lodCount() );
+    for (size_t level {0}; level < first.lodCount(); level++) {
+        CHECK( first.lodTriangleCount(level) == simplified.lodTriangleCount(level) );
+        CHECK( second.lodTriangleCount(level) == simplified.lodTriangleCount(level) );
+    }
+    CHECK( glGetError() == GL_NO_ERROR );
+}
+
+TEST_CASE("Triangles per frame with and without LOD selection", "[.][benchmark]"){
+    const size_t levels {5};
+    sjd::MeshData sphere {sjd::makeUvSphere(96, 48)};
+    auto chain {sjd::buildLodChain(sphere.positions, sphere.indices, levels, 0.5f)};
+    sjd::LodSelector selector {chain.size()};
+
+    // a 20x20 field of spheres, flown over from one corner to the other
+    std::vector<glm::vec3> centres;
+    std::vector<size_t> currentLevel;
+    for (int x {0}; x < 20; x++) {
+        for (int z {0}; z < 20; z++) {
+            centres.emplace_back(x * 4.0f, 0.0f, z * 4.0f);
+            currentLevel.push_back(0);
+        }
+    }
+    size_t withoutLod {0};
+    size_t withLod {0};
+    size_t levelChanges {0};
+    const int frames {600};
+    for (int frame {0}; frame < frames; frame++) {
+        float t {static_cast<float>(frame) / frames};
+        glm::vec3 eye {-5.0f + 85.0f * t, 3.0f, -5.0f + 85.0f * t};
+        for (size_t i {0}; i < centres.size(); i++) {
+            float size {sjd::projectedSize(1.0f, glm::length(centres[i] - eye),
+                                           glm::radians(45.0f), 1080)};
+            size_t level {selector.select(currentLevel[i], size)};
+            levelChanges += (level != currentLevel[i]);
+            currentLevel[i] = level;
+            withoutLod += chain[0].size() / 3;
+            withLod += chain[level].size() / 3;
+        }
+    }
+    std::cout << "LOD levels: ";
+    for (const auto& level : chain) {
+        std::cout << level.size() / 3 << " ";
+    }
+    std::cout << "triangles\n"
+              << "triangles/frame without LOD: " << withoutLod / frames << "\n"
+              << "triangles/frame with LOD:    " << withLod / frames << "\n"
+              << "level changes over " << frames << " frames: " << levelChanges << "\n";
+    CHECK( withLod < withoutLod );
+}
@@ -0,0 +1,82 @@
+#ifndef TEST_MESHES_H
+#define TEST_MESHES_H
+#include <glad/glad.h>
+#include <mesh/mesh.h>
+#include <profiler.h>
+#include <array>
+
+// A unit cube with position, normal and texture coordinates laid out for
+// simple.lighting.vert.glsl, for tests that need real geometry on the GPU.
+class TestCube : public sjd::Mesh {
+public:
+    TestCube(glm::vec3 location = glm::vec3(0.0f), float size = 1.0f) {
+        move(location);
+        scale(glm::vec3(size));
+        setLocalBounds(sjd::AABB{glm::vec3(-0.5f), glm::vec3(0.5f)});
+        glGenVertexArrays(1, &m_vao);
+        glGenBuffers(1, &m_vbo);
+        bufferData();
+        defineVAOPointers();
+    }
+    ~TestCube() {
+        glDeleteVertexArrays(1, &m_vao);
+        glDeleteBuffers(1, &m_vbo);
+    }
+
+    unsigned int defineVAOPointers() override {
+        glBindVertexArray(m_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glBindVertexArray(0);
+        return m_vao;
+    }
+
+    void bufferData() override {
+        std::array<float, 36 * 8> vertices {};
+        // each face: normal axis, sign; two triangles wound counter-clockwise
+        size_t v {0};
+        for (int axis {0}; axis < 3; axis++) {
+            for (float sign : {-1.0f, 1.0f}) {
+                glm::vec3 n {0.0f};
+                n[axis] = sign;
+                glm::vec3 u {0.0f};
+                glm::vec3 w {0.0f};
+                u[(axis + 1) % 3] = 1.0f;
+                w[(axis + 2) % 3] = 1.0f;
+                if (sign < 0.0f) {
+                    std::swap(u, w);
+                }
+                const glm::vec2 corners[6] {{-1, -1}, {1, -1}, {1, 1},
+                                            {-1, -1}, {1, 1}, {-1, 1}};
+                for (const glm::vec2& c : corners) {
+                    glm::vec3 p {0.5f * (n + u * c.x + w * c.y)};
+                    float data[8] {p.x, p.y, p.z, n.x, n.y, n.z,
+                                   0.5f * (c.x + 1.0f), 0.5f * (c.y + 1.0f)};
+                    for (float f : data) {
+                        vertices[v++] = f;
+                    }
+                }
+            }
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices.data(), GL_STATIC_DRAW);
+    }
+
+    void draw(glm::mat4 projection, glm::mat4 view, sjd::Shader& shader) override {
+        shader.use();
+        shader.setUniform("model", m_model);
+        shader.setUniform("view", view);
+        shader.setUniform("projection", projection);
+        glBindVertexArray(m_vao);
+        glDrawArrays(GL_TRIANGLES, 0, 36);
+        MAGE_COUNT_DRAW_CALLS(1);
+        glBindVertexArray(0);
+    }
+};
+
+#endif
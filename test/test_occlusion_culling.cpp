@@ -0,0 +1,227 @@
+#include <catch2/catch_test_macros.hpp>
+#include <glfw_setup.h>
+#include <occlusion_culling.h>
+#include "test_fixtures.h"
+#include "test_meshes.h"
+
+TEST_CASE("Mesh bounds are projected to a screen rectangle"){
+    glm::mat4 projection {glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f)};
+    glm::mat4 view {glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f),
+                                glm::vec3(0.0f),
+                                glm::vec3(0.0f, 1.0f, 0.0f))};
+    glm::mat4 viewProjection {projection * view};
+
+    WHEN("a box sits in the middle of the view"){
+        sjd::ScreenRect rect {sjd::projectBounds(sjd::AABB{glm::vec3(-1.0f), glm::vec3(1.0f)},
+                                                 viewProjection)};
+        THEN("its rectangle is centred and its depth is that of the front face"){
+            CHECK_FALSE( rect.crossesNearPlane );
+            CHECK_FALSE( rect.offscreen );
+            CHECK( std::abs((rect.min.x + rect.max.x) * 0.5f - 0.5f) < 0.0001f );
+            CHECK( std::abs((rect.min.y + rect.max.y) * 0.5f - 0.5f) < 0.0001f );
+            glm::vec4 front {viewProjection * glm::vec4(0.0f, 0.0f, 1.0f, 1.0f)};
+            CHECK( std::abs(rect.nearestDepth - (front.z / front.w * 0.5f + 0.5f)) < 0.0001f );
+        }
+    }
+    WHEN("a box surrounds the camera"){
+        sjd::ScreenRect rect {sjd::projectBounds(sjd::AABB{glm::vec3(-10.0f), glm::vec3(10.0f)},
+                                                 viewProjection)};
+        THEN("it cannot be tested"){
+            CHECK( rect.crossesNearPlane );
+        }
+    }
+    WHEN("a box is out of view to the side"){
+        sjd::ScreenRect rect {sjd::projectBounds(sjd::AABB{glm::vec3(50.0f, -1.0f, -1.0f),
+                                                           glm::vec3(52.0f, 1.0f, 1.0f)},
+                                                 viewProjection)};
+        THEN("it is reported offscreen"){
+            CHECK( rect.offscreen );
+        }
+    }
+}
+
+TEST_CASE("The Hi-Z level keeps a rectangle within 2x2 texels"){
+    CHECK( sjd::hiZLevelCount(1, 1) == 1 );
+    CHECK( sjd::hiZLevelCount(800, 600) == 10 );
+    CHECK( sjd::hiZLevelCount(1024, 1024) == 11 );
+
+    sjd::ScreenRect rect {};
+    rect.min = glm::vec2(0.25f);
+    rect.max = glm::vec2(0.25f + 1.0f / 1024.0f);
+    CHECK( sjd::hiZMipLevel(rect, 1024, 1024, 11) == 0 );
+
+    rect.max = glm::vec2(0.25f + 16.0f / 1024.0f);
+    CHECK( sjd::hiZMipLevel(rect, 1024, 1024, 11) == 4 );
+
+    rect.min = glm::vec2(0.0f);
+    rect.max = glm::vec2(1.0f);
+    CHECK( sjd::hiZMipLevel(rect, 1024, 1024, 11) == 10 );
+    CHECK( sjd::hiZMipLevel(rect, 1024, 1024, 4) == 3 );
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(WindowFixture,
+                             "Meshes hidden behind an occluder are rejected"){
+    const uint32_t size {256};
+    GLuint fbo {}, color {}, depth {};
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(1, &color);
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size, size);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, size, size);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+    REQUIRE( glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE );
+    glViewport(0, 0, size, size);
+
+    sjd::OcclusionCuller culler {"../src/glsl"};
+    REQUIRE( culler.isValid() );
+    sjd::Shader shader {"../src/glsl/depth_only.vert.glsl",
+                        "../src/glsl/depth_only.frag.glsl"};
+
+    glm::mat4 projection {glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f)};
+    glm::mat4 view {glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f),
+                                glm::vec3(0.0f),
+                                glm::vec3(0.0f, 1.0f, 0.0f))};
+    TestCube occluder {glm::vec3(0.0f, 0.0f, 1.0f), 4.0f};
+
+    auto renderFrames = [&](std::vector<sjd::Mesh*> meshes){
+        for (int frame {0}; frame < 4; frame++) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            culler.render(meshes, projection, view, shader);
+            culler.endFrame(fbo, size, size);
+            glFinish();
+        }
+    };
+
+    WHEN("a small mesh is directly behind the occluder"){
+        TestCube hidden {glm::vec3(0.0f, 0.0f, -5.0f)};
+        renderFrames({&occluder, &hidden});
+        THEN("its draw is rejected and the occluder's is not"){
+            CHECK( culler.stats().tested == 2 );
+            CHECK( culler.stats().rejected == 1 );
+        }
+    }
+    WHEN("the small mesh is in front of the occluder"){
+        TestCube visible {glm::vec3(0.0f, 0.0f, 3.5f), 0.25f};
+        renderFrames({&occluder, &visible});
+        THEN("nothing is rejected"){
+            CHECK( culler.stats().tested == 2 );
+            CHECK( culler.stats().rejected == 0 );
+        }
+    }
+    WHEN("the caller has writes masked off while meshes are tested"){
+        TestCube hidden {glm::vec3(0.0f, 0.0f, -5.0f)};
+        renderFrames({&occluder, &hidden});
+        glColorMask(GL_TRUE, GL_FALSE, GL_TRUE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        culler.render({&occluder, &hidden}, projection, view, shader);
+        THEN("the masks are left as they were"){
+            CHECK( culler.stats().tested == 2 );
+            GLboolean colorMask[4] {};
+            GLboolean depthMask {GL_TRUE};
+            glGetBooleanv(GL_COLOR_WRITEMASK, colorMask);
+            glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+            CHECK( colorMask[0] == GL_TRUE );
+            CHECK( colorMask[1] == GL_FALSE );
+            CHECK( colorMask[2] == GL_TRUE );
+            CHECK( colorMask[3] == GL_FALSE );
+            CHECK( depthMask == GL_FALSE );
+        }
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(GL_TRUE);
+    }
+    WHEN("culling is disabled"){
+        culler.setEnabled(false);
+        TestCube hidden {glm::vec3(0.0f, 0.0f, -5.0f)};
+        renderFrames({&occluder, &hidden});
+        THEN("no draws are tested"){
+            CHECK( culler.stats().tested == 0 );
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &color);
+    glDeleteRenderbuffers(1, &depth);
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(WindowFixture,
+                             "Hi-Z texels are found by position on non power of two targets"){
+    // 800 wide: level 7 is 6 texels, the last also covering pixels 768-799,
+    // so pixel 640 is in texel 5 although 640 / 800 * 6 rounds down to 4
+    const uint32_t width {800};
+    const uint32_t height {8};
+    GLuint fbo {}, depth {};
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    REQUIRE( glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE );
+
+    // texel 4 (pixels 512-639) fully occluded, texel 5 empty
+    glClearDepth(1.0);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(512, 0, 128, height);
+    glClearDepth(0.0);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+    glClearDepth(1.0);
+
+    sjd::HiZBuffer hiZ {"../src/glsl"};
+    REQUIRE( hiZ.isValid() );
+    hiZ.build(fbo, width, height);
+    REQUIRE( hiZ.levelCount() == 10 );
+
+    sjd::Shader test {"../src/glsl/occlusion_test.vert.glsl",
+                      "../src/glsl/occlusion_test.frag.glsl"};
+    REQUIRE( test.isValid() );
+    GLuint vao {}, query {};
+    glGenVertexArrays(1, &vao);
+    glGenQueries(1, &query);
+    glBindVertexArray(vao);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, hiZ.texture());
+    glDisable(GL_DEPTH_TEST);
+    glViewport(0, 0, width, height);
+    test.use();
+    test.setUniform("hiZ", 0);
+    test.setUniform("nearestDepth", 0.5f);
+    test.setUniform("level", 7);
+
+    auto samplesPassed = [&](float minX, float maxX){
+        test.setUniform("screenRect", glm::vec4(minX, 0.0f, maxX, 0.5f));
+        glBeginQuery(GL_SAMPLES_PASSED, query);
+        glDrawArrays(GL_POINTS, 0, 1);
+        glEndQuery(GL_SAMPLES_PASSED);
+        GLuint samples {0};
+        glGetQueryObjectuiv(query, GL_QUERY_RESULT, &samples);
+        return samples;
+    };
+
+    THEN("a rectangle starting at pixel 640 is tested against texel 5"){
+        CHECK( samplesPassed(640.0f / width, 656.0f / width) > 0 );
+    }
+    THEN("a rectangle ending at pixel 639 is tested against texel 4"){
+        CHECK( samplesPassed(600.0f / width, 639.0f / width) == 0 );
+    }
+    THEN("the leftover pixels at the right edge land in the last texel"){
+        CHECK( samplesPassed(790.0f / width, 799.0f / width) > 0 );
+    }
+
+    glEnable(GL_DEPTH_TEST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+    glDeleteQueries(1, &query);
+    glDeleteVertexArrays(1, &vao);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &depth);
+}
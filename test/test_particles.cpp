@@ -0,0 +1,189 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <glfw_setup.h>
+#include <framebuffer.h>
+#include <particles.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include "test_fixtures.h"
+
+namespace {
+
+const std::string SHADER_DIRECTORY {"../src/glsl"};
+
+auto closeTo(const glm::vec3& a, const glm::vec3& b, float tolerance = 0.0001f) -> bool {
+    return glm::length(a - b) < tolerance;
+}
+
+// particles sprayed upwards from the origin, as a fountain would
+auto fountain(size_t count, uint32_t seed) -> std::vector<sjd::Particle> {
+    std::mt19937 random {seed};
+    std::uniform_real_distribution<float> spread {-1.0f, 1.0f};
+    std::uniform_real_distribution<float> life {1.0f, 4.0f};
+    std::vector<sjd::Particle> particles(count);
+    for (sjd::Particle& particle : particles) {
+        particle.velocity = glm::vec3(spread(random), 4.0f + spread(random), spread(random));
+        particle.lifetime = life(random);
+    }
+    return particles;
+}
+
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "Particles are simulated with transform feedback"){
+    REQUIRE( window != nullptr );
+    sjd::ParticleSettings settings {};
+    settings.capacity = 8;
+    settings.maxSpawnPerFrame = 6;
+    settings.gravity = glm::vec3(0.0f, -10.0f, 0.0f);
+    settings.drag = 0.5f;
+
+    GIVEN("a few particles with different lifetimes"){
+        sjd::ParticleSystem particles {SHADER_DIRECTORY, settings};
+        REQUIRE( particles.isValid() );
+        std::vector<sjd::Particle> spawned {
+            {glm::vec3(0.0f), 0.0f, glm::vec3(1.0f, 5.0f, 0.0f), 10.0f},
+            {glm::vec3(2.0f, 0.0f, 0.0f), 0.0f, glm::vec3(0.0f, 0.0f, -3.0f), 0.75f},
+            {glm::vec3(0.0f, 1.0f, 0.0f), 0.0f, glm::vec3(0.0f), 10.0f},
+        };
+        particles.emit(spawned);
+        for (int step {0}; step < 4; step++) {
+            particles.update(0.25f);
+            for (sjd::Particle& particle : spawned) {
+                sjd::integrateParticle(particle, 0.25f, settings.gravity, settings.drag);
+            }
+        }
+        std::vector<sjd::Particle> simulated {particles.readParticles()};
+        THEN("the GPU matches the CPU reference step for step"){
+            REQUIRE( simulated.size() == spawned.size() );
+            CHECK( particles.activeSlots() == 3 );
+            for (size_t i {0}; i < spawned.size(); i++) {
+                INFO( "particle " << i );
+                CHECK( closeTo(simulated[i].position, spawned[i].position) );
+                CHECK( closeTo(simulated[i].velocity, spawned[i].velocity) );
+                CHECK( std::abs(simulated[i].age - spawned[i].age) < 0.0001f );
+            }
+        }
+        THEN("a particle stops once its lifetime is up"){
+            CHECK( simulated[1].age >= simulated[1].lifetime );
+            CHECK( std::abs(simulated[1].age - 0.75f) < 0.0001f );
+        }
+        CHECK( glGetError() == GL_NO_ERROR );
+    }
+    GIVEN("more particles than there are slots"){
+        sjd::ParticleSystem particles {SHADER_DIRECTORY, settings};
+        REQUIRE( particles.isValid() );
+        for (int batch {0}; batch < 2; batch++) {
+            for (int i {0}; i < 5; i++) {
+                particles.emit({glm::vec3(static_cast<float>(batch * 10 + i)), 0.0f,
+                                glm::vec3(0.0f), 10.0f});
+            }
+            particles.update(0.0f);
+        }
+        std::vector<sjd::Particle> simulated {particles.readParticles()};
+        THEN("new particles wrap round and replace the oldest"){
+            REQUIRE( simulated.size() == 8 );
+            CHECK( simulated[0].position.x == 13.0f );
+            CHECK( simulated[1].position.x == 14.0f );
+            CHECK( simulated[2].position.x == 2.0f );
+            CHECK( simulated[5].position.x == 10.0f );
+            CHECK( simulated[7].position.x == 12.0f );
+        }
+    }
+    GIVEN("more spawns in one frame than the spawn buffer holds"){
+        sjd::ParticleSystem particles {SHADER_DIRECTORY, settings};
+        particles.emit(fountain(4, 1));
+        particles.emit(fountain(4, 2));
+        particles.emit(sjd::Particle {});
+        particles.update(0.1f);
+        THEN("the excess is dropped and counted"){
+            CHECK( particles.activeSlots() == 6 );
+            CHECK( particles.droppedSpawns() == 3 );
+        }
+    }
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "Particles are drawn as billboards"){
+    REQUIRE( window != nullptr );
+    sjd::Framebuffer* target {sjd::headlessFramebuffer()};
+    REQUIRE( target != nullptr );
+    sjd::ParticleSettings settings {};
+    settings.capacity = 16;
+    settings.gravity = glm::vec3(0.0f);
+    settings.size = 1.0f;
+    settings.colour = glm::vec4(1.0f, 0.5f, 0.0f, 1.0f);
+    sjd::ParticleSystem particles {SHADER_DIRECTORY, settings};
+    REQUIRE( particles.isValid() );
+    particles.emit({glm::vec3(0.0f), 0.0f, glm::vec3(0.0f), 10.0f});
+    // dead on arrival, so never drawn
+    particles.emit({glm::vec3(1.0f, 0.0f, 0.0f), 1.0f, glm::vec3(0.0f), 1.0f});
+    particles.update(0.0f);
+
+    target->bind();
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glm::mat4 view {glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f),
+                                glm::vec3(0.0f, 1.0f, 0.0f))};
+    glm::mat4 projection {glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f)};
+    particles.draw(view, projection);
+    std::vector<uint8_t> pixels {target->readPixels()};
+    auto pixel = [&](uint32_t x, uint32_t y) -> const uint8_t* {
+        return pixels.data() + (y * target->width() + x) * 4;
+    };
+
+    THEN("the live particle faces the camera with a soft edge"){
+        const uint8_t* centre {pixel(target->width() / 2, target->height() / 2)};
+        CHECK( centre[0] > 200 );
+        CHECK( centre[1] > 90 );
+        CHECK( centre[2] == 0 );
+        const uint8_t* corner {pixel(2, 2)};
+        CHECK( corner[0] == 0 );
+    }
+    THEN("the dead particle leaves its spot empty"){
+        // 1 unit right of the origin, 3 units away
+        uint32_t x {target->width() / 2 + static_cast<uint32_t>(target->width() * 0.41f)};
+        CHECK( pixel(x, target->height() / 2)[0] == 0 );
+    }
+    THEN("blend and depth write state is restored"){
+        GLboolean depthMask {GL_FALSE};
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+        CHECK( depthMask == GL_TRUE );
+        CHECK( glIsEnabled(GL_BLEND) == GL_FALSE );
+        CHECK( glGetError() == GL_NO_ERROR );
+    }
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "Particle update and draw cost by count", "[.][benchmark]"){
+    const uint32_t width {640};
+    const uint32_t height {360};
+    glfwSetWindowSize(window, width, height);
+    sjd::Framebuffer* target {sjd::headlessFramebuffer()};
+    glm::mat4 view {glm::lookAt(glm::vec3(0.0f, 4.0f, 12.0f), glm::vec3(0.0f, 4.0f, 0.0f),
+                                glm::vec3(0.0f, 1.0f, 0.0f))};
+    glm::mat4 projection {glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f)};
+
+    for (uint32_t count : {1u << 14, 1u << 17, 1u << 20}) {
+        sjd::ParticleSettings settings {};
+        settings.capacity = count;
+        settings.maxSpawnPerFrame = 1u << 16;
+        sjd::ParticleSystem particles {SHADER_DIRECTORY, settings};
+        REQUIRE( particles.isValid() );
+        for (uint32_t spawned {0}; spawned < count; spawned += settings.maxSpawnPerFrame) {
+            particles.emit(fountain(std::min(settings.maxSpawnPerFrame, count - spawned), spawned));
+            particles.update(0.0f);
+        }
+        REQUIRE( particles.activeSlots() == count );
+        target->bind();
+        glViewport(0, 0, width, height);
+
+        BENCHMARK("update " + std::to_string(count)){
+            particles.update(1.0f / 240.0f);
+            glFinish();
+        };
+        BENCHMARK("draw " + std::to_string(count)){
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            particles.draw(view, projection);
+            glFinish();
+        };
+    }
+}
@@ -0,0 +1,221 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <glfw_setup.h>
+#include <framebuffer.h>
+#include <post_process.h>
+#include <profiler.h>
+#include <cmath>
+#include "test_fixtures.h"
+
+TEST_CASE("The bloom chain stops before levels get too small"){
+    CHECK( sjd::bloomLevelCount(1920, 1080, 6) == 6 );
+    CHECK( sjd::bloomLevelCount(64, 64, 6) == 5 );
+    CHECK( sjd::bloomLevelCount(64, 8, 6) == 2 );
+    CHECK( sjd::bloomLevelCount(3, 3, 6) == 0 );
+}
+
+TEST_CASE("Tone mapping compresses HDR values into [0,1]"){
+    CHECK( sjd::tonemapAces(0.0f) == 0.0f );
+    CHECK( sjd::tonemapAces(100.0f) > 0.99f );
+    CHECK( sjd::tonemapAces(0.5f) < sjd::tonemapAces(1.0f) );
+    CHECK( std::abs(sjd::linearToSrgb(1.0f) - 1.0f) < 0.0001f );
+    CHECK( std::abs(sjd::linearToSrgb(0.214f) - 0.5f) < 0.001f );
+}
+
+namespace {
+
+auto pixelAt(const std::vector<uint8_t>& pixels, uint32_t width, uint32_t x, uint32_t y) -> uint8_t {
+    return pixels[(y * width + x) * 4];
+}
+
+void clearScene(sjd::PostProcessChain& chain, float value) {
+    chain.bindSceneTarget();
+    glClearColor(value, value, value, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+// fills the scene target's rectangle with an HDR value
+void fillRect(float value, GLint x, GLint y, GLsizei width, GLsizei height) {
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(x, y, width, height);
+    glClearColor(value, value, value, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+}
+
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "The post chain tone maps an HDR scene"){
+    REQUIRE( window != nullptr );
+    const uint32_t size {64};
+    sjd::PostProcessChain chain {"../src/glsl", size, size};
+    REQUIRE( chain.isValid() );
+    CHECK( chain.bloomLevels() == 5 );
+    sjd::Framebuffer output {size, size};
+    REQUIRE( output.isValid() );
+
+    WHEN("a flat scene is tone mapped with every effect off"){
+        sjd::PostSettings settings {};
+        settings.bloom = false;
+        settings.fxaa = false;
+        chain.setSettings(settings);
+        clearScene(chain, 0.5f);
+        chain.apply(output.id(), size, size);
+        std::vector<uint8_t> pixels {output.readPixels()};
+        THEN("it matches the CPU curve"){
+            float expected {255.0f * sjd::linearToSrgb(sjd::tonemapAces(0.5f))};
+            CHECK( std::abs(pixelAt(pixels, size, 32, 32) - expected) < 1.5f );
+            CHECK( glGetError() == GL_NO_ERROR );
+        }
+    }
+    WHEN("the same scene goes through bloom and FXAA"){
+        clearScene(chain, 0.5f);
+        chain.apply(output.id(), size, size);
+        std::vector<uint8_t> pixels {output.readPixels()};
+        THEN("values below the threshold don't bloom and a flat image isn't blurred"){
+            // bloom is added on top, so a scene with nothing above the
+            // threshold comes out as if bloom were off
+            float expected {255.0f * sjd::linearToSrgb(sjd::tonemapAces(0.5f))};
+            CHECK( std::abs(pixelAt(pixels, size, 32, 32) - expected) < 1.5f );
+            CHECK( std::abs(pixelAt(pixels, size, 0, 0) - expected) < 1.5f );
+        }
+    }
+    WHEN("a small bright square is bloomed"){
+        sjd::PostSettings settings {};
+        settings.fxaa = false;
+        settings.bloomIntensity = 0.2f;
+        chain.setSettings(settings);
+        clearScene(chain, 0.0f);
+        fillRect(50.0f, 28, 28, 8, 8);
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ZERO);
+        chain.apply(output.id(), size, size);
+        std::vector<uint8_t> bloomed {output.readPixels()};
+        GLint blendSrcRgb {0};
+        GLint blendDstRgb {0};
+        GLint blendSrcAlpha {0};
+        GLint blendDstAlpha {0};
+        glGetIntegerv(GL_BLEND_SRC_RGB, &blendSrcRgb);
+        glGetIntegerv(GL_BLEND_DST_RGB, &blendDstRgb);
+        glGetIntegerv(GL_BLEND_SRC_ALPHA, &blendSrcAlpha);
+        glGetIntegerv(GL_BLEND_DST_ALPHA, &blendDstAlpha);
+        glBlendFunc(GL_ONE, GL_ZERO);
+
+        settings.bloom = false;
+        chain.setSettings(settings);
+        chain.apply(output.id(), size, size);
+        std::vector<uint8_t> plain {output.readPixels()};
+        THEN("light spreads past its edges only with bloom on"){
+            CHECK( pixelAt(bloomed, size, 32, 32) == 255 );
+            CHECK( pixelAt(bloomed, size, 24, 32) > 0 );
+            CHECK( pixelAt(bloomed, size, 32, 40) > 0 );
+            CHECK( pixelAt(plain, size, 24, 32) == 0 );
+            CHECK( pixelAt(plain, size, 32, 40) == 0 );
+        }
+        THEN("the caller's blend function is left as it was"){
+            CHECK( blendSrcRgb == GL_SRC_ALPHA );
+            CHECK( blendDstRgb == GL_ONE_MINUS_SRC_ALPHA );
+            CHECK( blendSrcAlpha == GL_ONE );
+            CHECK( blendDstAlpha == GL_ZERO );
+        }
+    }
+    WHEN("a hard diagonal edge is drawn"){
+        sjd::PostSettings settings {};
+        settings.bloom = false;
+        chain.setSettings(settings);
+        clearScene(chain, 0.0f);
+        for (GLint row {0}; row < static_cast<GLint>(size); row++) {
+            fillRect(10.0f, 0, row, row / 2 + 16, 1);
+        }
+
+        auto countGreys = [&](){
+            std::vector<uint8_t> pixels {output.readPixels()};
+            size_t greys {0};
+            for (size_t i {0}; i < pixels.size(); i += 4) {
+                greys += pixels[i] > 16 && pixels[i] < 224 ? 1 : 0;
+            }
+            return greys;
+        };
+        chain.apply(output.id(), size, size);
+        size_t smoothed {countGreys()};
+        settings.fxaa = false;
+        chain.setSettings(settings);
+        chain.apply(output.id(), size, size);
+        size_t aliased {countGreys()};
+        THEN("FXAA blends the stairs"){
+            CHECK( aliased == 0 );
+            CHECK( smoothed > size / 2 );
+        }
+    }
+    WHEN("the chain is resized"){
+        chain.resize(128, 32);
+        THEN("the targets follow and the chain is still usable"){
+            REQUIRE( chain.isValid() );
+            CHECK( chain.width() == 128 );
+            CHECK( chain.bloomLevels() == 4 );
+            clearScene(chain, 0.5f);
+            chain.apply(output.id(), size, size);
+            CHECK( glGetError() == GL_NO_ERROR );
+        }
+    }
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "Every post effect reports its GPU cost"){
+    sjd::Profiler& profiler {sjd::Profiler::instance()};
+    profiler.clear();
+    sjd::PostProcessChain chain {"../src/glsl", 64, 64};
+    REQUIRE( chain.isValid() );
+    sjd::Framebuffer output {64, 64};
+
+    for (int frame {0}; frame < 6; frame++) {
+        profiler.beginFrame();
+        {
+            // as an application timing its whole frame would
+            MAGE_PROFILE_GPU_SCOPE("frame");
+            clearScene(chain, 2.0f);
+            chain.apply(output.id(), 64, 64);
+        }
+        glFinish();
+        profiler.endFrame();
+    }
+    for (sjd::POST_EFFECT effect : {sjd::POST_EFFECT::BLOOM_DOWNSAMPLE,
+                                    sjd::POST_EFFECT::BLOOM_UPSAMPLE,
+                                    sjd::POST_EFFECT::TONEMAP,
+                                    sjd::POST_EFFECT::FXAA}) {
+        INFO( sjd::postEffectName(effect) );
+        CHECK( chain.gpuCostMs(effect) > 0.0 );
+    }
+    profiler.clear();
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(HeadlessFixture, "Cost of post AA against MSAA", "[.][benchmark]"){
+    const uint32_t width {1280};
+    const uint32_t height {720};
+    sjd::PostProcessChain chain {"../src/glsl", width, height};
+    sjd::Framebuffer output {width, height};
+    sjd::Framebuffer multisampled {width, height, 4};
+    REQUIRE( chain.isValid() );
+    REQUIRE( multisampled.isValid() );
+
+    BENCHMARK("bloom, tone mapping and FXAA"){
+        clearScene(chain, 2.0f);
+        chain.apply(output.id(), width, height);
+        glFinish();
+    };
+    sjd::PostSettings settings {};
+    settings.bloom = false;
+    chain.setSettings(settings);
+    BENCHMARK("tone mapping and FXAA"){
+        clearScene(chain, 2.0f);
+        chain.apply(output.id(), width, height);
+        glFinish();
+    };
+    BENCHMARK("4x MSAA clear and resolve"){
+        multisampled.bind();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, multisampled.id());
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, output.id());
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glFinish();
+    };
+}
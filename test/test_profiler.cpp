@@ -0,0 +1,296 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <glfw_setup.h>
+#include <profiler.h>
+#include <mesh/indexed_mesh.h>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include "test_fixtures.h"
+
+TEST_CASE("A ring buffer hands items from one thread to another in order"){
+    sjd::SpscRing<int, 8> ring {};
+
+    WHEN("it is filled"){
+        for (int i {0}; i < 8; i++) {
+            REQUIRE( ring.push(i) );
+        }
+        THEN("further pushes are refused"){
+            CHECK( ring.size() == 8 );
+            CHECK_FALSE( ring.push(8) );
+        }
+        THEN("draining returns every item in order and empties it"){
+            std::vector<int> drained;
+            CHECK( ring.drain([&](int item){ drained.push_back(item); }) == 8 );
+            CHECK( drained == std::vector<int> {0, 1, 2, 3, 4, 5, 6, 7} );
+            CHECK( ring.size() == 0 );
+        }
+    }
+    WHEN("a producer thread pushes while the consumer pops"){
+        const int count {100000};
+        std::thread producer {[&](){
+            for (int i {0}; i < count; i++) {
+                while (!ring.push(i)) {
+                    std::this_thread::yield();
+                }
+            }
+        }};
+        int expected {0};
+        bool ordered {true};
+        while (expected < count) {
+            int item {0};
+            if (ring.pop(item)) {
+                ordered = ordered && item == expected;
+                expected++;
+            }
+        }
+        producer.join();
+        THEN("nothing is lost or reordered"){
+            CHECK( ordered );
+        }
+    }
+}
+
+TEST_CASE("Nested CPU scopes are recorded per frame"){
+    sjd::Profiler& profiler {sjd::Profiler::instance()};
+    profiler.clear();
+
+    profiler.beginFrame();
+    {
+        MAGE_PROFILE_SCOPE("outer");
+        {
+            MAGE_PROFILE_SCOPE("inner");
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+    profiler.endFrame();
+
+    const sjd::FrameRecord& frame {profiler.lastFrame()};
+    REQUIRE( frame.cpuEvents.size() == 2 );
+    // scopes close innermost first
+    const sjd::CpuEvent& inner {frame.cpuEvents[0]};
+    const sjd::CpuEvent& outer {frame.cpuEvents[1]};
+    CHECK( std::string(inner.name) == "inner" );
+    CHECK( std::string(outer.name) == "outer" );
+    CHECK( inner.depth == outer.depth + 1 );
+    CHECK( inner.startNs >= outer.startNs );
+    CHECK( inner.startNs + inner.durationNs <= outer.startNs + outer.durationNs );
+    CHECK( frame.cpuTimeMs("inner") >= 2.0 );
+    CHECK( frame.durationNs >= outer.durationNs );
+
+    WHEN("the profiler is disabled"){
+        profiler.setEnabled(false);
+        profiler.beginFrame();
+        {
+            MAGE_PROFILE_SCOPE("ignored");
+        }
+        profiler.endFrame();
+        profiler.setEnabled(true);
+        THEN("no scopes are recorded"){
+            CHECK( profiler.lastFrame().cpuEvents.empty() );
+        }
+    }
+}
+
+TEST_CASE("Scopes from worker threads are kept apart"){
+    sjd::Profiler& profiler {sjd::Profiler::instance()};
+    profiler.clear();
+
+    profiler.beginFrame();
+    {
+        MAGE_PROFILE_SCOPE("main");
+    }
+    std::thread worker {[](){
+        sjd::Profiler::instance().setThreadName("worker");
+        for (int i {0}; i < 10; i++) {
+            MAGE_PROFILE_SCOPE("job");
+        }
+    }};
+    worker.join();
+    profiler.endFrame();
+
+    const sjd::FrameRecord& frame {profiler.lastFrame()};
+    REQUIRE( frame.cpuEvents.size() == 11 );
+    uint32_t mainThread {0};
+    uint32_t workerThread {0};
+    for (const sjd::CpuEvent& event : frame.cpuEvents) {
+        (std::string(event.name) == "main" ? mainThread : workerThread) = event.threadId;
+    }
+    CHECK( mainThread != workerThread );
+
+    std::stringstream trace;
+    profiler.writeChromeTrace(trace);
+    CHECK( trace.str().find("\"worker\"") != std::string::npos );
+}
+
+TEST_CASE("Rings of exited threads are reused"){
+    sjd::Profiler& profiler {sjd::Profiler::instance()};
+    profiler.clear();
+    profiler.beginFrame();
+    MAGE_PROFILE_SCOPE("main");
+    size_t ringsBefore {profiler.threadRingCount()};
+
+    for (size_t i {0}; i < 2 * sjd::Profiler::MAX_THREAD_RINGS; i++) {
+        std::thread worker {[](){
+            MAGE_PROFILE_SCOPE("job");
+        }};
+        worker.join();
+    }
+    profiler.endFrame();
+
+    CHECK( profiler.threadRingCount() <= ringsBefore + 1 );
+    CHECK( profiler.lastFrame().cpuEvents.size() == 2 * sjd::Profiler::MAX_THREAD_RINGS );
+    CHECK( profiler.droppedEvents() == 0 );
+}
+
+TEST_CASE("Counters reset every frame"){
+    sjd::Profiler& profiler {sjd::Profiler::instance()};
+    profiler.clear();
+
+    profiler.beginFrame();
+    MAGE_COUNT_DRAW_CALLS(3);
+    MAGE_COUNT_STATE_CHANGE();
+    MAGE_COUNT_UPLOAD(1024);
+    profiler.endFrame();
+    CHECK( profiler.lastFrame().counters.drawCalls == 3 );
+    CHECK( profiler.lastFrame().counters.stateChanges == 1 );
+    CHECK( profiler.lastFrame().counters.uploadBytes == 1024 );
+
+    profiler.beginFrame();
+    profiler.endFrame();
+    CHECK( profiler.lastFrame().counters.drawCalls == 0 );
+    CHECK( profiler.lastFrame().counters.uploadBytes == 0 );
+    CHECK( profiler.frames().size() == 2 );
+}
+
+TEST_CASE("Frames export as Chrome trace JSON"){
+    sjd::Profiler& profiler {sjd::Profiler::instance()};
+    profiler.clear();
+    profiler.setHistorySize(3);
+
+    for (int i {0}; i < 5; i++) {
+        profiler.beginFrame();
+        MAGE_PROFILE_SCOPE("frame \"work\"");
+        profiler.endFrame();
+    }
+    CHECK( profiler.frames().size() == 3 );
+
+    std::stringstream trace;
+    profiler.writeChromeTrace(trace);
+    std::string json {trace.str()};
+    CHECK( json.rfind("{\"traceEvents\":[", 0) == 0 );
+    CHECK( json.find("\"ph\":\"X\"") != std::string::npos );
+    CHECK( json.find("frame \\\"work\\\"") != std::string::npos );
+    // only the frames still in history are exported
+    size_t exportedFrames {0};
+    for (size_t at {json.find("\"cat\":\"frame\"")}; at != std::string::npos;
+         at = json.find("\"cat\":\"frame\"", at + 1)) {
+        exportedFrames++;
+    }
+    CHECK( exportedFrames == 3 );
+    profiler.setHistorySize(120);
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(WindowFixture, "GPU scopes are timed without stalling"){
+    sjd::Profiler& profiler {sjd::Profiler::instance()};
+    profiler.clear();
+    sjd::IndexedMesh sphere {sjd::makeUvSphere(64, 32)};
+    sjd::Shader shader {"../src/glsl/depth_only.vert.glsl",
+                        "../src/glsl/depth_only.frag.glsl"};
+
+    for (int i {0}; i < 4; i++) {
+        profiler.beginFrame();
+        {
+            MAGE_PROFILE_GPU_SCOPE("spheres");
+            {
+                // timed on its own as well as within the outer scope
+                MAGE_PROFILE_GPU_SCOPE("nested");
+                sphere.draw(glm::mat4(1.0f), glm::mat4(1.0f), shader);
+            }
+        }
+        profiler.endFrame();
+    }
+    glFinish();
+    profiler.beginFrame();
+    profiler.endFrame();
+
+    size_t outerEvents {0};
+    size_t nestedEvents {0};
+    for (const sjd::FrameRecord& frame : profiler.frames()) {
+        for (const sjd::GpuEvent& event : frame.gpuEvents) {
+            std::string name {event.name};
+            CHECK( (name == "spheres" || name == "nested") );
+            outerEvents += name == "spheres";
+            nestedEvents += name == "nested";
+        }
+        if (frame.gpuEvents.size() == 2) {
+            // the inner scope ends before the outer one
+            CHECK( frame.gpuTimeMs("nested") <= frame.gpuTimeMs("spheres") );
+        }
+    }
+    CHECK( outerEvents >= 1 );
+    CHECK( nestedEvents >= 1 );
+    CHECK( profiler.droppedEvents() == 0 );
+
+    // a scope can't be timed inside one of its own name, and says so
+    profiler.beginFrame();
+    {
+        MAGE_PROFILE_GPU_SCOPE("spheres");
+        MAGE_PROFILE_GPU_SCOPE("spheres");
+    }
+    profiler.endFrame();
+    CHECK( profiler.droppedEvents() == 1 );
+    CHECK( profiler.frames().front().counters.drawCalls == 1 );
+    CHECK( profiler.frames().front().counters.stateChanges >= 1 );
+    CHECK( glGetError() == GL_NO_ERROR );
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(WindowFixture, "GPU scopes are matched by name, not by pointer"){
+    sjd::Profiler& profiler {sjd::Profiler::instance()};
+    profiler.clear();
+    sjd::IndexedMesh sphere {sjd::makeUvSphere(16, 8)};
+    sjd::Shader shader {"../src/glsl/depth_only.vert.glsl",
+                        "../src/glsl/depth_only.frag.glsl"};
+
+    for (int i {0}; i < 4; i++) {
+        profiler.beginFrame();
+        {
+            // a new copy each frame, freed before its result arrives
+            auto name {std::make_unique<std::string>("spheres, named at run time")};
+            MAGE_PROFILE_GPU_SCOPE(name->c_str());
+            sphere.draw(glm::mat4(1.0f), glm::mat4(1.0f), shader);
+        }
+        profiler.endFrame();
+    }
+    glFinish();
+    profiler.beginFrame();
+    profiler.endFrame();
+
+    size_t gpuEvents {0};
+    for (const sjd::FrameRecord& frame : profiler.frames()) {
+        for (const sjd::GpuEvent& event : frame.gpuEvents) {
+            CHECK( std::string(event.name) == "spheres, named at run time" );
+            gpuEvents++;
+        }
+    }
+    CHECK( gpuEvents >= 1 );
+}
+
+TEST_CASE("Cost of a profile scope", "[.][benchmark]"){
+    sjd::Profiler& profiler {sjd::Profiler::instance()};
+    profiler.clear();
+    BENCHMARK("scope, enabled"){
+        profiler.beginFrame();
+        for (int i {0}; i < 1000; i++) {
+            MAGE_PROFILE_SCOPE("bench");
+        }
+        profiler.endFrame();
+    };
+    profiler.setEnabled(false);
+    BENCHMARK("scope, disabled"){
+        for (int i {0}; i < 1000; i++) {
+            MAGE_PROFILE_SCOPE("bench");
+        }
+    };
+    profiler.setEnabled(true);
+}
@@ -0,0 +1,198 @@
+#include <catch2/catch_test_macros.hpp>
+#include <glfw_setup.h>
+#include <render_graph.h>
+#include "test_fixtures.h"
+
+TEST_CASE("Passes that feed no output are culled"){
+    sjd::RenderGraph graph {};
+    sjd::TextureDesc hdr {320, 180, GL_RGBA16F};
+    auto scene {graph.createTexture("scene", hdr)};
+    auto debug {graph.createTexture("debug", hdr)};
+    auto backbuffer {graph.importFramebuffer("backbuffer", 0, 320, 180)};
+
+    graph.addPass("opaque").write(scene);
+    graph.addPass("debug view").read(scene).write(debug);
+    graph.addPass("present").read(scene).write(backbuffer);
+
+    auto stats {graph.compile()};
+    REQUIRE( stats.has_value() );
+    CHECK( stats->passes == 3 );
+    CHECK( stats->culledPasses == 1 );
+    CHECK( graph.isCulled("debug view") );
+    CHECK( graph.executionOrder() == std::vector<std::string> {"opaque", "present"} );
+
+    WHEN("the unused pass is marked as having side effects"){
+        graph.clear();
+        scene = graph.createTexture("scene", hdr);
+        auto counter {graph.createTexture("counter", {1, 1, GL_R32F})};
+        graph.addPass("opaque").write(scene);
+        graph.markOutput(scene);
+        graph.addPass("stats").read(scene).write(counter).sideEffect();
+        THEN("it is kept"){
+            REQUIRE( graph.compile().has_value() );
+            CHECK_FALSE( graph.isCulled("stats") );
+        }
+    }
+}
+
+TEST_CASE("Passes run after the writers of everything they read"){
+    sjd::RenderGraph graph {};
+    sjd::TextureDesc color {64, 64, GL_RGBA8};
+    auto shadow {graph.createTexture("shadow", {128, 128, GL_DEPTH_COMPONENT32F})};
+    auto scene {graph.createTexture("scene", color)};
+    auto backbuffer {graph.importFramebuffer("backbuffer", 0, 64, 64)};
+
+    // declared backwards on purpose
+    graph.addPass("present").read(scene).write(backbuffer);
+    graph.addPass("sky").read(shadow).write(scene);
+    graph.addPass("opaque").read(shadow).write(scene);
+    graph.addPass("shadow").write(shadow);
+
+    REQUIRE( graph.compile().has_value() );
+    CHECK( graph.executionOrder() == std::vector<std::string> {"shadow", "sky", "opaque", "present"} );
+
+    WHEN("two passes read each other's output"){
+        sjd::RenderGraph cyclic {};
+        auto a {cyclic.createTexture("a", color)};
+        auto b {cyclic.createTexture("b", color)};
+        cyclic.addPass("first").read(b).write(a);
+        cyclic.addPass("second").read(a).write(b);
+        cyclic.markOutput(a);
+        THEN("compiling reports the cycle"){
+            CHECK( cyclic.compile().error() == sjd::GRAPH_ERROR::cycle );
+        }
+    }
+    WHEN("a pass writes an imported framebuffer and a texture"){
+        sjd::RenderGraph mixed {};
+        auto ids {mixed.createTexture("ids", {64, 64, GL_R32F})};
+        auto window {mixed.importFramebuffer("backbuffer", 0, 64, 64)};
+        mixed.addPass("present").write(window).write(ids);
+        THEN("compiling rejects it rather than drop the texture"){
+            CHECK( mixed.compile().error() == sjd::GRAPH_ERROR::mixedTargets );
+        }
+    }
+    WHEN("a pass reads a texture nothing writes"){
+        sjd::RenderGraph orphan {};
+        auto missing {orphan.createTexture("missing", color)};
+        orphan.addPass("present").read(missing).write(orphan.importFramebuffer("backbuffer", 0, 64, 64));
+        THEN("compiling reports it"){
+            CHECK( orphan.compile().error() == sjd::GRAPH_ERROR::readBeforeWrite );
+        }
+    }
+}
+
+TEST_CASE("Transient textures with disjoint lifetimes share memory"){
+    sjd::RenderGraph graph {};
+    sjd::TextureDesc half {960, 540, GL_RGBA16F};
+    auto scene {graph.createTexture("scene", {1920, 1080, GL_RGBA16F})};
+    auto bright {graph.createTexture("bright", half)};
+    auto blurX {graph.createTexture("blurX", half)};
+    auto blurY {graph.createTexture("blurY", half)};
+    auto backbuffer {graph.importFramebuffer("backbuffer", 0, 1920, 1080)};
+
+    graph.addPass("scene").write(scene);
+    graph.addPass("bright").read(scene).write(bright);
+    graph.addPass("blur x").read(bright).write(blurX);
+    graph.addPass("blur y").read(blurX).write(blurY);
+    graph.addPass("composite").read(scene).read(blurY).write(backbuffer);
+
+    auto stats {graph.compile()};
+    REQUIRE( stats.has_value() );
+    CHECK( stats->transientResources == 4 );
+    // bright is dead once blur x has run, so blur y can take its memory
+    CHECK( stats->physicalTextures == 3 );
+    CHECK( graph.physicalSlot(blurY) == graph.physicalSlot(bright) );
+    CHECK( graph.physicalSlot(blurX) != graph.physicalSlot(bright) );
+    CHECK( stats->peakTransientBytes == half.bytes() * 2 + 1920 * 1080 * 8 );
+    CHECK( stats->unaliasedTransientBytes == half.bytes() * 3 + 1920 * 1080 * 8 );
+}
+
+TEST_CASE("The transient peak counts only what is live at once"){
+    sjd::RenderGraph graph {};
+    sjd::TextureDesc hdr {1920, 1080, GL_RGBA16F};
+    sjd::TextureDesc ldr {1920, 1080, GL_RGBA8};
+    sjd::TextureDesc luminance {1, 1, GL_R32F};
+    auto scene {graph.createTexture("scene", hdr)};
+    auto average {graph.createTexture("average", luminance)};
+    auto graded {graph.createTexture("graded", ldr)};
+    auto backbuffer {graph.importFramebuffer("backbuffer", 0, 1920, 1080)};
+
+    graph.addPass("scene").write(scene);
+    graph.addPass("luminance").read(scene).write(average);
+    graph.addPass("grade").read(average).write(graded);
+    graph.addPass("present").read(graded).write(backbuffer);
+
+    auto stats {graph.compile()};
+    REQUIRE( stats.has_value() );
+    // scene and graded never overlap, but their formats differ so each
+    // gets its own texture
+    CHECK( stats->physicalTextures == 3 );
+    CHECK( stats->peakTransientBytes == hdr.bytes() + luminance.bytes() );
+    CHECK( stats->unaliasedTransientBytes == hdr.bytes() + luminance.bytes() + ldr.bytes() );
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(WindowFixture, "A render graph executes into pooled textures"){
+    sjd::Framebuffer target {32, 32};
+    REQUIRE( target.isValid() );
+    sjd::TexturePool pool {};
+    sjd::RenderGraph graph {};
+    sjd::TextureDesc color {32, 32, GL_RGBA8};
+    auto first {graph.createTexture("first", color)};
+    auto second {graph.createTexture("second", color)};
+    auto output {graph.importFramebuffer("target", target.id(), 32, 32)};
+
+    std::vector<std::string> ran;
+    graph.addPass("clear").write(first).execute([&](const sjd::PassContext& context){
+        ran.push_back("clear");
+        CHECK( context.width() == 32 );
+        glClearColor(0.0f, 0.0f, 1.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    });
+    graph.addPass("copy").read(first).write(second).execute([&](const sjd::PassContext& context){
+        ran.push_back("copy");
+        GLuint source {0};
+        glGenFramebuffers(1, &source);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, source);
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                               context.texture(first), 0);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, context.framebuffer());
+        glBlitFramebuffer(0, 0, 32, 32, 0, 0, 32, 32, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glDeleteFramebuffers(1, &source);
+    });
+    graph.addPass("present").read(second).write(output).execute([&](const sjd::PassContext& context){
+        ran.push_back("present");
+        CHECK( context.framebuffer() == target.id() );
+        GLuint source {0};
+        glGenFramebuffers(1, &source);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, source);
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                               context.texture(second), 0);
+        glBlitFramebuffer(0, 0, 32, 32, 0, 0, 32, 32, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glDeleteFramebuffers(1, &source);
+    });
+
+    REQUIRE( graph.execute(pool).has_value() );
+    CHECK( ran == std::vector<std::string> {"clear", "copy", "present"} );
+    std::vector<uint8_t> pixels {target.readPixels()};
+    CHECK( pixels[0] == 0 );
+    CHECK( pixels[2] == 255 );
+    CHECK( pool.textureCount() == 2 );
+
+    WHEN("the graph runs again"){
+        pool.endFrame();
+        REQUIRE( graph.execute(pool).has_value() );
+        THEN("the pooled textures are reused"){
+            CHECK( pool.allocations() == 2 );
+        }
+    }
+    WHEN("the pooled textures go unused"){
+        for (int frame {0}; frame < 5; frame++) {
+            pool.endFrame();
+        }
+        THEN("they are freed"){
+            CHECK( pool.textureCount() == 0 );
+            CHECK( pool.allocatedBytes() == 0 );
+        }
+    }
+    CHECK( glGetError() == GL_NO_ERROR );
+}
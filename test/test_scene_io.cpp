@@ -0,0 +1,434 @@
+#include <catch2/catch_test_macros.hpp>
+#include <scene_io.h>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+auto sameTransform(const sjd::Transform& a, const sjd::Transform& b) -> bool {
+    const glm::quat& p {a.rotation};
+    const glm::quat& q {b.rotation};
+    return a.position == b.position && a.scale == b.scale
+        && p.w == q.w && p.x == q.x && p.y == q.y && p.z == q.z;
+}
+
+auto sameMaterial(const sjd::Material& a, const sjd::Material& b) -> bool {
+    return a.m_ambient == b.m_ambient && a.m_diffuse == b.m_diffuse && a.m_specular == b.m_specular
+        && a.m_shininess == b.m_shininess;
+}
+
+// exact, since both formats read back the floats they were given
+auto sameDocument(const sjd::SceneDocument& a, const sjd::SceneDocument& b) -> bool {
+    if (a.meshes.size() != b.meshes.size() || a.materials.size() != b.materials.size()
+        || a.objects.size() != b.objects.size()) {
+        return false;
+    }
+    for (size_t i {0}; i < a.meshes.size(); i++) {
+        const sjd::MeshData& x {a.meshes[i].data};
+        const sjd::MeshData& y {b.meshes[i].data};
+        if (a.meshes[i].name != b.meshes[i].name || x.positions != y.positions || x.normals != y.normals
+            || x.texCoords != y.texCoords || x.indices != y.indices) {
+            return false;
+        }
+    }
+    for (size_t i {0}; i < a.materials.size(); i++) {
+        if (a.materials[i].name != b.materials[i].name
+            || !sameMaterial(a.materials[i].material, b.materials[i].material)) {
+            return false;
+        }
+    }
+    for (size_t i {0}; i < a.objects.size(); i++) {
+        const sjd::SceneObject& x {a.objects[i]};
+        const sjd::SceneObject& y {b.objects[i]};
+        if (x.name != y.name || x.mesh != y.mesh || x.material != y.material
+            || !sameTransform(x.transform, y.transform)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+auto makeObject(size_t index, uint32_t meshes, uint32_t materials) -> sjd::SceneObject {
+    float f {static_cast<float>(index)};
+    sjd::SceneObject object {};
+    object.name = "object_" + std::to_string(index);
+    object.mesh = static_cast<uint32_t>(index % meshes);
+    // every seventh object goes without a material
+    object.material = index % 7 == 0 ? sjd::NO_MATERIAL : static_cast<uint32_t>(index % materials);
+    object.transform.position = glm::vec3(f * 0.1f, -f / 3.0f, 1.0e6f + f);
+    object.transform.rotation = glm::normalize(glm::quat(1.0f, 0.1f * f, 0.2f, -0.3f));
+    object.transform.scale = glm::vec3(1.0f + f * 0.01f, 0.5f, 2.0f);
+    return object;
+}
+
+auto makeDocument(size_t objects) -> sjd::SceneDocument {
+    sjd::SceneDocument document {};
+    document.meshes.push_back({"sphere", sjd::makeUvSphere(8, 6)});
+    sjd::MeshData triangle {};
+    triangle.positions = {glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)};
+    triangle.indices = {0, 1, 2};
+    document.meshes.push_back({"bare_triangle", triangle});
+    document.materials.push_back({"steel", {glm::vec3(0.1f), glm::vec3(0.5f, 0.5f, 0.55f), glm::vec3(0.9f), 64.0f}});
+    document.materials.push_back({"rubber", {glm::vec3(0.0f), glm::vec3(0.05f), glm::vec3(0.1f), 2.5f}});
+    for (size_t i {0}; i < objects; i++) {
+        document.objects.push_back(makeObject(i, 2, 2));
+    }
+    return document;
+}
+
+auto write(const sjd::SceneDocument& document, sjd::SCENE_FORMAT format) -> std::string {
+    std::ostringstream out {};
+    REQUIRE( sjd::writeSceneDocument(out, document, format).has_value() );
+    return out.str();
+}
+
+auto read(const std::string& text,
+          const sjd::SceneReadSettings& settings = {}) -> std::expected<sjd::SceneDocument, sjd::SCENE_ERROR> {
+    std::istringstream in {text};
+    return sjd::readSceneDocument(in, settings);
+}
+
+}
+
+TEST_CASE("Scenes round trip through both formats"){
+    sjd::SceneDocument document {makeDocument(200)};
+    sjd::WorkerPool pool {3};
+
+    for (sjd::SCENE_FORMAT format : {sjd::SCENE_FORMAT::USDA, sjd::SCENE_FORMAT::BINARY}) {
+        std::string text {write(document, format)};
+
+        WHEN("the whole file fits in one chunk"){
+            std::expected<sjd::SceneDocument, sjd::SCENE_ERROR> reread {read(text)};
+            REQUIRE( reread.has_value() );
+            CHECK( sameDocument(*reread, document) );
+        }
+        WHEN("chunks are smaller than a prim and parsed in parallel"){
+            sjd::SceneReadSettings settings {};
+            settings.chunkBytes = 64;
+            settings.batchSize = 4;
+            settings.pool = &pool;
+            std::expected<sjd::SceneDocument, sjd::SCENE_ERROR> reread {read(text, settings)};
+            REQUIRE( reread.has_value() );
+            CHECK( sameDocument(*reread, document) );
+        }
+        WHEN("objects are formatted in parallel"){
+            std::ostringstream out {};
+            sjd::SceneWriter writer {out, format, &pool};
+            REQUIRE( writer.writeMesh(document.meshes[0]).has_value() );
+            REQUIRE( writer.writeMesh(document.meshes[1]).has_value() );
+            REQUIRE( writer.writeMaterial(document.materials[0]).has_value() );
+            REQUIRE( writer.writeMaterial(document.materials[1]).has_value() );
+            REQUIRE( writer.writeObjects(document.objects).has_value() );
+            writer.finish();
+            THEN("the file is the same as one written serially"){
+                CHECK( writer.primCount() == 204 );
+                CHECK( writer.bytesWritten() == text.size() );
+                CHECK( out.str() == text );
+            }
+        }
+    }
+}
+
+TEST_CASE("Scenes are streamed to the callbacks in file order"){
+    sjd::SceneDocument document {makeDocument(5000)};
+    std::string text {write(document, sjd::SCENE_FORMAT::USDA)};
+    sjd::WorkerPool pool {3};
+    sjd::SceneReadSettings settings {};
+    settings.chunkBytes = 16 << 10;
+    settings.pool = &pool;
+
+    std::vector<std::string> order {};
+    sjd::SceneCallbacks callbacks {};
+    callbacks.mesh = [&](sjd::SceneMesh&& mesh) { order.push_back(mesh.name); };
+    callbacks.object = [&](sjd::SceneObject&& object) { order.push_back(object.name); };
+    std::istringstream in {text};
+    std::expected<sjd::SceneReadStats, sjd::SCENE_ERROR> stats {sjd::readScene(in, callbacks, settings)};
+
+    REQUIRE( stats.has_value() );
+    CHECK( stats->meshes == 2 );
+    CHECK( stats->materials == 2 );
+    CHECK( stats->objects == 5000 );
+    CHECK( stats->bytes == text.size() );
+    REQUIRE( order.size() == 5002 );
+    CHECK( order[0] == "sphere" );
+    CHECK( order[2] == "object_0" );
+    CHECK( order[5001] == "object_4999" );
+    THEN("only a few chunks' worth of the file is held at once"){
+        CHECK( stats->peakBufferedBytes < text.size() / 4 );
+    }
+}
+
+TEST_CASE("USDA scenes are laid out for USD tools"){
+    std::string text {write(makeDocument(8), sjd::SCENE_FORMAT::USDA)};
+
+    CHECK( text.starts_with("#usda 1.0\n") );
+    CHECK( text.find("defaultPrim = \"World\"") != std::string::npos );
+    CHECK( text.find("class \"Prototypes\"\n{\n    def Mesh \"sphere\"") != std::string::npos );
+    CHECK( text.find("def Scope \"Materials\"\n{\n    def Material \"steel\"") != std::string::npos );
+    CHECK( text.find("prepend references = </Prototypes/bare_triangle>") != std::string::npos );
+    CHECK( text.find("rel material:binding = </Materials/rubber>") != std::string::npos );
+    CHECK( text.find("custom float mage:shininess = 64") != std::string::npos );
+    CHECK( text.find("xformOpOrder = [\"xformOp:translate\", \"xformOp:orient\", \"xformOp:scale\"]")
+           != std::string::npos );
+    // object_0 has no material to bind
+    size_t first {text.find("def \"object_0\"")};
+    REQUIRE( first != std::string::npos );
+    CHECK( text.compare(first, 35, "def \"object_0\" (\n        instanceab") == 0 );
+}
+
+TEST_CASE("USDA written by other tools is read"){
+    std::string text {
+        "#usda 1.0\n"
+        "(\n"
+        "    doc = \"hand written { with braces }\"\n"
+        "    defaultPrim = \"World\"\n"
+        ")\n"
+        "\n"
+        "class \"Prototypes\"\n"
+        "{\n"
+        "    # a quad, which is split into two triangles\n"
+        "    def Mesh \"quad\" (\n"
+        "        kind = \"component\"\n"
+        "    )\n"
+        "    {\n"
+        "        int[] faceVertexCounts = [4]\n"
+        "        int[] faceVertexIndices = [0, 1, 2, 3]\n"
+        "        point3f[] points = [(0, 0, 0), (1, 0, 0), (1, 1, 0), (0, 1, 0)]\n"
+        "        color3f[] primvars:displayColor = [(1, 0, 0)] (\n"
+        "            interpolation = \"constant\"\n"
+        "        )\n"
+        "        uniform bool doubleSided\n"
+        "        def GeomSubset \"subset\"\n"
+        "        {\n"
+        "            int[] indices = [0]\n"
+        "        }\n"
+        "    }\n"
+        "}\n"
+        "\n"
+        "def Scope \"Looks\"\n"
+        "{\n"
+        "    def Material \"ignored\"\n"
+        "    {\n"
+        "    }\n"
+        "}\n"
+        "\n"
+        "def Xform \"World\"\n"
+        "{\n"
+        "    def \"a\" (\n"
+        "        prepend references = [</Prototypes/quad>]\n"
+        "    )\n"
+        "    {\n"
+        "        float3 xformOp:translate = (1, 2, 3)\n"
+        "    }\n"
+        "}\n"
+    };
+    std::expected<sjd::SceneDocument, sjd::SCENE_ERROR> document {read(text)};
+
+    REQUIRE( document.has_value() );
+    REQUIRE( document->meshes.size() == 1 );
+    CHECK( document->meshes[0].data.indices == std::vector<uint32_t> {0, 1, 2, 0, 2, 3} );
+    CHECK( document->materials.empty() );
+    REQUIRE( document->objects.size() == 1 );
+    CHECK( document->objects[0].name == "a" );
+    CHECK( document->objects[0].mesh == 0 );
+    CHECK( document->objects[0].material == sjd::NO_MATERIAL );
+    CHECK( document->objects[0].transform.position == glm::vec3(1.0f, 2.0f, 3.0f) );
+    CHECK( document->objects[0].transform.scale == glm::vec3(1.0f) );
+}
+
+TEST_CASE("Top level prims with metadata are read"){
+    std::string text {
+        "#usda 1.0\n"
+        "(\n"
+        "    defaultPrim = \"World\"\n"
+        ")\n"
+        "\n"
+        "class \"Prototypes\" (\n"
+        "    doc = \"meshes referenced from /World\"\n"
+        ")\n"
+        "{\n"
+        "    def Mesh \"triangle\"\n"
+        "    {\n"
+        "        int[] faceVertexCounts = [3]\n"
+        "        int[] faceVertexIndices = [0, 1, 2]\n"
+        "        point3f[] points = [(0, 0, 0), (1, 0, 0), (0, 1, 0)]\n"
+        "    }\n"
+        "}\n"
+        "\n"
+        "def Xform \"World\" (kind = \"assembly\") {\n"
+        "    def \"a\" (\n"
+        "        prepend references = [</Prototypes/triangle>]\n"
+        "    )\n"
+        "    {\n"
+        "    }\n"
+        "}\n"
+    };
+    // small chunks split keywords and names between reads
+    for (size_t chunkBytes : {size_t {1} << 20, size_t {7}}) {
+        INFO( chunkBytes << " byte chunks" );
+        sjd::SceneReadSettings settings {};
+        settings.chunkBytes = chunkBytes;
+        std::expected<sjd::SceneDocument, sjd::SCENE_ERROR> document {read(text, settings)};
+
+        REQUIRE( document.has_value() );
+        CHECK( document->meshes.size() == 1 );
+        REQUIRE( document->objects.size() == 1 );
+        CHECK( document->objects[0].name == "a" );
+        CHECK( document->objects[0].mesh == 0 );
+    }
+}
+
+TEST_CASE("Bad scenes are rejected"){
+    sjd::SceneDocument document {makeDocument(3)};
+    std::string usda {write(document, sjd::SCENE_FORMAT::USDA)};
+    std::string binary {write(document, sjd::SCENE_FORMAT::BINARY)};
+
+    WHEN("a file is neither format"){
+        CHECK( read("").error() == sjd::SCENE_ERROR::badHeader );
+        CHECK( read("#sdua 1.0\n").error() == sjd::SCENE_ERROR::badHeader );
+    }
+    WHEN("a binary file is from another version"){
+        std::string other {binary};
+        other[8] = 99;
+        CHECK( read(other).error() == sjd::SCENE_ERROR::version );
+    }
+    WHEN("a file is cut short"){
+        for (size_t cut : {usda.size() / 2, usda.size() - 3}) {
+            CHECK( read(usda.substr(0, cut)).error() == sjd::SCENE_ERROR::truncated );
+        }
+        for (size_t cut : {binary.size() / 2, binary.size() - 1}) {
+            CHECK( read(binary.substr(0, cut)).error() == sjd::SCENE_ERROR::truncated );
+        }
+    }
+    WHEN("a value is malformed"){
+        std::string broken {usda};
+        broken.replace(broken.find("mage:shininess = 64"), 19, "mage:shininess = xx");
+        CHECK( read(broken).error() == sjd::SCENE_ERROR::parse );
+        broken = usda;
+        broken.replace(broken.find("[0, 1, 2]"), 9, "[0, 1, 9]");
+        CHECK( read(broken).error() == sjd::SCENE_ERROR::parse );
+    }
+    WHEN("an object references a missing prim"){
+        std::string broken {usda};
+        broken.replace(broken.find("</Materials/rubber>"), 19, "</Materials/rubbex>");
+        CHECK( read(broken).error() == sjd::SCENE_ERROR::badReference );
+    }
+    WHEN("prims are written out of order or badly named"){
+        std::ostringstream out {};
+        sjd::SceneWriter writer {out, sjd::SCENE_FORMAT::USDA};
+        CHECK( writer.writeMesh({"2d", {}}).error() == sjd::SCENE_ERROR::badName );
+        CHECK( writer.writeMesh({"has space", {}}).error() == sjd::SCENE_ERROR::badName );
+        REQUIRE( writer.writeMesh(document.meshes[0]).has_value() );
+        CHECK( writer.writeMesh(document.meshes[0]).error() == sjd::SCENE_ERROR::badName );
+        sjd::SceneObject object {makeObject(1, 1, 1)};
+        CHECK( writer.writeObject(object).error() == sjd::SCENE_ERROR::badReference );
+        object.material = sjd::NO_MATERIAL;
+        REQUIRE( writer.writeObject(object).has_value() );
+        CHECK( writer.writeObject(object).error() == sjd::SCENE_ERROR::badName );
+        CHECK( writer.writeMaterial(document.materials[0]).error() == sjd::SCENE_ERROR::outOfOrder );
+        writer.finish();
+        CHECK( writer.writeObject(object).error() == sjd::SCENE_ERROR::outOfOrder );
+        THEN("what was written is still a valid scene"){
+            std::expected<sjd::SceneDocument, sjd::SCENE_ERROR> written {read(out.str())};
+            REQUIRE( written.has_value() );
+            CHECK( written->meshes.size() == 1 );
+            CHECK( written->objects.size() == 1 );
+        }
+    }
+    WHEN("a mesh's attributes don't match its positions"){
+        for (sjd::SCENE_FORMAT format : {sjd::SCENE_FORMAT::USDA, sjd::SCENE_FORMAT::BINARY}) {
+            std::ostringstream out {};
+            sjd::SceneWriter writer {out, format};
+            sjd::SceneMesh mesh {document.meshes[0]};
+            mesh.data.normals.pop_back();
+            CHECK( writer.writeMesh(mesh).error() == sjd::SCENE_ERROR::badMesh );
+            mesh = document.meshes[0];
+            mesh.data.texCoords.push_back(glm::vec2(0.0f));
+            CHECK( writer.writeMesh(mesh).error() == sjd::SCENE_ERROR::badMesh );
+            mesh.data.texCoords.clear();
+            mesh.data.normals.clear();
+            CHECK( writer.writeMesh(mesh).has_value() );
+        }
+    }
+    WHEN("objects formatted in parallel share a name"){
+        sjd::WorkerPool pool {3};
+        std::ostringstream out {};
+        sjd::SceneWriter writer {out, sjd::SCENE_FORMAT::USDA, &pool};
+        REQUIRE( writer.writeMesh(document.meshes[0]).has_value() );
+        REQUIRE( writer.writeMesh(document.meshes[1]).has_value() );
+        REQUIRE( writer.writeMaterial(document.materials[0]).has_value() );
+        REQUIRE( writer.writeMaterial(document.materials[1]).has_value() );
+        std::vector<sjd::SceneObject> objects {document.objects};
+        objects.push_back(objects[0]);
+        CHECK( writer.writeObjects(objects).error() == sjd::SCENE_ERROR::badName );
+        THEN("none of them were written, nor their names taken"){
+            CHECK( writer.primCount() == 4 );
+            CHECK( writer.writeObjects(document.objects).has_value() );
+        }
+    }
+}
+
+TEST_CASE("Streaming a scene of a million prims", "[.][benchmark]"){
+    const size_t objects {1000000};
+    const size_t batch {16384};
+    sjd::SceneDocument prototypes {makeDocument(0)};
+    sjd::WorkerPool pool {};
+    std::cout << std::fixed << std::setprecision(1)
+              << "format, workers, write MB/s, read MB/s, read Mprims/s, file MB, peak buffered MB\n";
+
+    for (sjd::SCENE_FORMAT format : {sjd::SCENE_FORMAT::USDA, sjd::SCENE_FORMAT::BINARY}) {
+        std::string path {(std::filesystem::temp_directory_path() / "mage_scene_bench").string()};
+        auto start {std::chrono::steady_clock::now()};
+        {
+            std::ofstream out {path, std::ios::binary};
+            sjd::SceneWriter writer {out, format, &pool};
+            for (const sjd::SceneMesh& mesh : prototypes.meshes) {
+                REQUIRE( writer.writeMesh(mesh).has_value() );
+            }
+            for (const sjd::SceneMaterial& material : prototypes.materials) {
+                REQUIRE( writer.writeMaterial(material).has_value() );
+            }
+            // generated a batch at a time, so the scene never exists in memory
+            std::vector<sjd::SceneObject> objectBatch {};
+            for (size_t first {0}; first < objects; first += batch) {
+                objectBatch.clear();
+                for (size_t i {first}; i < std::min(first + batch, objects); i++) {
+                    objectBatch.push_back(makeObject(i, 2, 2));
+                }
+                REQUIRE( writer.writeObjects(objectBatch).has_value() );
+            }
+        }
+        double writeSeconds {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+        double megabytes {static_cast<double>(std::filesystem::file_size(path)) / (1 << 20)};
+
+        std::vector<sjd::WorkerPool*> readPools {nullptr};
+        if (pool.workerCount() > 0) {
+            readPools.push_back(&pool);
+        }
+        for (sjd::WorkerPool* readPool : readPools) {
+            sjd::SceneReadSettings settings {};
+            settings.pool = readPool;
+            size_t received {0};
+            sjd::SceneCallbacks callbacks {};
+            callbacks.object = [&](sjd::SceneObject&&) { received++; };
+            std::ifstream in {path, std::ios::binary};
+            start = std::chrono::steady_clock::now();
+            std::expected<sjd::SceneReadStats, sjd::SCENE_ERROR> stats {sjd::readScene(in, callbacks, settings)};
+            double readSeconds {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+            REQUIRE( stats.has_value() );
+            CHECK( received == objects );
+
+            std::cout << (format == sjd::SCENE_FORMAT::USDA ? "usda" : "binary") << ", "
+                      << (readPool == nullptr ? 0 : pool.workerCount()) << ", "
+                      << megabytes / writeSeconds << ", " << megabytes / readSeconds << ", "
+                      << static_cast<double>(objects) / readSeconds / 1.0e6 << ", " << megabytes << ", "
+                      << static_cast<double>(stats->peakBufferedBytes) / (1 << 20) << "\n";
+        }
+        std::remove(path.c_str());
+    }
+}
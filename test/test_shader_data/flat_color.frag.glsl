@@ -0,0 +1,10 @@
+#version 330 core
+// one solid colour, for tests that compare pixels
+out vec4 FragColor;
+
+uniform vec3 color;
+
+void main()
+{
+    FragColor = vec4(color, 1.0);
+}
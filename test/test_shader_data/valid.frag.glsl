@@ -50,7 +50,7 @@ void main()
     // phase 1: Directional lighting
     vec3 dirResult = calcDirLight(dirLight, norm, viewDir);
     // point lighting
-    vec3 pointResult = {0, 0, 0};
+    vec3 pointResult = vec3(0.0);
     for (int i = 0; i < numPointLights; i++) {
         pointResult += calcPointLight(pointLights[i], norm, viewDir);
     }
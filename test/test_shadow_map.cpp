@@ -0,0 +1,203 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <glfw_setup.h>
+#include <shadow_map.h>
+#include <glm/gtc/epsilon.hpp>
+#include <chrono>
+#include "test_fixtures.h"
+#include "test_meshes.h"
+
+const float SPLIT_EPSILON {0.0001f};
+
+TEST_CASE("Cascade splits cover the view range in increasing order"){
+    auto lambda = GENERATE(0.0f, 0.5f, 0.75f, 1.0f);
+    std::vector<float> splits {sjd::computeCascadeSplits(0.1f, 100.0f, 4, lambda)};
+
+    REQUIRE( splits.size() == 5 );
+    CHECK( splits.front() == 0.1f );
+    CHECK( splits.back() == 100.0f );
+    for (size_t i {1}; i < splits.size(); i++) {
+        CHECK( splits[i] > splits[i - 1] );
+    }
+
+    WHEN("the splits are purely uniform"){
+        std::vector<float> uniform {sjd::computeCascadeSplits(10.0f, 90.0f, 4, 0.0f)};
+        THEN("every cascade is the same length"){
+            CHECK( std::abs(uniform[1] - 30.0f) < SPLIT_EPSILON );
+            CHECK( std::abs(uniform[2] - 50.0f) < SPLIT_EPSILON );
+            CHECK( std::abs(uniform[3] - 70.0f) < SPLIT_EPSILON );
+        }
+    }
+}
+
+TEST_CASE("Frustum slice corners lie on the near and far planes"){
+    sjd::Camera camera {};
+    glm::mat4 view {camera.getViewMatrix()};
+    auto corners {sjd::frustumSliceCorners(view, glm::radians(45.0f), 1.5f, 1.0f, 10.0f)};
+
+    for (size_t i {0}; i < corners.size(); i++) {
+        glm::vec4 viewSpace {view * glm::vec4(corners[i], 1.0f)};
+        float expected {i < 4 ? -1.0f : -10.0f};
+        INFO("corner " << i << " has view depth " << viewSpace.z);
+        CHECK( std::abs(viewSpace.z - expected) < 0.001f );
+    }
+}
+
+TEST_CASE("A fitted cascade encloses its slice and snaps to texels"){
+    const uint32_t resolution {1024};
+    glm::vec3 lightDir {glm::normalize(glm::vec3(-0.3f, -1.0f, -0.2f))};
+    sjd::Camera camera {glm::vec3(2.0f, 1.5f, 6.0f), glm::vec3(0.0f)};
+    auto corners {sjd::frustumSliceCorners(camera.getViewMatrix(),
+                                           glm::radians(45.0f), 1.5f, 0.5f, 20.0f)};
+    glm::mat4 lightSpace {sjd::fitCascade(corners, lightDir, resolution, 10.0f)};
+
+    THEN("every corner projects inside the shadow map"){
+        for (const glm::vec3& corner : corners) {
+            glm::vec4 ndc {lightSpace * glm::vec4(corner, 1.0f)};
+            CHECK( std::abs(ndc.x) <= 1.0f );
+            CHECK( std::abs(ndc.y) <= 1.0f );
+            CHECK( std::abs(ndc.z) <= 1.0f );
+        }
+    }
+
+    WHEN("the camera moves a fraction of a texel"){
+        std::array<glm::vec3, 8> moved {corners};
+        for (glm::vec3& corner : moved) {
+            corner += glm::vec3(0.003f, 0.0f, 0.002f);
+        }
+        glm::mat4 movedSpace {sjd::fitCascade(moved, lightDir, resolution, 10.0f)};
+
+        THEN("a world point moves by zero or exactly one texel"){
+            glm::vec4 before {lightSpace * glm::vec4(1.0f, 0.0f, 1.0f, 1.0f)};
+            glm::vec4 after {movedSpace * glm::vec4(1.0f, 0.0f, 1.0f, 1.0f)};
+            float texel {2.0f / static_cast<float>(resolution)};
+            for (int axis {0}; axis < 2; axis++) {
+                float shift {std::abs(after[axis] - before[axis]) / texel};
+                INFO("shift in texels along axis " << axis << ": " << shift);
+                CHECK( (shift < 0.01f || std::abs(shift - 1.0f) < 0.01f) );
+            }
+        }
+    }
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(WindowFixture,
+                             "Static cascades are only redrawn when invalidated"){
+    sjd::CascadedShadowMap shadows {"../src/glsl/depth_only.vert.glsl",
+                                    "../src/glsl/depth_only.frag.glsl",
+                                    sjd::ShadowSettings{.resolution = 512}};
+    REQUIRE( shadows.isValid() );
+
+    sjd::Camera camera {};
+    TestCube floor {glm::vec3(0.0f, -1.0f, 0.0f), 10.0f};
+    TestCube crate {glm::vec3(0.0f, 0.5f, 0.0f)};
+    std::vector<sjd::Mesh*> staticCasters {&floor};
+    std::vector<sjd::Mesh*> dynamicCasters {&crate};
+    glm::vec3 lightDir {-0.2f, -1.0f, -0.3f};
+
+    auto frame = [&](){
+        shadows.update(camera, 800.0f / 600.0f, 0.1f, 100.0f, lightDir);
+        shadows.render(staticCasters, dynamicCasters);
+    };
+
+    frame();
+    REQUIRE( shadows.cascadesRendered() == 4 );
+
+    WHEN("nothing changes between frames"){
+        frame();
+        THEN("only the dynamic cascades are redrawn"){
+            CHECK( shadows.cascadesRendered() == 2 );
+        }
+    }
+    WHEN("the static casters are invalidated"){
+        shadows.invalidateStaticCasters();
+        frame();
+        THEN("every cascade is redrawn"){
+            CHECK( shadows.cascadesRendered() == 4 );
+        }
+    }
+    WHEN("the light direction changes"){
+        lightDir = glm::vec3(0.3f, -1.0f, 0.1f);
+        frame();
+        THEN("every cascade is redrawn"){
+            CHECK( shadows.cascadesRendered() == 4 );
+        }
+    }
+    WHEN("caching is turned off"){
+        shadows.setCaching(false);
+        frame();
+        frame();
+        THEN("every cascade is redrawn every frame"){
+            CHECK( shadows.cascadesRendered() == 4 );
+        }
+    }
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(WindowFixture,
+                             "A lighting shader's shadow map has a unit of its own"){
+    sjd::Shader shader {"../src/glsl/simple.lighting.vert.glsl",
+                        "../src/glsl/blinn_phong16.frag.glsl"};
+    REQUIRE( shader.isValid() );
+
+    THEN("the sampler is on the reserved unit as soon as the shader is linked"){
+        GLint unit {-1};
+        glGetUniformiv(shader.id(), glGetUniformLocation(shader.id(), "shadowMap"), &unit);
+        CHECK( unit == sjd::SHADOW_MAP_UNIT );
+    }
+    THEN("a complete fallback is bound there until a shadow map is"){
+        glActiveTexture(GL_TEXTURE0 + sjd::SHADOW_MAP_UNIT);
+        GLint fallback {0};
+        glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &fallback);
+        CHECK( fallback != 0 );
+
+        sjd::CascadedShadowMap shadows {"../src/glsl/depth_only.vert.glsl",
+                                        "../src/glsl/depth_only.frag.glsl",
+                                        sjd::ShadowSettings{.resolution = 64}};
+        REQUIRE( shadows.isValid() );
+        shadows.bind(shader);
+        glActiveTexture(GL_TEXTURE0 + sjd::SHADOW_MAP_UNIT);
+        GLint bound {0};
+        glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &bound);
+        CHECK( bound != fallback );
+
+        sjd::CascadedShadowMap::unbind(shader);
+        glActiveTexture(GL_TEXTURE0 + sjd::SHADOW_MAP_UNIT);
+        glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &bound);
+        CHECK( bound == fallback );
+        glActiveTexture(GL_TEXTURE0);
+        CHECK( glGetError() == GL_NO_ERROR );
+    }
+}
+
+TEST_CASE_PERSISTENT_FIXTURE(WindowFixture,
+                             "Shadow pass time with and without cascade caching",
+                             "[.][benchmark]"){
+    sjd::CascadedShadowMap shadows {"../src/glsl/depth_only.vert.glsl",
+                                    "../src/glsl/depth_only.frag.glsl"};
+    REQUIRE( shadows.isValid() );
+
+    sjd::Camera camera {glm::vec3(0.0f, 2.0f, 10.0f)};
+    std::vector<TestCube> cubes;
+    cubes.reserve(400);
+    for (int x {-10}; x < 10; x++) {
+        for (int z {-10}; z < 10; z++) {
+            cubes.emplace_back(glm::vec3(x * 3.0f, 0.0f, z * 3.0f));
+        }
+    }
+    std::vector<sjd::Mesh*> staticCasters;
+    for (TestCube& cube : cubes) {
+        staticCasters.push_back(&cube);
+    }
+    std::vector<sjd::Mesh*> dynamicCasters {staticCasters.begin(), staticCasters.begin() + 8};
+    glm::vec3 lightDir {-0.2f, -1.0f, -0.3f};
+
+    for (bool caching : {false, true}) {
+        shadows.setCaching(caching);
+        BENCHMARK(caching ? "shadow pass, cached" : "shadow pass, uncached"){
+            camera.processMovement(sjd::Camera::FORWARD, 0.001f);
+            shadows.update(camera, 800.0f / 600.0f, 0.1f, 200.0f, lightDir);
+            shadows.render(staticCasters, dynamicCasters);
+            glFinish();
+            return shadows.cascadesRendered();
+        };
+    }
+}